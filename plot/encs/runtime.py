@@ -1,6 +1,9 @@
+import sys
+
 import numpy as np
 from scipy.optimize import curve_fit
 
+from histogram import HistogramData
 from encs.plots import plot_runtime
 from plotter import enc_data_dir, enc_figure_dir, combine_plotters
 
@@ -54,10 +57,52 @@ def fit_func(x, a, b, c):
     return a*pow(x, b) + c
 # TODO: Include log?
 
+
+def runtime_scaling(hist):
+    """Mean runtimes per jet (in ms) and their standard deviations,
+    by number of particles M, and the fit of fit_func to the means
+    (whose second parameter is the exponent of M).
+
+    Numbers of particles without jets are left out; each mean is
+    weighted by its standard error, when the file has the number
+    of jets of each multiplicity (`runtime_counts`).
+    """
+    means = np.array(hist.metadata['runtime_means'], dtype=float)/1000
+    stds  = np.array(hist.metadata['runtime_stds'], dtype=float)/1000
+    nums  = np.arange(0, len(means))
+
+    # Removing nans
+    valid = ~np.isnan(means)
+    nums, means, stds = nums[valid], means[valid], stds[valid]
+
+    sigma = None
+    if 'runtime_counts' in hist.metadata:
+        counts = np.array(hist.metadata['runtime_counts'],
+                          dtype=float)[valid]
+        errors = stds/np.sqrt(counts)
+        known = np.isfinite(errors) & (errors > 0)
+        if np.any(known):
+            # (as uncertain as the least certain mean, where there
+            #  are too few jets to tell)
+            sigma = np.where(known, errors, np.max(errors[known]))
+
+    fit, _ = curve_fit(fit_func, nums, means, sigma=sigma,
+                       maxfev=10000)
+    return nums, means, stds, fit
+
 # =====================================
 # Main
 # =====================================
 if __name__ == "__main__":
+    # Scaling exponents of the runtimes of any given runs, e.g.
+    #   python3 -m encs.runtime ../output/new_encs/3particle_*.py
+    if len(sys.argv) > 1:
+        for file_name in sys.argv[1:]:
+            _, _, _, fit = runtime_scaling(
+                    HistogramData(file_name=file_name))
+            print(f"{file_name}: t ~ M^{fit[1]:.2f}")
+        sys.exit(0)
+
     # =====================================
     # Opendata Plots
     # =====================================
@@ -73,16 +118,8 @@ if __name__ == "__main__":
                 save=None,
                 **runtime_plot_params,
         )
-        # Preparing for fill_between
-        means_1d = np.array(hist_1d.metadata['runtime_means'])/1000
-        stds_1d  = np.array(hist_1d.metadata['runtime_stds'])/1000
-        nans     = np.isnan(means_1d) * np.isnan(stds_1d)
-        # Removing nans
-        nums_1d  = np.arange(0, len(means_1d))[~nans]
-        means_1d = means_1d[~nans]
-        stds_1d  = stds_1d[~nans]
-        # Getting slope
-        fit_1d, _ = curve_fit(fit_func, nums_1d, means_1d)
+        # Preparing for fill_between, and getting slope
+        nums_1d, means_1d, stds_1d, fit_1d = runtime_scaling(hist_1d)
 
         # ---------------------------------
         # 3 particles:
@@ -95,16 +132,8 @@ if __name__ == "__main__":
                 save=None,
                 **runtime_plot_params,
         )
-        # Preparing for fill_between
-        means_3d = np.array(hist_3d.metadata['runtime_means'])/1000
-        stds_3d  = np.array(hist_3d.metadata['runtime_stds'])/1000
-        nans     = np.isnan(means_3d) * np.isnan(stds_3d)
-        # Removing nans
-        nums_3d  =np.arange(0, len(means_3d))[~nans]
-        means_3d = means_3d[~nans]
-        stds_3d  = stds_3d[~nans]
-        # Getting slope
-        fit_3d, _ = curve_fit(fit_func, nums_3d, means_3d)
+        # Preparing for fill_between, and getting slope
+        nums_3d, means_3d, stds_3d, fit_3d = runtime_scaling(hist_3d)
 
         # ---------------------------------
         # 4 particles:
@@ -118,16 +147,8 @@ if __name__ == "__main__":
                 save=None,
                 **runtime_plot_params,
         )
-        # Preparing for fill_between
-        means_5d = np.array(hist_5d.metadata['runtime_means'])/1000
-        stds_5d  = np.array(hist_5d.metadata['runtime_stds'])/1000
-        nans     = np.isnan(means_5d) * np.isnan(stds_5d)
-        # Removing nans
-        nums_5d  =np.arange(0, len(means_5d))[~nans]
-        means_5d = means_5d[~nans]
-        stds_5d  = stds_5d[~nans]
-        # Getting slope
-        fit_5d, _ = curve_fit(fit_func, nums_5d, means_5d)
+        # Preparing for fill_between, and getting slope
+        nums_5d, means_5d, stds_5d, fit_5d = runtime_scaling(hist_5d)
 
         # ---------------------------------
         # Plotting:
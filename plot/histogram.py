@@ -1,10 +1,189 @@
 import numpy as np
 import importlib.util
+import struct
+import zipfile
 
 from matplotlib.colors import Normalize, LogNorm
 from plotter import Plotter, PolarPlotter
 
 
+# #:#:#:#:#:#:#:#:#:#:#:#:#:#:#:#:#:#:#:#
+# Sparse Histograms
+# #:#:#:#:#:#:#:#:#:#:#:#:#:#:#:#:#:#:#:#
+class SparseHist:
+    """
+    A histogram stored as the indices and values of its filled
+    bins (coordinate format), as written for sparse histograms.
+
+    Supports the operations HistogramData uses on histograms
+    (copies, scaling by arrays which broadcast against the
+    histogram, sums over axes, and indexing with integers and
+    slices) without ever allocating the full histogram; use
+    todense() to get it as a numpy array.
+    """
+    def __init__(self, shape, indices, values):
+        self.shape = tuple(int(n) for n in shape)
+        self.indices = np.asarray(indices, dtype=np.int64
+                                  ).reshape(-1, len(self.shape))
+        self.values = np.asarray(values, dtype=float).reshape(-1)
+        if len(self.indices) != len(self.values):
+            raise ValueError(f"Given {len(self.indices)} indices, "
+                             f"but {len(self.values)} values, for "
+                             "a sparse histogram.")
+
+
+    @property
+    def ndim(self):
+        return len(self.shape)
+
+
+    @property
+    def nnz(self):
+        """Number of filled bins."""
+        return len(self.values)
+
+
+    def copy(self):
+        return SparseHist(self.shape, self.indices.copy(),
+                          self.values.copy())
+
+
+    def todense(self):
+        """The full histogram, as a numpy array."""
+        hist = np.zeros(self.shape)
+        if self.nnz > 0:
+            hist[tuple(self.indices.T)] = self.values
+        return hist
+
+
+    def __array__(self, dtype=None, copy=None):
+        # (so that numpy functions never silently allocate the full
+        #  histogram)
+        raise TypeError("Sparse histograms are not converted to "
+                        "numpy arrays implicitly; use todense().")
+
+
+    def _broadcast(self, other):
+        """Values of other at each filled bin, as in numpy
+        broadcasting of other against the histogram."""
+        other = np.asarray(other, dtype=float)
+        if other.ndim == 0:
+            return other
+        if other.ndim > self.ndim:
+            raise ValueError(f"Cannot broadcast shape {other.shape} "
+                             f"against a histogram of shape "
+                             f"{self.shape}.")
+        other = other.reshape((1,)*(self.ndim - other.ndim)
+                              + other.shape)
+        for axis, size in enumerate(other.shape):
+            if size not in (1, self.shape[axis]):
+                raise ValueError("Cannot broadcast shape "
+                                 f"{other.shape} against a "
+                                 f"histogram of shape {self.shape}.")
+        return other[tuple(self.indices[:, axis] if size > 1
+                           else np.zeros(self.nnz, dtype=np.int64)
+                           for axis, size in enumerate(other.shape))]
+
+
+    def __imul__(self, other):
+        self.values *= self._broadcast(other)
+        return self
+
+
+    def __itruediv__(self, other):
+        self.values /= self._broadcast(other)
+        return self
+
+
+    def __mul__(self, other):
+        result = self.copy()
+        result *= other
+        return result
+
+
+    def __truediv__(self, other):
+        result = self.copy()
+        result /= other
+        return result
+
+
+    __rmul__ = __mul__
+
+
+    def sum(self, axis=None):
+        """Sum over the given axes (or over all bins, if None)."""
+        if axis is None:
+            return self.values.sum()
+        axes = {a % self.ndim for a in np.atleast_1d(axis)}
+        kept = [a for a in range(self.ndim) if a not in axes]
+        if not kept:
+            return self.values.sum()
+
+        # Summing the values of filled bins with the same indices
+        # along the remaining axes
+        indices, inverse = np.unique(self.indices[:, kept], axis=0,
+                                     return_inverse=True)
+        values = np.zeros(len(indices))
+        np.add.at(values, inverse.reshape(-1), self.values)
+        return SparseHist([self.shape[a] for a in kept],
+                          indices, values)
+
+
+    def nansum(self):
+        """Sum over all bins, ignoring NaNs."""
+        return np.nansum(self.values)
+
+
+    def take(self, index, axis):
+        """The histogram at the given index along the given axis."""
+        key = [slice(None)]*self.ndim
+        key[axis] = index
+        return self[tuple(key)]
+
+
+    def __getitem__(self, key):
+        if not isinstance(key, tuple):
+            key = (key,)
+        if len(key) > self.ndim:
+            raise IndexError(f"Too many indices for a histogram of "
+                             f"shape {self.shape}.")
+        key = key + (slice(None),)*(self.ndim - len(key))
+
+        mask = np.ones(self.nnz, dtype=bool)
+        shape, columns = [], []
+        for axis, (size, item) in enumerate(zip(self.shape, key)):
+            indices = self.indices[:, axis]
+            if isinstance(item, slice):
+                start, stop, step = item.indices(size)
+                if step > 0:
+                    mask &= (indices >= start) & (indices < stop)
+                else:
+                    mask &= (indices <= start) & (indices > stop)
+                mask &= (indices - start) % step == 0
+                shape.append(len(range(start, stop, step)))
+                columns.append((indices - start) // step)
+            else:
+                item = int(item)
+                if not -size <= item < size:
+                    raise IndexError(f"Index {item} is out of bounds "
+                                     f"for axis {axis} of size "
+                                     f"{size}.")
+                mask &= indices == item % size
+
+        # (a single bin, for integer indices along every axis)
+        if not shape:
+            return self.values[mask].sum()
+        return SparseHist(shape,
+                          np.stack([column[mask] for column in columns],
+                                   axis=-1),
+                          self.values[mask])
+
+
+    def __repr__(self):
+        return (f"SparseHist(shape={self.shape}, "
+                f"filled bins={self.nnz})")
+
+
 # #:#:#:#:#:#:#:#:#:#:#:#:#:#:#:#:#:#:#:#
 # Base Histogram Class
 # #:#:#:#:#:#:#:#:#:#:#:#:#:#:#:#:#:#:#:#
@@ -91,6 +270,10 @@ class HistogramData:
         Identifies 'hist', bin edges, and bin centers,
         while storing other attributes separately.
         """
+        if str(file_name).endswith('.npz'):
+            self.load_npz(file_name)
+            return
+
         # Load the module from the given file
         spec = importlib.util.spec_from_file_location("data_file", file_name)
         data_file = importlib.util.module_from_spec(spec)
@@ -106,20 +289,104 @@ class HistogramData:
                 continue
 
             attr_value = getattr(data_file, attr_name)
-
-            # Identify 'hist', 'edges', 'centers', and other attributes
             if attr_name == 'hist':
-                self.hist = np.array(attr_value)
-            elif attr_name.endswith('_edges'):
-                self.edges[attr_name[:-6]] = np.array(attr_value)
-            elif attr_name.endswith('edges'):
-                self.edges[attr_name[:-5]] = np.array(attr_value)
-            elif attr_name.endswith('_centers'):
-                self.centers[attr_name[:-8]] = np.array(attr_value)
-            elif attr_name.endswith('centers'):
-                self.centers[attr_name[:-7]] = np.array(attr_value)
-            else:
-                self.metadata[attr_name] = attr_value
+                attr_value = np.array(attr_value)
+            self.store_attribute(attr_name, attr_value)
+
+        self.load_sparse_hist()
+
+
+    def load_npz(self, file_name):
+        """
+        Loads the data from the given binary (.npz) file.
+
+        Arrays stored without compression (as written by the
+        C++ executables) are memory-mapped rather than read, so
+        that only the parts of the histogram which are used are
+        ever read from disk.
+        """
+        with open(file_name, 'rb') as raw_file, \
+                zipfile.ZipFile(raw_file) as archive:
+            for info in archive.infolist():
+                name = info.filename[:-len('.npy')]
+                if info.compress_type != zipfile.ZIP_STORED:
+                    with archive.open(info) as member:
+                        value = np.lib.format.read_array(member)
+                else:
+                    value = self._map_npy(file_name, raw_file, info)
+
+                # Scalars and strings are stored as 0-d arrays
+                if value.ndim == 0:
+                    value = value.item()
+                elif name != 'hist':
+                    value = np.array(value)
+                self.store_attribute(name, value)
+
+        self.load_sparse_hist()
+
+
+    @staticmethod
+    def _map_npy(file_name, raw_file, info):
+        """Memory-maps an uncompressed .npy file in an archive."""
+        # Skipping the local header of the archive member
+        raw_file.seek(info.header_offset)
+        local_header = raw_file.read(30)
+        name_length, extra_length = struct.unpack('<HH',
+                                                  local_header[26:30])
+        raw_file.seek(info.header_offset + 30
+                      + name_length + extra_length)
+
+        # and then the .npy header
+        version = np.lib.format.read_magic(raw_file)
+        if version == (1, 0):
+            header = np.lib.format.read_array_header_1_0(raw_file)
+        else:
+            header = np.lib.format.read_array_header_2_0(raw_file)
+        shape, fortran_order, dtype = header
+
+        if len(shape) == 0 or 0 in shape:
+            return np.fromfile(raw_file, dtype=dtype,
+                               count=int(np.prod(shape))
+                               ).reshape(shape)
+        return np.memmap(file_name, dtype=dtype, mode='r',
+                         offset=raw_file.tell(), shape=shape,
+                         order='F' if fortran_order else 'C')
+
+
+    def store_attribute(self, attr_name, attr_value):
+        """Stores a loaded histogram, bin edges/centers or metadata."""
+        # Identify 'hist', 'edges', 'centers', and other attributes
+        if attr_name == 'hist':
+            self.hist = attr_value
+        elif attr_name.endswith('_edges'):
+            self.edges[attr_name[:-6]] = np.array(attr_value)
+        elif attr_name.endswith('edges'):
+            self.edges[attr_name[:-5]] = np.array(attr_value)
+        elif attr_name.endswith('_centers'):
+            self.centers[attr_name[:-8]] = np.array(attr_value)
+        elif attr_name.endswith('centers'):
+            self.centers[attr_name[:-7]] = np.array(attr_value)
+        else:
+            self.metadata[attr_name] = attr_value
+
+
+    def load_sparse_hist(self):
+        """Keeps a loaded sparse histogram in coordinate format."""
+        # Sparse histograms are stored in coordinate format:
+        # the full shape, and the indices and value of each filled bin
+        # (which are only filled into a dense histogram on request,
+        #  since the dense histogram may not fit in memory)
+        if self.hist is None and 'hist_shape' in self.metadata:
+            self.hist = SparseHist(self.metadata.pop('hist_shape'),
+                                   self.metadata.pop('hist_indices'),
+                                   self.metadata.pop('hist_values'))
+
+
+    def densify(self):
+        """Converts a sparse histogram into a dense one, in place."""
+        if isinstance(self.hist, SparseHist):
+            self.hist = self.hist.todense()
+        return self
 
 
     def validate(self):
@@ -246,7 +513,19 @@ class HistogramData:
 
         # Stack all bin centers together as a grid for the function application
         # TODO: DEBUG
-        if func is not None:
+        if func is not None and isinstance(total, SparseHist):
+            # (evaluating the function only at the filled bins)
+            filled_centers = np.stack([
+                np.ravel(centers)[total.indices[:, i]]
+                for i, centers in enumerate(bin_centers_list)],
+                axis=-1)
+            filled_outflow = np.any([
+                is_outflow_bin[total.indices[:, i]]
+                for i, is_outflow_bin in enumerate(is_outflow_bin_list)],
+                axis=0)
+            total *= np.where(filled_outflow, outflow_weight,
+                              func(filled_centers))
+        elif func is not None:
             # Generate a grid of bin centers across all dimensions
             bin_centers_grid = np.stack(np.meshgrid(*bin_centers_list, indexing='ij'), axis=-1)
 
@@ -269,8 +548,11 @@ class HistogramData:
         # END TODO/DEBUG
 
         # Finally, sum up all the elements in the weighted histogram
-        self.integral = np.nansum(total)
-        return np.nansum(total)
+        if isinstance(total, SparseHist):
+            self.integral = total.nansum()
+        else:
+            self.integral = np.nansum(total)
+        return self.integral
 
 
     def integrate_over_variable(self, var_name, scheme='linear',
@@ -341,7 +623,7 @@ class HistogramData:
         total_hist *= bin_widths
 
         # Sum over the axis corresponding to the integrated variable
-        integrated_hist = np.sum(total_hist, axis=var_index)
+        integrated_hist = total_hist.sum(axis=var_index)
 
         # Remove the integrated variable from the edges and centers
         new_edges = {k: v for k, v in self.edges.items()
@@ -394,7 +676,7 @@ class HistogramData:
                              f"for variable '{var_name}'.")
 
         # Prepare new histogram and bin edges
-        new_hist = np.take(self.hist, bin_index,
+        new_hist = self.hist.take(bin_index,
                        axis=list(self.variable_order).\
                                  index(var_name))
 
@@ -462,6 +744,13 @@ class HistogramData:
 # #:#:#:#:#:#:#:#:#:#:#:#:#:#:#:#:#:#:#:#
 class HistogramData1D(HistogramData):
     """A HistogramData subclass with 1D hists and plotting."""
+    def __init__(self, *args, **kwargs):
+        # (one-dimensional histograms, e.g. projections or slices of
+        #  sparse histograms, are small enough to plot densely)
+        super().__init__(*args, **kwargs)
+        self.densify()
+
+
     def validate(self):
         """
         Validates that the bin edges match the shape of the histogram and that
@@ -498,6 +787,13 @@ class HistogramData1D(HistogramData):
 # #:#:#:#:#:#:#:#:#:#:#:#:#:#:#:#:#:#:#:#
 class HistogramData2D(HistogramData):
     """A HistogramData subclass with 2D hists and plotting."""
+    def __init__(self, *args, **kwargs):
+        # (two-dimensional histograms, e.g. projections or slices of
+        #  sparse histograms, are small enough to plot densely)
+        super().__init__(*args, **kwargs)
+        self.densify()
+
+
     def make_plot(self, plot_type, **kwargs):
         """
         Plots the one-dimensional histogram using the Plotter class.
@@ -7,6 +7,7 @@ from plotter import combine_axes
 from histogram import HistogramData
 from histogram import HistogramData1D
 from histogram import HistogramData2D
+from histogram import SparseHist
 
 from utils.postprocess import collision_stamp
 from utils.gen_utils import mathematica_to_python
@@ -410,6 +411,60 @@ def test_dimensional_reduction(file_path, plot_kwargs):
                                     'tests/figures')
 
 
+def test_sparse_histogram():
+    # A 5d histogram with few filled bins, kept sparse and dense
+    rng = np.random.default_rng(1)
+    shape = (6, 5, 4, 5, 3)
+    flat = rng.choice(np.prod(shape), size=40, replace=False)
+    indices = np.stack(np.unravel_index(flat, shape), axis=-1)
+    values = rng.random(40)
+
+    variables = ['theta1', 'theta2_over_theta1', 'phi2',
+                 'theta3_over_theta2', 'phi3']
+    edges = {var: np.linspace(0, 1, n+1)
+             for var, n in zip(variables, shape)}
+    centers = {var: (e[1:] + e[:-1])/2 for var, e in edges.items()}
+
+    sparse = HistogramData(hist=SparseHist(shape, indices, values),
+                           edges=edges, centers=centers, metadata={},
+                           variable_order=variables)
+    dense = HistogramData(hist=sparse.hist.todense(),
+                          edges=edges, centers=centers, metadata={},
+                          variable_order=variables)
+    assert isinstance(sparse.hist, SparseHist)
+    assert np.count_nonzero(dense.hist) == 40
+
+    # Integrals, projections and slices match, without densifying
+    assert np.isclose(sparse.integrate_histogram(),
+                      dense.integrate_histogram())
+    reduced = sparse.integrate_over_variable('phi2')
+    assert isinstance(reduced.hist, SparseHist)
+    assert np.allclose(reduced.hist.todense(),
+                       dense.integrate_over_variable('phi2').hist)
+    sub = sparse.get_sub_histogram('theta1', 0.5)
+    assert isinstance(sub.hist, SparseHist)
+    assert np.allclose(sub.hist.todense(),
+                       dense.get_sub_histogram('theta1', 0.5).hist)
+    for key in [(2,), (slice(1, 4), 0), (slice(None),),
+                (slice(None, None, -2), slice(1, None), 3)]:
+        assert np.allclose(sparse.hist[key].todense(), dense.hist[key])
+    assert np.isclose(sparse.hist[tuple(indices[0])], values[0])
+
+    weights = np.linspace(1, 2, shape[2]).reshape(1, 1, -1, 1, 1)
+    assert np.allclose((sparse.hist*weights).todense(),
+                       dense.hist*weights)
+
+    # and plotting classes densify their (small) histograms
+    bullseye = HistogramData2D(hist_data=sub.get_sub_histogram(
+                    'theta2_over_theta1', 0.5).get_sub_histogram(
+                    'phi2', 0.5))
+    assert isinstance(bullseye.hist, np.ndarray)
+    assert bullseye.hist.shape == (5, 3)
+
+    with pytest.raises(TypeError):
+        np.asarray(sparse.hist)
+
+
 # ====================================
 # Run with pytest
 # ====================================
@@ -0,0 +1,562 @@
+/**
+ * @file    enc_bench.cc
+ *
+ * @brief   Micro-benchmarks of the ENC kernels, and of the binning
+ *          and azimuthal-angle utilities they use, on deterministic
+ *          synthetic jets of controlled multiplicity, written as JSON.
+ *
+ *          Needs neither Pythia nor the CMS Open Data, so that kernel
+ *          optimizations can be compared on any machine.
+ */
+
+
+// ---------------------------------
+// Basic imports
+// ---------------------------------
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <utility>
+#include <memory>
+#include <functional>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <atomic>
+
+#include <chrono>
+using namespace std::chrono;
+
+// ---------------------------------
+// HEP imports
+// ---------------------------------
+#include "fastjet/PseudoJet.hh"
+
+// Local imports:
+#include "../include/general_utils.h"
+#include "../include/cmdln.h"
+
+#include "../include/jet_geometry.h"
+#include "../include/nd_histogram.h"
+#include "../include/enc_engine.h"
+#include "../include/enc_kernels.h"
+#include "../include/opendata_utils.h"
+#include "../include/synthetic_jets.h"
+
+
+// =====================================
+// Type definitions for correlators
+// =====================================
+// As in the executables for each correlator
+typedef ENCEngine<2> EECEngine;
+typedef ENCEngine<3> EEECEngine;
+typedef ENCEngine<4, PowerWeights, SelectablePhi> EEEECEngine;
+
+
+// =====================================
+// Synthetic jets
+// =====================================
+// A synthetic jet, with its compact kinematics and pairwise angles
+// (used by the benchmarks of the utilities, which should not time
+//  the kinematics of the jet)
+struct BenchJet {
+    std::vector<fastjet::PseudoJet> constituents;
+    CompactJet compact;
+    // Angles of the pairs i < j, in order
+    std::vector<double> pair_angles;
+};
+
+
+// Jets of exactly nparts particles from the synthetic jet generator
+// (see synthetic_jets.h), with its default kinematics
+std::vector<BenchJet> bench_jets(const int nparts, const int njets,
+                                 const int seed,
+                                 const double minbin, const double maxbin,
+                                 const int nbins) {
+    SyntheticJetSettings synthetic;
+    synthetic.seed = seed;
+    synthetic.multiplicity = nparts;
+    synthetic.fixed_multiplicity = true;
+    const SyntheticJets generator(synthetic);
+
+    od::JetConstituents constituents;
+    JetGeometry geometry(minbin, maxbin, nbins);
+
+    std::vector<BenchJet> jets(njets);
+    for (int ijet = 0; ijet < njets; ++ijet) {
+        BenchJet& jet = jets[ijet];
+        generator.generate(ijet, constituents);
+        constituents.to_pseudojets(jet.constituents);
+
+        jet.compact.fill(jet.constituents, true);
+        geometry.fill(jet.compact, true);
+        for (int i = 0; i < nparts; ++i)
+            for (int j = i+1; j < nparts; ++j)
+                jet.pair_angles.push_back(geometry.angle(i, j));
+    }
+    return jets;
+}
+
+
+// =====================================
+// Kernels
+// =====================================
+// Processes jets one at a time, with its own storage (one per thread)
+typedef std::function<void(const BenchJet&)> Worker;
+
+/**
+* @brief: A benchmarked kernel: its name, the unit of work whose
+*         number in a jet of N particles is binomial(N, order), and a
+*         function which makes a worker for each thread.
+*/
+struct BenchKernel {
+    std::string name;
+    std::string unit;
+    int order;
+    std::function<Worker()> make_worker;
+};
+
+
+// Settings shared by the kernels
+struct BenchSettings {
+    double minbin = -4, maxbin = 0;
+    int nbins = 20, nphibins = 20;
+    bool contact_terms = false;
+};
+
+
+// Number of units of work in a jet, binomial(nparts, order)
+double n_units(const int nparts, const int order) {
+    double units = 1;
+    for (int k = 0; k < order; ++k)
+        units *= double(nparts - k)/(k + 1);
+    return units;
+}
+
+
+// Worker for an ENCEngine, which (as in the executables) also fills
+// the kinematics and angles of each jet; ratios of angles are binned
+// linearly, as by default in the executables
+template <class Engine>
+std::function<Worker()> engine_worker(const BenchSettings& settings,
+        const std::vector<typename Engine::nus_t>& nus) {
+    return [=]() {
+        const std::vector<BinAxis> ratio_axes((Engine::n_dims - 1)/2,
+                BinAxis(0, 1, settings.nbins, "lin", false, false));
+        auto engine = std::make_shared<Engine>(
+                JetGeometry(settings.minbin, settings.maxbin,
+                            settings.nbins),
+                ratio_axes,
+                BinAxis(-PI, PI, settings.nphibins, "linear",
+                        false, false),
+                nus, true, true, settings.contact_terms);
+        return Worker([engine](const BenchJet& jet) {
+            engine->process_jet(jet.constituents);
+        });
+    };
+}
+
+
+// Counter which keeps the results of the utilities from being
+// optimized away
+std::atomic<double> bench_sink(0);
+
+
+std::vector<BenchKernel> bench_kernels(const BenchSettings& settings) {
+    std::vector<BenchKernel> kernels;
+
+    kernels.push_back({"2particle", "pair", 2,
+            engine_worker<EECEngine>(settings, {{1}})});
+    kernels.push_back({"3particle", "triple", 3,
+            engine_worker<EEECEngine>(settings, {{1, 1}})});
+    kernels.push_back({"4particle", "quadruple", 4,
+            engine_worker<EEEECEngine>(settings, {{1, 1, 1}})});
+
+    // Kernels outside of ENCEngine
+    kernels.push_back({"2special", "triple", 3, [settings]() {
+        struct State {
+            CompactJet jet;
+            JetGeometry geometry;
+            std::vector<std::pair<double, double>> nus;
+            std::vector<NDHistogram<1>> hist_1;
+            std::vector<NDHistogram<2>> hist_2;
+        };
+        auto state = std::make_shared<State>(State{CompactJet(),
+                JetGeometry(settings.minbin, settings.maxbin,
+                            settings.nbins),
+                {{1, 1}},
+                {NDHistogram<1>(settings.nbins)},
+                {NDHistogram<2>(settings.nbins, settings.nbins)}});
+        return Worker([state, settings](const BenchJet& jet) {
+            state->jet.fill(jet.constituents, true);
+            state->geometry.fill(state->jet, true);
+            two_special_jet(state->jet, state->geometry, state->nus,
+                            state->hist_1, state->hist_2,
+                            settings.contact_terms);
+        });
+    }});
+
+    kernels.push_back({"old_3particle", "triple", 3, [settings]() {
+        struct State {
+            CompactJet jet;
+            JetGeometry geometry;
+            BinAxis binS_axis, phi_axis;
+            NDHistogram<3> hist;
+        };
+        auto state = std::make_shared<State>(State{CompactJet(),
+                JetGeometry(settings.minbin, settings.maxbin,
+                            settings.nbins),
+                BinAxis(0, 1, settings.nbins, "lin", false, false),
+                BinAxis(-PI, PI, settings.nphibins, "linear",
+                        false, false),
+                NDHistogram<3>(settings.nbins, settings.nbins,
+                               settings.nphibins)});
+        return Worker([state, settings](const BenchJet& jet) {
+            state->jet.fill(jet.constituents, true);
+            state->geometry.fill(state->jet, true);
+            old_3particle_jet(state->jet, state->geometry,
+                              state->binS_axis, state->phi_axis,
+                              state->hist, settings.contact_terms);
+        });
+    }});
+
+    // Utilities, on the pairs (or triples) of each jet
+    kernels.push_back({"bin_position", "pair", 2, [settings]() {
+        return Worker([settings](const BenchJet& jet) {
+            int sum_bins = 0;
+            for (const double angle : jet.pair_angles)
+                sum_bins += bin_position(angle, settings.minbin,
+                                         settings.maxbin, settings.nbins,
+                                         "log", true, true);
+            bench_sink = bench_sink + sum_bins;
+        });
+    }});
+
+    kernels.push_back({"enc_azimuth", "triple", 3, []() {
+        return Worker([](const BenchJet& jet) {
+            const size_t nparts = jet.compact.size();
+            double sum_phis = 0;
+            for (size_t isp = 0; isp < nparts; ++isp)
+                for (size_t i1 = isp+1; i1 < nparts; ++i1)
+                    for (size_t i2 = i1+1; i2 < nparts; ++i2)
+                        sum_phis += enc_azimuth(jet.compact,
+                                                i1, isp, i2);
+            bench_sink = bench_sink + sum_phis;
+        });
+    }});
+
+    return kernels;
+}
+
+
+// =====================================
+// Timing
+// =====================================
+/**
+* @brief: Processes the jets, cycling through them, on n_threads
+*         threads (each with its own worker) until at least min_time
+*         seconds have passed, after one untimed jet per thread.
+*
+* @return: std::pair<int64_t, double>  Jets processed, and seconds.
+*/
+std::pair<int64_t, double> time_kernel(const BenchKernel& kernel,
+        const std::vector<BenchJet>& jets,
+        const int n_threads, const double min_time) {
+    std::vector<Worker> workers;
+    for (int ithread = 0; ithread < n_threads; ++ithread) {
+        workers.push_back(kernel.make_worker());
+        workers.back()(jets[ithread % jets.size()]);
+    }
+
+    std::atomic<int64_t> next_jet(0);
+    std::atomic<bool> done(false);
+    const auto start = steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (int ithread = 0; ithread < n_threads; ++ithread) {
+        threads.emplace_back([&, ithread]() {
+            while (not done) {
+                const int64_t ijet = next_jet++;
+                workers[ithread](jets[ijet % jets.size()]);
+                if (duration<double>(steady_clock::now() - start).count()
+                        >= min_time)
+                    done = true;
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    // (jets begun are all finished once the threads are joined)
+    const double seconds = duration<double>(
+            steady_clock::now() - start).count();
+    return {next_jet.load(), seconds};
+}
+
+
+// Slope of a least-squares fit of log(y) against log(x)
+double scaling_exponent(const std::vector<double>& xs,
+                        const std::vector<double>& ys) {
+    const size_t n = xs.size();
+    if (n < 2)
+        return std::numeric_limits<double>::quiet_NaN();
+
+    double mean_x = 0, mean_y = 0;
+    for (size_t i = 0; i < n; ++i) {
+        mean_x += std::log(xs[i])/n;
+        mean_y += std::log(ys[i])/n;
+    }
+    double sxx = 0, sxy = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const double dx = std::log(xs[i]) - mean_x;
+        sxx += dx*dx;
+        sxy += dx*(std::log(ys[i]) - mean_y);
+    }
+    return sxy/sxx;
+}
+
+
+// A finite number for JSON output, or null
+std::string json_number(const double value) {
+    if (not std::isfinite(value))
+        return "null";
+    std::ostringstream stream;
+    stream << std::setprecision(6) << value;
+    return stream.str();
+}
+
+
+// Values following the given option, e.g. --threads 1 2 4
+std::vector<int> cmdln_int_list(const std::string opt,
+                                int argc, char* argv[],
+                                const std::vector<int>& default_vals) {
+    std::vector<int> values;
+    for (int iarg = 0; iarg < argc; ++iarg)
+        if (str_eq(argv[iarg], "--" + opt))
+            while (iarg+1 < argc and
+                    std::string(argv[iarg+1]).rfind("--", 0) != 0)
+                values.push_back(std::stoi(argv[++iarg]));
+    return values.empty() ? default_vals : values;
+}
+
+
+// ####################################
+// Main
+// ####################################
+/**
+* @brief: Times each kernel on synthetic jets of each multiplicity,
+*         fits the scaling of its time per jet with the multiplicity,
+*         and measures its throughput for each number of threads.
+*
+* @return: int
+*/
+int main (int argc, char* argv[]) {
+    for (int iarg = 0; iarg < argc; ++iarg) {
+        if (str_eq(argv[iarg], "-h") or str_eq(argv[iarg], "--help")) {
+            std::cout << "Usage: enc_bench [--kernels name ...] "
+                      << "[--multiplicities N ...] [--njets n] "
+                      << "[--min_time seconds] [--threads n ...] "
+                      << "[--throughput_multiplicity N] "
+                      << "[--nbins n] [--nphibins n] "
+                      << "[--contact_terms bool] [--seed n] "
+                      << "[--output file.json]\n"
+                      << "Kernels: 2particle 3particle 4particle "
+                      << "2special old_3particle bin_position "
+                      << "enc_azimuth\n";
+            return 0;
+        }
+    }
+
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Benchmark Settings
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    const int verbose = cmdln_int("verbose", argc, argv, 1);
+    const int seed    = cmdln_int("seed", argc, argv, 1);
+
+    // Multiplicities of the synthetic jets, and number of distinct
+    // jets of each multiplicity
+    const std::vector<int> multiplicities = cmdln_int_list(
+            "multiplicities", argc, argv,
+            {10, 20, 30, 50, 75, 100, 150, 200, 300});
+    const int njets = cmdln_int("njets", argc, argv, 10);
+    // Minimum time for each measurement, in seconds
+    const double min_time = cmdln_double("min_time", argc, argv, 0.5);
+
+    // Numbers of threads for the throughput, at a single multiplicity
+    const int hardware_threads = std::max(1u,
+            std::thread::hardware_concurrency());
+    std::vector<int> default_threads;
+    for (int n_threads = 1; n_threads < hardware_threads; n_threads *= 2)
+        default_threads.push_back(n_threads);
+    default_threads.push_back(hardware_threads);
+    const std::vector<int> thread_counts = cmdln_int_list(
+            "threads", argc, argv, default_threads);
+    const int throughput_multiplicity = cmdln_int(
+            "throughput_multiplicity", argc, argv, 50);
+
+    BenchSettings settings;
+    settings.nbins         = cmdln_int("nbins", argc, argv, 20);
+    settings.nphibins      = cmdln_int("nphibins", argc, argv, 20);
+    settings.contact_terms = cmdln_bool("contact_terms", argc, argv,
+                                        false);
+
+    const std::string output_file = cmdln_string("output", argc, argv,
+                                                 "");
+
+    if (njets < 1 or min_time < 0)
+        throw std::invalid_argument(
+            "Need at least one jet per multiplicity, and a "
+            "non-negative --min_time.");
+    for (const int nparts : multiplicities)
+        if (nparts < 2)
+            throw std::invalid_argument(
+                "Need multiplicities of at least two particles.");
+    if (throughput_multiplicity < 2)
+        throw std::invalid_argument(
+            "Need a throughput multiplicity of at least two particles.");
+    for (const int n_threads : thread_counts)
+        if (n_threads < 1)
+            throw std::invalid_argument(
+                "Must be given positive numbers of threads.");
+
+    // Kernels to benchmark (all by default)
+    std::vector<BenchKernel> kernels = bench_kernels(settings);
+    std::vector<std::string> selected;
+    for (int iarg = 0; iarg < argc; ++iarg)
+        if (str_eq(argv[iarg], "--kernels"))
+            while (iarg+1 < argc and
+                    std::string(argv[iarg+1]).rfind("--", 0) != 0)
+                selected.push_back(argv[++iarg]);
+    for (const std::string& name : selected)
+        if (std::none_of(kernels.begin(), kernels.end(),
+                [&](const BenchKernel& k) { return k.name == name; }))
+            throw std::invalid_argument("Unknown kernel " + name + ".");
+    if (not selected.empty())
+        kernels.erase(std::remove_if(kernels.begin(), kernels.end(),
+                [&](const BenchKernel& k) {
+                    return std::find(selected.begin(), selected.end(),
+                                     k.name) == selected.end();
+                }), kernels.end());
+
+    // =====================================
+    // Benchmarks
+    // =====================================
+    std::ostringstream json;
+    json << "{\n"
+         << "  \"settings\": {\n"
+         << "    \"seed\": " << seed << ",\n"
+         << "    \"njets\": " << njets << ",\n"
+         << "    \"min_time\": " << json_number(min_time) << ",\n"
+         << "    \"nbins\": " << settings.nbins << ",\n"
+         << "    \"nphibins\": " << settings.nphibins << ",\n"
+         << "    \"contact_terms\": "
+         << (settings.contact_terms ? "true" : "false") << ",\n"
+         << "    \"hardware_threads\": " << hardware_threads << "\n"
+         << "  },\n"
+         << "  \"kernels\": [";
+
+    for (size_t ikernel = 0; ikernel < kernels.size(); ++ikernel) {
+        const BenchKernel& kernel = kernels[ikernel];
+        json << (ikernel ? "," : "") << "\n    {\n"
+             << "      \"name\": \"" << kernel.name << "\",\n"
+             << "      \"unit\": \"" << kernel.unit << "\",\n"
+             << "      \"multiplicities\": [";
+
+        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+        // Time per jet, by multiplicity
+        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+        std::vector<double> nums, ns_per_jets;
+        for (size_t inum = 0; inum < multiplicities.size(); ++inum) {
+            const int nparts = multiplicities[inum];
+            const std::vector<BenchJet> jets = bench_jets(nparts, njets,
+                    seed, settings.minbin, settings.maxbin,
+                    settings.nbins);
+
+            const auto [jets_done, seconds] = time_kernel(kernel, jets,
+                                                          1, min_time);
+            const double ns_per_jet = 1e9*seconds/jets_done;
+            const double ns_per_unit = ns_per_jet
+                                       /n_units(nparts, kernel.order);
+            nums.push_back(nparts);
+            ns_per_jets.push_back(ns_per_jet);
+
+            if (verbose >= 1)
+                std::cerr << kernel.name << ", N = " << nparts << ": "
+                          << ns_per_jet << " ns/jet, " << ns_per_unit
+                          << " ns/" << kernel.unit << "\n";
+
+            json << (inum ? "," : "") << "\n        {"
+                 << "\"multiplicity\": " << nparts << ", "
+                 << "\"jets\": " << jets_done << ", "
+                 << "\"ns_per_jet\": " << json_number(ns_per_jet) << ", "
+                 << "\"ns_per_" << kernel.unit << "\": "
+                 << json_number(ns_per_unit) << "}";
+        }
+        const double exponent = scaling_exponent(nums, ns_per_jets);
+        if (verbose >= 1)
+            std::cerr << kernel.name << ": scaling exponent "
+                      << exponent << "\n";
+        json << "\n      ],\n"
+             << "      \"scaling_exponent\": " << json_number(exponent)
+             << ",\n"
+             << "      \"throughput\": [";
+
+        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+        // Throughput, by number of threads
+        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+        const std::vector<BenchJet> jets = bench_jets(
+                throughput_multiplicity, njets, seed,
+                settings.minbin, settings.maxbin, settings.nbins);
+        // (speedups relative to the first number of threads, per
+        //  thread)
+        double single_thread_rate = 0;
+        for (size_t ithreads = 0; ithreads < thread_counts.size();
+                ++ithreads) {
+            const int n_threads = thread_counts[ithreads];
+            const auto [jets_done, seconds] = time_kernel(kernel, jets,
+                    n_threads, min_time);
+            const double jets_per_second = jets_done/seconds;
+            if (ithreads == 0)
+                single_thread_rate = jets_per_second/thread_counts[0];
+
+            if (verbose >= 1)
+                std::cerr << kernel.name << ", " << n_threads
+                          << " threads: " << jets_per_second
+                          << " jets/s\n";
+
+            json << (ithreads ? "," : "") << "\n        {"
+                 << "\"threads\": " << n_threads << ", "
+                 << "\"multiplicity\": " << throughput_multiplicity
+                 << ", "
+                 << "\"jets_per_second\": "
+                 << json_number(jets_per_second) << ", "
+                 << "\"speedup\": "
+                 << json_number(jets_per_second/single_thread_rate)
+                 << "}";
+        }
+        json << "\n      ]\n    }";
+    }
+    json << "\n  ]\n}\n";
+
+    // =====================================
+    // Output
+    // =====================================
+    if (output_file.empty()) {
+        std::cout << json.str();
+    } else {
+        std::ofstream outfile(output_file);
+        if (not outfile)
+            throw std::runtime_error("Could not open " + output_file
+                                     + " for writing.");
+        outfile << json.str();
+        if (verbose >= 0)
+            std::cout << "Wrote benchmarks to " << output_file << ".\n";
+    }
+
+    return 0;
+}
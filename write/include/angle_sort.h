@@ -0,0 +1,64 @@
+/**
+ * @file    angle_sort.h
+ *
+ * @brief   Index sorting specialized to non-negative floating
+ *          point keys, such as the angles between jet constituents.
+ */
+#ifndef ANGLE_SORT_H
+#define ANGLE_SORT_H
+
+#include <vector>
+#include <cstdint>
+
+
+// =====================================
+// Angle Sorting
+// =====================================
+/**
+* @brief: Stable sort of particle indices by non-negative angle
+*         keys.
+*
+*         Small inputs use insertion sort. Larger inputs use an LSD
+*         radix sort on the leading 32 bits of the keys (whose bit
+*         patterns, for non-negative doubles, are ordered in the same
+*         way as the keys themselves), skipping any byte shared by
+*         all keys; a final insertion sort on the full keys then
+*         orders keys which agree in their leading 32 bits.
+*         Scratch storage is kept between calls, so that sorting
+*         the neighbours of every particle in a jet allocates at
+*         most once.
+*/
+class AngleSorter {
+public:
+    // Inputs at or below this size use insertion sort
+    static constexpr size_t INSERTION_SORT_MAX = 48;
+
+    /**
+    * @brief: Reorders indices[0..n) so that keys[indices[k]] is
+    *         non-decreasing in k, keeping the input order of
+    *         indices with equal keys.
+    *
+    * @param: keys      Non-negative angles (not NaN), indexed by
+    *                   the entries of indices.
+    * @param: indices   Indices to sort, in place.
+    * @param: n         Number of indices.
+    */
+    void sort(const double* keys, size_t* indices, const size_t n);
+
+    // Scratch memory used when sorting n indices, in bytes
+    static size_t memory_bytes(const size_t n) {
+        return n*(2*sizeof(uint32_t) + sizeof(size_t));
+    }
+
+private:
+    void insertion_sort(const double* keys, size_t* indices,
+                        const size_t n) const;
+    void radix_sort(const double* keys, size_t* indices,
+                    const size_t n);
+
+    // Scratch storage for the radix sort
+    std::vector<uint32_t> bits, bits_tmp;
+    std::vector<size_t> indices_tmp;
+};
+
+#endif
@@ -0,0 +1,206 @@
+/**
+ * @file    checkpoint.h
+ *
+ * @brief   Checkpoints of in-progress ENC runs, from which long runs
+ *          can be resumed (e.g. after being preempted) with the same
+ *          results as uninterrupted ones.
+ */
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <functional>
+#include <stdexcept>
+
+#include "general_utils.h"
+
+namespace Pythia8 { class Pythia; }
+
+
+// =====================================
+// Checkpoints
+// =====================================
+/**
+* @brief: Settings and position of a run between two events.
+*
+*         Checkpoint files hold a header (magic "ECSCKPT", version),
+*         these settings, and then the state of the correlators
+*         (see save_engines), in the byte order of the writing
+*         machine.
+*/
+struct RunCheckpoint {
+    // Command line of the run (before reading any jet cache)
+    std::vector<std::string> arguments;
+    // Number of events generated or read (for Open Data and jet
+    // caches, the number of jets read)
+    int64_t events_done = 0;
+    // Jets counted towards the normalization without reaching the
+    // correlators (i.e. without constituents)
+    int64_t njets = 0;
+    // State of the Pythia random number generator (empty when
+    // reading jets)
+    std::string rng_state;
+};
+
+
+// Writes a checkpoint, with the correlators written by write_engines,
+// to a temporary file which then replaces the given one, so that
+// an interrupted write leaves the previous checkpoint intact
+void write_checkpoint(const std::string& filename,
+        const RunCheckpoint& checkpoint,
+        const std::function<void(std::ostream&)>& write_engines);
+
+// Reads the settings of a checkpoint
+RunCheckpoint read_checkpoint(const std::string& filename);
+
+// Reads the correlators of a checkpoint with read_engines
+void read_checkpoint_engines(const std::string& filename,
+        const std::function<void(std::istream&)>& read_engines);
+
+// The command line of a checkpointed run, used in place of the
+// given one when resuming it; throws if the given command line has
+// options other than --resume and --verbose
+std::vector<std::string> resumed_arguments(int argc, char* argv[],
+        const RunCheckpoint& checkpoint);
+
+
+// ---------------------------------
+// Correlators
+// ---------------------------------
+// Writes (or reads) the state of the engine of each thread
+// (see ENCEngine::save)
+template <class Engine>
+void save_engines(std::ostream& stream,
+                  const std::vector<Engine>& engines) {
+    write_binary(stream, static_cast<uint64_t>(engines.size()));
+    for (const Engine& engine : engines)
+        engine.save(stream);
+}
+
+template <class Engine>
+void load_engines(std::istream& stream, std::vector<Engine>& engines) {
+    uint64_t n_engines;
+    read_binary(stream, n_engines);
+    if (n_engines != engines.size())
+        throw std::runtime_error("Checkpoint was written with "
+                + std::to_string(n_engines) + " threads, but the run "
+                + "uses " + std::to_string(engines.size()) + ".");
+    for (Engine& engine : engines)
+        engine.load(stream);
+}
+
+
+// ---------------------------------
+// Pythia
+// ---------------------------------
+// State of the random number generator of Pythia (through the
+// given scratch file)
+std::string pythia_rng_state(Pythia8::Pythia& pythia,
+                             const std::string& scratch_file);
+void set_pythia_rng_state(Pythia8::Pythia& pythia,
+                          const std::string& state,
+                          const std::string& scratch_file);
+
+
+// =====================================
+// Scheduling Checkpoints
+// =====================================
+/**
+* @brief: Decides when to write checkpoints: after every interval
+*         (in seconds; never if not positive), and whenever the
+*         process receives SIGUSR1 or SIGTERM, after which the run
+*         should stop.
+*
+*         Installs handlers for both signals; only one schedule
+*         should exist at a time.
+*/
+class CheckpointSchedule {
+public:
+    CheckpointSchedule(const double interval);
+
+    // Whether a checkpoint is due, restarting the interval if so
+    bool due();
+    // Whether the run should stop after its checkpoint
+    bool stop_requested() const;
+
+private:
+    double interval;
+    std::chrono::steady_clock::time_point last_checkpoint;
+};
+
+
+
+// =====================================
+// Checkpointed Runs
+// =====================================
+/**
+* @brief: The checkpoints of a run: resuming it from the checkpoint
+*         given with --resume, with the command line of the
+*         checkpointed run, and writing checkpoints to
+*         --checkpoint_file every --checkpoint_interval seconds (600 by
+*         default; see CheckpointSchedule).
+*
+*         The correlators of the run are written and read by the
+*         given functions (e.g. with save_engines and load_engines),
+*         and the random number generator is that of the given Pythia
+*         (null if the run reads its jets rather than generating
+*         events).
+*/
+class RunCheckpoints {
+public:
+    // Reads --resume from the given command line, replacing it with
+    // the command line of the checkpointed run, if any
+    RunCheckpoints(int& argc, char**& argv, const int verbose);
+
+    // Command line of the run (before reading any jet cache), which
+    // is stored in its checkpoints
+    std::vector<std::string> arguments;
+
+    // File to which checkpoints are written (empty if none)
+    std::string file;
+    double interval;
+
+    /**
+    * @brief: Continues from the checkpoint being resumed, if any,
+    *         reading its correlators and random number generator, and
+    *         adding the jets it counted without constituents to njets.
+    *
+    * @return: int  The event to start from: the number of events
+    *               done before the checkpoint, or first_event if the
+    *               run is not resumed.
+    */
+    int resume(const int first_event,
+               const std::function<void(std::istream&)>& read_engines,
+               Pythia8::Pythia* pythia, int& njets) const;
+
+    // Starts scheduling checkpoints, if the run writes them (installing
+    // the handlers of CheckpointSchedule)
+    void start();
+
+    /**
+    * @brief: Writes a checkpoint after the given number of events, if
+    *         one is due (write_engines should first process any jets
+    *         of these events which are still buffered).
+    *
+    * @return: bool  Whether the run should stop after the checkpoint
+    *                (after printing how to continue it).
+    */
+    bool write_if_due(const int events_done, const int64_t njets,
+              const std::function<void(std::ostream&)>& write_engines,
+              Pythia8::Pythia* pythia);
+
+private:
+    std::string resume_file;
+    std::unique_ptr<RunCheckpoint> resumed;
+    std::vector<std::string> resumed_args;
+    std::vector<char*> resumed_argv;
+    std::unique_ptr<CheckpointSchedule> schedule;
+};
+
+#endif
@@ -0,0 +1,80 @@
+/**
+ * @file    config_file.h
+ *
+ * @brief   Configuration files for batch runs, listing the settings
+ *          of several analyses as sections of command line options,
+ *          and the command line options of each analysis.
+ */
+#ifndef CONFIG_FILE_H
+#define CONFIG_FILE_H
+
+#include <string>
+#include <vector>
+#include <utility>
+
+
+// =====================================
+// Options
+// =====================================
+// Command line options (e.g. "--nbins"), each with its values,
+// in the order given
+typedef std::vector<std::pair<std::string, std::vector<std::string>>>
+        OptionList;
+
+// The options of a command line (after the name of the executable)
+OptionList command_line_options(int argc, char* argv[]);
+
+// Whether the option is given, and its values (empty if not given)
+bool has_option(const OptionList& options, const std::string& option);
+std::vector<std::string> option_values(const OptionList& options,
+                                       const std::string& option);
+
+// The options of first, followed by those of second which are not
+// in first (so that, since each cmdln_* function reads the first
+// occurrence of an option, first takes precedence)
+OptionList merge_options(const OptionList& first,
+                         const OptionList& second);
+
+// Arguments of a command line (as for strings_to_argv) with the
+// given program name and options
+std::vector<std::string> option_arguments(const std::string& program,
+                                          const OptionList& options);
+
+
+// =====================================
+// Configuration Files
+// =====================================
+/**
+* @brief: A section of a configuration file, with its name and its
+*         options.
+*/
+struct ConfigSection {
+    std::string name;
+    OptionList options;
+};
+
+
+/**
+* @brief: Reads a configuration file of sections of options, e.g.
+*
+*             # Shared by all sections
+*             n_events = 100000
+*             use_pt
+*
+*             [eec_r04]
+*             analysis = 2particle
+*             jet_rad  = 0.4
+*             weights  = 1 2
+*
+*         in which each line is a command line option (without the
+*         leading dashes), with its values after an '=', separated
+*         by spaces; an option with no values is a flag. Lines, or
+*         the ends of lines, starting with '#' or ';' are comments.
+*
+* @return: std::vector<ConfigSection>  The options before the first
+*                                      section (with an empty name),
+*                                      then each section in order.
+*/
+std::vector<ConfigSection> read_config_file(const std::string& filename);
+
+#endif
@@ -0,0 +1,558 @@
+/**
+ * @file    enc_analysis.h
+ *
+ * @brief   Several "new angles on" ENCs run over the same jets, as by
+ *          the multi and batch executables (together with the other
+ *          correlators and the histograms of jet properties): the
+ *          settings, engines and output files of each analysis, the
+ *          jet finding and per-jet angles which analyses share, the
+ *          planning of their threads within a memory budget, the
+ *          events they read, the loops over these events, and the
+ *          runs of the executables for each correlator and of the
+ *          multi executable.
+ */
+#ifndef ENC_ANALYSIS_H
+#define ENC_ANALYSIS_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <istream>
+#include <ostream>
+
+#include "Pythia8/Pythia.h"
+#include "fastjet/PseudoJet.hh"
+#include "fastjet/ClusterSequence.hh"
+
+#include "jet_utils.h"
+#include "opendata_utils.h"
+#include "jet_cache.h"
+#include "jet_geometry.h"
+#include "nd_histogram.h"
+#include "sparse_histogram.h"
+#include "runtime_stats.h"
+#include "enc_engine.h"
+#include "enc_kernels.h"
+#include "enc_output.h"
+#include "jet_property_hists.h"
+#include "pipeline.h"
+#include "telemetry.h"
+#include "checkpoint.h"
+#include "enc_shard.h"
+
+
+// =====================================
+// Type definitions for histograms
+// =====================================
+// Correlators, as in the executables for each of them
+typedef ENCEngine<2> EECEngine;
+typedef ENCEngine<3> EEECEngine;
+typedef ENCEngine<4, PowerWeights, SelectablePhi> EEEECEngine;
+typedef ENCEngine<4, PowerWeights, SelectablePhi,
+                  SparseHistogram<5>> SparseEEEECEngine;
+
+
+// =====================================
+// Analyses
+// =====================================
+// Correlators which can be run together, over the same jets: the
+// "new angles on" ENCs, the two-special-particle and old
+// three-particle correlators, and the histograms of jet properties
+// (as by the jet_properties executable)
+extern const std::vector<std::string> analysis_correlators;
+
+// Energy weights given on the command line after --<flag>, in order
+std::vector<double> weights_cmdln(const std::string& flag,
+                                  int argc, char* argv[]);
+
+
+/**
+* @brief: An analysis of a run: a single correlator, with its own
+*         jets, energy weights, binning and output files, read from
+*         its own command line (with the same defaults as the
+*         executable for the correlator).
+*/
+class ENCAnalysis {
+public:
+    /**
+    * @param: name_        Name of the analysis, given in its errors
+    *                      (e.g. the section of a configuration file)
+    * @param: correlator_  One of analysis_correlators
+    * @param: arguments_   Command line of the analysis (as for
+    *                      strings_to_argv)
+    * @param: weights      Energy weights of the analysis, in groups
+    *                      of one fewer than the number of particles
+    *                      (pairs for 2special, and none for
+    *                      old_3particle and jet_properties, whose
+    *                      weights are fixed), and the option which
+    *                      gave them
+    * @param: is_proton_collision_  Whether the events are pp
+    *                      collisions, which decides the defaults
+    * @param: default_file_prefix   Prefix of the output files unless
+    *                      given with --file_prefix
+    */
+    ENCAnalysis(const std::string& name_,
+                const std::string& correlator_,
+                const std::vector<std::string>& arguments_,
+                const std::vector<double>& weights,
+                const std::string& weights_option,
+                const bool is_proton_collision_,
+                const std::string& default_file_prefix);
+
+    // (the headers of the output files point into the arguments)
+    ENCAnalysis(const ENCAnalysis&) = delete;
+    ENCAnalysis& operator=(const ENCAnalysis&) = delete;
+    ENCAnalysis(ENCAnalysis&&) = default;
+
+    // Name and command line of the analysis
+    std::string name;
+    std::vector<std::string> arguments;
+    std::vector<char*> argv;
+    int argc() const { return static_cast<int>(arguments.size()); }
+
+    // Correlator (one of analysis_correlators) and its number of
+    // particles (3 for 2special and old_3particle, and 1 for
+    // jet_properties)
+    bool is_proton_collision;
+    std::string correlator;
+    int order;
+
+    // Jet definition and cuts
+    std::string jet_alg;
+    double jet_rad;
+    RecombinationScheme jet_recomb;
+    int n_exclusive_jets;
+    double pt_min, pt_max, eta_cut;
+
+    // Settings of the correlator
+    // (for jet_properties, the bins of theta1 are those of the mass,
+    //  pT and energy)
+    bool contact_terms, use_deltaR, use_pt;
+    bool recursive_phi, sparse_hist;
+    std::vector<std::vector<double>> nus;
+    ENCBinning binning;
+
+    // Whether the analysis uses the pairwise angles of its jets (all
+    // but jet_properties, which only use their kinematics)
+    bool uses_geometry() const { return correlator != "jet_properties"; }
+
+    // Output files, for each weight (or each jet property)
+    std::string file_prefix;
+    ENCOutputFormat output_format;
+    std::vector<std::string> outfiles;
+
+    // Selected jets whose constituents could not be found, which
+    // still count towards the normalization
+    int empty_jets = 0;
+
+    // Index of the per-jet angles used by the analysis
+    // (see AnalysisJets)
+    size_t igeometry = 0;
+
+    // Cuts on the jets of the analysis, which select them among the
+    // jets of each event found with its jet definition and at most
+    // its cut on pT (see select_jets)
+    JetCuts jet_cuts() const;
+
+    // Memory of the engine of a single thread
+    ENCMemoryEstimate memory_estimate(const size_t jets_per_thread)
+        const;
+
+    // Engines for each thread, with the given limit on the memory of
+    // the histograms of each (if they grow, and the limit is given)
+    void make_engines(const int n_threads,
+                      const size_t histogram_memory = 0);
+
+    // Output files for each weight, with the names used by the
+    // executable for the correlator
+    void setup_outfiles();
+
+    // Processes a jet on the given thread, from its kinematics and
+    // angles, or from its constituents if it uses no angles
+    void process_jet(const size_t ithread, const CompactJet& jet,
+                     const JetGeometry& geometry);
+    void process_jet(const size_t ithread,
+                     const std::vector<PseudoJet>& constituents);
+
+    // Merges the results of all threads, and writes the histograms
+    // to the output files
+    // (the runtimes are those of the correlator of the analysis, for
+    //  all of its weights together)
+    void write(const int verbose);
+
+    // Whether the engines of the analysis can be written to
+    // checkpoints and shards, and combined by ecscribe-merge: those
+    // of the three- and four-particle correlators
+    bool saves_engines() const {
+        return correlator == "3particle" or correlator == "4particle";
+    }
+
+    // Writes (or reads) the engines of each thread (see save_engines)
+    void save(std::ostream& stream) const;
+    void load(std::istream& stream);
+
+    // Number of jets processed by the engines of all threads
+    long long engine_njets() const;
+
+    // Merges the results of all threads, and writes them to a shard
+    // of the given range of the n_events events of the run (see
+    // write_shard), with the empty jets of the range
+    void write_shard(const EventRange& range, const int n_events,
+                     const int verbose);
+
+private:
+    // Bins of the correlator
+    ENCBinning read_binning();
+
+    // Engines of each thread, for the correlator of the analysis
+    // (the others have no engines)
+    std::vector<EECEngine> engines_2particle;
+    std::vector<EEECEngine> engines_3particle;
+    std::vector<EEEECEngine> engines_4particle;
+    std::vector<SparseEEEECEngine> sparse_engines_4particle;
+
+    // Histograms of each thread for the correlators whose kernels
+    // have no engine (see enc_kernels.h), with the jet counts and
+    // runtimes which engines keep
+    struct TwoSpecialHistograms {
+        std::vector<NDHistogram<1>> hist_1;
+        std::vector<NDHistogram<2>> hist_2;
+        int njets = 0;
+        RuntimeStatistics jet_runtimes;
+    };
+    struct Old3ParticleHistograms {
+        NDHistogram<3> hist;
+        int njets = 0;
+        RuntimeStatistics jet_runtimes;
+    };
+    std::vector<std::pair<double, double>> nu_pairs;
+    std::vector<TwoSpecialHistograms> two_special_hists;
+    std::vector<Old3ParticleHistograms> old_3particle_hists;
+    std::vector<JetPropertyHistograms> jet_property_hists;
+};
+
+
+// =====================================
+// Shared Per-Jet Work
+// =====================================
+/**
+* @brief: Jet finding shared by the analyses with the same jet
+*         definition, with the loosest cut on pT of those analyses.
+*/
+struct AnalysisJetFinder {
+    std::string jet_alg;
+    double jet_rad;
+    RecombinationScheme jet_recomb;
+    double pt_min;
+    JetDefinition jet_def;
+    std::vector<size_t> analyses;
+
+    /**
+    * @brief: Clusters the particles of an event (which need
+    *         cluster_seq_ptr to stay alive), adding each jet selected
+    *         by any of the analyses of the finder to jets, and the
+    *         analyses which selected it to jet_analyses.
+    */
+    void find_jets(const std::vector<PseudoJet>& particles,
+                   const std::vector<ENCAnalysis>& all_analyses,
+                   std::unique_ptr<ClusterSequence>& cluster_seq_ptr,
+                   std::vector<PseudoJet>& jets,
+                   std::vector<std::vector<size_t>>& jet_analyses)
+        const;
+};
+
+// The jet finders for the given analyses, one for each distinct
+// jet definition
+std::vector<AnalysisJetFinder> analysis_jet_finders(
+        const std::vector<ENCAnalysis>& analyses);
+
+
+/**
+* @brief: The per-jet work shared by analyses, for each thread: the
+*         kinematics of the current jet with pT and energy weights,
+*         and its pairwise angles and sorted neighbours once for
+*         each distinct choice of weights, angles and bins of theta1,
+*         each found only if an analysis of the jet uses it.
+*/
+class AnalysisJets {
+public:
+    // (setting the index of the angles used by each analysis)
+    AnalysisJets(std::vector<ENCAnalysis>& analyses_);
+
+    // Number of distinct sets of per-jet angles
+    size_t ngeometries() const { return geometries.size(); }
+
+    // Storage for each of the given number of threads
+    void set_threads(const int n_threads);
+
+    // Processes a jet on the given thread, with each of the given
+    // analyses (finding its kinematics and angles only for those
+    // which use them)
+    void process_jet(const size_t ithread,
+                     const std::vector<PseudoJet>& constituents,
+                     const std::vector<size_t>& jet_analyses);
+
+private:
+    struct SharedGeometry {
+        bool use_pt, use_deltaR;
+        double minbin, maxbin;
+        int nbins;
+        JetGeometry geometry;
+
+        bool matches(const ENCAnalysis& analysis) const;
+    };
+
+    struct ThreadJet {
+        CompactJet jets[2];
+        bool filled_jets[2];
+        std::vector<JetGeometry> geometries;
+        std::vector<char> filled_geometries;
+    };
+
+    std::vector<ENCAnalysis>& analyses;
+    std::vector<SharedGeometry> geometries;
+    std::vector<ThreadJet> thread_jets;
+};
+
+
+// =====================================
+// Threads and Memory
+// =====================================
+/**
+* @brief: Plans the threads of a run of the given analyses, each of
+*         which holds the engines of every analysis, with a single
+*         buffer of jets_per_thread jets for all of them.
+*
+*         Given a memory budget (max_memory > 0), the number of
+*         threads is reduced until they fit within it (with the
+*         four-particle correlators switched to sparse histograms if
+*         even a single thread does not fit); if any
+*         analysis has sparse histograms, which grow with the number
+*         of filled bins, a single thread is used instead, whose
+*         sparse histograms may use the memory which the rest of the
+*         thread leaves (see make_analysis_engines).
+*
+* @return: ENCMemoryEstimate  For a single thread, summed over the
+*                             analyses.
+*/
+ENCMemoryEstimate plan_analysis_threads(
+        std::vector<ENCAnalysis>& analyses, int& n_threads,
+        const size_t max_memory, const size_t jets_per_thread,
+        const int verbose);
+
+// Makes the engines of each analysis for each thread, sharing the
+// memory planned for growing histograms between the analyses which
+// have them
+void make_analysis_engines(std::vector<ENCAnalysis>& analyses,
+                           const int n_threads,
+                           const ENCMemoryEstimate& memory,
+                           const size_t jets_per_thread);
+
+// Largest number of particles of the correlators of the analyses
+// (e.g. for the units of work of telemetry)
+int max_analysis_order(const std::vector<ENCAnalysis>& analyses);
+
+
+// =====================================
+// Events
+// =====================================
+// Opens the jet cache given with --read_jet_cache in arguments, if
+// any, adding the settings which selected the cached jets to the
+// arguments (null if no cache is given)
+std::unique_ptr<JetCacheReader> open_jet_cache(
+        std::vector<std::string>& arguments, const int verbose);
+
+// Pythia, with its banner muted unless very verbose
+std::unique_ptr<Pythia8::Pythia> new_pythia(const int verbose);
+
+// Independent Pythia instances, e.g. one for each thread, set up from
+// the given command line with the given seeds (see pythia_seeds),
+// muting all but the first
+std::vector<std::unique_ptr<Pythia8::Pythia>> setup_thread_pythias(
+        const std::vector<int>& seeds, int argc, char* argv[],
+        const int verbose);
+
+// Mutes the FastJet banner (otherwise printed when the first event
+// is clustered)
+void mute_fastjet_banner();
+
+
+/**
+* @brief: The events of a run: jets read from a jet cache, from CMS
+*         Open Data or from the toy generator of synthetic jets, or
+*         the particles of Pythia events, in which jets are found.
+*/
+class AnalysisEvents {
+public:
+    /**
+    * @param: jet_cache_   Cache from open_jet_cache, if any
+    * @param: jet_source   "opendata", "pythia" or "synthetic"
+    *                      (see jet_source_cmdln)
+    * @param: argc, argv   Command line with the settings of the
+    *                      events, and the cuts of the synthetic jets
+    * @param: pythia_argc, pythia_argv  Command line for Pythia, and
+    *                      whether to set it up at all (e.g. not if
+    *                      each thread has a Pythia of its own)
+    * @param: pythia_seed  Seed of Pythia (e.g. that of a shard, see
+    *                      shard_pythia_seeds)
+    * @param: analysis     An analysis, whose cuts give those of the
+    *                      synthetic jets
+    */
+    AnalysisEvents(std::unique_ptr<JetCacheReader> jet_cache_,
+                   const std::string& jet_source,
+                   int argc, char* argv[],
+                   int pythia_argc, char* pythia_argv[],
+                   const bool setup_pythia, const int pythia_seed,
+                   const ENCAnalysis& analysis, const int verbose);
+
+    // Whether jets are found in the events (of Pythia), rather
+    // than given from the start
+    bool finds_jets() const { return finds_jets_; }
+
+    // Number of events, or of jets in the jet cache
+    int size() const { return n_events; }
+
+    /**
+    * @brief: Reads the next event: a single jet (without finding
+    *         jets), or the particles of a Pythia event.
+    *
+    * @return: bool  Whether the event is valid.
+    */
+    bool next(std::vector<PseudoJet>& event);
+
+    // Skips the first n_jets jets which are read (generated events
+    // cannot be skipped)
+    void skip(const int n_jets);
+
+    // Pythia generating the events (null if the jets are read)
+    Pythia8::Pythia* generator() { return pythia.get(); }
+
+private:
+    std::unique_ptr<JetCacheReader> jet_cache;
+    std::unique_ptr<od::EventReader> jet_reader;
+    std::unique_ptr<Pythia8::Pythia> pythia;
+    bool finds_jets_;
+    int n_events;
+};
+
+
+
+// =====================================
+// Event Loops
+// =====================================
+// Reads (or generates) the next event of a run, returning whether it
+// is valid (see AnalysisEvents::next)
+typedef std::function<bool(std::vector<PseudoJet>&)> NextEvent;
+
+// Finds the jets of the particles of an event (which need
+// cluster_seq_ptr to stay alive)
+typedef std::function<void(const std::vector<PseudoJet>&,
+                           std::unique_ptr<ClusterSequence>&,
+                           std::vector<PseudoJet>&)> FindJets;
+
+// Processes the constituents of a jet on the given thread
+typedef std::function<void(const size_t,
+                           const std::vector<PseudoJet>&)> ProcessJet;
+
+
+/**
+* @brief: Runs the n_events events of a run through a pipeline (see
+*         run_jet_pipeline): reads them with next_event, finds their
+*         jets with find_jets (unless it is empty, when each event is
+*         a single jet, found from the start), and processes the jets
+*         on settings.kernels threads with process_jet. Every event
+*         and jet is counted by the telemetry of the run, and every
+*         jet written to its jet cache, if any.
+*
+* @return: int  Number of jets whose constituents could not be found
+*               (written to the jet cache as empty jets), which still
+*               count towards the normalization.
+*/
+int run_event_pipeline(const int n_events, const NextEvent& next_event,
+                       const FindJets& find_jets,
+                       const ProcessJet& process_jet,
+                       const PipelineSettings& settings,
+                       RunTelemetry& telemetry,
+                       JetCacheWriter* jet_cache_writer,
+                       const int verbose);
+
+
+/**
+* @brief: Generates the n_events events of a run in parallel, with a
+*         thread for each of the given Pythia instances, which
+*         generates its own share of the events, finds their jets with
+*         find_jets, and processes them with process_jet (given the
+*         index of the thread). Every event and jet is counted by the
+*         telemetry of the run, and every jet written to its jet cache,
+*         if any.
+*
+* @return: int  Number of jets whose constituents could not be found
+*               (written to the jet cache as empty jets), which still
+*               count towards the normalization.
+*/
+int run_parallel_pythia(
+        std::vector<std::unique_ptr<Pythia8::Pythia>>& pythias,
+        const int n_events, const FindJets& find_jets,
+        const ProcessJet& process_jet, RunTelemetry& telemetry,
+        JetCacheWriter* jet_cache_writer);
+
+
+
+// =====================================
+// Runs
+// =====================================
+/**
+* @brief: A run of the executable for a correlator, or of the multi
+*         executable: the analyses of the run find (or read) each jet
+*         of its events a single time, in a serial loop, through a
+*         pipeline (--pipeline), or with a Pythia instance for each
+*         thread (--parallel_pythia), within a memory budget
+*         (--max_memory), and write the histograms of each.
+*
+*         A run of a single three- or four-particle correlator can
+*         also analyze only a range of its events, writing a shard
+*         (see event_range_cmdln), and write checkpoints (see
+*         RunCheckpoints).
+*/
+class AnalysisRun {
+public:
+    // Reads the command line of the run: that of the checkpoint given
+    // with --resume, if any, with the settings of the jet cache given
+    // with --read_jet_cache, if any (see open_jet_cache)
+    AnalysisRun(int argc, char* argv[], const int verbose_);
+
+    // (argv points into the arguments)
+    AnalysisRun(const AnalysisRun&) = delete;
+    AnalysisRun& operator=(const AnalysisRun&) = delete;
+
+    // Command line of the run, from which its analyses are read
+    std::vector<std::string> arguments;
+    int argc() const { return static_cast<int>(arguments.size()); }
+    char** argv() { return arguments_argv.data(); }
+
+    // Whether the events are pp collisions, which decides the
+    // defaults of the analyses
+    bool is_proton_collision();
+
+    /**
+    * @brief: Runs the given analyses (which share their jet
+    *         definition and cuts) over the events of the run, and
+    *         writes their histograms, or the shard of the run.
+    *
+    * @return: int  Exit code: 1 if the run stopped after writing a
+    *               checkpoint, and 0 otherwise.
+    */
+    int run(std::vector<ENCAnalysis>& analyses);
+
+private:
+    int verbose;
+    std::chrono::high_resolution_clock::time_point start;
+
+    RunCheckpoints checkpoints;
+    std::unique_ptr<JetCacheReader> jet_cache;
+    std::vector<char*> arguments_argv;
+};
+
+#endif
@@ -0,0 +1,650 @@
+/**
+ * @file    enc_engine.h
+ *
+ * @brief   A generic engine for "new angles on" N-point energy
+ *          correlators, whose nested loops on particles sorted
+ *          by angle are generated at compile time.
+ */
+#ifndef ENC_ENGINE_H
+#define ENC_ENGINE_H
+
+#include <array>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+#include "fastjet/PseudoJet.hh"
+
+#include "general_utils.h"
+#include "jet_geometry.h"
+#include "nd_histogram.h"
+#include "runtime_stats.h"
+
+
+// =====================================
+// Policies
+// =====================================
+// ---------------------------------
+// Energy weights
+// ---------------------------------
+/**
+* @brief: Change in the cumulative E^nu-weighted sum,
+*         (sum_weight + weight)^nu - sum_weight^nu,
+*         due to a particle with the given weight.
+*/
+struct PowerWeights {
+    static double delta(const double sum_weight,
+                        const double weight, const double nu) {
+        return std::pow(sum_weight + weight, nu)
+               - std::pow(sum_weight, nu);
+    }
+};
+
+// ---------------------------------
+// Azimuthal angles
+// ---------------------------------
+// Each policy gives the particle (by its position in the loop nest,
+// with 0 the special particle) from which the azimuthal angle of the
+// particle at the given level is measured, about the special particle.
+
+// Measuring all azimuthal angles from the first particle
+struct FirstParticlePhi {
+    int reference(const int /*level*/) const { return 1; }
+};
+
+// Measuring each azimuthal angle from the previous particle
+struct RecursivePhi {
+    int reference(const int level) const { return level - 1; }
+};
+
+// Choosing between the two above at run time
+struct SelectablePhi {
+    bool recursive = false;
+    int reference(const int level) const {
+        return recursive ? level - 1 : 1;
+    }
+};
+
+
+// =====================================
+// Memory Planning
+// =====================================
+/**
+* @brief: Memory needed by each thread of an ENC computation,
+*         estimated from its settings before anything is allocated.
+*/
+struct ENCMemoryEstimate {
+    // Histograms of one engine (one for each set of weights)
+    size_t histograms = 0;
+    // Per-jet storage of one engine
+    size_t scratch    = 0;
+    // Jets buffered for one thread (only with several threads)
+    size_t jet_buffer = 0;
+
+    // Whether the histograms grow with the number of filled bins
+    // (sparse histograms, whose initial size is given above), and
+    // whether their growth is capped at that size instead
+    bool histograms_grow   = false;
+    bool histograms_capped = false;
+
+    size_t per_thread(const int n_threads) const {
+        return histograms + scratch + (n_threads > 1 ? jet_buffer : 0);
+    }
+    size_t total(const int n_threads) const {
+        return n_threads*per_thread(n_threads);
+    }
+
+    // Largest number of threads, at most n_threads, that fit
+    // within the given budget (0 if not even one does)
+    int threads_within(const size_t max_memory,
+                       const int n_threads) const {
+        for (int threads = n_threads; threads > 0; --threads)
+            if (total(threads) <= max_memory)
+                return threads;
+        return 0;
+    }
+
+    // Summary for printing, one line per component
+    std::string summary(const int n_threads) const {
+        std::stringstream ss;
+        ss << "\thistograms:  " << format_bytes(histograms)
+           << " per thread";
+        if (histograms_grow and histograms_capped)
+            ss << " at most (sparse; the run stops if they would "
+               << "need more)";
+        else if (histograms_grow)
+            ss << " at first (sparse; growing with the number of "
+               << "filled bins, without bound)";
+        ss << "\n"
+           << "\tscratch:     " << format_bytes(scratch)
+           << " per thread\n";
+        if (n_threads > 1)
+            ss << "\tjet buffer:  " << format_bytes(jet_buffer)
+               << " per thread\n";
+        ss << "\ttotal:       " << format_bytes(total(n_threads))
+           << " for " << n_threads << " thread"
+           << (n_threads > 1 ? "s" : "") << "\n";
+        return ss.str();
+    }
+};
+
+
+// =====================================
+// ENC Engine
+// =====================================
+/**
+* @brief: Accumulates the N-point ENC, differential in theta1 and
+*         in (theta_k/theta_{k-1}, phi_k) for each further particle
+*         k, into one histogram for each set of energy weights.
+*
+*         For each special particle, the other particles are sorted
+*         by their angle to it; each of the N-1 nested loops runs
+*         over particles closer than the particle in the enclosing
+*         loop, keeping a cumulative sum of weights (per phi bin,
+*         beyond the first loop). The change in each cumulative
+*         weight is computed in the loop it belongs to, and carried
+*         inwards as a running product.
+*
+*         Each engine holds its own histograms and per-jet storage,
+*         so that separate engines may process jets in separate
+*         threads, and be merged afterwards.
+*
+* @tparam: N             Number of particles in the correlator
+* @tparam: WeightPolicy  Energy weighting (see PowerWeights)
+* @tparam: AnglePolicy   Reference particles for azimuthal angles
+* @tparam: Histogram     Histogram storage, filled by flat position
+*                        (NDHistogram, or SparseHistogram when most
+*                         bins stay empty)
+*/
+template <int N,
+          class WeightPolicy = PowerWeights,
+          class AnglePolicy  = FirstParticlePhi,
+          class Histogram    = NDHistogram<2*N - 3>>
+class ENCEngine {
+    static_assert(N >= 2, "Need at least two particles.");
+    static_assert(std::tuple_size<typename Histogram::shape_t>::value
+                  == 2*N - 3,
+                  "Need one histogram dimension for each angle.");
+
+    static constexpr double factorial(const int n) {
+        return n <= 1 ? 1. : n*factorial(n-1);
+    }
+
+public:
+    // Histogram dimensions:
+    // theta1, then theta_k/theta_{k-1} and phi_k for each k > 1
+    static constexpr size_t n_dims = 2*N - 3;
+    // Number of orderings of the non-special particles
+    static constexpr double perm = factorial(N-1);
+
+    // Energy weights (nu_1, ..., nu_{N-1}) of a single correlator
+    typedef std::array<double, N-1> nus_t;
+    typedef Histogram hist_t;
+
+    /**
+    * @param: geometry       Per-jet angles, binned in theta1
+    * @param: ratio_axes     Axes for theta_k/theta_{k-1}, k = 2..N-1
+    * @param: phi_axis       Axis for the azimuthal angles
+    * @param: nu_weights     Energy weights of each correlator
+    * @param: use_pt         Whether to weight by pT (or energy)
+    * @param: use_deltaR     Whether to use Delta R (or real-space
+    *                        angles)
+    * @param: contact_terms  Whether to include contact terms
+    * @param: angle_policy   Reference particles for azimuthal angles
+    */
+    ENCEngine(const JetGeometry& geometry_,
+              const std::vector<BinAxis>& ratio_axes_,
+              const BinAxis& phi_axis_,
+              const std::vector<nus_t>& nu_weights_,
+              const bool use_pt_, const bool use_deltaR_,
+              const bool contact_terms_,
+              const AnglePolicy& angle_policy_ = AnglePolicy())
+            : own_geometry(geometry_), ratio_axes(ratio_axes_),
+              phi_axis(phi_axis_), angle_policy(angle_policy_),
+              nu_weights(nu_weights_),
+              use_pt(use_pt_), use_deltaR(use_deltaR_),
+              contact_terms(contact_terms_) {
+        // Histogram shape and strides
+        const hist_t empty_hist(hist_shape(geometry_, ratio_axes,
+                                           phi_axis));
+        hists.assign(nu_weights.size(), empty_hist);
+        strides = empty_hist.strides();
+
+        // Bin for phi = 0, and for "all particles at the
+        // special particle", used by contact terms
+        phizerobin  = phi_axis.bin(0);
+        zero_offset = 0;
+        for (int level = 2; level < N; ++level)
+            zero_offset += phizerobin*strides[2*level-2];
+
+        // Energy weight of the contact term
+        // (all particles at the special particle)
+        for (const nus_t& nus : nu_weights) {
+            double power = 1;
+            for (const double nu : nus)
+                power += nu;
+            contact_powers.push_back(power);
+        }
+
+        // Per-level storage
+        for (int level = 0; level < N; ++level) {
+            weight_products[level].resize(nu_weights.size());
+            sum_weights[level].resize(level <= 1 ? 1
+                                      : phi_axis.size());
+        }
+    }
+
+
+    /**
+    * @brief: Shape of the histograms for the given binning.
+    */
+    static typename hist_t::shape_t hist_shape(
+            const JetGeometry& geometry,
+            const std::vector<BinAxis>& ratio_axes,
+            const BinAxis& phi_axis) {
+        if (ratio_axes.size() != N-2)
+            throw std::invalid_argument(
+                    "Need one theta ratio axis for each particle "
+                    "beyond the first two.");
+
+        typename hist_t::shape_t shape;
+        shape[0] = geometry.nbins();
+        for (int level = 2; level < N; ++level) {
+            shape[2*level-3] = ratio_axes[level-2].size();
+            shape[2*level-2] = phi_axis.size();
+        }
+        return shape;
+    }
+
+
+    /**
+    * @brief: Memory needed by an engine with the given settings,
+    *         for jets of up to max_particles particles (beyond
+    *         which the per-jet storage grows), and by a thread's
+    *         buffer of jets_per_thread such jets.
+    */
+    static ENCMemoryEstimate memory_estimate(
+            const JetGeometry& geometry,
+            const std::vector<BinAxis>& ratio_axes,
+            const BinAxis& phi_axis,
+            const size_t n_nus,
+            const size_t jets_per_thread,
+            const size_t max_particles = 200) {
+        ENCMemoryEstimate estimate;
+        estimate.histograms = n_nus*hist_t::allocated_bytes(
+                hist_shape(geometry, ratio_axes, phi_axis));
+        estimate.histograms_grow = hist_t::grows;
+
+        // Per-jet storage, and running products and cumulative
+        // weights at each level
+        estimate.scratch = CompactJet::memory_bytes(max_particles)
+                + JetGeometry::memory_bytes(max_particles)
+                + N*n_nus*sizeof(double)
+                + (2 + (N-2)*phi_axis.size())*sizeof(double);
+
+        estimate.jet_buffer = jets_per_thread*max_particles
+                              *sizeof(fastjet::PseudoJet);
+        return estimate;
+    }
+
+
+    /**
+    * @brief: Adds the contribution of a single jet.
+    */
+    void process_jet(const std::vector<fastjet::PseudoJet>& constituents) {
+        // Start timing
+        auto jet_start = std::chrono::high_resolution_clock::now();
+
+        // Compact kinematics and normalized weights
+        own_jet.fill(constituents, use_pt);
+
+        // Pairwise angles, and particles sorted by angle
+        own_geometry.fill(own_jet, use_deltaR);
+
+        process_filled_jet(own_jet, own_geometry, jet_start);
+    }
+
+
+    /**
+    * @brief: Adds the contribution of a single jet, whose compact
+    *         kinematics and geometry were already filled, e.g. once
+    *         for several engines with the same use_pt and use_deltaR
+    *         (and, for the geometry, the same binning of theta1).
+    */
+    void process_jet(const CompactJet& shared_jet,
+                     const JetGeometry& shared_geometry) {
+        process_filled_jet(shared_jet, shared_geometry,
+                           std::chrono::high_resolution_clock::now());
+    }
+
+
+    /**
+    * @brief: Adds the histograms, jet counts and runtimes of
+    *         another engine with the same settings to this one.
+    */
+    void merge(const ENCEngine& other) {
+        for (size_t inu = 0; inu < hists.size(); ++inu)
+            hists[inu] += other.hists[inu];
+
+        njets += other.njets;
+        jet_runtimes.merge(other.jet_runtimes);
+    }
+
+
+    /**
+    * @brief: Writes the raw (unnormalized) histograms, jet count and
+    *         runtimes, e.g. for checkpoints; load reads them back
+    *         into an engine with the same settings, replacing its
+    *         own.
+    */
+    void save(std::ostream& stream) const {
+        write_binary(stream, static_cast<uint64_t>(hists.size()));
+        for (const hist_t& hist : hists)
+            hist.save(stream);
+
+        write_binary(stream, njets);
+        jet_runtimes.save(stream);
+    }
+
+    void load(std::istream& stream) {
+        uint64_t n_hists;
+        read_binary(stream, n_hists);
+        if (n_hists != hists.size())
+            throw std::runtime_error(
+                    "Saved correlator has different energy weights.");
+        for (hist_t& hist : hists)
+            hist.load(stream);
+
+        read_binary(stream, njets);
+        jet_runtimes.load(stream);
+    }
+
+
+    /**
+    * @brief: Limits the memory of the (sparse) histograms to the
+    *         given total, shared equally between the sets of weights
+    *         (whose histograms fill the same bins).
+    */
+    void limit_histogram_memory(const size_t bytes) {
+        for (hist_t& hist : hists)
+            hist.set_memory_limit(bytes/hists.size());
+    }
+
+
+    // Histogram for the correlator with weights nu_weights[inu]
+    hist_t& hist(const size_t inu) { return hists[inu]; }
+    const hist_t& hist(const size_t inu) const { return hists[inu]; }
+
+    // Number of jets processed, and statistics of their runtimes
+    // (in microseconds, for all weights together) by number of
+    // particles in the jet
+    int njets = 0;
+    RuntimeStatistics jet_runtimes;
+
+private:
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Loop on the special particle
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // (for a jet whose kinematics and angles are filled, timed
+    //  from jet_start)
+    void process_filled_jet(const CompactJet& current_jet,
+            const JetGeometry& current_geometry,
+            const std::chrono::high_resolution_clock::time_point
+                    jet_start) {
+        // Counting total num_jets
+        ++njets;
+
+        jet = &current_jet;
+        geometry = &current_geometry;
+        const size_t nparts = jet->size();
+
+        // ---------------------------------
+        // Loop on "special" particle
+        for (size_t isp = 0; isp < nparts; ++isp) {
+            iparts[0] = isp;
+            // Energy-weighting factor for "special" particle
+            const double weight_sp = jet->weight[isp];
+            std::fill(weight_products[0].begin(),
+                      weight_products[0].end(), weight_sp);
+
+            // Contact term: all particles at the special particle
+            if (contact_terms)
+                for (size_t inu = 0; inu < nu_weights.size(); ++inu)
+                    hists[inu][zero_offset] +=
+                            std::pow(weight_sp, contact_powers[inu]);
+
+            // Particles sorted by their angle theta1
+            // relative to the special particle
+            // (the special particle itself comes first)
+            sorted_parts = geometry->sorted_neighbours(isp);
+
+            particle_loop<1>(nparts, 0);
+        }
+
+        // End timing
+        const std::chrono::duration<double, std::micro> jet_duration =
+                std::chrono::high_resolution_clock::now() - jet_start;
+        jet_runtimes.add(nparts, jet_duration.count());
+    }
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Loop on the particle at the given level
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // (over sorted positions 1 <= j < jend, i.e. particles closer
+    //  to the special particle than the particle at the previous
+    //  level, with offset the histogram position of the bins of
+    //  the previous levels)
+    template <int Level>
+    void particle_loop(const size_t jend, const size_t offset) {
+        const size_t isp = iparts[0];
+        const double weight_sp = jet->weight[isp];
+
+        // Initializing the cumulative sum of weights within an
+        // angle of this particle (within each phi bin, beyond the
+        // first level), starting with the special particle
+        double* sum_weight = sum_weights[Level].data();
+        if constexpr (Level == 1) {
+            sum_weight[0] = weight_sp;
+        } else {
+            std::fill(sum_weights[Level].begin(),
+                      sum_weights[Level].end(), 0.);
+            sum_weight[phizerobin] += weight_sp;
+        }
+
+        const double* prev_products = weight_products[Level-1].data();
+        double* products = weight_products[Level].data();
+
+        for (size_t j = 1; j < jend; ++j) {
+            // Properties of this particle
+            const size_t ipart  = sorted_parts[j];
+            const double weight = jet->weight[ipart];
+            iparts[Level] = ipart;
+            thetas[Level] = geometry->angle(isp, ipart);
+
+            // Histogram bins, and phi bin for the cumulative weight
+            size_t bin_offset;
+            int sum_bin;
+            if constexpr (Level == 1) {
+                bin_offset = offset
+                        + geometry->angle_bin(isp, ipart)*strides[0];
+                sum_bin = 0;
+            } else {
+                const double theta_ratio = thetas[Level-1] == 0 ? 0 :
+                        thetas[Level]/thetas[Level-1];
+                const int bin_ratio =
+                        ratio_axes[Level-2].bin(theta_ratio);
+
+                const double phi = enc_azimuth(*jet,
+                        iparts[angle_policy.reference(Level)],
+                        isp, ipart);
+                const int binphi = phi_axis.bin(phi);
+
+                bin_offset = offset + bin_ratio*strides[2*Level-3]
+                                    + binphi*strides[2*Level-2];
+                sum_bin = binphi;
+            }
+
+            // Change in cumulative weight, times those of all
+            // enclosing levels (and the special particle weight)
+            for (size_t inu = 0; inu < nu_weights.size(); ++inu)
+                products[inu] = prev_products[inu] *
+                        WeightPolicy::delta(sum_weight[sum_bin], weight,
+                                            nu_weights[inu][Level-1]);
+
+            if constexpr (Level == N-1) {
+                // Adding to the histogram
+                for (size_t inu = 0; inu < nu_weights.size(); ++inu)
+                    hists[inu][bin_offset] += perm*products[inu];
+            } else {
+                if constexpr (N == 3) {
+                    if (contact_terms)
+                        add_contact_terms_3particle(bin_offset, weight);
+                }
+                particle_loop<Level+1>(j, bin_offset);
+            }
+
+            // Preparing for the next particle in the loop
+            sum_weight[sum_bin] += weight;
+        }
+    }
+
+    // Contact terms with the second particle at the first
+    // particle or at the special particle
+    void add_contact_terms_3particle(const size_t offset,
+                                     const double weight1) {
+        const double weight_sp = jet->weight[iparts[0]];
+        const size_t phizero_offset = offset
+                                      + phizerobin*strides[2];
+        const size_t last_ratio_offset =
+                (ratio_axes[0].size()-1)*strides[1];
+
+        for (size_t inu = 0; inu < nu_weights.size(); ++inu) {
+            const double nu1 = nu_weights[inu][0];
+            const double nu2 = nu_weights[inu][1];
+
+            // part2 = part_sp != part_1
+            hists[inu][phizero_offset] +=
+                2*std::pow(weight_sp, 1+nu2)*
+                  std::pow(weight1, nu1);
+
+            // part2 = part1 != part_sp
+            hists[inu][phizero_offset + last_ratio_offset] +=
+                        std::pow(weight_sp, 1)*
+                        std::pow(weight1, nu1+nu2);
+        }
+    }
+
+    // Binning (with storage for the angles of each jet)
+    JetGeometry own_geometry;
+    std::vector<BinAxis> ratio_axes;
+    BinAxis phi_axis;
+    AnglePolicy angle_policy;
+    int phizerobin;
+
+    // Correlator settings
+    std::vector<nus_t> nu_weights;
+    std::vector<double> contact_powers;
+    bool use_pt, use_deltaR, contact_terms;
+
+    // Histograms, one for each set of energy weights
+    // (filled by flat position, using their strides)
+    std::vector<hist_t> hists;
+    typename hist_t::shape_t strides;
+    size_t zero_offset;
+
+    // Storage for the kinematics of each jet
+    CompactJet own_jet;
+
+    // Current jet and its angles (either of the above, or shared
+    // with other engines), and the particles at each level of the
+    // loops
+    const CompactJet* jet = nullptr;
+    const JetGeometry* geometry = nullptr;
+    const size_t* sorted_parts = nullptr;
+    std::array<size_t, N> iparts;
+    std::array<double, N> thetas;
+    // Running products of weights, and cumulative weights,
+    // at each level
+    std::array<std::vector<double>, N> weight_products;
+    std::array<std::vector<double>, N> sum_weights;
+};
+
+
+// =====================================
+// Parallel Processing
+// =====================================
+/**
+* @brief: Calls process_jet(ithread, jet) for each of the given jets
+*         (e.g. their constituents) on n_threads threads, each thread
+*         taking the next unprocessed jet until none remain.
+*/
+template <class Jet, class ProcessJet>
+void for_each_jet_parallel(const size_t n_threads,
+        const std::vector<Jet>& jets, ProcessJet&& process_jet) {
+    std::atomic<size_t> next_jet(0);
+    std::vector<std::thread> workers;
+    for (size_t ithread = 0; ithread < n_threads; ++ithread) {
+        workers.emplace_back([&, ithread]() {
+            for (size_t ijet = next_jet++; ijet < jets.size();
+                    ijet = next_jet++)
+                process_jet(ithread, jets[ijet]);
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+}
+
+
+/**
+* @brief: As for_each_jet_parallel, but with the ijet-th jet always
+*         processed by thread (first_jet + ijet) % n_threads, so
+*         that each thread gets the same jets, in the same order,
+*         however the jets of a run are split into batches (e.g.
+*         when a run is resumed from a checkpoint).
+*/
+template <class Jet, class ProcessJet>
+void for_each_jet_interleaved(const size_t n_threads,
+        const size_t first_jet, const std::vector<Jet>& jets,
+        ProcessJet&& process_jet) {
+    std::vector<std::thread> workers;
+    for (size_t ithread = 0; ithread < n_threads; ++ithread) {
+        workers.emplace_back([&, ithread]() {
+            for (size_t ijet = (ithread + n_threads
+                                - first_jet % n_threads) % n_threads;
+                    ijet < jets.size(); ijet += n_threads)
+                process_jet(ithread, jets[ijet]);
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+}
+
+
+/**
+* @brief: Processes the given jets with one engine per thread
+*         (with each jet given to a fixed thread, as in
+*          for_each_jet_interleaved, if first_jet is given).
+*/
+template <class Engine>
+void process_jets_parallel(std::vector<Engine>& engines,
+        const std::vector<std::vector<fastjet::PseudoJet>>& jets,
+        const long long first_jet = -1) {
+    auto process_jet = [&](const size_t ithread,
+            const std::vector<fastjet::PseudoJet>& constituents) {
+        engines[ithread].process_jet(constituents);
+    };
+    if (first_jet < 0)
+        for_each_jet_parallel(engines.size(), jets, process_jet);
+    else
+        for_each_jet_interleaved(engines.size(),
+                static_cast<size_t>(first_jet), jets, process_jet);
+}
+
+#endif
@@ -0,0 +1,301 @@
+/**
+ * @file    enc_kernels.h
+ *
+ * @brief   Per-jet kernels of the correlators which are not computed
+ *          by ENCEngine: the two-special-particle correlator and the
+ *          old (thetaL, thetaS, phi) three-particle correlator.
+ */
+#ifndef ENC_KERNELS_H
+#define ENC_KERNELS_H
+
+#include <vector>
+#include <tuple>
+#include <utility>
+#include <cmath>
+#include <algorithm>
+
+#include "general_utils.h"
+#include "jet_geometry.h"
+#include "nd_histogram.h"
+
+
+// =====================================
+// Two special particles
+// =====================================
+/**
+* @brief: Adds the contribution of a single jet, whose compact
+*         kinematics and geometry were already filled, to the
+*         histograms of the two-special-particle correlator.
+*
+* @param: nu_weights     Pairs of energy weights of each correlator
+* @param: hist_1         Histograms in theta1, one for each pair
+* @param: hist_2         Histograms in (R_sp, theta1'), one for each
+*                        pair
+* @param: contact_terms  Whether to include contact terms
+*/
+inline void two_special_jet(const CompactJet& jet,
+        const JetGeometry& geometry,
+        const std::vector<std::pair<double, double>>& nu_weights,
+        std::vector<NDHistogram<1>>& hist_1,
+        std::vector<NDHistogram<2>>& hist_2,
+        const bool contact_terms) {
+    const size_t nparts = jet.size();
+
+    // ---------------------------------
+    // Loop on first special particle
+    for (size_t isp1=0; isp1 < nparts; ++isp1) {
+        // Energy-weighting factor for "special" particle
+        const double weight_sp1 = jet.weight[isp1];
+        // Initializing sum of weights within an
+        // angle of the first special particle
+        double sum_weight1 = weight_sp1;
+
+        // =*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=
+        // First Histogram
+        // =*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=
+        // -|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-
+        // Preparing contact terms:
+        // -|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-
+        if (contact_terms) {
+            for (size_t inu = 0; inu < nu_weights.size(); ++inu) {
+                hist_1[inu][0] +=
+                    std::pow(weight_sp1, nu_weights[inu].first);
+            }
+        }
+        // -|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-
+
+        // Particles sorted by their angle theta1
+        // relative to the first special particle
+        const size_t* sorted_parts_sp1 =
+                geometry.sorted_neighbours(isp1);
+
+        // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
+        // Loop on first non-special particle
+        for (size_t jpart=0; jpart<nparts; ++jpart) {
+            const size_t ipart1 = sorted_parts_sp1[jpart];
+            // The theta1 bin in the histogram
+            const int bin1 = geometry.angle_bin(isp1, ipart1);
+            const double weight1 = jet.weight[ipart1];
+
+            // Adding to histogram
+            for (size_t inu = 0; inu < nu_weights.size(); ++inu) {
+                hist_1[inu][bin1] +=
+                        std::pow(sum_weight1 + weight1,
+                                 nu_weights[inu].first)
+                        - std::pow(weight1, nu_weights[inu].first);
+            }
+
+            sum_weight1 += weight1;
+        }
+        // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
+
+        // =*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=
+        // Second Histogram
+        // =*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=
+        // -|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-
+        // Preparing contact terms:
+        // -|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-
+        if (contact_terms) {
+            for (size_t inu = 0; inu < nu_weights.size(); ++inu) {
+                // TODO: Make this placeholder correct
+                hist_2[inu](0, 0) +=
+                    std::pow(weight_sp1, 2 + nu_weights[inu].second);
+            }
+        }
+        // -|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-
+
+        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+        // Loop on second special particle
+        for (size_t isp2=0; isp2<isp1; ++isp2) {
+            // Energy-weighting factor for second special particle
+            const double weight_sp2 = jet.weight[isp2];
+            // Initializing sum of weights within an
+            // angle of the second special particle
+            double sum_weight2 = weight_sp2;
+
+            // The R_sp bin in the histogram
+            // (R_sp is binned in the same way as theta1)
+            const int bin_sp = geometry.angle_bin(isp2, isp1);
+
+            // -|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-
+            // Preparing contact terms:
+            // -|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-
+            if (contact_terms) {
+                for (size_t inu = 0; inu < nu_weights.size(); ++inu) {
+                    // TODO: Make this placeholder correct
+                    hist_2[inu](bin_sp, 0) += weight_sp1 *
+                        std::pow(weight_sp2, 1 + nu_weights[inu].second);
+                }
+            }
+            // -|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-
+
+            // Special particle histogram contribution
+            const double delta_sp = weight_sp1 * weight_sp2;
+
+            // Particles sorted by their angle theta1'
+            // relative to the second special particle
+            const size_t* sorted_parts_sp2 =
+                    geometry.sorted_neighbours(isp2);
+
+            // -----------------------------------
+            // Loop on second non-special particle
+            for (size_t kpart=0; kpart<nparts; ++kpart) {
+                const size_t ipart1p = sorted_parts_sp2[kpart];
+                // The theta1' bin in the histogram
+                const int bin1p = geometry.angle_bin(isp2, ipart1p);
+                const double weight1p = jet.weight[ipart1p];
+
+                // Add weight to Histogram
+                for (size_t inu = 0; inu < nu_weights.size(); ++inu) {
+                    const double delta2 =
+                         std::pow(sum_weight2 + weight1p,
+                                  nu_weights[inu].second)
+                       - std::pow(sum_weight2, nu_weights[inu].second);
+                    hist_2[inu](bin_sp, bin1p) += delta_sp*delta2;
+                }
+                // Preparing for next particle
+                sum_weight2 += weight1p;
+            } // end non-special particle loop
+            // -------------------------------
+        } // end 2nd special particle loop
+        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    } // end first special particle loop
+    // ---------------------------------
+}
+
+
+// =====================================
+// Old three-particle parameterization
+// =====================================
+// Largest and smallest side of the triangle of a pair of particles
+// with the special particle (theta2 < theta1), and the azimuthal
+// angle about the vertex between them
+inline std::tuple<double, double, double> thetaL_thetaS_phi(
+    const double& theta1, const double& theta2, const double& theta12,
+    const CompactJet& jet,
+    const size_t ipart1, const size_t ipart_sp, const size_t ipart2) {
+    // Assuming theta2 < theta1
+    double thetaS = std::min(theta12, theta2);
+    double thetaL = std::max(theta1, theta12);
+    double phi;
+
+    if (theta12 < theta2) {
+        phi = enc_azimuth(jet, ipart2, ipart1, ipart_sp);
+    } else if (theta12 < theta1) {
+        phi = enc_azimuth(jet, ipart1, ipart_sp, ipart2);
+    } else {
+        phi = enc_azimuth(jet, ipart1, ipart2, ipart_sp);
+    }
+
+    return {thetaL, thetaS, phi};
+}
+
+
+/**
+* @brief: Adds the contribution of a single jet, whose compact
+*         kinematics and geometry were already filled, to the
+*         histogram of the old three-particle correlator in
+*         (thetaL, thetaS/thetaL, phi).
+*
+* @param: binS_axis      Axis for thetaS/thetaL
+* @param: phi_axis       Axis for phi
+* @param: contact_terms  Whether to include contact terms
+*/
+inline void old_3particle_jet(const CompactJet& jet,
+        const JetGeometry& geometry,
+        const BinAxis& binS_axis, const BinAxis& phi_axis,
+        NDHistogram<3>& enc_hist, const bool contact_terms) {
+    const size_t nparts = jet.size();
+    const int phizerobin = phi_axis.bin(0);
+
+    // ---------------------------------
+    // Loop on "special" particle
+    for (size_t isp = 0; isp < nparts; ++isp) {
+        // Energy-weighting factor for "special" particle
+        const double weight_sp = jet.weight[isp];
+
+        // -|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-
+        // Preparing contact term
+        // -|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-
+        if (contact_terms)
+            enc_hist(0, 0, phizerobin) += std::pow(weight_sp, 3.);
+        // -|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-
+
+        // Particles sorted by their angle theta1
+        // relative to the special particle
+        // (the special particle itself comes first)
+        const size_t* sorted_parts = geometry.sorted_neighbours(isp);
+
+        // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
+        // Loop on first non-special particle
+        // (calculating change in cumulative E^3 C)
+        for (size_t jpart=1; jpart<nparts; ++jpart) {
+            // Properties of 1st particle
+            const size_t ipart1 = sorted_parts[jpart];
+            const double theta1 = geometry.angle(isp, ipart1);
+            const double weight1 = jet.weight[ipart1];
+
+            // -|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-
+            // Preparing contact term:
+            // -|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-
+            if (contact_terms) {
+                // The theta1 bin
+                const int bin1 = geometry.angle_bin(isp, ipart1);
+
+                // part2 = part_sp != part_1
+                enc_hist(bin1, 0, phizerobin) +=
+                    2*std::pow(weight_sp, 2) * std::pow(weight1, 1);
+
+                // part2 = part1 != part_sp
+                enc_hist(bin1, 0, phizerobin) +=
+                    std::pow(weight_sp, 1) * std::pow(weight1, 2);
+            }
+            // -|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-
+
+            // -----------------------------------
+            // Loop on second non-special particle
+            for (size_t kpart=1; kpart<jpart; ++kpart) {
+                // Getting 2nd particle
+                const size_t ipart2 = sorted_parts[kpart];
+                const double theta2 = geometry.angle(isp, ipart2);
+                const double weight2 = jet.weight[ipart2];
+
+                // Getting thetaL, thetaM, thetaS
+                const double theta12 = geometry.angle(ipart1, ipart2);
+                auto [thetaL, thetaS, phi] =
+                    thetaL_thetaS_phi(theta1, theta2, theta12,
+                                      jet, ipart1, isp, ipart2);
+
+                const double thetaS_over_thetaL = thetaS/thetaL;
+
+                // The thetaL bin in the histogram
+                // (thetaL is either theta1 or theta12)
+                const int binL = theta1 < theta12 ?
+                        geometry.angle_bin(ipart1, ipart2) :
+                        geometry.angle_bin(isp, ipart1);
+                // Calculating thetaS/thetaL bin position
+                // (variable spacing scheme, but with no overflow)
+                const int binS = binS_axis.bin(thetaS_over_thetaL);
+                // Calculating the phi bin
+                const int binphi = phi_axis.bin(phi);
+
+                // *:*:*:*:*:*:*:*:*:*:*:*:*:*:*:*:*:*:*
+                // Adding to the histogram
+                // *:*:*:*:*:*:*:*:*:*:*:*:*:*:*:*:*:*:*
+                const double hist_weight = weight_sp * weight1 * weight2;
+                // imagine a triangle with theta_j < theta_i;
+                // need to count twice to get the full
+                // sum on all pairs (see also contact term)
+                const double perm = 2;
+
+                enc_hist(binL, binS, binphi) += perm*hist_weight;
+                // *:*:*:*:*:*:*:*:*:*:*:*:*:*:*:*:*:*:*
+            } // end calculation/2nd particle loop
+            // -----------------------------------
+        } // end 1st particle loop
+        // -#-#-#-#-#-#-#-#-#-#-#-#-#-#-#-#-
+    } // end "special particle" loop
+    // ---------------------------------
+}
+
+#endif
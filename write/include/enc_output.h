@@ -0,0 +1,173 @@
+/**
+ * @file    enc_output.h
+ *
+ * @brief   Binning, normalization and output of the histograms of
+ *          the "new angles on" N-point energy correlators, shared by
+ *          the executables for each correlator and by the driver
+ *          which runs several of them over the same jets.
+ */
+#ifndef ENC_OUTPUT_H
+#define ENC_OUTPUT_H
+
+#include <string>
+#include <vector>
+#include <array>
+
+#include "general_utils.h"
+#include "jet_geometry.h"
+#include "nd_histogram.h"
+#include "sparse_histogram.h"
+#include "runtime_stats.h"
+
+
+// =====================================
+// Binning
+// =====================================
+/**
+* @brief: Bins of an ENC histogram:
+*           theta1               logarithmic, from 10^minbin to
+*                                10^maxbin, with under- and overflow
+*           theta_k/theta_{k-1}  for each particle beyond the second,
+*                                linear in (0, 1), or logarithmic in
+*                                (10^minbin, 1) with an underflow bin
+*           phi_k                linear in (-pi, pi)
+*
+*         Edges and centers are stored as log10 of the angle for
+*         logarithmic bins, as given by get_bin_edges.
+*/
+struct ENCBinning {
+    // Bins of one ratio theta_k/theta_{k-1}
+    struct RatioBins {
+        bool lin;
+        std::vector<double> edges, centers;
+        int finite_start, nfinite;
+        BinAxis axis;
+    };
+
+    /**
+    * @param: lin_ratios  Whether each ratio theta_k/theta_{k-1}
+    *                     (k = 3, ..., N) is binned linearly
+    */
+    ENCBinning(const double minbin, const double maxbin,
+               const int nbins, const int nphibins,
+               const std::vector<bool>& lin_ratios);
+
+    double minbin, maxbin;
+    int nbins, nphibins;
+
+    std::vector<double> theta1_edges, theta1_centers;
+    int theta1_finite_start, theta1_nfinite;
+
+    std::vector<RatioBins> ratios;
+
+    std::vector<double> phi_edges, phi_centers;
+    BinAxis phi_axis;
+
+    // Per-jet angles binned in theta1, and the axes of the ratios,
+    // as used by ENCEngine
+    JetGeometry geometry() const;
+    std::vector<BinAxis> ratio_axes() const;
+};
+
+
+// =====================================
+// Output Files
+// =====================================
+// Format of the output files
+struct ENCOutputFormat {
+    // Binary NumPy files, or Mathematica-friendly text files
+    // (Python files otherwise)
+    bool npz = false;
+    bool mathematica = false;
+
+    // Command line recorded in each header
+    int argc = 0;
+    char** argv = nullptr;
+
+    std::string extension() const {
+        return npz ? ".npz" : mathematica ? ".txt" : ".py";
+    }
+};
+
+
+// Output file for the correlator with the given weights, e.g.
+// output/new_encs/3particle_<file_prefix>_nus_1_1.py, with its
+// header already written (for text files)
+std::string setup_enc_outfile(const std::string& correlator,
+                              const std::string& file_prefix,
+                              const std::vector<double>& nus,
+                              const ENCOutputFormat& format);
+
+// Output file for the old three-particle correlator, whose weights
+// are fixed, output/new_encs/old_3particle_<file_prefix>.py
+std::string setup_old_3particle_outfile(const std::string& file_prefix,
+                                        const ENCOutputFormat& format);
+
+
+// =====================================
+// Writing Histograms
+// =====================================
+// Each of the following normalizes the histogram of a single
+// correlator, accumulated over njets_tot jets, to the expectation
+// value per jet, differential in the logarithm of theta1 and in
+// each further angle (except in outflow bins); if verbose, prints
+// its total and integrated weights; then writes it to filename,
+// together with its bins, and with the statistics of the runtimes
+// per jet (by number of particles) unless jet_runtimes is null.
+//   (histograms are modified in place)
+
+// Projected two-particle correlator, differential in theta1
+void write_2particle_hist(NDHistogram<1>& hist,
+        const std::vector<double>& nus, const double njets_tot,
+        const ENCBinning& binning,
+        const RuntimeStatistics* jet_runtimes,
+        const std::string& filename, const ENCOutputFormat& format,
+        const int verbose);
+
+// Three-particle correlator, differential in theta1,
+// theta2/theta1 and phi2
+void write_3particle_hist(NDHistogram<3>& hist,
+        const std::vector<double>& nus, const double njets_tot,
+        const ENCBinning& binning,
+        const RuntimeStatistics* jet_runtimes,
+        const std::string& filename, const ENCOutputFormat& format,
+        const int verbose);
+
+// Four-particle correlator, differential in theta1,
+// theta2/theta1, phi2, theta3/theta2 and phi3
+// (sparse histograms are written in coordinate format)
+void write_4particle_hist(NDHistogram<5>& hist,
+        const std::vector<double>& nus, const double njets_tot,
+        const ENCBinning& binning,
+        const RuntimeStatistics* jet_runtimes,
+        const std::string& filename, const ENCOutputFormat& format,
+        const int verbose);
+void write_4particle_hist(SparseHistogram<5>& hist,
+        const std::vector<double>& nus, const double njets_tot,
+        const ENCBinning& binning,
+        const RuntimeStatistics* jet_runtimes,
+        const std::string& filename, const ENCOutputFormat& format,
+        const int verbose);
+
+// Two-special-particle correlator, differential in R_sp, theta1
+// and theta1': the outer product of its histograms in theta1 and in
+// (R_sp, theta1'), all binned as theta1
+void write_2special_hist(NDHistogram<1>& hist_1,
+        NDHistogram<2>& hist_2,
+        const std::vector<double>& nus, const double njets_tot,
+        const ENCBinning& binning,
+        const RuntimeStatistics* jet_runtimes,
+        const std::string& filename, const ENCOutputFormat& format,
+        const int verbose);
+
+// Old three-particle correlator, with weights (1,1,1), differential
+// in thetaL, thetaS/thetaL and phi (binned as theta1,
+// theta2/theta1 and phi2)
+void write_old_3particle_hist(NDHistogram<3>& hist,
+        const double njets_tot,
+        const ENCBinning& binning,
+        const RuntimeStatistics* jet_runtimes,
+        const std::string& filename, const ENCOutputFormat& format,
+        const int verbose);
+
+#endif
@@ -0,0 +1,448 @@
+/**
+ * @file    enc_reference.h
+ *
+ * @brief   Brute-force reference implementations of the energy
+ *          correlators, computed directly from their definitions
+ *          with nested loops on all particles, against which the
+ *          optimized kernels are tested (see
+ *          tests/test_enc_reference.cc).
+ */
+#ifndef ENC_REFERENCE_H
+#define ENC_REFERENCE_H
+
+#include <array>
+#include <vector>
+#include <utility>
+#include <cmath>
+#include <algorithm>
+
+#include "fastjet/PseudoJet.hh"
+
+#include "general_utils.h"
+#include "nd_histogram.h"
+
+
+// =====================================
+// Reference Jets
+// =====================================
+/**
+* @brief: Normalized weights and pairwise angles of the constituents
+*         of a jet, computed directly from the constituents (without
+*         the compact kinematics, sorting or binning of the kernels).
+*
+*         The neighbours of a particle i are ordered as in the
+*         kernels: particle i itself first, then all others by their
+*         angle to i, and by index for equal angles.
+*/
+struct ReferenceJet {
+    ReferenceJet(const std::vector<fastjet::PseudoJet>& constituents,
+                 const bool use_pt, const bool use_deltaR) {
+        const size_t nparts = constituents.size();
+
+        double weight_tot = 0;
+        for (const fastjet::PseudoJet& part : constituents) {
+            weight.push_back(use_pt ? part.pt() : part.e());
+            rap.push_back(part.rap());
+            phi.push_back(part.phi());
+            weight_tot += weight.back();
+        }
+        for (double& w : weight)
+            w /= weight_tot;
+
+        angles.assign(nparts, std::vector<double>(nparts, 0));
+        for (size_t i = 0; i < nparts; ++i) {
+            for (size_t j = 0; j < nparts; ++j) {
+                if (i == j) continue;
+                const fastjet::PseudoJet& a = constituents[i];
+                const fastjet::PseudoJet& b = constituents[j];
+                if (use_deltaR) {
+                    const double dphi = wrap_phi(phi[i] - phi[j]);
+                    angles[i][j] = std::sqrt(dphi*dphi
+                            + (rap[i] - rap[j])*(rap[i] - rap[j]));
+                } else if (a.modp() == 0 or b.modp() == 0) {
+                    angles[i][j] = PI/2;
+                } else {
+                    const double cos_theta = (a.px()*b.px()
+                            + a.py()*b.py() + a.pz()*b.pz())
+                            /(a.modp()*b.modp());
+                    angles[i][j] = std::acos(
+                            std::max(-1., std::min(1., cos_theta)));
+                }
+            }
+        }
+    }
+
+    size_t size() const { return weight.size(); }
+
+    double angle(const size_t i, const size_t j) const {
+        return angles[i][j];
+    }
+
+    // Whether particle a comes before particle b among the
+    // neighbours of particle i
+    bool before(const size_t i, const size_t a, const size_t b) const {
+        if (a == b or b == i) return false;
+        if (a == i) return true;
+        return angles[i][a] < angles[i][b]
+               or (angles[i][a] == angles[i][b] and a < b);
+    }
+
+    // Total weight of the particles before particle b among the
+    // neighbours of particle i
+    double weight_before(const size_t i, const size_t b) const {
+        double sum = 0;
+        for (size_t k = 0; k < size(); ++k)
+            if (before(i, k, b)) sum += weight[k];
+        return sum;
+    }
+
+    // Azimuthal angle (between -pi and pi, in the rapidity-azimuth
+    // plane) from particle a to particle b about particle v, or zero
+    // if either coincides with v
+    double azimuth(const size_t a, const size_t v,
+                   const size_t b) const {
+        const double xa = rap[a] - rap[v], ya = wrap_phi(phi[a] - phi[v]);
+        const double xb = rap[b] - rap[v], yb = wrap_phi(phi[b] - phi[v]);
+        if ((xa == 0 and ya == 0) or (xb == 0 and yb == 0))
+            return 0;
+        return wrap_phi(std::atan2(xa*yb - ya*xb, xa*xb + ya*yb));
+    }
+
+    std::vector<double> weight, rap, phi;
+    std::vector<std::vector<double>> angles;
+
+private:
+    // Angle in (-pi, pi]
+    static double wrap_phi(const double dphi) {
+        const double wrapped = std::remainder(dphi, TWOPI);
+        return wrapped <= -PI ? wrapped + TWOPI : wrapped;
+    }
+};
+
+
+// =====================================
+// Projected and Resolved ENCs
+// =====================================
+// In each, the cumulative energy-weighted sum within an angle of
+// the special particle, (sum of weights)^nu, is differentiated
+// bin by bin: each bin receives the change in (sum of weights)^nu
+// between its lower and upper edge, with sums taken directly over
+// all particles in the earlier bins.
+
+/**
+* @brief: Projected two-particle correlator (PENC) with energy
+*         weight nu, in theta1.
+*/
+inline NDHistogram<1> reference_penc(const ReferenceJet& jet,
+        const BinAxis& theta_axis, const double nu,
+        const bool contact_terms) {
+    NDHistogram<1> hist(NDHistogram<1>::shape_t{
+            size_t(theta_axis.size())});
+
+    for (size_t isp = 0; isp < jet.size(); ++isp) {
+        const double weight_sp = jet.weight[isp];
+
+        // (the contact term is the special particle on its own,
+        //  at zero angle)
+        double prev_sum = contact_terms ? 0 : weight_sp;
+        for (int bin1 = 0; bin1 < theta_axis.size(); ++bin1) {
+            double sum = weight_sp;
+            for (size_t k = 0; k < jet.size(); ++k)
+                if (k != isp and theta_axis.bin(jet.angle(isp, k)) <= bin1)
+                    sum += jet.weight[k];
+
+            hist(bin1) += weight_sp*(std::pow(sum, nu)
+                                     - std::pow(prev_sum, nu));
+            prev_sum = sum;
+        }
+    }
+    return hist;
+}
+
+
+/**
+* @brief: Resolved three-particle correlator (RE3C) with energy
+*         weights (nu1, nu2), in (theta1, theta2/theta1, phi2).
+*/
+inline NDHistogram<3> reference_re3c(const ReferenceJet& jet,
+        const BinAxis& theta_axis, const BinAxis& ratio_axis,
+        const BinAxis& phi_axis, const std::array<double, 2>& nus,
+        const bool contact_terms) {
+    NDHistogram<3> hist(NDHistogram<3>::shape_t{
+            size_t(theta_axis.size()), size_t(ratio_axis.size()),
+            size_t(phi_axis.size())});
+    const int phizerobin = phi_axis.bin(0);
+    const double perm = 2;
+
+    for (size_t isp = 0; isp < jet.size(); ++isp) {
+        const double weight_sp = jet.weight[isp];
+        if (contact_terms)
+            hist(0, 0, phizerobin) +=
+                    std::pow(weight_sp, 1 + nus[0] + nus[1]);
+
+        for (size_t j = 0; j < jet.size(); ++j) {
+            if (j == isp) continue;
+            const double theta1 = jet.angle(isp, j);
+            const int bin1 = theta_axis.bin(theta1);
+
+            // Change in the cumulative weight within theta1
+            const double sum1 = jet.weight_before(isp, j);
+            const double delta1 = std::pow(sum1 + jet.weight[j], nus[0])
+                                  - std::pow(sum1, nus[0]);
+
+            // Second particle at the special particle, or at the first
+            if (contact_terms) {
+                hist(bin1, 0, phizerobin) += 2
+                        *std::pow(weight_sp, 1 + nus[1])
+                        *std::pow(jet.weight[j], nus[0]);
+                hist(bin1, ratio_axis.size()-1, phizerobin) +=
+                        weight_sp*std::pow(jet.weight[j], nus[0] + nus[1]);
+            }
+
+            // Second particle closer to the special particle than the
+            // first, within each phi bin
+            for (int binphi = 0; binphi < phi_axis.size(); ++binphi) {
+                const double weight_phi0 =
+                        binphi == phizerobin ? weight_sp : 0;
+                double prev_sum = weight_phi0;
+                for (int bin2 = 0; bin2 < ratio_axis.size(); ++bin2) {
+                    double sum = weight_phi0;
+                    for (size_t k = 0; k < jet.size(); ++k) {
+                        if (k == isp or not jet.before(isp, k, j))
+                            continue;
+                        const double ratio = theta1 == 0 ? 0
+                                : jet.angle(isp, k)/theta1;
+                        if (ratio_axis.bin(ratio) <= bin2 and
+                                phi_axis.bin(jet.azimuth(j, isp, k))
+                                == binphi)
+                            sum += jet.weight[k];
+                    }
+
+                    hist(bin1, bin2, binphi) += perm*weight_sp*delta1
+                            *(std::pow(sum, nus[1])
+                              - std::pow(prev_sum, nus[1]));
+                    prev_sum = sum;
+                }
+            }
+        }
+    }
+    return hist;
+}
+
+
+/**
+* @brief: Resolved four-particle correlator (RE4C) with energy
+*         weights (nu1, nu2, nu3), in (theta1, theta2/theta1, phi2,
+*         theta3/theta2, phi3), with phi3 measured from the first
+*         particle or, if recursive_phi, from the second.
+*/
+inline NDHistogram<5> reference_re4c(const ReferenceJet& jet,
+        const BinAxis& theta_axis,
+        const std::array<BinAxis, 2>& ratio_axes,
+        const BinAxis& phi_axis, const std::array<double, 3>& nus,
+        const bool recursive_phi, const bool contact_terms) {
+    NDHistogram<5> hist(NDHistogram<5>::shape_t{
+            size_t(theta_axis.size()), size_t(ratio_axes[0].size()),
+            size_t(phi_axis.size()), size_t(ratio_axes[1].size()),
+            size_t(phi_axis.size())});
+    const int phizerobin = phi_axis.bin(0);
+    const double perm = 6;
+
+    for (size_t isp = 0; isp < jet.size(); ++isp) {
+        const double weight_sp = jet.weight[isp];
+        if (contact_terms)
+            hist(0, 0, phizerobin, 0, phizerobin) +=
+                    std::pow(weight_sp, 1 + nus[0] + nus[1] + nus[2]);
+
+        for (size_t j = 0; j < jet.size(); ++j) {
+            if (j == isp) continue;
+            const double theta1 = jet.angle(isp, j);
+            const int bin1 = theta_axis.bin(theta1);
+
+            const double sum1 = jet.weight_before(isp, j);
+            const double delta1 = std::pow(sum1 + jet.weight[j], nus[0])
+                                  - std::pow(sum1, nus[0]);
+
+            for (size_t k = 0; k < jet.size(); ++k) {
+                if (k == isp or not jet.before(isp, k, j)) continue;
+                const double theta2 = jet.angle(isp, k);
+                const int bin2 = ratio_axes[0].bin(
+                        theta1 == 0 ? 0 : theta2/theta1);
+                const int binphi2 = phi_axis.bin(jet.azimuth(j, isp, k));
+
+                // Change in the cumulative weight within theta2, in the
+                // phi bin of the second particle
+                double sum2 = binphi2 == phizerobin ? weight_sp : 0;
+                for (size_t l = 0; l < jet.size(); ++l)
+                    if (l != isp and jet.before(isp, l, k) and
+                            phi_axis.bin(jet.azimuth(j, isp, l))
+                            == binphi2)
+                        sum2 += jet.weight[l];
+                const double delta2 = std::pow(sum2 + jet.weight[k], nus[1])
+                                      - std::pow(sum2, nus[1]);
+
+                // Third particle closer to the special particle than the
+                // second, within each phi bin
+                const size_t iref = recursive_phi ? k : j;
+                for (int binphi3 = 0; binphi3 < phi_axis.size();
+                        ++binphi3) {
+                    const double weight_phi0 =
+                            binphi3 == phizerobin ? weight_sp : 0;
+                    double prev_sum = weight_phi0;
+                    for (int bin3 = 0; bin3 < ratio_axes[1].size();
+                            ++bin3) {
+                        double sum = weight_phi0;
+                        for (size_t l = 0; l < jet.size(); ++l) {
+                            if (l == isp or not jet.before(isp, l, k))
+                                continue;
+                            const double ratio = theta2 == 0 ? 0
+                                    : jet.angle(isp, l)/theta2;
+                            if (ratio_axes[1].bin(ratio) <= bin3 and
+                                    phi_axis.bin(jet.azimuth(iref, isp, l))
+                                    == binphi3)
+                                sum += jet.weight[l];
+                        }
+
+                        hist(bin1, bin2, binphi2, bin3, binphi3) +=
+                                perm*weight_sp*delta1*delta2
+                                *(std::pow(sum, nus[2])
+                                  - std::pow(prev_sum, nus[2]));
+                        prev_sum = sum;
+                    }
+                }
+            }
+        }
+    }
+    return hist;
+}
+
+
+// =====================================
+// Two special particles
+// =====================================
+/**
+* @brief: Two-special-particle correlator with energy weights
+*         (nu1, nu2): the first histogram in theta1, the second in
+*         (R_sp, theta1').
+*
+*         NOTE: As in two_special_jet, each special particle is
+*         NOTE:   also counted as its own neighbour (at zero angle),
+*         NOTE:   the first histogram subtracts the weight of each
+*         NOTE:   particle rather than the cumulative weight before
+*         NOTE:   it, and the contact terms are placeholders.
+*/
+inline std::pair<NDHistogram<1>, NDHistogram<2>> reference_two_special(
+        const ReferenceJet& jet, const BinAxis& theta_axis,
+        const std::pair<double, double>& nus,
+        const bool contact_terms) {
+    const size_t nbins = theta_axis.size();
+    NDHistogram<1> hist_1(NDHistogram<1>::shape_t{nbins});
+    NDHistogram<2> hist_2(NDHistogram<2>::shape_t{nbins, nbins});
+
+    for (size_t isp1 = 0; isp1 < jet.size(); ++isp1) {
+        const double weight_sp1 = jet.weight[isp1];
+
+        // First histogram
+        if (contact_terms)
+            hist_1(0) += std::pow(weight_sp1, nus.first);
+        for (size_t i = 0; i < jet.size(); ++i) {
+            const double sum = weight_sp1 + jet.weight_before(isp1, i);
+            hist_1(theta_axis.bin(jet.angle(isp1, i))) +=
+                    std::pow(sum + jet.weight[i], nus.first)
+                    - std::pow(jet.weight[i], nus.first);
+        }
+
+        // Second histogram
+        if (contact_terms)
+            hist_2(0, 0) += std::pow(weight_sp1, 2 + nus.second);
+        for (size_t isp2 = 0; isp2 < isp1; ++isp2) {
+            const double weight_sp2 = jet.weight[isp2];
+            const int bin_sp = theta_axis.bin(jet.angle(isp2, isp1));
+            if (contact_terms)
+                hist_2(bin_sp, 0) += weight_sp1
+                        *std::pow(weight_sp2, 1 + nus.second);
+
+            double prev_sum = weight_sp2;
+            for (size_t bin1p = 0; bin1p < nbins; ++bin1p) {
+                double sum = weight_sp2;
+                for (size_t k = 0; k < jet.size(); ++k)
+                    if (size_t(theta_axis.bin(jet.angle(isp2, k))) <= bin1p)
+                        sum += jet.weight[k];
+
+                hist_2(bin_sp, bin1p) += weight_sp1*weight_sp2
+                        *(std::pow(sum, nus.second)
+                          - std::pow(prev_sum, nus.second));
+                prev_sum = sum;
+            }
+        }
+    }
+    return {hist_1, hist_2};
+}
+
+
+// =====================================
+// Old three-particle parameterization
+// =====================================
+/**
+* @brief: Three-particle correlator with unit energy weights, in
+*         (thetaL, thetaS/thetaL, phi): the longest and shortest
+*         sides of the triangle of the special particle and two
+*         others, and the azimuthal angle at the vertex they share.
+*/
+inline NDHistogram<3> reference_old_3particle(const ReferenceJet& jet,
+        const BinAxis& theta_axis, const BinAxis& binS_axis,
+        const BinAxis& phi_axis, const bool contact_terms) {
+    NDHistogram<3> hist(NDHistogram<3>::shape_t{
+            size_t(theta_axis.size()), size_t(binS_axis.size()),
+            size_t(phi_axis.size())});
+    const int phizerobin = phi_axis.bin(0);
+    const double perm = 2;
+
+    for (size_t isp = 0; isp < jet.size(); ++isp) {
+        const double weight_sp = jet.weight[isp];
+        if (contact_terms)
+            hist(0, 0, phizerobin) += std::pow(weight_sp, 3);
+
+        for (size_t j = 0; j < jet.size(); ++j) {
+            if (j == isp) continue;
+            const double weight1 = jet.weight[j];
+            const double theta1 = jet.angle(isp, j);
+
+            // Second particle at the special particle, or at the first
+            if (contact_terms)
+                hist(theta_axis.bin(theta1), 0, phizerobin) +=
+                        2*weight_sp*weight_sp*weight1
+                        + weight_sp*weight1*weight1;
+
+            // Second particle closer to the special particle
+            for (size_t k = 0; k < jet.size(); ++k) {
+                if (k == isp or not jet.before(isp, k, j)) continue;
+                const double theta2 = jet.angle(isp, k);
+                const double theta12 = jet.angle(j, k);
+
+                // (with the azimuthal angle taken from the far end of
+                //  the longest side to that of the shortest, except
+                //  when the shortest side does not touch the special
+                //  particle, as in the kernels)
+                double thetaL, thetaS, phi;
+                if (theta12 < theta2) {
+                    thetaL = theta1;  thetaS = theta12;
+                    phi = jet.azimuth(k, j, isp);
+                } else if (theta12 < theta1) {
+                    thetaL = theta1;  thetaS = theta2;
+                    phi = jet.azimuth(j, isp, k);
+                } else {
+                    thetaL = theta12; thetaS = theta2;
+                    phi = jet.azimuth(j, k, isp);
+                }
+
+                hist(theta_axis.bin(thetaL), binS_axis.bin(thetaS/thetaL),
+                     phi_axis.bin(phi)) +=
+                        perm*weight_sp*weight1*jet.weight[k];
+            }
+        }
+    }
+    return hist;
+}
+
+#endif
@@ -0,0 +1,146 @@
+/**
+ * @file    enc_shard.h
+ *
+ * @brief   Shards of ENC runs: runs over disjoint ranges of the
+ *          events (or jets) of a full run, e.g. on separate machines,
+ *          which write their raw histograms so that ecscribe-merge can
+ *          combine them into the output of the full run.
+ */
+#ifndef ENC_SHARD_H
+#define ENC_SHARD_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <functional>
+
+#include "enc_output.h"
+
+
+// =====================================
+// Event Ranges
+// =====================================
+/**
+* @brief: Events [first, last) analyzed by a run; for Open Data and
+*         jet caches, the jets read.
+*/
+struct EventRange {
+    int first = 0;
+    int last = 0;
+    // Shard index and number of shards, with --shard and --nshards
+    // (nshards is 0 otherwise)
+    int shard = 0;
+    int nshards = 0;
+
+    // Whether the run analyzes only part of its events, and writes
+    // a shard rather than the usual output
+    bool sharded = false;
+
+    int size() const { return last - first; }
+};
+
+
+// Range of events given by the command line, out of the n_events of
+// the full run: either --first_event and --last_event, or the
+// --shard-th of --nshards nearly equal ranges (all events otherwise).
+// Since generated events cannot be skipped, Pythia runs (i.e. not
+// reading_jets) can only be split with --shard and --nshards
+EventRange event_range_cmdln(int argc, char* argv[], const int n_events,
+                             const bool reading_jets);
+
+
+// =====================================
+// Configurations
+// =====================================
+// Options which do not change the results of a run (apart from the
+// range of events), and are left out of its configuration (except
+// for --threads with --parallel_pythia, which generates the events
+// of each thread with its own seed)
+extern const std::vector<std::string> configuration_independent_options;
+
+// The options of a command line which determine the results of a
+// run, sorted, one per line with their values
+std::string run_configuration(int argc, char* argv[]);
+
+// 64-bit FNV-1a hash, e.g. of a configuration
+uint64_t configuration_hash(const std::string& configuration);
+
+// A command line without the options selecting a range of events
+std::vector<std::string> unsharded_arguments(
+        const std::vector<std::string>& arguments);
+
+
+// =====================================
+// Shards
+// =====================================
+/**
+* @brief: Settings of a shard, written before its raw (unnormalized)
+*         correlator (see ENCEngine::save).
+*
+*         Shard files hold a header (magic "ECSSHRD", version), these
+*         settings, and then the correlator, in the byte order of the
+*         writing machine.
+*/
+struct ShardInfo {
+    // e.g. "3particle"
+    std::string correlator;
+    // Command line of the shard
+    std::vector<std::string> arguments;
+    // See run_configuration and configuration_hash
+    std::string configuration;
+    uint64_t hash = 0;
+
+    // Binning (see ENCBinning), and energy weights of each histogram
+    double minbin = 0, maxbin = 0;
+    int64_t nbins = 0, nphibins = 0;
+    std::vector<bool> lin_ratios;
+    std::vector<std::vector<double>> nus;
+    bool sparse = false;
+
+    // Events analyzed, out of the n_events of the full run
+    int64_t first_event = 0, last_event = 0;
+    int64_t n_events = 0;
+    // Jets counted towards the normalization without reaching the
+    // correlator (i.e. without constituents)
+    int64_t njets = 0;
+
+    ENCBinning binning() const;
+};
+
+
+// Settings of a shard of the run with the given command line, over
+// the given range of its n_events events (with no jets counted yet)
+ShardInfo shard_info(const std::string& correlator,
+                     int argc, char* argv[],
+                     const ENCBinning& binning,
+                     const std::vector<std::vector<double>>& nus,
+                     const bool sparse,
+                     const EventRange& range, const int n_events);
+
+
+// Output file of a shard, e.g. output/new_encs/
+// 3particle_<file_prefix>_events_<first>_<last>.shard
+std::string shard_filename(const std::string& correlator,
+                           const std::string& file_prefix,
+                           const EventRange& range);
+
+// Writes a shard, with the correlator written by write_engine
+void write_shard(const std::string& filename, const ShardInfo& info,
+                 const std::function<void(std::ostream&)>& write_engine);
+
+// Reads the settings of a shard
+ShardInfo read_shard(const std::string& filename);
+
+// Reads the correlator of a shard with read_engine
+void read_shard_engine(const std::string& filename,
+                       const std::function<void(std::istream&)>& read_engine);
+
+// Throws if the shards cannot be combined: if they are of different
+// correlators, configurations, binnings or weights, or if their
+// ranges of events overlap
+void check_compatible_shards(const std::vector<ShardInfo>& shards,
+                             const std::vector<std::string>& filenames);
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <string.h>
+#include <vector>
 
 #include "cmdln.h"
 #include "pythia_cmdln.h"
@@ -15,4 +16,8 @@ void write_enc_header(std::string filename,
                            std::vector<double> weight,
                            bool python_format);
 
+class NpzWriter;
+void add_enc_header(NpzWriter& npz, int argc, char* argv[],
+                    const std::vector<double> weights);
+
 #endif
@@ -11,10 +11,13 @@
 // ---------------------------------
 #include <cmath>
 #include <cstring>
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include <string>
 #include <vector>
+#include <stdexcept>
+#include <type_traits>
 
 
 // =====================================
@@ -143,6 +146,8 @@ std::vector<double> get_bin_centers(const double minbin,
                                     const bool underflow,
                                     const bool overflow);
 
+std::vector<double> powers_of_ten(const std::vector<double>& log10_vals);
+
 int bin_position(const double val,
                  const double minbin,
                  const double maxbin,
@@ -152,10 +157,105 @@ int bin_position(const double val,
                  const bool overflow);
 
 
+/**
+* @brief: A histogram axis, binned in the same way as get_bin_edges
+*         and bin_position, but with the bin scheme and everything
+*         that does not depend on the value being binned resolved
+*         once, at construction.
+*
+*         Values below (above) the finite bins go into the
+*         underflow (overflow) bin if there is one, and otherwise
+*         raise the same errors as bin_position.
+*/
+class BinAxis {
+public:
+    /**
+    * @param: minbin, maxbin  Edges of the finite bins
+    *                         (log10 of the edges for log bins)
+    * @param: nbins           Number of bins (including outflow bins)
+    * @param: bin_scheme      "lin"/"linear" or "log"/"logarithmic"
+    * @param: underflow       Whether the axis has an underflow bin
+    * @param: overflow        Whether the axis has an overflow bin
+    */
+    BinAxis(const double minbin, const double maxbin,
+            const int nbins, const std::string bin_scheme,
+            const bool underflow, const bool overflow);
+
+    // Bin index of the given value
+    int bin(const double val) const {
+        check_range(val);
+        return bin_from_coordinate(log_bins ? log10(val) : val);
+    }
+
+    // Bin indices of the n given values, vals[i] -> bins[i]
+    void bin_indices(const double* vals, const size_t n,
+                     int* bins) const;
+
+    // Number of bins (including outflow bins)
+    int size() const { return nbins; }
+
+private:
+    double minbin, maxbin;
+    double minbin_val, maxbin_val;
+    int nbins;
+    bool log_bins;
+    bool underflow, overflow;
+
+    // Index of the first finite bin, and number of bins per unit
+    // of (log10 of) the binned value
+    double base_bin;
+    double inv_width;
+
+    // Throws if the value has no bin
+    void check_range(const double val) const {
+        if ((not underflow and val < minbin_val) or
+                (not overflow and maxbin_val < val))
+            throw_out_of_range(val);
+    }
+    [[noreturn]] void throw_out_of_range(const double val) const;
+
+    // Bin index of the given (log10 of the) value, clamped to the
+    // outermost bins (and sending NaN to the first bin)
+    int bin_from_coordinate(const double x) const {
+        const double pos = base_bin + (x - minbin)*inv_width;
+        return static_cast<int>(std::min(double(nbins-1),
+                                         std::max(0., pos)));
+    }
+};
+
+
 // ---------------------------------
 // Command Line Utilities
 // ---------------------------------
-std::vector<char*> strings_to_argv(std::vector<std::string> arguments);
+std::vector<char*> strings_to_argv(std::vector<std::string>& arguments);
+
+// ---------------------------------
+// Memory Utilities
+// ---------------------------------
+size_t parse_memory_size(const std::string size_str);
+std::string format_bytes(const size_t bytes);
+size_t peak_rss_bytes();
+size_t current_rss_bytes();
+
+// ---------------------------------
+// Binary I/O Utilities
+// ---------------------------------
+// Writes (or reads) the raw bytes of a trivially copyable value,
+// e.g. for checkpoints, which are read back on the same machine
+template <typename T>
+inline void write_binary(std::ostream& stream, const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "Can only write trivially copyable values.");
+    stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+template <typename T>
+inline void read_binary(std::istream& stream, T& value) {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "Can only read trivially copyable values.");
+    stream.read(reinterpret_cast<char*>(&value), sizeof(T));
+    if (not stream)
+        throw std::runtime_error("Unexpected end of binary data.");
+}
 
 // ---------------------------------
 // Progress Bar
@@ -0,0 +1,133 @@
+/**
+ * @file    jet_cache.h
+ *
+ * @brief   Binary caches of the jets selected by a run (after jet
+ *          finding and cuts), so that later runs can analyze the
+ *          same jets without generating or clustering any events.
+ */
+#ifndef JET_CACHE_H
+#define JET_CACHE_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <mutex>
+#include <cstdint>
+
+#include "fastjet/PseudoJet.hh"
+
+#include "opendata_utils.h"
+
+
+// =====================================
+// Cached Settings
+// =====================================
+// Command line options which decide the jets in a cache
+// (event generation, jet finding, and cuts)
+extern const std::vector<std::string> jet_cache_options;
+
+// The jet_cache_options given on the command line, each followed
+// by its value
+std::vector<std::string> jet_cache_arguments(int argc, char* argv[]);
+
+// The command line, followed by the arguments stored in a cache;
+// throws if the command line itself gives any jet_cache_options
+std::vector<std::string> with_cached_arguments(int argc, char* argv[],
+        const std::vector<std::string>& cached_arguments);
+
+
+// =====================================
+// Jet Caches
+// =====================================
+/**
+* @brief: Writes jets to a cache, one after the other, as the
+*         four-momenta (px, py, pz, E, as doubles) of their
+*         constituents, so that cached jets are analyzed exactly as
+*         the original ones were.
+*
+*         Layout (in the byte order of the writing machine):
+*           header     magic "ECSJETC", version, counts of jets and
+*                      particles, and the offset of the jets
+*           settings   the command line of the writing run, and the
+*                      arguments from jet_cache_arguments, each
+*                      ending in '\0'
+*           jets       per jet: number of constituents (uint64),
+*                      then their four-momenta
+*
+*         The header is only completed by close(), so that caches
+*         from interrupted runs are not mistaken for complete ones.
+*         Jets may be written from several threads at once.
+*/
+class JetCacheWriter {
+public:
+    JetCacheWriter(const std::string& filename,
+                   int argc, char* argv[]);
+    ~JetCacheWriter();
+
+    JetCacheWriter(const JetCacheWriter&) = delete;
+    JetCacheWriter& operator=(const JetCacheWriter&) = delete;
+
+    // Writes a jet; jets without constituents still count
+    // towards the normalization when the cache is read
+    void write_jet(const std::vector<fastjet::PseudoJet>& constituents);
+    void write_empty_jets(const size_t njets);
+
+    void close();
+
+    size_t size() const { return njets; }
+
+private:
+    const std::string filename;
+    std::ofstream file;
+    std::mutex write_mutex;
+    bool closed = false;
+
+    uint64_t njets = 0, nparticles = 0;
+    uint64_t settings_size = 0, jets_offset = 0;
+    std::string buffer;
+};
+
+
+/**
+* @brief: Reads the jets of a cache written by JetCacheWriter,
+*         in order, directly from the memory-mapped file.
+*/
+class JetCacheReader {
+public:
+    JetCacheReader(const std::string& filename);
+
+    // Number of jets and particles in the cache
+    size_t size() const { return njets; }
+    size_t num_particles() const { return nparticles; }
+
+    // Command line of the run which wrote the cache, and the
+    // arguments which decided its jets
+    const std::string& command() const { return command_; }
+    const std::vector<std::string>& arguments() const {
+        return arguments_;
+    }
+
+    // Reads the next jet, returning false if none are left
+    bool read_jet(std::vector<fastjet::PseudoJet>& constituents);
+    bool read_jet(fastjet::PseudoJet& jet);
+
+    // Skips the given number of jets, returning false if fewer
+    // were left
+    bool skip_jets(const size_t count);
+
+private:
+    const std::string filename;
+    od::MappedFile file;
+    size_t njets = 0, nparticles = 0;
+
+    std::string command_;
+    std::vector<std::string> arguments_;
+
+    // Next jet to be read, and its position
+    size_t next_jet = 0;
+    size_t position = 0;
+
+    std::vector<fastjet::PseudoJet> particle_buffer;
+};
+
+#endif
@@ -0,0 +1,141 @@
+/**
+ * @file    jet_geometry.h
+ *
+ * @brief   Compact per-jet representations of jet constituents
+ *          and of their pairwise angles, for use in energy
+ *          correlator kernels.
+ */
+#ifndef JET_GEOMETRY_H
+#define JET_GEOMETRY_H
+
+#include <vector>
+
+#include "fastjet/PseudoJet.hh"
+
+#include "general_utils.h"
+#include "angle_sort.h"
+
+
+// =====================================
+// Compact Jets
+// =====================================
+/**
+* @brief: Structure-of-arrays representation of the constituents
+*         of a jet, holding only the quantities used by the ENC
+*         kernels. Filled once per jet; storage is reused from
+*         jet to jet.
+*/
+struct CompactJet {
+    // Reads the given constituents, using either pT or energy
+    // (normalized to the total over the jet) as weights
+    void fill(const std::vector<fastjet::PseudoJet>& constituents,
+              const bool use_pt);
+
+    // Number of particles in the current jet
+    size_t size() const { return weight.size(); }
+
+    // Memory used by a jet with nparts particles, in bytes
+    static size_t memory_bytes(const size_t nparts) {
+        return 6*nparts*sizeof(double);
+    }
+
+    // Rapidity and azimuth (the latter in [0, 2pi), as in fastjet)
+    std::vector<double> rap, phi;
+    // Unit 3-vector along the momentum (zero if the momentum is zero)
+    std::vector<double> ux, uy, uz;
+    // Normalized energy weight
+    std::vector<double> weight;
+};
+
+
+// =====================================
+// Azimuthal Angles
+// =====================================
+inline double mod2pi(double phi) {
+    while (phi > PI)
+        phi -= TWOPI;
+    while (phi <= -PI)
+        phi += TWOPI;
+
+    return phi;
+}
+
+double enc_azimuth(const CompactJet& jet,
+                   const size_t ipart1,
+                   const size_t ipart_sp,
+                   const size_t ipart2);
+
+
+// =====================================
+// Jet Geometry
+// =====================================
+/**
+* @brief: Stores the pairwise angles between the constituents
+*         of a single jet, together with their positions in a
+*         logarithmically binned histogram, and, for each particle,
+*         the list of all particles sorted by their angle to that
+*         particle.
+*
+*         Filled once per jet, so that each angle is computed
+*         N(N-1)/2 times rather than once for every loop in which
+*         it is used. Storage is reused from jet to jet.
+*/
+class JetGeometry {
+public:
+    /**
+    * @param: minbin, maxbin  Log10 of the edges of the finite bins
+    * @param: nbins           Number of bins (including outflow bins)
+    * @param: underflow       Whether the binning has an underflow bin
+    * @param: overflow        Whether the binning has an overflow bin
+    */
+    JetGeometry(const double minbin, const double maxbin,
+                const int nbins,
+                const bool underflow=true, const bool overflow=true);
+
+    // Computes all pairwise angles for the given jet
+    // (Delta R in rapidity-azimuth if use_deltaR, or the
+    //  real-space opening angle otherwise)
+    void fill(const CompactJet& jet, const bool use_deltaR);
+
+    // Number of particles in the current jet
+    size_t size() const { return nparts; }
+    // Number of angle bins
+    int nbins() const { return axis.size(); }
+
+    // Memory used for a jet with nparts particles, in bytes
+    static size_t memory_bytes(const size_t nparts) {
+        return nparts*nparts*(sizeof(double) + sizeof(int)
+                              + sizeof(size_t))
+               + AngleSorter::memory_bytes(nparts);
+    }
+
+    // Angle between particles i and j
+    double angle(const size_t i, const size_t j) const {
+        return angles[i*nparts + j];
+    }
+    // Histogram bin of the angle between particles i and j
+    int angle_bin(const size_t i, const size_t j) const {
+        return angle_bins[i*nparts + j];
+    }
+
+    // Indices of all particles, sorted by their angle to particle i;
+    // particle i itself always comes first.
+    const size_t* sorted_neighbours(const size_t i) const {
+        return &neighbours[i*nparts];
+    }
+
+private:
+    // Binning
+    BinAxis axis;
+
+    // Flattened nparts x nparts arrays
+    size_t nparts = 0;
+    std::vector<double> angles;
+    std::vector<int> angle_bins;
+    std::vector<size_t> neighbours;
+
+    // Sorts the neighbours of each particle
+    AngleSorter sorter;
+};
+
+#endif
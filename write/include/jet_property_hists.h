@@ -0,0 +1,82 @@
+/**
+ * @file    jet_property_hists.h
+ *
+ * @brief   Histograms of several properties of jets (mass, pT,
+ *          energy, pseudorapidity and number of constituents), as
+ *          written by the jet_properties executable and by the
+ *          jet_properties analysis of the multi and batch drivers.
+ */
+#ifndef JET_PROPERTY_HISTS_H
+#define JET_PROPERTY_HISTS_H
+
+#include <string>
+#include <vector>
+
+#include "fastjet/PseudoJet.hh"
+
+#include "general_utils.h"
+#include "nd_histogram.h"
+
+
+// Properties of each jet, in the order of their histograms
+extern const std::vector<std::string> jet_property_names;
+
+
+/**
+* @brief: Histograms of the properties of jets:
+*           mass, pT, energy  logarithmic, from 10^minbin to
+*                             10^maxbin, with under- and overflow
+*           eta               linear, in (-eta_cut, eta_cut)
+*           n_constituents    a bin for each number, up to 200
+*/
+class JetPropertyHistograms {
+public:
+    JetPropertyHistograms(const int nbins, const double minbin,
+                          const double maxbin, const double eta_cut);
+
+    // Adds a jet with the given number of constituents
+    void fill(const fastjet::PseudoJet& jet,
+              const size_t n_constituents);
+
+    // Adds the histograms and jet count of another with the same
+    // bins to these
+    void merge(const JetPropertyHistograms& other);
+
+    // Memory of the histograms
+    size_t memory_bytes() const;
+
+    /**
+    * @brief: Normalizes each histogram to the expectation value per
+    *         jet, differential in the property (or in its logarithm,
+    *         except in outflow bins), and writes it with its bins to
+    *         the given files, one for each property (as from
+    *         setup_jet_property_outfiles).
+    *           (histograms are modified in place)
+    */
+    void write(const std::vector<std::string>& filenames,
+               const bool mathematica_format);
+
+    // Number of jets added
+    int njets = 0;
+
+private:
+    struct PropertyBins {
+        bool log;
+        std::vector<double> edges, centers;
+        BinAxis axis;
+        NDHistogram<1> hist;
+    };
+
+    // In the order of jet_property_names
+    std::vector<PropertyBins> properties;
+};
+
+
+// Output files for each property, e.g.
+// output/jet_properties/<file_prefix>_mass.py, with their headers
+// already written
+std::vector<std::string> setup_jet_property_outfiles(
+        const std::string& file_prefix, int argc, char* argv[],
+        const bool mathematica_format);
+
+#endif
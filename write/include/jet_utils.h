@@ -19,6 +19,7 @@
 #include <string>
 #include <string.h>
 #include <algorithm>
+#include <memory>
 
 #include <utility>
 #include <stdexcept>
@@ -102,6 +103,9 @@ PseudoJets get_particles_pythia(const Pythia8::Event event,
 
 PseudoJets add_events(const PseudoJets event1, const PseudoJets event2);
 
+// Whole event as a single (flat) jet
+PseudoJet full_event_jet(const PseudoJets& particles);
+
 double SumScalarPt(const PseudoJets pjs);
 
 double SumEnergy(const PseudoJets pjs);
@@ -126,6 +130,46 @@ JetDefinition process_JetDef(std::string algorithm, double radius,
 std::string jetAlgorithmType(std::string algorithm);
 
 
+// =====================================
+// Jet Selection
+// =====================================
+/**
+* @brief: Cuts on the jets of an event: at most its n_exclusive_jets
+*         leading jets (all of them unless positive), with
+*         pt_min <= pT <= pt_max and |eta| <= eta_cut (unless
+*         eta_cut < 0) for pp collisions, or pt_min <= E <= pt_max
+*         otherwise.
+*/
+struct JetCuts {
+    // (the whole event is a single jet for jet_rad >= 1000)
+    double jet_rad;
+    int n_exclusive_jets;
+    double pt_min, pt_max, eta_cut;
+    bool is_proton_collision;
+
+    // Whether the i-th jet of an event (sorted by pT) passes the
+    // cuts, including the cut pT^2 >= pt_min^2 of event_jets
+    bool selects(const PseudoJet& jet, const size_t i) const;
+};
+
+// Jets of an event, sorted by pT: those found with the given jet
+// definition with pT^2 >= pt_min^2 (as by
+// ClusterSequence::inclusive_jets), or, for jet_rad >= 1000, the
+// whole event as a single jet (cluster_seq_ptr must stay alive as
+// long as the jets)
+PseudoJets event_jets(const PseudoJets& particles,
+                      const JetDefinition& jet_def,
+                      const double jet_rad, const double pt_min,
+                      std::unique_ptr<ClusterSequence>& cluster_seq_ptr);
+
+// Adds the jets of an event which pass the given cuts to jets
+// (see event_jets)
+void select_jets(const PseudoJets& particles,
+                 const JetDefinition& jet_def, const JetCuts& cuts,
+                 std::unique_ptr<ClusterSequence>& cluster_seq_ptr,
+                 PseudoJets& jets);
+
+
 // =====================================
 // Visualization Utilities
 // =====================================
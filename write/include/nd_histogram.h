@@ -0,0 +1,345 @@
+/**
+ * @file    nd_histogram.h
+ *
+ * @brief   Multi-dimensional histograms stored in a single
+ *          contiguous, aligned buffer.
+ */
+#ifndef ND_HISTOGRAM_H
+#define ND_HISTOGRAM_H
+
+#include <array>
+#include <vector>
+#include <cstddef>
+#include <new>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <algorithm>
+#include <type_traits>
+
+
+// =====================================
+// Aligned Storage
+// =====================================
+/**
+* @brief: Allocator returning storage aligned to the given number
+*         of bytes (by default, a cache line).
+*/
+template <typename T, size_t Alignment = 64>
+struct AlignedAllocator {
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind { typedef AlignedAllocator<U, Alignment> other; };
+
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+    T* allocate(const size_t n) {
+        return static_cast<T*>(::operator new(
+                n*sizeof(T), std::align_val_t(Alignment)));
+    }
+    void deallocate(T* ptr, const size_t) {
+        ::operator delete(ptr, std::align_val_t(Alignment));
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const {
+        return true;
+    }
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const {
+        return false;
+    }
+};
+
+
+// =====================================
+// Histogram Views
+// =====================================
+/**
+* @brief: Read-only view of a histogram (or of a slice of one),
+*         indexed like a nested std::vector: view[i][j][k].
+*         Does not own its data, which must outlive the view.
+*/
+template <size_t Rank>
+class NDHistogramView {
+public:
+    NDHistogramView(const double* data_, const size_t* shape_,
+                    const size_t* strides_)
+        : data(data_), shape(shape_), strides(strides_) {}
+
+    // Number of bins along the first dimension
+    size_t size() const { return shape[0]; }
+
+    // Slice at bin i of the first dimension
+    // (or the bin content itself, for one-dimensional views)
+    auto operator[](const size_t i) const {
+        if constexpr (Rank == 1)
+            return data[i*strides[0]];
+        else
+            return NDHistogramView<Rank-1>(data + i*strides[0],
+                                           shape + 1, strides + 1);
+    }
+
+private:
+    const double* data;
+    const size_t* shape;
+    const size_t* strides;
+};
+
+
+// =====================================
+// N-Dimensional Histograms
+// =====================================
+/**
+* @brief: Histogram with Rank dimensions, whose bins are stored
+*         contiguously in row-major order (the last dimension
+*         varying fastest), in a single cache-line aligned buffer.
+*
+*         Bins are accessed either by their indices along each
+*         dimension, hist(i, j, k), or by their flat position in
+*         the buffer, hist[index], with
+*             index = i*stride(0) + j*stride(1) + k*stride(2).
+*/
+template <size_t Rank>
+class NDHistogram {
+    static_assert(Rank >= 1, "Need at least one dimension.");
+
+public:
+    typedef std::array<size_t, Rank> shape_t;
+
+    // (memory use is fixed by the shape, see allocated_bytes)
+    static constexpr bool grows = false;
+
+    NDHistogram() { shape_.fill(0); strides_.fill(0); }
+
+    // Histogram with the given number of bins along each dimension,
+    // with all bins set to the given value
+    explicit NDHistogram(const shape_t& shape, const double value = 0)
+            : shape_(shape) {
+        size_t total_size = 1;
+        for (size_t dim = Rank; dim-- > 0;) {
+            strides_[dim] = total_size;
+            total_size   *= shape_[dim];
+        }
+        bins.assign(total_size, value);
+    }
+
+    // e.g. NDHistogram<3> hist(nbins1, nbins2, nbins3);
+    template <typename... Sizes,
+              typename = std::enable_if_t<sizeof...(Sizes) == Rank and
+                          std::conjunction_v<std::is_integral<Sizes>...>>>
+    explicit NDHistogram(const Sizes... sizes)
+        : NDHistogram(shape_t{static_cast<size_t>(sizes)...}) {}
+
+    // ---------------------------------
+    // Shape
+    // ---------------------------------
+    // Total number of bins
+    size_t size() const { return bins.size(); }
+
+    // Memory allocated for a histogram with the given shape, in bytes
+    static size_t allocated_bytes(const shape_t& shape) {
+        size_t total_size = 1;
+        for (const size_t dim_size : shape)
+            total_size *= dim_size;
+        return total_size*sizeof(double);
+    }
+
+    const shape_t& shape() const { return shape_; }
+    size_t shape(const size_t dim) const { return shape_[dim]; }
+
+    // Distance in the buffer between neighbouring bins
+    // along the given dimension
+    const shape_t& strides() const { return strides_; }
+    size_t stride(const size_t dim) const { return strides_[dim]; }
+
+    // ---------------------------------
+    // Access
+    // ---------------------------------
+    // Flat position of the bin with the given indices
+    template <typename... Indices>
+    size_t index(const Indices... indices) const {
+        static_assert(sizeof...(Indices) == Rank,
+                      "Need one index for each dimension.");
+        const shape_t index_array{static_cast<size_t>(indices)...};
+        size_t flat_index = 0;
+        for (size_t dim = 0; dim < Rank; ++dim)
+            flat_index += index_array[dim]*strides_[dim];
+        return flat_index;
+    }
+
+    template <typename... Indices>
+    double& operator()(const Indices... indices) {
+        return bins[index(indices...)];
+    }
+    template <typename... Indices>
+    double operator()(const Indices... indices) const {
+        return bins[index(indices...)];
+    }
+
+    double& operator[](const size_t flat_index) {
+        return bins[flat_index];
+    }
+    double operator[](const size_t flat_index) const {
+        return bins[flat_index];
+    }
+
+    double* data() { return bins.data(); }
+    const double* data() const { return bins.data(); }
+
+    // Calls func(indices, value) for every bin, in order
+    // of flat position
+    template <typename Func>
+    void for_each_bin(Func func) {
+        for_each_index([&](const shape_t& indices,
+                           const size_t flat_index) {
+            func(indices, bins[flat_index]);
+        });
+    }
+
+    // Read-only nested view, e.g. for output
+    NDHistogramView<Rank> view() const {
+        return NDHistogramView<Rank>(bins.data(), shape_.data(),
+                                     strides_.data());
+    }
+
+    // ---------------------------------
+    // Bulk operations
+    // ---------------------------------
+    void fill(const double value) {
+        std::fill(bins.begin(), bins.end(), value);
+    }
+
+    // Multiplies every bin by the given factor
+    NDHistogram& scale(const double factor) {
+        for (double& bin : bins)
+            bin *= factor;
+        return *this;
+    }
+
+    // Adds the bins of another histogram with the same shape
+    NDHistogram& add(const NDHistogram& other) {
+        check_same_shape(other);
+        const double* other_bins = other.data();
+        for (size_t i = 0; i < bins.size(); ++i)
+            bins[i] += other_bins[i];
+        return *this;
+    }
+    NDHistogram& operator+=(const NDHistogram& other) {
+        return add(other);
+    }
+
+    // ---------------------------------
+    // Serialization
+    // ---------------------------------
+    // Writes the shape and the raw bins (e.g. for checkpoints)
+    void save(std::ostream& stream) const {
+        stream.write(reinterpret_cast<const char*>(shape_.data()),
+                     sizeof(shape_t));
+        stream.write(reinterpret_cast<const char*>(bins.data()),
+                     bins.size()*sizeof(double));
+    }
+
+    // Reads bins written by save, from a histogram of the same shape
+    void load(std::istream& stream) {
+        shape_t saved_shape;
+        stream.read(reinterpret_cast<char*>(saved_shape.data()),
+                    sizeof(shape_t));
+        if (stream and saved_shape != shape_)
+            throw std::runtime_error(
+                    "Saved histogram has a different shape.");
+        stream.read(reinterpret_cast<char*>(bins.data()),
+                    bins.size()*sizeof(double));
+        if (not stream)
+            throw std::runtime_error("Saved histogram is truncated.");
+    }
+
+    /**
+    * @brief: Sums over all dimensions except the given ones.
+    *
+    * @param: dims   Dimensions to keep, in increasing order.
+    *
+    * @return: NDHistogram<ProjRank>
+    */
+    template <size_t ProjRank>
+    NDHistogram<ProjRank> project(
+            const std::array<size_t, ProjRank>& dims) const {
+        typename NDHistogram<ProjRank>::shape_t proj_shape;
+        for (size_t idim = 0; idim < ProjRank; ++idim) {
+            if (dims[idim] >= Rank or
+                    (idim > 0 and dims[idim] <= dims[idim-1]))
+                throw std::invalid_argument(
+                        "Projected dimensions must be distinct, "
+                        "increasing, and less than the rank.");
+            proj_shape[idim] = shape_[dims[idim]];
+        }
+
+        NDHistogram<ProjRank> proj(proj_shape);
+        for_each_index([&](const shape_t& indices,
+                           const size_t flat_index) {
+            size_t proj_index = 0;
+            for (size_t idim = 0; idim < ProjRank; ++idim)
+                proj_index += indices[dims[idim]]*proj.stride(idim);
+            proj[proj_index] += bins[flat_index];
+        });
+        return proj;
+    }
+
+    /**
+    * @brief: Merges each group of `factor` neighbouring bins along
+    *         the given dimension into a single bin, summing their
+    *         contents.
+    */
+    NDHistogram rebin(const size_t dim, const size_t factor) const {
+        if (dim >= Rank or factor == 0 or shape_[dim] % factor != 0)
+            throw std::invalid_argument(
+                    "Can only rebin by a factor dividing the "
+                    "number of bins along an existing dimension.");
+
+        shape_t new_shape = shape_;
+        new_shape[dim] /= factor;
+
+        NDHistogram rebinned(new_shape);
+        for_each_index([&](shape_t indices, const size_t flat_index) {
+            indices[dim] /= factor;
+            size_t new_index = 0;
+            for (size_t idim = 0; idim < Rank; ++idim)
+                new_index += indices[idim]*rebinned.stride(idim);
+            rebinned[new_index] += bins[flat_index];
+        });
+        return rebinned;
+    }
+
+private:
+    shape_t shape_;
+    shape_t strides_;
+    std::vector<double, AlignedAllocator<double>> bins;
+
+    void check_same_shape(const NDHistogram& other) const {
+        if (other.shape_ != shape_)
+            throw std::invalid_argument(
+                    "Histograms must have the same shape.");
+    }
+
+    // Calls func(indices, flat_index) for every bin, in order
+    template <typename Func>
+    void for_each_index(Func func) const {
+        if (bins.empty()) return;
+        shape_t indices;
+        indices.fill(0);
+        for (size_t flat_index = 0; flat_index < bins.size();
+                ++flat_index) {
+            func(indices, flat_index);
+            // Incrementing the indices, last dimension fastest
+            for (size_t dim = Rank; dim-- > 0;) {
+                if (++indices[dim] < shape_[dim]) break;
+                indices[dim] = 0;
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,85 @@
+/**
+ * @file    npy_utils.h
+ *
+ * @brief   Writes arrays to binary files in the NumPy .npz format,
+ *          so that large histograms can be saved (and later loaded,
+ *          or memory-mapped) without formatting them as text.
+ */
+#ifndef NPY_UTILS_H
+#define NPY_UTILS_H
+
+#include <array>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include <cstddef>
+
+
+// =====================================
+// NumPy Archives
+// =====================================
+/**
+* @brief: Writes named arrays to an uncompressed .npz archive,
+*         readable with numpy.load.
+*
+*         Each array is stored as a .npy file within the archive,
+*         with its data aligned to 64 bytes from the start of the
+*         archive, so that it can be memory-mapped in place (see
+*         plot/histogram.py). The archive is finalized by close(),
+*         or on destruction.
+*
+*         Archives are limited to 4 GB (no ZIP64 extensions).
+*/
+class NpzWriter {
+public:
+    explicit NpzWriter(const std::string& filename);
+    ~NpzWriter();
+
+    NpzWriter(const NpzWriter&) = delete;
+    NpzWriter& operator=(const NpzWriter&) = delete;
+
+    // Array of doubles with the given shape (row-major)
+    void add(const std::string& name, const double* data,
+             const std::vector<size_t>& shape);
+    template <size_t Rank>
+    void add(const std::string& name, const double* data,
+             const std::array<size_t, Rank>& shape) {
+        add(name, data, std::vector<size_t>(shape.begin(),
+                                            shape.end()));
+    }
+
+    // Array of integers with the given shape (row-major)
+    void add(const std::string& name, const int64_t* data,
+             const std::vector<size_t>& shape);
+
+    // One-dimensional array
+    void add(const std::string& name,
+             const std::vector<double>& values);
+
+    // Scalars (zero-dimensional arrays)
+    void add(const std::string& name, const double value);
+    void add(const std::string& name, const std::string& value);
+
+    // Writes the archive directory; no arrays may be added after
+    void close();
+
+private:
+    struct Member {
+        std::string name;
+        uint32_t crc;
+        uint32_t size;
+        uint32_t offset;
+    };
+
+    std::string filename;
+    std::ofstream file;
+    std::vector<Member> members;
+    bool closed = false;
+
+    void add_array(const std::string& name, const std::string& descr,
+                   const std::vector<size_t>& shape,
+                   const char* data, const size_t nbytes);
+};
+
+#endif
@@ -2,29 +2,167 @@
 #define READ_EVENT_H
 
 #include <vector>
+#include <memory>
+#include <utility>
 #include <fstream>
 #include <sstream>
+#include <cstdint>
 #include <cmath>
 
 #include "fastjet/PseudoJet.hh"
 
+#include "synthetic_jets.h"
+
 
 namespace od
 {
     // Opendata Files
     const std::string cms_jets_file = "/home/samaf/Documents/Research/DelphiScribe/write/data/cms_jet_run2011A.opendata.txt";
 
-    // Class for reading files
+    // Constituents of a single jet, as flat arrays
+    struct JetConstituents {
+        int event = -1;
+        std::vector<double> pt, eta, phi;
+
+        size_t size() const { return pt.size(); }
+        void clear() { pt.clear(); eta.clear(); phi.clear(); }
+
+        // Massless PseudoJets for each constituent
+        void to_pseudojets(
+                std::vector<fastjet::PseudoJet>& particles) const {
+            particles.clear();
+            particles.reserve(size());
+            for (size_t ipart = 0; ipart < size(); ++ipart) {
+                double px = pt[ipart] * cos(phi[ipart]);
+                double py = pt[ipart] * sin(phi[ipart]);
+                double pz = pt[ipart] * sinh(eta[ipart]);
+                double E = sqrt(px * px + py * py + pz * pz);
+                particles.emplace_back(px, py, pz, E);
+            }
+        }
+    };
+
+    // Read-only view of a whole file, mapped into memory
+    class MappedFile {
+    private:
+        const char* data_ = nullptr;
+        size_t size_ = 0;
+
+    public:
+        // (sequential: whether the file will be read from start to end)
+        MappedFile(const std::string& filename,
+                   const bool sequential=false);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const char* data() const { return data_; }
+        size_t size() const { return size_; }
+    };
+
+
+    // =====================================
+    // Binary Jet Datasets
+    // =====================================
+    /**
+    * @brief: Jets stored in a binary, columnar file (written by
+    *         write_jet_dataset, or by ecscribe-convert), which can
+    *         be read in any order without parsing.
+    *
+    *         Layout (each section 64-byte aligned, in the byte order
+    *         of the writing machine, which is checked on reading):
+    *           header  magic "ECSJETS", version, jet and particle
+    *                   counts, and the offsets of each section
+    *           pt, eta, phi   one float per particle, jet by jet
+    *           index   per jet: offset of its first particle,
+    *                   number of particles, and event number
+    */
+    class JetDataset {
+    public:
+        // Per-jet entry of the index
+        struct JetEntry {
+            uint64_t offset;
+            uint32_t count;
+            int32_t  event;
+        };
+
+        JetDataset(const std::string& filename);
+
+        // Whether the given file is a binary jet dataset
+        static bool is_dataset(const std::string& filename);
+
+        // Number of jets, and total number of particles
+        size_t size() const { return njets; }
+        size_t num_particles() const { return nparticles; }
+
+        // Number of particles in the given jet
+        size_t multiplicity(const size_t ijet) const {
+            return index[ijet].count;
+        }
+
+        // Reads the jet with the given index
+        void read_jet(const size_t ijet, JetConstituents& jet) const;
+
+        // Range [begin, end) of the ishard-th of nshards contiguous
+        // sets of jets, e.g. for parallel workers
+        std::pair<size_t, size_t> shard(const size_t ishard,
+                                        const size_t nshards) const;
+
+        // Indices of the jets with between min_mult and max_mult
+        // particles (inclusive)
+        std::vector<size_t> select_by_multiplicity(
+                const size_t min_mult, const size_t max_mult) const;
+
+    private:
+        MappedFile file;
+        size_t njets = 0, nparticles = 0;
+        const float *pt = nullptr, *eta = nullptr, *phi = nullptr;
+        const JetEntry* index = nullptr;
+    };
+
+    // Converts a text file of CMS Open Data (lines of
+    // `event pt eta phi`) to a binary jet dataset; returns the
+    // number of jets written
+    size_t write_jet_dataset(const std::string& textfile,
+                             const std::string& binaryfile);
+
+
+    // =====================================
+    // Sequential Reading
+    // =====================================
+    // Class for reading files, either as text or as binary
+    // jet datasets (detected automatically), or for reading
+    // synthetic jets in the same way
     class EventReader {
     private:
-        std::ifstream source;
-        int current_event;
+        // Text files: start of the next line to be read
+        std::unique_ptr<MappedFile> text;
+        const char* cursor = nullptr;
+
+        // Binary files: index of the next jet to be read
+        std::unique_ptr<JetDataset> dataset;
+        size_t next_jet = 0;
+
+        // Synthetic jets (never running out), also by the index
+        // of the next jet
+        std::unique_ptr<SyntheticJets> synthetic;
+
+        // Storage reused from jet to jet
+        JetConstituents jet_buffer;
+        std::vector<fastjet::PseudoJet> particle_buffer;
 
     public:
         EventReader(const std::string& inputfile);
-        ~EventReader();
+        EventReader(const SyntheticJetSettings& settings);
 
+        // Reads the next jet, returning false if none are left
+        bool read_jet(JetConstituents& jet);
         bool read_jet(fastjet::PseudoJet& jet);
+
+        // Skips the given number of jets (e.g. those analyzed before
+        // a checkpoint), returning false if fewer were left
+        bool skip_jets(const size_t njets);
     };
 
     // DEBUG: Old OD method
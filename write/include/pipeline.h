@@ -0,0 +1,427 @@
+/**
+ * @file    pipeline.h
+ *
+ * @brief   A staged pipeline for analyzing jets, in which event
+ *          generation (or reading), jet finding, and the correlator
+ *          kernels run concurrently, connected by bounded lock-free
+ *          queues of batches.
+ */
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+#include <stdexcept>
+#include <exception>
+
+#include "fastjet/PseudoJet.hh"
+#include "fastjet/ClusterSequence.hh"
+
+
+// =====================================
+// Bounded Queues
+// =====================================
+/**
+* @brief: Bounded queue with any number of producers and consumers,
+*         in which each slot carries a sequence number saying whose
+*         turn it is (following D. Vyukov), so that no locks are
+*         needed. Producers wait while the queue is full, and
+*         consumers while it is empty, until the queue is closed.
+*
+*         Also records how full the queue is at each push, and how
+*         often producers and consumers had to wait, to show which
+*         stage of a pipeline limits its throughput.
+*/
+template <typename T>
+class BoundedQueue {
+public:
+    // (the capacity is rounded up to a power of two)
+    explicit BoundedQueue(const size_t min_capacity) {
+        if (min_capacity == 0)
+            throw std::invalid_argument(
+                    "BoundedQueue: capacity must be positive.");
+        size_t size = 1;
+        while (size < min_capacity)
+            size <<= 1;
+
+        capacity_ = size;
+        slots.reset(new Slot[capacity_]);
+        for (size_t islot = 0; islot < capacity_; ++islot)
+            slots[islot].sequence.store(islot,
+                                        std::memory_order_relaxed);
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    size_t capacity() const { return capacity_; }
+
+    // Adds an item, waiting while the queue is full; returns false,
+    // without adding it, if the queue is closed while waiting (e.g.
+    // when a pipeline stops after an error)
+    bool push(T&& item) {
+        const size_t occupancy = size();
+        occupancy_sum.fetch_add(occupancy, std::memory_order_relaxed);
+        size_t old_max = max_occupancy_.load(std::memory_order_relaxed);
+        while (occupancy > old_max and not
+               max_occupancy_.compare_exchange_weak(old_max, occupancy,
+                        std::memory_order_relaxed)) {}
+        npushes.fetch_add(1, std::memory_order_relaxed);
+
+        if (try_push(item)) return true;
+        nfull.fetch_add(1, std::memory_order_relaxed);
+        for (int attempt = 1; not try_push(item); ++attempt) {
+            if (closed.load(std::memory_order_acquire))
+                return false;
+            wait(attempt);
+        }
+        return true;
+    }
+
+    // Takes the oldest item, waiting while the queue is empty;
+    // returns false once the queue is closed and empty
+    bool pop(T& item) {
+        npops.fetch_add(1, std::memory_order_relaxed);
+        if (try_pop(item)) return true;
+
+        nempty.fetch_add(1, std::memory_order_relaxed);
+        for (int attempt = 1; not try_pop(item); ++attempt) {
+            // (all pushes are complete once the queue is closed,
+            //  so one more attempt finds any items left)
+            if (closed.load(std::memory_order_acquire))
+                return try_pop(item);
+            wait(attempt);
+        }
+        return true;
+    }
+
+    // Signals that no more items will be pushed
+    void close() { closed.store(true, std::memory_order_release); }
+
+    // Approximate number of items in the queue
+    size_t size() const {
+        const size_t popped = tail.load(std::memory_order_relaxed);
+        const size_t pushed = head.load(std::memory_order_relaxed);
+        return std::min(pushed - std::min(popped, pushed), capacity_);
+    }
+
+    // ---------------------------------
+    // Occupancy statistics
+    // ---------------------------------
+    // Mean and maximum number of items seen by each push
+    double mean_occupancy() const {
+        const uint64_t n = npushes.load();
+        return n == 0 ? 0. : double(occupancy_sum.load())/double(n);
+    }
+    size_t max_occupancy() const { return max_occupancy_.load(); }
+
+    // Fractions of pushes which found the queue full, and of pops
+    // which found it empty
+    double fraction_full() const {
+        const uint64_t n = npushes.load();
+        return n == 0 ? 0. : double(nfull.load())/double(n);
+    }
+    double fraction_empty() const {
+        const uint64_t n = npops.load();
+        return n == 0 ? 0. : double(nempty.load())/double(n);
+    }
+
+    // One-line summary of the above
+    std::string occupancy_summary() const {
+        std::stringstream summary;
+        summary << std::fixed << std::setprecision(1)
+                << mean_occupancy() << " of " << capacity_
+                << " on average (max " << max_occupancy() << "); "
+                << "full for " << 100*fraction_full()
+                << "% of pushes, empty for " << 100*fraction_empty()
+                << "% of pops";
+        return summary.str();
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T item;
+    };
+
+    size_t capacity_ = 0;
+    std::unique_ptr<Slot[]> slots;
+
+    // Positions of the next push and the next pop
+    // (on separate cache lines, as producers and consumers
+    //  update them independently)
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+    alignas(64) std::atomic<bool> closed{false};
+
+    std::atomic<uint64_t> npushes{0}, nfull{0}, occupancy_sum{0};
+    std::atomic<uint64_t> npops{0}, nempty{0};
+    std::atomic<size_t> max_occupancy_{0};
+
+    bool try_push(T& item) {
+        size_t pos = head.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slots[pos & (capacity_-1)];
+            const size_t sequence = slot->sequence.load(
+                    std::memory_order_acquire);
+            if (sequence == pos) {
+                // The slot is free: claiming it
+                if (head.compare_exchange_weak(pos, pos+1,
+                        std::memory_order_relaxed))
+                    break;
+            } else if (sequence < pos) {
+                // The slot still holds an item from the last lap
+                return false;
+            } else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+        slot->item = std::move(item);
+        slot->sequence.store(pos+1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T& item) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slots[pos & (capacity_-1)];
+            const size_t sequence = slot->sequence.load(
+                    std::memory_order_acquire);
+            if (sequence == pos+1) {
+                // The slot holds an item: claiming it
+                if (tail.compare_exchange_weak(pos, pos+1,
+                        std::memory_order_relaxed))
+                    break;
+            } else if (sequence < pos+1) {
+                // The slot has not been filled yet
+                return false;
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+        item = std::move(slot->item);
+        slot->sequence.store(pos + capacity_,
+                             std::memory_order_release);
+        return true;
+    }
+
+    // Yielding at first, then sleeping, so that waiting stages
+    // do not take time from the stage which limits the pipeline
+    static void wait(const int attempt) {
+        if (attempt < 64)
+            std::this_thread::yield();
+        else
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+};
+
+
+// =====================================
+// Jet Analysis Pipeline
+// =====================================
+// Settings for the stages of a pipeline
+struct PipelineSettings {
+    // Threads finding jets, and threads running kernels
+    int jet_finders = 1;
+    int kernels = 1;
+
+    // Batches held by each queue, and events in each batch
+    size_t queue_size = 8;
+    size_t batch_size = 16;
+};
+
+// Results of running a pipeline
+struct PipelineResult {
+    // Jets whose constituents could not be found
+    // (not processed, but still counted towards normalization)
+    int empty_jets = 0;
+
+    // Summary of the occupancy of each queue
+    std::string occupancy;
+};
+
+
+/**
+* @brief: Analyzes events in three concurrent stages, connected by
+*         bounded queues of batches:
+*           1) a single thread producing events with
+*                bool next_event(std::vector<PseudoJet>& event),
+*              which returns false when no events remain;
+*           2) settings.jet_finders threads finding the jets of
+*              each event which pass all cuts, with
+*                void find_jets(const std::vector<PseudoJet>& event,
+*                               std::unique_ptr<ClusterSequence>& cs,
+*                               std::vector<PseudoJet>& jets),
+*              and storing their constituents;
+*           3) settings.kernels threads processing each jet with
+*                void process_jet(int ikernel,
+*                                 const std::vector<PseudoJet>& jet),
+*              where ikernel labels the thread (e.g. to choose its
+*              engine).
+*
+*         A queue which is often full shows that the stage after it
+*         limits the pipeline; one which is often empty, that the
+*         stage before it does.
+*
+*         An exception thrown in any stage stops the others, and is
+*         rethrown (the first one, if several stages fail) once all
+*         threads have finished.
+*
+* @return: PipelineResult
+*/
+template <typename NextEvent, typename FindJets, typename ProcessJet>
+PipelineResult run_jet_pipeline(NextEvent&& next_event,
+                                FindJets&& find_jets,
+                                ProcessJet&& process_jet,
+                                const PipelineSettings& settings) {
+    using fastjet::PseudoJet;
+    typedef std::vector<PseudoJet> Particles;
+
+    if (settings.jet_finders < 1 or settings.kernels < 1
+            or settings.batch_size < 1)
+        throw std::invalid_argument(
+                "run_jet_pipeline: each stage needs at least one "
+                "thread, and batches at least one event.");
+
+    // Constituents of the jets found in a batch of events
+    struct JetBatch {
+        std::vector<Particles> jets;
+        int empty_jets = 0;
+    };
+
+    BoundedQueue<std::vector<Particles>> event_queue(
+            settings.queue_size);
+    BoundedQueue<JetBatch> jet_queue(settings.queue_size);
+
+    // The first error in any stage, after which the queues are
+    // closed, so that no stage waits on them, and each stage stops
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    std::atomic<bool> failed(false);
+    auto fail = [&]() {
+        {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (not error)
+                error = std::current_exception();
+        }
+        failed = true;
+        event_queue.close();
+        jet_queue.close();
+    };
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Events
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    std::thread source([&]() {
+        try {
+            std::vector<Particles> batch;
+            Particles event;
+            while (not failed and next_event(event)) {
+                batch.push_back(std::move(event));
+                event.clear();
+                if (batch.size() >= settings.batch_size) {
+                    if (not event_queue.push(std::move(batch)))
+                        return;
+                    batch.clear();
+                }
+            }
+            if (not batch.empty())
+                event_queue.push(std::move(batch));
+            event_queue.close();
+        } catch (...) {
+            fail();
+        }
+    });
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Jet finding
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    std::atomic<int> finders_running(settings.jet_finders);
+    std::vector<std::thread> finders;
+    for (int ifinder = 0; ifinder < settings.jet_finders; ++ifinder) {
+        finders.emplace_back([&]() {
+            try {
+                std::vector<Particles> batch;
+                std::vector<PseudoJet> event_jets;
+                while (not failed and event_queue.pop(batch)) {
+                    JetBatch jet_batch;
+                    for (const Particles& event : batch) {
+                        std::unique_ptr<fastjet::ClusterSequence> cs;
+                        event_jets.clear();
+                        find_jets(event, cs, event_jets);
+
+                        for (const PseudoJet& jet : event_jets) {
+                            try {
+                                jet_batch.jets.push_back(
+                                        jet.constituents());
+                            } catch (const fastjet::Error& ex) {
+                                std::cerr << "Warning: FastJet: "
+                                          << ex.message() << std::endl;
+                                ++jet_batch.empty_jets;
+                            }
+                        }
+                    }
+                    if (not jet_queue.push(std::move(jet_batch)))
+                        break;
+                }
+            } catch (...) {
+                fail();
+            }
+            // (the last jet finder to finish closes the queue)
+            if (--finders_running == 0)
+                jet_queue.close();
+        });
+    }
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Kernels
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    std::atomic<int> empty_jets(0);
+    std::vector<std::thread> kernels;
+    for (int ikernel = 0; ikernel < settings.kernels; ++ikernel) {
+        kernels.emplace_back([&, ikernel]() {
+            try {
+                JetBatch batch;
+                while (not failed and jet_queue.pop(batch)) {
+                    empty_jets += batch.empty_jets;
+                    for (const Particles& jet : batch.jets)
+                        process_jet(ikernel, jet);
+                }
+            } catch (...) {
+                fail();
+            }
+        });
+    }
+
+    source.join();
+    for (auto& finder : finders)
+        finder.join();
+    for (auto& kernel : kernels)
+        kernel.join();
+
+    if (error)
+        std::rethrow_exception(error);
+
+    PipelineResult result;
+    result.empty_jets = empty_jets.load();
+    result.occupancy = "Pipeline queue occupancy (in batches):\n"
+            "\tevents -> jet finding:  "
+            + event_queue.occupancy_summary() + "\n"
+            "\tjets -> kernels:        "
+            + jet_queue.occupancy_summary() + "\n";
+    return result;
+}
+
+#endif
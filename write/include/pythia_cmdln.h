@@ -8,6 +8,7 @@
 
 #include <string>
 #include <string.h>
+#include <vector>
 #include <iostream>
 
 #include <sys/types.h>
@@ -43,7 +44,22 @@ int showermodel_cmdln(int argc, char* argv[]);
 int checkPythiaInputs(int argc, char* argv[]);
 
 // Setting up pythia
-void setup_pythia_cmdln(Pythia8::Pythia &pythia, int argc, char* argv[]);
+// (with the given random seed, if positive, or Pythia's default)
+void setup_pythia_cmdln(Pythia8::Pythia &pythia, int argc, char* argv[],
+                        const int seed=-1);
+
+// Pythia's default random seed, and the largest allowed seed
+extern const int _PYTHIA_SEED_DEFAULT;
+extern const int _PYTHIA_SEED_MAX;
+
+// Distinct, reproducible seeds for n_streams independent Pythia
+// instances; the first is base_seed itself
+std::vector<int> pythia_seeds(const int base_seed, const int n_streams);
+// The seeds of the n_streams instances of one shard of a run, all
+// distinct from those of the other shards
+std::vector<int> shard_pythia_seeds(const int base_seed,
+                                    const int shard, const int nshards,
+                                    const int n_streams);
 
 void write_jetproperty_header(std::string filename,
                               int argc, char* argv[],
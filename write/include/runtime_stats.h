@@ -0,0 +1,214 @@
+/**
+ * @file    runtime_stats.h
+ *
+ * @brief   Statistics of the runtimes per jet, by number of particles
+ *          in the jet, in memory which does not grow with the number
+ *          of jets.
+ */
+#ifndef RUNTIME_STATS_H
+#define RUNTIME_STATS_H
+
+#include <vector>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <algorithm>
+
+#include "general_utils.h"
+
+
+/**
+* @brief: Runtimes (e.g. in microseconds) by multiplicity: for each
+*         multiplicity, the count, mean and variance (accumulated with
+*         Welford's algorithm), minimum, maximum, and a histogram of
+*         the runtimes in logarithmic bins, from which quantiles are
+*         estimated.
+*
+*         Not thread-safe: each thread should fill its own
+*         statistics, which can be merged afterwards.
+*/
+class RuntimeStatistics {
+public:
+    // Latency bins: BINS_PER_DECADE per decade from 10^MIN_LOG10
+    // to 10^MAX_LOG10, with under- and overflow bins
+    static constexpr int BINS_PER_DECADE = 10;
+    static constexpr int MIN_LOG10 = -2;
+    static constexpr int MAX_LOG10 = 8;
+    static constexpr int NLATENCY_BINS =
+            (MAX_LOG10 - MIN_LOG10)*BINS_PER_DECADE + 2;
+
+    // Statistics of the runtimes of a single multiplicity
+    struct Bucket {
+        uint64_t count = 0;
+        double mean = 0;
+        // Sum of squared deviations from the mean
+        double m2 = 0;
+        double min = std::numeric_limits<double>::infinity();
+        double max = -std::numeric_limits<double>::infinity();
+        std::array<uint64_t, NLATENCY_BINS> latency{};
+
+        void add(const double runtime) {
+            ++count;
+            const double delta = runtime - mean;
+            mean += delta/count;
+            m2 += delta*(runtime - mean);
+            min = std::min(min, runtime);
+            max = std::max(max, runtime);
+            ++latency[latency_bin(runtime)];
+        }
+
+        // (combining the means and variances as in Chan et al.)
+        void merge(const Bucket& other) {
+            if (other.count == 0) return;
+            const double n_a = count, n_b = other.count;
+            const double delta = other.mean - mean;
+            count += other.count;
+            mean += delta*n_b/count;
+            m2 += other.m2 + delta*delta*n_a*n_b/count;
+            min = std::min(min, other.min);
+            max = std::max(max, other.max);
+            for (int ibin = 0; ibin < NLATENCY_BINS; ++ibin)
+                latency[ibin] += other.latency[ibin];
+        }
+
+        // Sample standard deviation (NaN for fewer than two runtimes)
+        double stdev() const {
+            return count < 2 ? std::numeric_limits<double>::quiet_NaN()
+                             : std::sqrt(m2/(count - 1));
+        }
+
+        // Estimated q-quantile, interpolating logarithmically within
+        // the latency bin which contains it
+        double quantile(const double q) const {
+            if (count == 0)
+                return std::numeric_limits<double>::quiet_NaN();
+
+            const double target = q*count;
+            double cumulative = 0;
+            for (int ibin = 0; ibin < NLATENCY_BINS; ++ibin) {
+                if (latency[ibin] == 0 or
+                        cumulative + latency[ibin] < target) {
+                    cumulative += latency[ibin];
+                    continue;
+                }
+                if (ibin == 0) return min;
+                if (ibin == NLATENCY_BINS-1) return max;
+
+                const double fraction = (target - cumulative)
+                                        /latency[ibin];
+                const double log_low = MIN_LOG10 + double(ibin-1)
+                                                   /BINS_PER_DECADE;
+                const double value = std::pow(10., log_low
+                        + fraction/BINS_PER_DECADE);
+                return std::clamp(value, min, max);
+            }
+            return max;
+        }
+    };
+
+
+    // Adds the runtime of a jet with the given number of particles
+    void add(const size_t multiplicity, const double runtime) {
+        if (multiplicity >= buckets.size())
+            buckets.resize(multiplicity + 1);
+        buckets[multiplicity].add(runtime);
+    }
+
+    void merge(const RuntimeStatistics& other) {
+        if (other.buckets.size() > buckets.size())
+            buckets.resize(other.buckets.size());
+        for (size_t num = 0; num < other.buckets.size(); ++num)
+            buckets[num].merge(other.buckets[num]);
+    }
+
+    // Statistics of the runtimes for each multiplicity, from zero to
+    // the largest multiplicity seen (NaN where there are no jets)
+    std::vector<double> counts() const {
+        return collect([](const Bucket& b) { return double(b.count); },
+                       true);
+    }
+    std::vector<double> means() const {
+        return collect([](const Bucket& b) { return b.mean; });
+    }
+    std::vector<double> stds() const {
+        return collect([](const Bucket& b) { return b.stdev(); });
+    }
+    std::vector<double> mins() const {
+        return collect([](const Bucket& b) { return b.min; });
+    }
+    std::vector<double> maxs() const {
+        return collect([](const Bucket& b) { return b.max; });
+    }
+    std::vector<double> quantiles(const double q) const {
+        return collect([q](const Bucket& b) { return b.quantile(q); });
+    }
+
+    const std::vector<Bucket>& by_multiplicity() const { return buckets; }
+
+
+    /**
+    * @brief: Writes the statistics, e.g. for checkpoints; load reads
+    *         them back, replacing the current ones.
+    */
+    void save(std::ostream& stream) const {
+        write_binary(stream, static_cast<uint64_t>(buckets.size()));
+        for (const Bucket& bucket : buckets) {
+            write_binary(stream, bucket.count);
+            write_binary(stream, bucket.mean);
+            write_binary(stream, bucket.m2);
+            write_binary(stream, bucket.min);
+            write_binary(stream, bucket.max);
+            stream.write(reinterpret_cast<const char*>(
+                            bucket.latency.data()),
+                         sizeof(bucket.latency));
+        }
+    }
+
+    void load(std::istream& stream) {
+        uint64_t nbuckets;
+        read_binary(stream, nbuckets);
+        buckets.assign(nbuckets, Bucket());
+        for (Bucket& bucket : buckets) {
+            read_binary(stream, bucket.count);
+            read_binary(stream, bucket.mean);
+            read_binary(stream, bucket.m2);
+            read_binary(stream, bucket.min);
+            read_binary(stream, bucket.max);
+            stream.read(reinterpret_cast<char*>(bucket.latency.data()),
+                        sizeof(bucket.latency));
+        }
+        if (not stream)
+            throw std::runtime_error("Saved runtime statistics are "
+                                     "truncated.");
+    }
+
+private:
+    // Indexed by multiplicity
+    std::vector<Bucket> buckets;
+
+    static int latency_bin(const double runtime) {
+        if (not (runtime >= std::pow(10., MIN_LOG10)))
+            return 0;
+        const int ibin = 1 + static_cast<int>(std::floor(
+                (std::log10(runtime) - MIN_LOG10)*BINS_PER_DECADE));
+        return std::min(ibin, NLATENCY_BINS-1);
+    }
+
+    template <class Statistic>
+    std::vector<double> collect(const Statistic& statistic,
+                                const bool keep_empty = false) const {
+        std::vector<double> values;
+        values.reserve(buckets.size());
+        for (const Bucket& bucket : buckets)
+            values.push_back(bucket.count > 0 or keep_empty ?
+                    statistic(bucket)
+                    : std::numeric_limits<double>::quiet_NaN());
+        return values;
+    }
+};
+
+#endif
@@ -0,0 +1,325 @@
+/**
+ * @file    sparse_histogram.h
+ *
+ * @brief   Multi-dimensional histograms storing only their
+ *          non-empty bins, in an open-addressing hash table.
+ */
+#ifndef SPARSE_HISTOGRAM_H
+#define SPARSE_HISTOGRAM_H
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+
+
+// =====================================
+// Sparse Histograms
+// =====================================
+/**
+* @brief: Histogram with Rank dimensions, storing only the bins
+*         which have been filled.
+*
+*         Bins are addressed by the same row-major flat position
+*         as in NDHistogram, which is used as the key of an
+*         open-addressing hash table with linear probing. The table
+*         doubles in size whenever it becomes half full, so that
+*         memory use grows with the number of filled bins rather
+*         than with the total number of bins; set_memory_limit
+*         bounds this growth.
+*/
+template <size_t Rank>
+class SparseHistogram {
+    static_assert(Rank >= 1, "Need at least one dimension.");
+
+public:
+    typedef std::array<size_t, Rank> shape_t;
+
+    // (memory use is not fixed by the shape, see allocated_bytes)
+    static constexpr bool grows = true;
+
+    SparseHistogram() : SparseHistogram(shape_t{}) {}
+
+    /**
+    * @param: shape             Number of bins along each dimension
+    * @param: initial_capacity  Number of slots in the hash table
+    *                           (rounded up to a power of two)
+    */
+    explicit SparseHistogram(const shape_t& shape,
+                             const size_t initial_capacity = 1024)
+            : shape_(shape) {
+        num_bins_ = 1;
+        for (size_t dim = Rank; dim-- > 0;) {
+            strides_[dim] = num_bins_;
+            num_bins_    *= shape_[dim];
+        }
+
+        allocate(table_size(initial_capacity));
+    }
+
+    // ---------------------------------
+    // Shape
+    // ---------------------------------
+    // Total number of bins, filled or not
+    size_t num_bins() const { return num_bins_; }
+    // Number of filled bins
+    size_t nnz() const { return num_filled; }
+    // Number of slots in the hash table
+    size_t capacity() const { return keys.size(); }
+    // Memory used by the hash table, in bytes
+    size_t memory_bytes() const {
+        return keys.size()*(sizeof(uint64_t) + sizeof(double));
+    }
+    // Memory allocated on construction, in bytes
+    // (the table then grows with the number of filled bins)
+    static size_t allocated_bytes(const shape_t& /*shape*/,
+                                  const size_t initial_capacity = 1024) {
+        return table_size(initial_capacity)
+               *(sizeof(uint64_t) + sizeof(double));
+    }
+
+    /**
+    * @brief: Limits the memory of the hash table, including the old
+    *         table while it is being resized, to the given number of
+    *         bytes (0 for no limit). Filling a new bin which would
+    *         need a larger table throws std::runtime_error.
+    */
+    void set_memory_limit(const size_t bytes) { memory_limit = bytes; }
+    size_t get_memory_limit() const { return memory_limit; }
+
+    const shape_t& shape() const { return shape_; }
+    size_t shape(const size_t dim) const { return shape_[dim]; }
+
+    const shape_t& strides() const { return strides_; }
+    size_t stride(const size_t dim) const { return strides_[dim]; }
+
+    // Flat position of the bin with the given indices
+    template <typename... Indices>
+    size_t index(const Indices... indices) const {
+        static_assert(sizeof...(Indices) == Rank,
+                      "Need one index for each dimension.");
+        const shape_t index_array{static_cast<size_t>(indices)...};
+        size_t flat_index = 0;
+        for (size_t dim = 0; dim < Rank; ++dim)
+            flat_index += index_array[dim]*strides_[dim];
+        return flat_index;
+    }
+
+    // Indices of the bin at the given flat position
+    shape_t unravel(size_t flat_index) const {
+        shape_t indices;
+        for (size_t dim = 0; dim < Rank; ++dim) {
+            indices[dim] = flat_index / strides_[dim];
+            flat_index  %= strides_[dim];
+        }
+        return indices;
+    }
+
+    // ---------------------------------
+    // Access
+    // ---------------------------------
+    // Content of the bin at the given flat position,
+    // which is added to the table (empty) if not yet filled
+    double& operator[](const size_t flat_index) {
+        size_t slot = find_slot(flat_index);
+        if (keys[slot] == EMPTY) {
+            // Growing the table if it would become over half full
+            if (2*(num_filled+1) > keys.size()) {
+                check_memory(2*keys.size(), keys.size());
+                rehash(2*keys.size());
+                slot = find_slot(flat_index);
+            }
+            keys[slot] = flat_index;
+            ++num_filled;
+        }
+        return values[slot];
+    }
+
+    // Content of the bin at the given flat position
+    // (zero if not filled)
+    double at(const size_t flat_index) const {
+        const size_t slot = find_slot(flat_index);
+        return keys[slot] == EMPTY ? 0. : values[slot];
+    }
+
+    template <typename... Indices>
+    double& operator()(const Indices... indices) {
+        return (*this)[index(indices...)];
+    }
+    template <typename... Indices>
+    double operator()(const Indices... indices) const {
+        return at(index(indices...));
+    }
+
+    /**
+    * @brief: Calls func(indices, value) for every filled bin, in
+    *         order of flat position (i.e. in the order in which
+    *         the same bins of an NDHistogram would be visited).
+    */
+    template <typename Func>
+    void for_each_bin(Func func) {
+        for (const size_t slot : sorted_slots())
+            func(unravel(keys[slot]), values[slot]);
+    }
+
+    // ---------------------------------
+    // Bulk operations
+    // ---------------------------------
+    // Multiplies every bin by the given factor
+    SparseHistogram& scale(const double factor) {
+        for (size_t slot = 0; slot < keys.size(); ++slot)
+            if (keys[slot] != EMPTY)
+                values[slot] *= factor;
+        return *this;
+    }
+
+    // Adds the bins of another histogram with the same shape
+    SparseHistogram& operator+=(const SparseHistogram& other) {
+        if (other.shape_ != shape_)
+            throw std::invalid_argument(
+                    "Histograms must have the same shape.");
+        // (in order, so that the result does not depend on the
+        //  layout of either table)
+        for (const size_t slot : other.sorted_slots())
+            (*this)[other.keys[slot]] += other.values[slot];
+        return *this;
+    }
+
+    // ---------------------------------
+    // Serialization
+    // ---------------------------------
+    // Writes the shape and the filled bins, as (flat position, value)
+    // pairs in order of flat position (e.g. for checkpoints)
+    void save(std::ostream& stream) const {
+        stream.write(reinterpret_cast<const char*>(shape_.data()),
+                     sizeof(shape_t));
+        const uint64_t nfilled = num_filled;
+        stream.write(reinterpret_cast<const char*>(&nfilled),
+                     sizeof(nfilled));
+        for (const size_t slot : sorted_slots()) {
+            stream.write(reinterpret_cast<const char*>(&keys[slot]),
+                         sizeof(uint64_t));
+            stream.write(reinterpret_cast<const char*>(&values[slot]),
+                         sizeof(double));
+        }
+    }
+
+    // Replaces the bins with those written by save, from a histogram
+    // of the same shape
+    void load(std::istream& stream) {
+        shape_t saved_shape;
+        uint64_t nfilled = 0;
+        stream.read(reinterpret_cast<char*>(saved_shape.data()),
+                    sizeof(shape_t));
+        stream.read(reinterpret_cast<char*>(&nfilled), sizeof(nfilled));
+        if (stream and saved_shape != shape_)
+            throw std::runtime_error(
+                    "Saved histogram has a different shape.");
+
+        check_memory(table_size(2*nfilled + 1), 0);
+        allocate(table_size(2*nfilled + 1));
+        for (uint64_t ibin = 0; stream and ibin < nfilled; ++ibin) {
+            uint64_t key;
+            double value;
+            stream.read(reinterpret_cast<char*>(&key), sizeof(key));
+            stream.read(reinterpret_cast<char*>(&value), sizeof(value));
+            if (not stream) break;
+            if (key >= num_bins_)
+                throw std::runtime_error(
+                        "Saved histogram has a bin out of range.");
+            (*this)[key] = value;
+        }
+        if (not stream)
+            throw std::runtime_error("Saved histogram is truncated.");
+    }
+
+private:
+    // Key marking an unused slot
+    static constexpr uint64_t EMPTY = ~uint64_t(0);
+
+    shape_t shape_;
+    shape_t strides_;
+    size_t num_bins_ = 0;
+
+    // Hash table, with a power-of-two number of slots
+    std::vector<uint64_t> keys;
+    std::vector<double> values;
+    size_t num_filled = 0;
+    int shift = 64;
+
+    size_t memory_limit = 0;
+
+    // Number of slots for at least the given capacity
+    static size_t table_size(const size_t capacity) {
+        size_t size = 16;
+        while (size < capacity)
+            size *= 2;
+        return size;
+    }
+
+    // Throws if a table with the given number of slots, alongside
+    // the given number of old slots, would exceed the memory limit
+    void check_memory(const size_t capacity,
+                      const size_t old_capacity) const {
+        const size_t bytes = (capacity + old_capacity)
+                             *(sizeof(uint64_t) + sizeof(double));
+        if (memory_limit > 0 and bytes > memory_limit)
+            throw std::runtime_error(
+                    "Sparse histogram with "
+                    + std::to_string(num_filled) + " filled bins "
+                    + "needs more than its memory limit of "
+                    + std::to_string(memory_limit) + " bytes.");
+    }
+
+    void allocate(const size_t capacity) {
+        keys.assign(capacity, EMPTY);
+        values.assign(capacity, 0.);
+        num_filled = 0;
+        shift = 64;
+        for (size_t size = capacity; size > 1; size /= 2)
+            --shift;
+    }
+
+    // Slot holding the given key, or the empty slot where it
+    // would be inserted (Fibonacci hashing, then linear probing)
+    size_t find_slot(const uint64_t key) const {
+        const size_t mask = keys.size() - 1;
+        size_t slot = (key*UINT64_C(0x9E3779B97F4A7C15)) >> shift;
+        while (keys[slot] != key and keys[slot] != EMPTY)
+            slot = (slot + 1) & mask;
+        return slot;
+    }
+
+    void rehash(const size_t capacity) {
+        std::vector<uint64_t> old_keys = std::move(keys);
+        std::vector<double> old_values = std::move(values);
+        allocate(capacity);
+        for (size_t slot = 0; slot < old_keys.size(); ++slot) {
+            if (old_keys[slot] == EMPTY) continue;
+            const size_t new_slot = find_slot(old_keys[slot]);
+            keys[new_slot]   = old_keys[slot];
+            values[new_slot] = old_values[slot];
+            ++num_filled;
+        }
+    }
+
+    std::vector<size_t> sorted_slots() const {
+        std::vector<size_t> slots;
+        slots.reserve(num_filled);
+        for (size_t slot = 0; slot < keys.size(); ++slot)
+            if (keys[slot] != EMPTY)
+                slots.push_back(slot);
+        std::sort(slots.begin(), slots.end(),
+                  [this](const size_t a, const size_t b) {
+                      return keys[a] < keys[b];
+                  });
+        return slots;
+    }
+};
+
+#endif
@@ -0,0 +1,84 @@
+/**
+ * @file    synthetic_jets.h
+ *
+ * @brief   A toy generator of jets, needing neither Pythia nor any
+ *          data files, whose jets are read in the same way as those of
+ *          the CMS Open Data (see od::EventReader).
+ */
+#ifndef SYNTHETIC_JETS_H
+#define SYNTHETIC_JETS_H
+
+#include <string>
+#include <cstdint>
+
+namespace od { struct JetConstituents; }
+
+
+// =====================================
+// Settings
+// =====================================
+struct SyntheticJetSettings {
+    int seed = 1;
+
+    // Mean number of constituents, drawn from a negative binomial
+    // distribution (or exactly this number, if fixed_multiplicity)
+    double multiplicity = 50;
+    bool fixed_multiplicity = false;
+
+    // Jet transverse momenta, uniform in [pt_min, pt_max], and jet
+    // axes, uniform in pseudorapidity |eta| < eta_max and in azimuth
+    double pt_min = 500, pt_max = 550;
+    double eta_max = 1.9;
+    // Largest angle of a splitting, i.e. the jet radius
+    double jet_rad = 0.5;
+};
+
+// The settings given on the command line (--synthetic_mult and
+// --synthetic_fixed_mult), with the seed and the jet kinematics of
+// the run, for the options which are shared with Pythia runs
+SyntheticJetSettings synthetic_jet_settings(int argc, char* argv[],
+        const int seed, const double pt_min, const double pt_max,
+        const double eta_max, const double jet_rad);
+
+
+// =====================================
+// Jet Sources
+// =====================================
+// The source of the jets of a run given on the command line:
+// "opendata", "pythia" or "synthetic" (with --source), or, without
+// --source, either of the first two by --use_opendata
+std::string jet_source_cmdln(int argc, char* argv[],
+                             const bool default_use_opendata=true);
+
+
+// =====================================
+// Synthetic Jets
+// =====================================
+/**
+* @brief: Generates jets by a toy parton shower: starting from a
+*         single particle along the jet axis, the constituent chosen
+*         (with probability proportional to its energy fraction)
+*         splits into two, with an angle drawn from d(theta)/theta
+*         below the angle of the splitting which produced it, and a
+*         softer energy fraction drawn from dz/z, until the jet has
+*         its multiplicity. The resulting jets are enhanced in
+*         collinear and soft emissions, as are those of QCD.
+*
+*         Each jet depends only on the settings and on its index, so
+*         that jets can be skipped (e.g. by shards, or on resuming
+*         from a checkpoint) without generating them.
+*/
+class SyntheticJets {
+public:
+    SyntheticJets(const SyntheticJetSettings& settings);
+
+    // Fills the constituents of the jet with the given index
+    void generate(const uint64_t ijet, od::JetConstituents& jet) const;
+
+    const SyntheticJetSettings& settings() const { return settings_; }
+
+private:
+    SyntheticJetSettings settings_;
+};
+
+#endif
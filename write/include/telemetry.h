@@ -0,0 +1,122 @@
+/**
+ * @file    telemetry.h
+ *
+ * @brief   Rate-limited progress and throughput reports of a run,
+ *          printed to stderr and written to an optional status file,
+ *          at a per-event cost of a single atomic increment.
+ */
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <string>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include <condition_variable>
+
+
+// =====================================
+// Settings
+// =====================================
+struct TelemetrySettings {
+    // Seconds between reports (by default, 0.25 on a terminal, where
+    // each report replaces the previous one, and 30 otherwise, where
+    // each report is a new line of the log)
+    double interval = 0.25;
+    // Whether to print reports to stderr
+    bool print = true;
+    // File to which the status of the run is written (as JSON) at
+    // each report, if any
+    std::string status_file;
+
+    // The work for a jet of N particles is binomial(N, work_order),
+    // e.g. the number of triples for three-particle correlators
+    int work_order = 2;
+};
+
+// The settings given on the command line (--progress_interval and
+// --status_file), for correlators of the given order
+TelemetrySettings telemetry_settings(int argc, char* argv[],
+                                     const int work_order,
+                                     const bool print);
+
+
+// =====================================
+// Telemetry
+// =====================================
+/**
+* @brief: Counts the events, jets and units of work of a run, which
+*         any thread may add to, and reports them from a thread of
+*         its own: every interval, the fraction of events done, the
+*         rates of events, jets and work over the last interval, the
+*         estimated time remaining, and the resident memory.
+*
+*         The counters are relaxed atomics, so that the threads adding
+*         to them never wait for each other or for the reports.
+*/
+class RunTelemetry {
+public:
+    /**
+    * @param: total_events  Number of events of the run
+    * @param: settings      Report interval, outputs and work per jet
+    * @param: events_done   Events already done (e.g. before resuming
+    *                       from a checkpoint)
+    */
+    RunTelemetry(const int64_t total_events,
+                 const TelemetrySettings& settings,
+                 const int64_t events_done = 0);
+    // (reporting the run as stopped, if it did not finish)
+    ~RunTelemetry();
+
+    RunTelemetry(const RunTelemetry&) = delete;
+    RunTelemetry& operator=(const RunTelemetry&) = delete;
+
+    // Counts an event
+    void add_event() {
+        events.fetch_add(1, std::memory_order_relaxed);
+    }
+    // Counts a jet with the given number of particles
+    void add_jet(const size_t nparts) {
+        jets.fetch_add(1, std::memory_order_relaxed);
+        work.fetch_add(work_units(nparts), std::memory_order_relaxed);
+    }
+
+    // Makes the final report, and stops the reporting thread
+    void finish();
+
+    // Units of work for a jet of nparts particles
+    uint64_t work_units(const size_t nparts) const;
+
+private:
+    // Counts at a report
+    struct Snapshot {
+        int64_t events = 0;
+        uint64_t jets = 0, work = 0;
+        std::chrono::steady_clock::time_point time;
+    };
+
+    Snapshot snapshot() const;
+    // Prints and writes the report of the interval since previous
+    void report(const Snapshot& current, const Snapshot& previous,
+                const std::string& state);
+    void stop(const std::string& state);
+
+    TelemetrySettings settings;
+    int64_t total_events, initial_events;
+    bool terminal;
+    std::string work_unit;
+    size_t last_line_length = 0;
+
+    std::atomic<int64_t> events;
+    std::atomic<uint64_t> jets, work;
+
+    Snapshot start;
+    std::thread reporter;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
+
+#endif
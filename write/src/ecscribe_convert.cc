@@ -0,0 +1,76 @@
+/**
+ * @file    ecscribe_convert.cc
+ *
+ * @brief   Converts a text file of CMS Open Data (lines of
+ *          `event pt eta phi`) into a binary jet dataset, which
+ *          the ENC executables can read (with `--od_file`) without
+ *          parsing, and which supports random access by jet.
+ */
+
+
+// ---------------------------------
+// Basic imports
+// ---------------------------------
+#include <iostream>
+#include <string>
+#include <stdexcept>
+
+#include <chrono>
+using namespace std::chrono;
+
+// Local imports:
+#include "../include/general_utils.h"
+#include "../include/cmdln.h"
+#include "../include/opendata_utils.h"
+
+
+// ####################################
+// Main
+// ####################################
+/**
+* @brief: Converts the file given by `--input` (by default, the
+*         CMS 2011A Jet Dataset) to the binary file given by
+*         `--output` (by default, the same name ending in .bin).
+*
+* @return: int
+*/
+int main (int argc, char* argv[]) {
+    for (int iarg = 0; iarg < argc; ++iarg) {
+        if (str_eq(argv[iarg], "-h") or str_eq(argv[iarg], "--help")) {
+            std::cout << "Usage: ecscribe-convert [--input file.txt] "
+                      << "[--output file.bin]\n";
+            return 0;
+        }
+    }
+
+    const std::string input = cmdln_string("input", argc, argv,
+                                           od::cms_jets_file);
+    std::string default_output = input;
+    const size_t extension = default_output.rfind(".txt");
+    if (extension != std::string::npos
+            and extension + 4 == default_output.size())
+        default_output.erase(extension);
+    default_output += ".bin";
+    const std::string output = cmdln_string("output", argc, argv,
+                                            default_output);
+
+    if (od::JetDataset::is_dataset(input))
+        throw std::invalid_argument(input + " is already a binary "
+                                    "jet dataset.");
+    if (output == input)
+        throw std::invalid_argument("Cannot overwrite the input file.");
+
+    auto start = high_resolution_clock::now();
+    od::write_jet_dataset(input, output);
+    auto stop = high_resolution_clock::now();
+
+    const od::JetDataset dataset(output);
+    std::cout << "Wrote " << dataset.size() << " jets ("
+              << dataset.num_particles() << " particles) from\n\t"
+              << input << "\nto\n\t" << output << "\n("
+              << format_bytes(od::MappedFile(output).size()) << ", in "
+              << duration_cast<milliseconds>(stop - start).count()/1000.
+              << " seconds).\n";
+
+    return 0;
+}
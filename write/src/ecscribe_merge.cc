@@ -0,0 +1,262 @@
+/**
+ * @file    ecscribe_merge.cc
+ *
+ * @brief   Combines the shards of a three- or four-particle ENC run
+ *          (written by runs over disjoint ranges of its events, with
+ *          --shard and --nshards, or --first_event and --last_event)
+ *          into the output files of the full run.
+ */
+
+
+// ---------------------------------
+// Basic imports
+// ---------------------------------
+#include <iostream>
+#include <string>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+#include <chrono>
+using namespace std::chrono;
+
+// Local imports:
+#include "../include/general_utils.h"
+#include "../include/cmdln.h"
+
+#include "../include/jet_geometry.h"
+#include "../include/nd_histogram.h"
+#include "../include/sparse_histogram.h"
+#include "../include/enc_engine.h"
+#include "../include/enc_output.h"
+#include "../include/enc_shard.h"
+
+
+// =====================================
+// Type definitions for histograms
+// =====================================
+// Correlators, as in the executables for each of them
+typedef ENCEngine<3> EEECEngine;
+typedef ENCEngine<4, PowerWeights, SelectablePhi> EEEECEngine;
+typedef ENCEngine<4, PowerWeights, SelectablePhi,
+                  SparseHistogram<5>> SparseEEEECEngine;
+
+
+// =====================================
+// Merging shards
+// =====================================
+/**
+* @brief: Sums the correlators of the given shards (which must have
+*         the settings of the empty engine), with each thread summing
+*         a contiguous block of the shards.
+*
+* @return: Engine  The summed correlator.
+*/
+template <class Engine>
+Engine merge_shards(const std::vector<std::string>& shard_files,
+                    const Engine& empty, const int n_threads) {
+    const size_t nshards = shard_files.size();
+    const int nblocks = std::max(1, std::min(n_threads,
+                                             static_cast<int>(nshards)));
+
+    std::vector<Engine> sums(nblocks, empty);
+    // (reported after all threads are done)
+    std::vector<std::string> errors(nblocks);
+
+    std::vector<std::thread> workers;
+    for (int iblock = 0; iblock < nblocks; ++iblock) {
+        workers.emplace_back([&, iblock]() {
+            Engine shard = empty;
+            try {
+                for (size_t ishard = nshards*iblock/nblocks;
+                        ishard < nshards*(iblock+1)/nblocks; ++ishard) {
+                    read_shard_engine(shard_files[ishard],
+                        [&](std::istream& stream) { shard.load(stream); });
+                    sums[iblock].merge(shard);
+                }
+            } catch (const std::exception& ex) {
+                errors[iblock] = ex.what();
+            }
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+
+    for (const std::string& error : errors)
+        if (not error.empty())
+            throw std::runtime_error(error);
+
+    for (int iblock = 1; iblock < nblocks; ++iblock)
+        sums[0].merge(sums[iblock]);
+    return std::move(sums[0]);
+}
+
+
+// Energy weights of a correlator from those stored in a shard
+template <class Engine>
+std::vector<typename Engine::nus_t> engine_nus(
+        const std::vector<std::vector<double>>& nus) {
+    std::vector<typename Engine::nus_t> engine_nus;
+    for (const std::vector<double>& weights : nus) {
+        typename Engine::nus_t engine_weights;
+        if (weights.size() != engine_weights.size())
+            throw std::runtime_error("Shard has the wrong number of "
+                                     "energy weights per histogram.");
+        std::copy(weights.begin(), weights.end(),
+                  engine_weights.begin());
+        engine_nus.push_back(engine_weights);
+    }
+    return engine_nus;
+}
+
+
+// ####################################
+// Main
+// ####################################
+/**
+* @brief: Reads the shards given by `--shards`, ensures that they can
+*         be combined, sums them with `--threads` threads, and writes
+*         the normalized histograms as the full run would have (to
+*         files with the `--file_prefix` and output format of the
+*         shards, unless given).
+*
+* @return: int
+*/
+int main (int argc, char* argv[]) {
+    for (int iarg = 0; iarg < argc; ++iarg) {
+        if (str_eq(argv[iarg], "-h") or str_eq(argv[iarg], "--help")) {
+            std::cout << "Usage: ecscribe-merge --shards file1.shard "
+                      << "[file2.shard ...] [--file_prefix prefix] "
+                      << "[--threads n] [--npz bool] "
+                      << "[--mathematica bool]\n";
+            return 0;
+        }
+    }
+
+    const int verbose = cmdln_int("verbose", argc, argv, 1);
+    auto start = high_resolution_clock::now();
+
+    // Shards to combine
+    std::vector<std::string> shard_files;
+    for (int iarg = 0; iarg < argc; ++iarg)
+        if (str_eq(argv[iarg], "--shards"))
+            while (iarg+1 < argc and
+                    std::string(argv[iarg+1]).rfind("--", 0) != 0)
+                shard_files.push_back(argv[++iarg]);
+
+    std::vector<ShardInfo> shards;
+    for (const std::string& file : shard_files)
+        shards.push_back(read_shard(file));
+    check_compatible_shards(shards, shard_files);
+    const ShardInfo& info = shards[0];
+
+    const int n_threads = cmdln_int("threads", argc, argv, 1);
+    if (n_threads < 1)
+        throw std::invalid_argument(
+            "Must be given a positive number of threads.");
+
+    // ---------------------------------
+    // Output settings
+    // ---------------------------------
+    // (by default, those of the shards, whose command line, without
+    //  its range of events, is recorded in the output)
+    std::vector<std::string> run_args = unsharded_arguments(
+            info.arguments);
+    std::vector<char*> run_argv = strings_to_argv(run_args);
+    const int run_argc = static_cast<int>(run_args.size());
+
+    const std::string file_prefix = cmdln_string("file_prefix",
+            argc, argv, cmdln_string("file_prefix", run_argc,
+                                     run_argv.data(), "", true));
+
+    ENCOutputFormat output_format;
+    output_format.npz         = cmdln_bool("npz", argc, argv,
+            cmdln_bool("npz", run_argc, run_argv.data(), false));
+    output_format.mathematica = cmdln_bool("mathematica", argc, argv,
+            cmdln_bool("mathematica", run_argc, run_argv.data(), false));
+    output_format.argc        = run_argc;
+    output_format.argv        = run_argv.data();
+    if (output_format.npz and output_format.mathematica)
+        throw std::invalid_argument(
+            "Cannot write both binary and mathematica output.");
+
+    int64_t events_merged = 0;
+    int64_t njets_tot = 0;
+    for (const ShardInfo& shard : shards) {
+        events_merged += shard.last_event - shard.first_event;
+        njets_tot += shard.njets;
+    }
+    if (verbose >= 1) {
+        std::cout << "Merging " << shards.size() << " shards of the "
+                  << info.correlator << " correlator, with "
+                  << events_merged << " of " << info.n_events
+                  << " events.\n";
+        if (events_merged < info.n_events)
+            std::cout << "Warning: The shards do not cover every "
+                      << "event of the run; the output is normalized "
+                      << "to the jets of the events they cover.\n";
+    }
+
+    // ---------------------------------
+    // Summing and writing the shards
+    // ---------------------------------
+    const ENCBinning binning = info.binning();
+
+    std::vector<std::string> enc_outfiles;
+    for (const std::vector<double>& nus : info.nus)
+        enc_outfiles.push_back(setup_enc_outfile(info.correlator,
+                               file_prefix, nus, output_format));
+
+    // (each with the runtimes of the jets of all shards, for all
+    //  weights together)
+    auto merge_and_write = [&](const auto& empty, auto write_hist) {
+        auto enc = merge_shards(shard_files, empty, n_threads);
+        njets_tot += enc.njets;
+
+        for (size_t inu = 0; inu < info.nus.size(); ++inu)
+            write_hist(enc.hist(inu), info.nus[inu], njets_tot, binning,
+                       &enc.jet_runtimes,
+                       enc_outfiles[inu], output_format, verbose);
+    };
+
+    if (info.correlator == "3particle") {
+        merge_and_write(EEECEngine(binning.geometry(),
+                    binning.ratio_axes(), binning.phi_axis,
+                    engine_nus<EEECEngine>(info.nus),
+                    false, false, false),
+                [](NDHistogram<3>& hist, auto&&... args) {
+                    write_3particle_hist(hist, args...);
+                });
+    } else if (info.correlator == "4particle" and info.sparse) {
+        merge_and_write(SparseEEEECEngine(binning.geometry(),
+                    binning.ratio_axes(), binning.phi_axis,
+                    engine_nus<SparseEEEECEngine>(info.nus),
+                    false, false, false),
+                [](SparseHistogram<5>& hist, auto&&... args) {
+                    write_4particle_hist(hist, args...);
+                });
+    } else if (info.correlator == "4particle") {
+        merge_and_write(EEEECEngine(binning.geometry(),
+                    binning.ratio_axes(), binning.phi_axis,
+                    engine_nus<EEEECEngine>(info.nus),
+                    false, false, false),
+                [](NDHistogram<5>& hist, auto&&... args) {
+                    write_4particle_hist(hist, args...);
+                });
+    } else {
+        throw std::invalid_argument("Cannot merge shards of the "
+                + info.correlator + " correlator.");
+    }
+
+    if (verbose >= 0) {
+        auto stop = high_resolution_clock::now();
+        auto duration = duration_cast<microseconds>(stop-start);
+        std::cout << "\nMerged " << shards.size() << " shards in "
+                  << std::to_string(float(duration.count())/1e6)
+                  << " seconds.\n";
+    }
+
+    return 0;
+}
@@ -45,12 +45,11 @@ using namespace std::chrono;
 #include "../include/pythia_cmdln.h"
 
 #include "../include/opendata_utils.h"
+#include "../include/synthetic_jets.h"
+#include "../include/jet_property_hists.h"
+#include "../include/telemetry.h"
 
 
-// Type definition for histograms
-typedef std::vector<double> Hist;
-// (we are only differential in a single angle)
-
 // =====================================
 // Switches, flags, and options
 // =====================================
@@ -61,21 +60,6 @@ std::string CMS_JET_ALG = "akt";
 float CMS_PT_MIN        = 500;
 float CMS_PT_MAX        = 550;
 
-// List of jet properties we want to store
-int MAX_N_CONSTITUENTS = 200;
-std::vector<std::string> property_names = {"mass", "pT", "energy",
-                                        "eta", "n_constituents"};
-bool is_logarithmic(std::string prop) {
-    if (str_eq(prop, "mass") or str_eq(prop, "pT")
-            or str_eq(prop, "energy"))
-        return true;
-    if (str_eq(prop, "eta") or str_eq(prop, "n_constituents"))
-        return false;
-
-    throw std::runtime_error("Invalid property name " + prop);
-}
-
-
 // ####################################
 // Main
 // ####################################
@@ -173,45 +157,11 @@ int main (int argc, char* argv[]) {
                                   -2, false);
     const double maxbin  = cmdln_double("maxbin", argc, argv,
                                   log10(2*pt_max), false);
-    const bool uflow = true, oflow = true;
-
-
-    // Initializing bin edges and centers
-    // Setting up under/overflow for mass, pT, energy
-    int nbins_finite = nbins, bins_finite_start = 0;
-    if (uflow) {nbins_finite -= 1; bins_finite_start += 1;}
-    if (oflow) nbins_finite -= 1;
-
-    std::map<std::string, std::vector<double>> bin_centers;
-    std::map<std::string, std::vector<double>> bin_edges;
-
-    bin_centers.insert(std::pair("mass",
-            get_bin_centers(minbin, maxbin, nbins, uflow, oflow)));
-    bin_centers.insert(std::pair("pT",
-            get_bin_centers(minbin, maxbin, nbins, uflow, oflow)));
-    bin_centers.insert(std::pair("energy",
-            get_bin_centers(minbin, maxbin, nbins, uflow, oflow)));
-    bin_centers.insert(std::pair("eta",
-            get_bin_centers(-eta_cut, eta_cut, nbins,
-                            false, false)));
-    bin_centers.insert(std::pair("n_constituents",
-            get_bin_centers(-0.5, MAX_N_CONSTITUENTS+0.5,
-                            MAX_N_CONSTITUENTS+1,
-                            false, false)));
-
-    bin_edges.insert(std::pair("mass",
-            get_bin_edges(minbin, maxbin, nbins, uflow, oflow)));
-    bin_edges.insert(std::pair("pT",
-            get_bin_edges(minbin, maxbin, nbins, uflow, oflow)));
-    bin_edges.insert(std::pair("energy",
-            get_bin_edges(minbin, maxbin, nbins, uflow, oflow)));
-    bin_edges.insert(std::pair("eta",
-            get_bin_edges(-eta_cut, eta_cut, nbins,
-                            false, false)));
-    bin_edges.insert(std::pair("n_constituents",
-            get_bin_edges(-0.5, MAX_N_CONSTITUENTS+0.5,
-                          MAX_N_CONSTITUENTS+1,
-                          false, false)));
+
+    // Histograms of each property (logarithmic bins from 10^minbin
+    // to 10^maxbin for the mass, pT and energy)
+    JetPropertyHistograms jet_properties(nbins, minbin, maxbin,
+                                         eta_cut);
 
     // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
     // Output Settings
@@ -219,41 +169,28 @@ int main (int argc, char* argv[]) {
     // Whether to output hist in a mathematica friendly format
     const bool mathematica_format = cmdln_bool("mathematica",
                                                argc, argv, false);
-    const std::string HIST_DELIM = mathematica_format ?  " " : ", ";
-    const std::string file_ext   = mathematica_format ?  ".txt"
-                                                      : ".py";
 
     // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
     // Input Settings
     // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
-    const bool use_opendata = cmdln_bool("use_opendata", argc, argv,
-                                         true);
+    // Source of the jets: CMS Open Data (by default), Pythia, or
+    // synthetic jets from a toy generator (--source, or
+    // --use_opendata), the latter read in the same way as Open Data
+    const std::string jet_source = jet_source_cmdln(argc, argv, true);
+    const bool use_opendata = jet_source != "pythia";
+    // File of CMS Open Data, as text or as a binary jet dataset
+    // (see ecscribe-convert)
+    const std::string od_file = cmdln_string("od_file", argc, argv,
+                                             od::cms_jets_file);
 
 
     // =====================================
     // Output Setup
     // =====================================
-    // Set up histograms
-    std::map<std::string, Hist> jet_properties;
-    std::map<std::string, std::string> filenames;
-
-    for (auto prop : property_names) {
-        // Setting up histograms
-        Hist hist (str_eq(prop, "n_constituents") ?
-                        MAX_N_CONSTITUENTS+1 : nbins);
-        jet_properties.insert(std::pair(prop, hist));
-
-        // Setting up output files
-        std::string filename = "output/jet_properties/";
-        if (!str_eq(file_prefix, ""))
-            filename += file_prefix+"_";
-        filename += prop;
-        filename += file_ext;
-        filenames.insert(std::pair(prop, filename));
-        // Write a header
-        write_jetproperty_header(filename, argc, argv,
-                                 not(mathematica_format));
-    }
+    // Set up output files, one for each property
+    const std::vector<std::string> filenames =
+            setup_jet_property_outfiles(file_prefix, argc, argv,
+                                        mathematica_format);
 
     // =====================================
     // Event Generation Setup
@@ -284,11 +221,19 @@ int main (int argc, char* argv[]) {
     // ---------------------------------
     const JetDefinition jet_def = process_JetDef(jet_alg, jet_rad,
                                                  jet_recomb);
+    // Cuts on the jets found in each event (see select_jets)
+    const JetCuts jet_cuts{jet_rad, n_exclusive_jets, pt_min, pt_max,
+                           eta_cut, is_proton_collision};
 
     // ---------------------------------
-    // CMS Open Data
+    // CMS Open Data (or synthetic jets)
     // ---------------------------------
-    od::EventReader cms_jet_reader(od::cms_jets_file);
+    od::EventReader cms_jet_reader = jet_source == "synthetic" ?
+            od::EventReader(synthetic_jet_settings(argc, argv,
+                    cmdln_int("seed", argc, argv,
+                              _PYTHIA_SEED_DEFAULT),
+                    pt_min, pt_max, eta_cut, jet_rad))
+            : od::EventReader(od_file);
 
     // ---------------------------------
     // =====================================
@@ -296,27 +241,23 @@ int main (int argc, char* argv[]) {
     // =====================================
     // ---------------------------------
 
-    // Initializing total number of jets,
-    //   summed over all events
-    //   (used to normalize the histogram)
-    int njets_tot = 0;
-
     // Initializing particles, good_jets, sorted angles and weights
     std::vector<PseudoJet> particles;
-    std::vector<PseudoJet> all_jets;
     std::vector<PseudoJet> good_jets;
 
     // Reserving memory
     particles.reserve(150);
-    all_jets.reserve(20);
     good_jets.reserve(5);
 
     // =====================================
     // Looping over events
     // =====================================
+    // Progress and throughput of the run, reported every
+    // --progress_interval seconds
+    RunTelemetry telemetry(n_events,
+            telemetry_settings(argc, argv, 1, verbose >= 0));
     for (int iev = 0; iev < n_events; ++iev){
-        progressbar(static_cast<double>(iev+1)/
-                    double(n_events));
+        telemetry.add_event();
 
         // -#-#-#-#-#-#-#-#-#-#-#-#-#-#-#-#-
         // Jet finding (with cuts)
@@ -349,63 +290,15 @@ int main (int argc, char* argv[]) {
                 std::cout.rdbuf(fastjetstream.rdbuf());
             }
 
-
-            cluster_seq_ptr = std::make_unique
-                    <ClusterSequence>(particles, jet_def);
-
-            if (iev == 0) {
-                std::cout.rdbuf(old);  // Restore std::cout
-            }
-
             // ---------------------------------
             // Jet finding (with cuts)
             // ---------------------------------
-            if (jet_rad < 1000) {
-                // If given a generic value of R,
-                // cluster the event with the given jet definition
-                all_jets = sorted_by_pt(
-                        cluster_seq_ptr->inclusive_jets(pt_min));
-            } else {
-                // If we are given the maximum possible value of R,
-                // use the whole event as a single "jet"
-                PseudoJet full_event;
-                for (auto part : particles)
-                    if (part.modp() > 0)
-                        full_event = join(full_event, part);
-
-                all_jets.push_back(std::move(full_event));
-            }
+            select_jets(particles, jet_def, jet_cuts, cluster_seq_ptr,
+                        good_jets);
 
-            // Getting all jets which satisfy other requirements
-            for (size_t i = 0; i < all_jets.size()
-                               &&
-                // Only working up to the Nth jet if doing exclusive analysis
-                     (n_exclusive_jets <= 0
-                      ||
-                      i < static_cast<size_t>(n_exclusive_jets));
-             ++i) {
-                const PseudoJet& jet = all_jets[i];
-
-                // Adding jets that satisfy certain criteria to good jets list
-                if (is_proton_collision) {
-                    // For pp, ensuring pt_min < pt < pt_max
-                    // and |eta| < eta_cut   (or no eta_cut given)
-                    if (pt_min <= jet.pt() and jet.pt() <= pt_max
-                            and (abs(jet.eta()) <= eta_cut
-                                 or eta_cut < 0)) {
-                        good_jets.push_back(jet);
-                    }
-                } else {
-                    // For other collisions, ensuring E_min < E < E_max
-                    // (for now, keeping confusing notation with, e.g.,
-                    //    E_min represented by `pt_min` below)
-                    if (pt_min <= jet.E() and jet.E() <= pt_max) {
-                        good_jets.push_back(jet);
-                    }
-                }
+            if (iev == 0) {
+                std::cout.rdbuf(old);  // Restore std::cout
             }
-
-            all_jets.clear();
         }
 
         // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
@@ -414,31 +307,9 @@ int main (int argc, char* argv[]) {
         for (const auto& jet : good_jets) {
         try {
             // Histogramming properties of this jet
-            jet_properties["n_constituents"][bin_position(
-                                   jet.constituents().size(),
-                                   -0.5, MAX_N_CONSTITUENTS+0.5,
-                                   MAX_N_CONSTITUENTS+1, "lin",
-                                   false, false)]
-                += 1;
-            jet_properties["mass"][bin_position(
-                                   jet.m(), minbin, maxbin,
-                                   nbins, "log", uflow, oflow)]
-                += 1;
-            jet_properties["pT"][bin_position(
-                                   jet.pt(), minbin, maxbin,
-                                   nbins, "log", uflow, oflow)]
-                += 1;
-            jet_properties["energy"][bin_position(
-                                   jet.e(), minbin, maxbin,
-                                   nbins, "log", uflow, oflow)]
-                += 1;
-            jet_properties["eta"][bin_position(
-                                   jet.eta(), -eta_cut, eta_cut,
-                                   nbins, "lin", false, false)]
-                += 1;
-
-            // Counting total num jets for normalization
-            ++njets_tot;
+            const size_t n_constituents = jet.constituents().size();
+            jet_properties.fill(jet, n_constituents);
+            telemetry.add_jet(n_constituents);
         } catch (const fastjet::Error& ex) {
             // ending try statement (sometimes I find empty jets)
             std::cerr << "Warning: FastJet: " << ex.message()
@@ -448,123 +319,13 @@ int main (int argc, char* argv[]) {
         } // end loop on jets
         // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
     } // end event loop
+    telemetry.finish();
     // =====================================
 
     // =====================================
     // Writing output files
     // =====================================
-    for (auto& prop : property_names) {
-        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
-        // Opening histogram output file
-        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
-        std::fstream outfile;
-        outfile.open(filenames[prop], std::ios_base::in |
-                                      std::ios_base::out |
-                                      std::ios_base::app);
-
-        // Checking for existence
-        if (!outfile.is_open()) {
-            std::stringstream errMsg;
-            errMsg << "File for jet property output was expected "
-                   << "to be open, but was not open.\n\n"
-                   << "It is possible the file was unable to "
-                   << "be created at the desired location:\n\n\t"
-                   << "filename = " << filenames[prop] << "\n\n"
-                   << "Is the filename an absolute path? If not, "
-                   << "that might be the problem.";
-            throw std::runtime_error(errMsg.str().c_str());
-        }
-
-        // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
-        // Writing to files
-        // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
-        if (not(mathematica_format))
-            outfile << prop << "_edges = [\n\t";
-        else outfile << "(* " << prop << "_edges *)\n";
-
-        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
-        // Edges
-        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
-        for (int ibin = 0; ibin < nbins; ++ibin)
-            if (is_logarithmic(prop))
-                outfile << std::pow(10, bin_edges[prop][ibin])
-                        << HIST_DELIM;
-            else
-                outfile << bin_edges[prop][ibin] << HIST_DELIM;
-        if (std::isinf(bin_edges[prop][nbins])
-                and not(mathematica_format))
-            outfile << "np.inf\n";
-        else
-            if (is_logarithmic(prop))
-                outfile << std::pow(10, bin_edges[prop][nbins])
-                        << "\n";
-            else
-                outfile << bin_edges[prop][nbins] << "\n";
-        if (not(mathematica_format)) outfile << "]\n\n";
-
-
-        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
-        // Centers
-        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
-        if (not(mathematica_format))
-            outfile << prop << "_centers = [\n\t";
-        else outfile << "\n(* " << prop << "_centers *)\n";
-
-        for (int ibin = 0; ibin < nbins-1; ++ibin)
-            if (is_logarithmic(prop))
-                outfile << std::pow(10, bin_centers[prop][ibin])
-                        << HIST_DELIM;
-            else
-                outfile << bin_centers[prop][ibin]
-                        << HIST_DELIM;
-        if (std::isinf(bin_centers[prop][nbins-1]) and
-                not(mathematica_format))
-            outfile << "np.inf\n";
-        else
-            if (is_logarithmic(prop))
-                outfile << std::pow(10, bin_centers[prop][nbins-1])
-                        << "\n";
-            else
-                outfile << bin_centers[prop][nbins-1]
-                        << "\n";
-
-        if (not(mathematica_format)) outfile << "]\n\n";
-
-
-        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
-        // Histogram
-        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
-        if (not(mathematica_format))
-            outfile << "hist = [\n\t";
-        else outfile << "\n(* " << prop << " hist *)\n";
-
-        for (size_t bin=0; bin<jet_properties[prop].size(); ++bin){
-            // Expectation values over N jets
-            jet_properties[prop][bin] /= njets_tot;
-
-            // Not normalizing outflow bins further
-            // If not in an outflow bin
-            if (not(is_logarithmic(prop) and
-                    (int(bin) < bins_finite_start
-                     or int(bin) >= nbins_finite))) {
-                // getting differential "volume" element
-                double dvol = (bin_edges[prop][bin+1]-bin_edges[prop][bin]);
-                // and normalizing
-                jet_properties[prop][bin] /= dvol;
-            }
-
-            // Printing histogram
-            outfile << std::setprecision(10)
-                    << jet_properties[prop][bin];
-            if (int(bin) != nbins-1)
-                outfile << HIST_DELIM;
-            else
-                outfile << "\n";
-        }
-        if (not(mathematica_format)) outfile << "]\n\n";
-
-        outfile.close();
-    }
+    jet_properties.write(filenames, mathematica_format);
 
     // =====================================
     // Verifying successful run
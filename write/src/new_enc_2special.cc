@@ -46,15 +46,22 @@ using namespace std::chrono;
 #include "../include/enc_utils.h"
 
 #include "../include/opendata_utils.h"
+#include "../include/synthetic_jets.h"
+#include "../include/jet_cache.h"
+#include "../include/jet_geometry.h"
+#include "../include/nd_histogram.h"
+#include "../include/enc_kernels.h"
+#include "../include/enc_output.h"
+#include "../include/runtime_stats.h"
+#include "../include/telemetry.h"
 
 
 // =====================================
 // Type definitions for histograms
 // =====================================
 // Multi-dimensional Histograms
-typedef std::vector<double> Hist1d;
-typedef std::vector<std::vector<double>> Hist2d;
-typedef std::vector<Hist2d> Hist3d;
+typedef NDHistogram<1> Hist1d;
+typedef NDHistogram<2> Hist2d;
 
 // Using pairs of weights to specify the 2-special correlator
 typedef std::pair<double, double> weight_t;
@@ -92,6 +99,29 @@ int main (int argc, char* argv[]) {
     // Command line setup
     // =====================================
     // ---------------------------------
+    // Reading jets from a cache (see --write_jet_cache) rather
+    // than generating them: the settings which selected the cached
+    // jets (see jet_cache_options) then come from the cache
+    const std::string read_cache_file = cmdln_string("read_jet_cache",
+                                                     argc, argv, "");
+    std::unique_ptr<JetCacheReader> jet_cache;
+    std::vector<std::string> cached_args;
+    std::vector<char*> cached_argv;
+    if (not read_cache_file.empty()) {
+        jet_cache = std::make_unique<JetCacheReader>(read_cache_file);
+        cached_args = with_cached_arguments(argc, argv,
+                                            jet_cache->arguments());
+        cached_argv = strings_to_argv(cached_args);
+        argc = static_cast<int>(cached_args.size());
+        argv = cached_argv.data();
+
+        if (verbose >= 1)
+            std::cout << "Reading " << jet_cache->size()
+                      << " jets from " << read_cache_file
+                      << ", written by\n\t" << jet_cache->command()
+                      << "\n";
+    }
+
     // Ensuring valid command line inputs
     if (checkPythiaInputs(argc, argv) == 1) return 1;
 
@@ -228,67 +258,41 @@ int main (int argc, char* argv[]) {
     const double maxbin   = cmdln_double("maxbin", argc, argv,
                                    0.05, false);
 
-    // Bins for separation of special particles
-    const bool bin_sp_uflow = true, bin_sp_oflow = true;
-
-    // For particles around the special particles
-    const bool bin1_uflow = true, bin1_oflow = true;
-
-
-    // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
-    // Initializing bin edges and centers
-    // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
-    // - - - - - - - - - - - - - - -
-    // For theta_sp
-    // - - - - - - - - - - - - - - -
-    // Setting up under/overflow
-    int nbins_sp_finite = nbins, bin_sp_finite_start = 0;
-    if (bin_sp_uflow) {
-        nbins_sp_finite -= 1; bin_sp_finite_start += 1;}
-    if (bin_sp_oflow) nbins_sp_finite -= 1;
-
-    // (logarithmic, from 10^minbin to 10^maxbin)
-    const std::vector<double> bin_sp_edges = get_bin_edges(
-                                        minbin, maxbin, nbins,
-                                        bin_sp_uflow, bin_sp_oflow);
-    const std::vector<double> bin_sp_centers = get_bin_centers(
-                                        minbin, maxbin, nbins,
-                                        bin_sp_uflow, bin_sp_oflow);
-
-
-    // - - - - - - - - - - - - - - -
-    // For theta1 and theta1'
-    // - - - - - - - - - - - - - - -
-    // Setting up under/overflow
-    int nbins1_finite = nbins, bin1_finite_start = 0;
-    if (bin1_uflow) {nbins1_finite -= 1; bin1_finite_start += 1;}
-    if (bin1_oflow) nbins1_finite -= 1;
-
-    // (logarithmic, from 10^minbin to 10^maxbin)
-    const std::vector<double> bin1_edges = get_bin_edges(
-                                        minbin, maxbin, nbins,
-                                        bin1_uflow, bin1_oflow);
-    const std::vector<double> bin1_centers = get_bin_centers(
-                                        minbin, maxbin, nbins,
-                                        bin1_uflow, bin1_oflow);
+    // Bins of R_sp, theta1 and theta1', which have the same range
+    // (logarithmic, from 10^minbin to 10^maxbin, with under- and
+    //  overflow)
+    const ENCBinning binning(minbin, maxbin, nbins, 1, {});
 
     // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
     // Output Settings
     // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
     // Whether to output hist in a mathematica friendly format
-    const bool mathematica_format = cmdln_bool("mathematica",
-                                               argc, argv, false);
-    const std::string HIST_DELIM = mathematica_format ?  " " : ", ";
-    const std::string file_ext   = mathematica_format ?  ".txt"
-                                                      : ".py";
+    ENCOutputFormat output_format;
+    output_format.mathematica = cmdln_bool("mathematica",
+                                           argc, argv, false);
+    output_format.argc = argc;
+    output_format.argv = argv;
 
 
     // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
     // Input Settings
     // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
-    const bool use_opendata = cmdln_bool("use_opendata",
-                                         argc, argv,
-                                         true);
+    // Source of the jets: CMS Open Data (by default), Pythia, or
+    // synthetic jets from a toy generator (--source, or
+    // --use_opendata), the latter read in the same way as Open Data
+    const std::string jet_source = jet_source_cmdln(argc, argv, true);
+    const bool use_opendata = jet_source != "pythia";
+    // File of CMS Open Data, as text or as a binary jet dataset
+    // (see ecscribe-convert)
+    const std::string od_file = cmdln_string("od_file", argc, argv,
+                                             od::cms_jets_file);
+    // File to which the selected jets are written, so that later
+    // runs can analyze them again with --read_jet_cache
+    const std::string write_cache_file = cmdln_string("write_jet_cache",
+                                                      argc, argv, "");
+    if (jet_cache and not write_cache_file.empty())
+        throw std::invalid_argument(
+            "Cannot both read and write a jet cache.");
 
 
     // =====================================
@@ -299,33 +303,17 @@ int main (int argc, char* argv[]) {
     // NOTE:   of two independent histograms.
     std::vector<Hist1d> hist_1;
     std::vector<Hist2d> hist_2;
-    std::vector<Hist3d> enc_hists;
     // Set up histogram output files
     std::vector<std::string> enc_outfiles;
 
     for (auto nus : nu_weights){
         hist_1.emplace_back(Hist1d(nbins));
-        hist_2.emplace_back(Hist2d (nbins, Hist1d(nbins)));
-
-        // TODO: remove this if procedure is correct
-        enc_hists.emplace_back(Hist3d (nbins,
-                    Hist2d(nbins, Hist1d(nbins))));
-
-        // Setting up output files
-        std::string filename = "output/new_encs/2special_" +
-                file_prefix +
-                "_nus_" + str_round(nus.first, 2) +
-                "_" + str_round(nus.second, 2);
-
-        filename = periods_to_hyphens(filename);
-        filename += file_ext;
-        // writing a header with relevant information
-        write_enc_header(filename, argc, argv,
-                     std::vector<double> {nus.first,
-                                          nus.second},
-                     not(mathematica_format));
-        // and adding them to the dict of output files
-        enc_outfiles.push_back(filename);
+        hist_2.emplace_back(Hist2d (nbins, nbins));
+
+        // Setting up output files, with a header with relevant
+        // information
+        enc_outfiles.push_back(setup_enc_outfile("2special",
+                file_prefix, {nus.first, nus.second}, output_format));
     }
 
 
@@ -347,7 +335,7 @@ int main (int argc, char* argv[]) {
     Pythia8::Pythia pythia;  // Declaring Pythia8
 
     std::cout.rdbuf(old);    // Restore std::cout
-    if (not use_opendata) {
+    if (not use_opendata and not jet_cache) {
         std::cout << "Setting up pythia" << std::endl;
         // Setting up pythia based on command line arguments
         setup_pythia_cmdln(pythia, argc, argv);
@@ -358,11 +346,27 @@ int main (int argc, char* argv[]) {
     // ---------------------------------
     const JetDefinition jet_def = process_JetDef(jet_alg, jet_rad,
                                                  jet_recomb);
+    // Cuts on the jets found in each event (see select_jets)
+    const JetCuts jet_cuts{jet_rad, n_exclusive_jets, pt_min, pt_max,
+                           eta_cut, is_proton_collision};
 
     // ---------------------------------
-    // CMS Open Data
+    // CMS Open Data (or synthetic jets)
     // ---------------------------------
-    od::EventReader cms_jet_reader(od::cms_jets_file);
+    od::EventReader cms_jet_reader = jet_source == "synthetic" ?
+            od::EventReader(synthetic_jet_settings(argc, argv,
+                    cmdln_int("seed", argc, argv,
+                              _PYTHIA_SEED_DEFAULT),
+                    pt_min, pt_max, eta_cut, jet_rad))
+            : od::EventReader(od_file);
+
+    // ---------------------------------
+    // Jet cache
+    // ---------------------------------
+    std::unique_ptr<JetCacheWriter> jet_cache_writer;
+    if (not write_cache_file.empty())
+        jet_cache_writer = std::make_unique<JetCacheWriter>(
+                write_cache_file, argc, argv);
 
     // ---------------------------------
     // =====================================
@@ -377,33 +381,33 @@ int main (int argc, char* argv[]) {
 
     // Initializing particles, good_jets, sorted angles and weights
     std::vector<PseudoJet> particles;
-    std::vector<PseudoJet> all_jets;
     std::vector<PseudoJet> good_jets;
 
-    // Initializing list of of which particles are closest to others
-    std::vector<std::vector<std::pair<double, double>>>
-                all_angweight_pairs;
-    std::vector<std::pair<double, double>> angs_weights_sp1;
-    std::vector<std::pair<double, double>> angs_weights_sp2;
+    // Initializing compact jets, pairwise angles, and the
+    // lists of which particles are closest to others
+    CompactJet compact_jet;
+    JetGeometry geometry = binning.geometry();
 
     // Reserving memory
     particles.reserve(150);
-    all_jets.reserve(20);
     good_jets.reserve(5);
 
-    all_angweight_pairs.reserve(150);
-    angs_weights_sp1.reserve(150);
-    angs_weights_sp2.reserve(150);
-
     // Preparing to store runtime info
-    std::map<int, std::vector<double>> jet_runtimes;
+    RuntimeStatistics jet_runtimes;
 
     // =====================================
     // Looping over events
     // =====================================
-    for (int iev = 0; iev < n_events; ++iev) {
-        progressbar(static_cast<double>(iev+1)/
-                    double(n_events));
+    // (with a jet cache, each event is a single cached jet)
+    const int n_source_events = jet_cache ?
+                                static_cast<int>(jet_cache->size())
+                                : n_events;
+    // Progress and throughput of the run, reported every
+    // --progress_interval seconds
+    RunTelemetry telemetry(n_source_events,
+            telemetry_settings(argc, argv, 3, verbose >= 0));
+    for (int iev = 0; iev < n_source_events; ++iev) {
+        telemetry.add_event();
 
         // -#-#-#-#-#-#-#-#-#-#-#-#-#-#-#-#-
         // Jet finding (with cuts)
@@ -411,10 +415,17 @@ int main (int argc, char* argv[]) {
         good_jets.clear();
         std::unique_ptr<ClusterSequence> cluster_seq_ptr = nullptr;
 
+        // -----------------------------------------
+        // Jet cache (gives the jets selected when it was written)
+        // -----------------------------------------
+        if (jet_cache) {
+            PseudoJet jet;
+            jet_cache->read_jet(jet);
+            good_jets.emplace_back(std::move(jet));
         // -----------------------------------------
         // CMS Open Data (gives jets from the start)
         // -----------------------------------------
-        if (use_opendata) {
+        } else if (use_opendata) {
             PseudoJet jet;
             cms_jet_reader.read_jet(jet);
             good_jets.emplace_back(std::move(jet));
@@ -438,63 +449,15 @@ int main (int argc, char* argv[]) {
                 std::cout.rdbuf(fastjetstream.rdbuf());
             }
 
-
-            cluster_seq_ptr = std::make_unique
-                <ClusterSequence>(particles, jet_def);
-
-            if (iev == 0) {
-                std::cout.rdbuf(old);  // Restore std::cout
-            }
-
             // ---------------------------------
             // Jet finding (with cuts)
             // ---------------------------------
-            if (jet_rad < 1000) {
-                // If given a generic value of R,
-                // cluster the event with the given jet definition
-                all_jets = sorted_by_pt(
-                        cluster_seq_ptr->inclusive_jets(pt_min));
-            } else {
-                // If we are given the maximum possible value of R,
-                // use the whole event as a single "jet"
-                PseudoJet full_event;
-                for (auto part : particles)
-                    if (part.modp() > 0)
-                        full_event = join(full_event, part);
-
-                all_jets.push_back(std::move(full_event));
-            }
+            select_jets(particles, jet_def, jet_cuts, cluster_seq_ptr,
+                        good_jets);
 
-            // Getting all jets which satisfy other requirements
-            for (size_t i = 0; i < all_jets.size()
-                               &&
-                // Only working up to the Nth jet if doing exclusive analysis
-                     (n_exclusive_jets <= 0
-                      ||
-                      i < static_cast<size_t>(n_exclusive_jets));
-             ++i) {
-                PseudoJet jet = all_jets[i];
-
-                // Getting jets that satisfy certain criteria
-                if (is_proton_collision) {
-                    // For pp, ensuring pt_min < pt < pt_max
-                    // and |eta| < eta_cut   (or no eta_cut given)
-                    if (pt_min <= jet.pt() and jet.pt() <= pt_max
-                            and (abs(jet.eta()) <= eta_cut
-                                or eta_cut < 0)) {
-                        good_jets.push_back(jet);
-                    }
-                } else {
-                    // For other collisions, ensuring E_min < E < E_max
-                    // (for now, keeping confusing notation with, e.g.,
-                    //    E_min represented by `pt_min` below)
-                    if (pt_min <= jet.E() and jet.E() <= pt_max) {
-                        good_jets.push_back(jet);
-                    }
-                }
+            if (iev == 0) {
+                std::cout.rdbuf(old);  // Restore std::cout
             }
-
-            all_jets.clear();
         }
 
         // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
@@ -511,500 +474,57 @@ int main (int argc, char* argv[]) {
             // Storing jet constituents
             const std::vector<PseudoJet>& constituents =
                                             jet.constituents();
-            double weight_tot = 0;
-            for (const auto& particle : constituents) {
-                weight_tot += use_pt ? particle.pt() : particle.e();
-            }
-
+            if (jet_cache_writer)
+                jet_cache_writer->write_jet(constituents);
+            telemetry.add_jet(constituents.size());
+            // Compact kinematics and normalized weights
+            compact_jet.fill(constituents, use_pt);
 
-            all_angweight_pairs.clear();
+            // Pairwise angles, and particles sorted by angle
+            geometry.fill(compact_jet, use_deltaR);
 
-            // ---------------------------------
-            // Loop on first special particle
-            for (size_t isp1=0; isp1 < constituents.size(); ++isp1) {
-                // Getting the first special particle
-                const PseudoJet& part_sp_1 = constituents[isp1];
-
-                // Energy-weighting factor for "special" particle
-                double weight_sp1 = use_pt ?
-                        part_sp_1.pt() / weight_tot :
-                        part_sp_1.e() / weight_tot;
-                // Initializing sum of weights within an
-                // angle of the first special particle
-                double sum_weight1  = weight_sp1;
-                double sum_weight_sp  = weight_sp1;
-
-                // =*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=
-                // First Histogram
-                // =*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=
-                // -|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-
-                // Preparing contact terms:
-                // -|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-
-                if (contact_terms) {
-                    for (size_t inu = 0; inu < nu_weights.size(); ++inu) {
-                        hist_1[inu][0] +=
-                            std::pow(weight_sp1,
-                                     nu_weights[inu].first);
-                    }
-                }
-                // -|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-
-
-                // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
-                // Sorting:
-                //     * [theta1] : angle relative to special particle
-                //     * [weight1]: weight of particle
-                //  by theta1
-                angs_weights_sp1.clear();
-                for (const auto& part1 : constituents) {
-                    angs_weights_sp1.emplace_back(
-                        // theta_1,
-                        use_deltaR ? part_sp_1.delta_R(part1)
-                                   : fastjet::theta(part_sp_1,
-                                                    part1),
-                        // weight_1
-                        use_pt ? part1.pt() / weight_tot
-                               : part1.e() / weight_tot
-                       );
-                } // end particle sorting loop
-                // Sorting angles/weights by angle as promised :)
-                std::sort(angs_weights_sp1.begin(),
-                          angs_weights_sp1.end());
-                // Storing for second special particle
-                all_angweight_pairs.push_back(angs_weights_sp1);
-                // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
-
-                // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
-                // Loop on first non-special particle
-                for (auto angweight : angs_weights_sp1) {
-                    // Calculating the theta1 (angweight.first)
-                    // bin in the histogram
-                    int bin1 = bin_position(angweight.first,
-                                            minbin, maxbin,
-                                            nbins, "log",
-                                            bin1_uflow, bin1_oflow);
-                    const double weight1 = angweight.second;
-
-                    // Adding to histogram
-                    for (size_t inu = 0;
-                            inu < nu_weights.size();
-                            ++inu) {
-                        hist_1[inu][bin1] +=
-                                std::pow(sum_weight1
-                                        +weight1,
-                                        nu_weights[inu].first)
-                                - std::pow(weight1,
-                                           nu_weights[inu].first);
-                    }
-
-                    sum_weight1 += weight1;
-                }
-                // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
-
-                // =*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=
-                // Second Histogram
-                // =*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=
-                // -|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-
-                // Preparing contact terms:
-                // -|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-
-                if (contact_terms) {
-                    for (size_t inu = 0;
-                            inu < nu_weights.size();
-                            ++inu) {
-                        // TODO: Make this placeholder correct
-                        hist_2[inu][0][0] +=
-                            std::pow(weight_sp1,
-                                    2 + nu_weights[inu].second);
-                    }
-                }
-                // -|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-
-
-                // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
-                // Loop on second special particle
-                for (size_t isp2=0; isp2<isp1; ++isp2) {
-                    // Getting second special particle
-                    const PseudoJet& part_sp_2 = constituents[isp2];
-
-                    // And its properties
-                    double R_sp = use_deltaR
-                                    ? part_sp_2.delta_R(part_sp_1)
-                                    : fastjet::theta(part_sp_2,
-                                                     part_sp_1);
-                    double weight_sp2 = use_pt
-                                    ? part_sp_2.pt() / weight_tot
-                                    : part_sp_2.e() / weight_tot;
-                    // Initializing sum of weights within an
-                    // angle of the second special particle
-                    double sum_weight2 = weight_sp2;
-
-                    // Calculating the R_sp bin in the histogram
-                    int bin_sp = bin_position(R_sp, minbin, maxbin,
-                                              nbins, "log",
-                                              bin_sp_uflow,
-                                              bin_sp_oflow);
-
-                    // -|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-
-                    // Preparing contact terms:
-                    // -|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-
-                    if (contact_terms) {
-                        for (size_t inu = 0;
-                                inu < nu_weights.size();
-                                ++inu) {
-                            // TODO: Make this placeholder correct
-                            hist_2[inu][bin_sp][0] += weight_sp1 *
-                                std::pow(weight_sp2,
-                                         1 + nu_weights[inu].second);
-                        }
-                    }
-                    // -|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-
-
-                    // Special particle histogram contribution
-                    const double delta_sp =
-                        weight_sp1 * weight_sp2;
-
-                    // Getting stored list of sorted angles/weights
-                    angs_weights_sp2.clear();
-                    angs_weights_sp2 = all_angweight_pairs[isp2];
-
-                    // -----------------------------------
-                    // Loop on second non-special particle
-                    for (auto angweight : angs_weights_sp2) {
-                        // Calculating bin position
-                        int bin1p = bin_position(
-                                angweight.first,
-                                minbin, maxbin,
-                                nbins, "log",
-                                bin1_uflow, bin1_oflow);
-
-                        // Add weight to Histogram
-                        for (size_t inu = 0;
-                                inu < nu_weights.size();
-                                ++inu) {
-                            const double delta2 =
-                                 std::pow(sum_weight2
-                                          +angweight.second,
-                                          nu_weights[inu].second)
-                               - std::pow(sum_weight2,
-                                          nu_weights[inu].second);
-                            hist_2[inu][bin_sp][bin1p] +=
-                                delta_sp*delta2;
-                        }
-                        // -----------------------------
-                        // Preparing for next particle
-                        sum_weight2 += angweight.second;
-                    } // end non-special particle loop
-                    // -------------------------------
-
-                    // Preparing for next particle
-                    sum_weight_sp += weight_sp2;
-                } // end 2nd special particle loop
-                // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
-            } // end first special particle loop
-            // ---------------------------------
+            // Loops on the special and non-special particles
+            two_special_jet(compact_jet, geometry, nu_weights,
+                            hist_1, hist_2, contact_terms);
 
             // ---------------------------------
             // Finished with this jet!
             // ---------------------------------
             // End timing
-            if (nu_weights.size() == 1) {
-                auto jet_end = std::chrono::high_resolution_clock::now();
-                auto jet_duration = std::chrono::duration_cast
-                        <std::chrono::microseconds>(jet_end - jet_start);
-
-                // Store the runtime for this jet
-                jet_runtimes[constituents.size()].emplace_back(
-                        static_cast<double>(jet_duration.count()));
-            }
+            const std::chrono::duration<double, std::micro> jet_duration =
+                    std::chrono::high_resolution_clock::now() - jet_start;
+
+            // Store the runtime for this jet
+            jet_runtimes.add(constituents.size(), jet_duration.count());
         } catch (const fastjet::Error& ex) {
             // ending try statement (sometimes I find empty jets)
             std::cerr << "Warning: FastJet: " << ex.message()
                       << std::endl;
+            if (jet_cache_writer)
+                jet_cache_writer->write_empty_jets(1);
             continue;
         }
         } // end loop on jets
         // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
     } // end event loop
+    telemetry.finish();
+
+    if (jet_cache_writer) {
+        jet_cache_writer->close();
+        if (verbose >= 0)
+            std::cout << "Wrote " << jet_cache_writer->size()
+                      << " jets to " << write_cache_file << ".\n";
+    }
     // =====================================
 
     // ===================================
     // Writing histograms to output files
     // ===================================
-    std::vector<std::string> bin_names =
-                {"R_sp", "theta1", "theta1p"};
-
-        for (size_t inu = 0; inu < nu_weights.size(); ++inu) {
-        // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
-        // Output setup
-        // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
-        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
-        // Opening histogram output file
-        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
-        std::string filename = enc_outfiles[inu];
-        std::fstream outfile;
-        outfile.open(filename, std::ios_base::in |
-                               std::ios_base::out |
-                               std::ios_base::app);
-
-        // Checking for existence
-        if (!outfile.is_open()) {
-            std::stringstream errMsg;
-            errMsg << "File for EnC output was expected "
-                   << "to be open, but was not open.\n\n"
-                   << "It is possible the file was unable to "
-                   << "be created at the desired location:\n\n\t"
-                   << "filename = " << filename << "\n\n"
-                   << "Is the filename an absolute path? If not, "
-                   << "that might be the problem.";
-            throw std::runtime_error(errMsg.str().c_str());
-        }
-
-
-        // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
-        // Writing bins to files
-        // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
-
-        // All bins have the same range
-        for (auto bin_name : bin_names) {
-            // -:-:-:-:-:-:-:-:-:-:-:-:
-            // bin edges
-            // -:-:-:-:-:-:-:-:-:-:-:-:
-            if (not(mathematica_format)) outfile << bin_name
-                                                 << "_edges = [\n\t";
-            else outfile << "(* " << bin_name << "_edges *)\n";
-
-            // nbins+1 bin edges:
-            //   include -infty and infty for under/overflow
-            for (int ibin = 0; ibin < nbins; ++ibin)
-                outfile << std::pow(10, bin1_edges[ibin]) << HIST_DELIM;
-            if (std::isinf(bin1_edges[nbins]) and not(mathematica_format))
-                outfile << "np.inf\n";
-            else
-                outfile << std::pow(10, bin1_edges[nbins]) << "\n";
-
-            if (not(mathematica_format)) outfile << "]\n\n";
-
-            // -:-:-:-:-:-:-:-:-:-:-:-:
-            // bin centers
-            // -:-:-:-:-:-:-:-:-:-:-:-:
-            if (not(mathematica_format)) outfile << bin_name
-                                                 << "_centers = [\n\t";
-            else outfile << "(* " << bin_name << "s *)\n";
-
-            for (int ibin = 0; ibin < nbins-1; ++ibin)
-                outfile << std::pow(10, bin1_centers[ibin]) << HIST_DELIM;
-            if (std::isinf(bin1_centers[nbins-1]) and not(mathematica_format))
-                outfile << "np.inf\n";
-            else
-                outfile << std::pow(10, bin1_centers[nbins-1]) << "\n";
-
-            if (not(mathematica_format)) outfile << "]\n\n";
-        }
-
-        // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
-        // Processing/writing histogram
-        // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
-        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
-        // Normalizing histograms
-        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
-        double sum_1 = 0.0;
-        double sum_2 = 0.0;
-
-        // Normalizing first histogram
-        for (int bin1=0; bin1<nbins; ++bin1) {
-            // Dealing with expectation values over N jets
-            hist_1[inu][bin1] /= njets_tot;
-            sum_1 += hist_1[inu][bin1];
-
-            // Not normalizing outflow bins further
-            if (bin1 < bin1_finite_start or bin1 >= nbins1_finite)
-                continue;
-
-            // Otherwise, log-normalizing the histogram
-            hist_1[inu][bin1] /= (bin1_edges[bin1+1]
-                                  - bin1_edges[bin1]);
-        }
-
-        // Normalizing second histogram
-        for (int bin_sp=0; bin_sp<nbins; ++bin_sp) {
-            for (int bin1p=0; bin1p<nbins; ++bin1p) {
-                // Dealing with expectation values over N jets
-                hist_2[inu][bin_sp][bin1p] /= njets_tot;
-                sum_2 += hist_2[inu][bin_sp][bin1p];
-
-                // Not normalizing outflow bins further
-                if (bin_sp < bin_sp_finite_start
-                        or bin_sp >= nbins_sp_finite
-                        or bin1p < bin1_finite_start
-                        or bin1p >= nbins1_finite)
-                    continue;
-
-                // Otherwise, log-normalizing the histogram
-                double dlog_sp = (bin_sp_edges[bin_sp+1]
-                                  - bin_sp_edges[bin_sp]);
-                double dlog_1p = (bin1_edges[bin1p+1]
-                                  - bin1_edges[bin1p]);
-                hist_2[inu][bin_sp][bin1p] /= dlog_sp*dlog_1p;
-            }
-        }
-
-        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
-        // Taking the outer product
-        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
-        for (int bin_sp=0; bin_sp<nbins; ++bin_sp) {
-            for (int bin1=0; bin1<nbins; ++bin1) {
-                for (int bin1p=0; bin1p<nbins; ++bin1p) {
-                    // Taking the outer product
-                    enc_hists[inu][bin_sp][bin1][bin1p] =
-                        hist_1[inu][bin1]
-                        * hist_2[inu][bin_sp][bin1p];
-                }
-            }
-        }
-
-        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
-        // Printing normalization info
-        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
-        if (verbose >= 0) {
-            double total_integral = 0.0;
-            // Looping over all bins
-            for (int bin_sp=0; bin_sp<nbins; ++bin_sp) {
-                for (int bin1=0; bin1<nbins; ++bin1) {
-                    for (int bin1p=0; bin1p<nbins; ++bin1p) {
-                        if (bin_sp < bin_sp_finite_start
-                                or bin_sp >= nbins_sp_finite
-                                or bin1 < bin1_finite_start
-                                or bin1 >= nbins1_finite
-                                or bin1p < bin1_finite_start
-                                or bin1p >= nbins1_finite) {
-                            total_integral += enc_hists[inu][bin_sp][bin1][bin1p];
-                            continue;
-                        }
-
-                        // Getting differential "volume" element
-                        double dlog_sp = (bin_sp_edges[bin_sp+1]
-                                          - bin_sp_edges[bin_sp]);
-                        double dlog_1  = (bin1_edges[bin1+1]
-                                          - bin1_edges[bin1]);
-                        double dlog_1p = (bin1_edges[bin1p+1]
-                                          - bin1_edges[bin1p]);
-
-                        double dvol = dlog_sp*dlog_1*dlog_1p;
-                        total_integral += enc_hists[inu][bin_sp][bin1][bin1p] * dvol;
-                    }
-                }
-            }
-
-            // Printing normalization
-            weight_t nu = nu_weights[inu];
-            std::cout << "\nTotal weight for nu=("
-                      << nu.first << "," << nu.second << "): "
-                      << sum_1*sum_2;
-            // for sub-histograms as well
-            if (verbose >= 1) {
-                std::cout << "\n\tSub-histograms: "
-                          << sum_1 << " and " << sum_2;
-            }
-
-            // And integral
-            std::cout << "\nIntegrated weight for nu=("
-                      << nu.first << "," << nu.second << "): "
-                      << total_integral;
-        }
-
-        // Then getting the finalized histogram
-        Hist3d hist = enc_hists[inu];
-
-        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
-        // Writing histogram
-        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
-        if (not(mathematica_format)) outfile << "hist = [\n\t";
-        else outfile << "\n(* hist *)\n";
-        for (int bin_sp=0; bin_sp<nbins; ++bin_sp) {
-            if (not(mathematica_format)) outfile << "[\n\t";
-            for (int bin1=0; bin1<nbins; ++bin1) {
-                if (not(mathematica_format)) outfile << "\t[\n\t\t\t";
-
-                // Printing histogram
-                for (int bin1p=0; bin1p<nbins-1; ++bin1p) {
-                    outfile << std::setprecision(10)
-                            << hist[bin_sp][bin1][bin1p]
-                            << HIST_DELIM;
-                }
-                outfile << hist[bin_sp][bin1][nbins-1] << "\n";
-                // END
-
-                if (not(mathematica_format))
-                    outfile << (bin1 != nbins-1 ? "\t\t],\n\t"
-                                                : "\t\t]\n");
-            }
-            if (not(mathematica_format))
-                outfile << (bin_sp != nbins-1 ? "\t],\n\t"
-                                            : "\t]\n");
-        }
-        if (not(mathematica_format)) outfile << "]";
-
-
-        // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
-        // Writing runtimes
-        // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
-        if (nu_weights.size() != 1) {
-            outfile.close();
-            continue;
-        }
-
-        std::vector<double> runtime_means;
-        std::vector<double> runtime_stds;
-
-        // Looping over number of particles in a jet
-        for (int num=0; num<200; ++num) {
-            // Finding the runtimes associated with this
-            // number of particles
-            std::map<int, std::vector<double>>::iterator it
-                    = jet_runtimes.find(num);
-            if(it == jet_runtimes.end()) {
-                runtime_means.emplace_back(
-                        std::numeric_limits<double>::quiet_NaN());
-                runtime_stds.emplace_back(
-                        std::numeric_limits<double>::quiet_NaN());
-                continue;
-            }
-
-            // If found, calculate mean and standard deviation:
-            const std::vector<double>& runtimes = it->second;
-            double mean  = vector_mean(runtimes);
-            double stdev = vector_std(runtimes);
-            runtime_means.push_back(mean);
-            runtime_stds.push_back(stdev);
-        }
-
-        // Adding mean runtimes to file
-        if (not(mathematica_format))
-            outfile << "\n\nruntime_means = [\n\t";
-        else outfile << "\n(* mean runtimes *)\n";
-        for (size_t inum = 0; inum < runtime_means.size(); ++inum) {
-            !std::isnan(runtime_means[inum])    ?
-                outfile << runtime_means[inum] :
-                outfile << "np.nan";
-            if (inum < runtime_means.size()) outfile << HIST_DELIM;
-            else outfile << "\n";
-        }
-        if (not(mathematica_format)) outfile << "]\n";
-
-        // Adding stdev runtimes to file
-        if (not(mathematica_format))
-            outfile << "runtime_stds = [\n\t";
-        else outfile << "\n(* stdev runtimes *)\n";
-        for (size_t inum = 0; inum < runtime_stds.size(); ++inum) {
-            !std::isnan(runtime_stds[inum])    ?
-                outfile << runtime_stds[inum] :
-                outfile << "np.nan";
-            if (inum < runtime_stds.size()) outfile << HIST_DELIM;
-            else outfile << "\n";
-        }
-        if (not(mathematica_format)) outfile << "]";
-
-        // Closing file
-        outfile.close();
-    }
+    for (size_t inu = 0; inu < nu_weights.size(); ++inu)
+        write_2special_hist(hist_1[inu], hist_2[inu],
+                {nu_weights[inu].first, nu_weights[inu].second},
+                njets_tot, binning, &jet_runtimes, enc_outfiles[inu],
+                output_format, verbose);
 
     // ---------------------------------
     // =====================================
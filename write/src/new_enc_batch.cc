@@ -0,0 +1,492 @@
+/**
+ * @file    new_enc_batch.cc
+ *
+ * @brief   Code for generating the histograms of many analyses of
+ *          "new angles on" n-point energy correlators (ENCs), each
+ *          with its own jet definition, cuts, energy weights and
+ *          binning, from a single pass over the events.
+ *
+ *          The analyses are the sections of a configuration file
+ *          (--config, see config_file.h); each event is clustered
+ *          once for each distinct jet definition, and each selected
+ *          jet is analyzed by every analysis which selects it, which
+ *          share its kinematics and pairwise angles wherever their
+ *          weights, angles and binning of theta1 agree.
+ *
+ *          The output files are the same as those of the
+ *          executables for each correlator, given the options of
+ *          each section.
+ */
+
+
+// ---------------------------------
+// Basic imports
+// ---------------------------------
+#include <iostream>
+#include <cmath>
+#include <locale>
+#include <fstream>
+#include <sstream>
+#include <string.h>
+#include <vector>
+#include <map>
+#include <set>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <memory>
+
+#include <chrono>
+using namespace std::chrono;
+
+// ---------------------------------
+// HEP imports
+// ---------------------------------
+#include "Pythia8/Pythia.h"
+#include "fastjet/PseudoJet.hh"
+#include "fastjet/ClusterSequence.hh"
+
+// Local imports:
+#include "../include/general_utils.h"
+#include "../include/jet_utils.h"
+#include "../include/cmdln.h"
+#include "../include/pythia_cmdln.h"
+
+#include "../include/enc_utils.h"
+
+#include "../include/synthetic_jets.h"
+#include "../include/jet_cache.h"
+#include "../include/enc_engine.h"
+#include "../include/enc_analysis.h"
+#include "../include/config_file.h"
+#include "../include/telemetry.h"
+
+
+// =====================================
+// Switches, flags, and options
+// =====================================
+// Number of jets per thread to gather before processing
+// them in parallel (only used with more than one thread)
+size_t JETS_PER_THREAD  = 32;
+
+// Options which select the jets of an analysis (its jet definition
+// and cuts), which may differ between the analyses of a batch of
+// Pythia events; the jets of Open Data, synthetic jets and jet
+// caches are instead selected once, for all analyses
+const std::vector<std::string> batch_jet_options = {
+    "--jet_rad", "-j", "--jet_alg", "--jet_algorithm",
+    "--jet_recomb", "--jet_scheme", "--jet_recombination",
+    "--jet_recombination_scheme",
+    "--n_exclusive_jets", "--pt_min", "--pt_max", "--eta_cut"};
+
+// Options of the whole run, which are shared by all analyses
+// (in addition to the other jet_cache_options, which select the
+//  events)
+const std::vector<std::string> batch_run_options = {
+    "--config", "--verbose", "--threads", "--max_memory",
+    "--progress_interval", "--status_file", "--read_jet_cache",
+    "--print_every"};
+
+// Options of the executables for each correlator which batches do
+// not support (yet)
+const std::vector<std::string> batch_unsupported_options = {
+    "--analyses", "--pipeline", "--cluster_threads", "--queue_size",
+    "--parallel_pythia", "--write_jet_cache",
+    "--checkpoint_file", "--checkpoint_interval", "--resume",
+    "--first_event", "--last_event", "--shard", "--nshards"};
+
+
+bool contains(const std::vector<std::string>& options,
+              const std::string& option) {
+    return std::find(options.begin(), options.end(), option)
+           != options.end();
+}
+
+
+// A selected jet, and the analyses which selected it
+struct BatchJet {
+    std::vector<PseudoJet> constituents;
+    std::vector<size_t> analyses;
+};
+
+
+// ####################################
+// Main
+// ####################################
+/**
+* @brief: Generates (or reads) events, and creates the histograms of
+*         each analysis of the configuration file from a single pass
+*         over the events.
+*
+* @return: int
+*/
+int main (int argc, char* argv[]) {
+    // Starting timer
+    auto start = high_resolution_clock::now();
+
+    // ---------------------------------
+    // =====================================
+    // Command line and configuration setup
+    // =====================================
+    // ---------------------------------
+    // Configuration file: options shared by all analyses (which the
+    // command line may also give, and overrides), then the options
+    // of each analysis, in its own section
+    const std::string config_file = cmdln_string("config", argc, argv,
+                                                 "", true);
+    const std::vector<ConfigSection> sections = read_config_file(
+                                                        config_file);
+    if (sections.size() < 2)
+        throw std::invalid_argument(
+            "The configuration file " + config_file + " must have at "
+            "least one section, for each analysis.");
+
+    const OptionList command_line = command_line_options(argc, argv);
+    OptionList shared_options = merge_options(command_line,
+                                              sections[0].options);
+    auto check_supported = [](const OptionList& options) {
+        for (const auto& entry : options)
+            if (contains(batch_unsupported_options, entry.first))
+                throw std::invalid_argument(
+                    entry.first + " is not supported in batch runs.");
+    };
+    check_supported(shared_options);
+    for (const ConfigSection& section : sections)
+        check_supported(section.options);
+    if (has_option(shared_options, "--file_prefix"))
+        throw std::invalid_argument(
+            "Each analysis has its own --file_prefix (by default, the "
+            "name of its section), which cannot be shared.");
+
+    std::vector<std::string> shared_args = option_arguments(argv[0],
+                                                            shared_options);
+    std::vector<char*> shared_argv = strings_to_argv(shared_args);
+    int shared_argc = static_cast<int>(shared_args.size());
+
+    // Printing if told to be verbose
+    const int verbose = cmdln_int("verbose", shared_argc,
+                                  shared_argv.data(), 1);
+    if (verbose >= 0) std::cout << enc_banner;
+
+    // Reading jets from a cache (see --write_jet_cache) rather
+    // than generating them: the settings which selected the cached
+    // jets then come from the cache
+    std::unique_ptr<JetCacheReader> jet_cache = open_jet_cache(
+                                                shared_args, verbose);
+    if (jet_cache) {
+        shared_argv = strings_to_argv(shared_args);
+        shared_argc = static_cast<int>(shared_args.size());
+        shared_options = command_line_options(shared_argc,
+                                              shared_argv.data());
+    }
+
+    // Ensuring valid command line inputs
+    if (checkPythiaInputs(shared_argc, shared_argv.data()) == 1)
+        return 1;
+
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Event Settings
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // (shared by all analyses)
+    const int n_events = cmdln_int("n_events", shared_argc,
+                                   shared_argv.data(), _NEVENTS_DEFAULT);
+    const int pid_1    = cmdln_int("pid_1", shared_argc,
+                                   shared_argv.data(), _PID_1_DEFAULT);
+    const int pid_2    = cmdln_int("pid_2", shared_argc,
+                                   shared_argv.data(), _PID_2_DEFAULT);
+    const bool is_proton_collision = (pid_1 == 2212 and
+                                      pid_2 == 2212);
+
+    // Source of the jets: CMS Open Data (by default), Pythia, or
+    // synthetic jets from a toy generator
+    const std::string jet_source = jet_source_cmdln(shared_argc,
+                                                    shared_argv.data(),
+                                                    true);
+    const bool finds_jets = jet_source == "pythia" and not jet_cache;
+
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Analyses
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // (each with the options of its section, then the shared ones;
+    //  reserved, so that the analyses stay in place for the shared
+    //  per-jet work)
+    std::vector<ENCAnalysis> analyses;
+    analyses.reserve(sections.size() - 1);
+    std::set<std::pair<std::string, std::string>> outputs;
+    for (size_t isection = 1; isection < sections.size(); ++isection) {
+        const ConfigSection& section = sections[isection];
+        for (const auto& entry : section.options) {
+            const std::string& option = entry.first;
+            if (contains(batch_run_options, option))
+                throw std::invalid_argument(
+                    "[" + section.name + "]: " + option + " applies to "
+                    "the whole run, and must be given before the "
+                    "first section (or on the command line).");
+            if (contains(jet_cache_options, option) and not
+                    (finds_jets and contains(batch_jet_options, option)))
+                throw std::invalid_argument(
+                    "[" + section.name + "]: " + option + " selects the "
+                    "events (or, unless finding jets in Pythia events, "
+                    "the jets) of all analyses, and must be given "
+                    "before the first section (or on the command "
+                    "line).");
+        }
+
+        const OptionList options = merge_options(section.options,
+                                                 shared_options);
+        const std::vector<std::string> correlator = option_values(
+                options, "--analysis");
+        std::vector<double> weights;
+        for (const std::string& value : option_values(options,
+                                                      "--weights"))
+            weights.push_back(atof(value.c_str()));
+
+        analyses.emplace_back(section.name,
+                              correlator.empty() ? "" : correlator[0],
+                              option_arguments(argv[0], options),
+                              weights, "weights", is_proton_collision,
+                              section.name);
+        const ENCAnalysis& analysis = analyses.back();
+        if (not outputs.emplace(analysis.correlator,
+                                analysis.file_prefix).second)
+            throw std::invalid_argument(
+                "[" + section.name + "]: Another " + analysis.correlator
+                + " analysis has the file prefix " + analysis.file_prefix
+                + "; each needs its own (with file_prefix, or a "
+                "section of its own name).");
+    }
+
+    // Jet finding, once per event for each jet definition
+    const std::vector<AnalysisJetFinder> jet_finders =
+            analysis_jet_finders(analyses);
+    // Per-jet angles, once per jet for each weight, angle and binning
+    AnalysisJets analysis_jets(analyses);
+
+    if (verbose >= 0) {
+        std::cout << "Running " << analyses.size() << " analyses";
+        if (finds_jets)
+            std::cout << " with " << jet_finders.size()
+                      << " jet definitions";
+        std::cout << ", sharing " << analysis_jets.ngeometries()
+                  << " sets of per-jet angles.\n";
+    }
+
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Parallelization and Memory Settings
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Number of threads over which jets are distributed
+    // (each thread runs all of the analyses of its jets)
+    int n_threads = cmdln_int("threads", shared_argc,
+                              shared_argv.data(), 1);
+    if (n_threads < 1)
+        throw std::invalid_argument(
+            "Must be given a positive number of threads.");
+    // Memory budget for the histograms and per-thread storage,
+    // e.g. 4G or 500M (no budget by default); the number of
+    // threads is reduced if needed to fit within the budget
+    const size_t max_memory = parse_memory_size(
+            cmdln_string("max_memory", shared_argc, shared_argv.data(),
+                         "0"));
+
+    // =====================================
+    // Memory Planning
+    // =====================================
+    const ENCMemoryEstimate memory = plan_analysis_threads(analyses,
+            n_threads, max_memory, JETS_PER_THREAD, verbose);
+
+    // =====================================
+    // Output Setup
+    // =====================================
+    // Set up histogram output files, with the names used by the
+    // executables for each correlator
+    for (ENCAnalysis& analysis : analyses)
+        analysis.setup_outfiles();
+
+
+    // =====================================
+    // Event Generation Setup
+    // =====================================
+    // Generating Pythia events for the loosest cuts on pT (or
+    // energy) of any analysis, if the analyses have cuts of their own
+    OptionList pythia_options = shared_options;
+    bool own_cuts = false;
+    for (size_t isection = 1; isection < sections.size(); ++isection)
+        own_cuts |= has_option(sections[isection].options, "--pt_min")
+                 or has_option(sections[isection].options, "--pt_max");
+    if (own_cuts) {
+        double pt_min = analyses[0].pt_min;
+        double pt_max = analyses[0].pt_max;
+        for (const ENCAnalysis& analysis : analyses) {
+            pt_min = std::min(pt_min, analysis.pt_min);
+            pt_max = std::max(pt_max, analysis.pt_max);
+        }
+        pythia_options = merge_options({
+                {"--pt_min", {std::to_string(pt_min)}},
+                {"--pt_max", {std::to_string(pt_max)}}},
+            shared_options);
+    }
+    std::vector<std::string> pythia_args = option_arguments(argv[0],
+                                                            pythia_options);
+    std::vector<char*> pythia_argv = strings_to_argv(pythia_args);
+
+    // (Open Data, synthetic jets or jet caches, with the jet settings
+    //  shared by all analyses, or Pythia events)
+    AnalysisEvents events(std::move(jet_cache), jet_source,
+                          shared_argc, shared_argv.data(),
+                          static_cast<int>(pythia_args.size()),
+                          pythia_argv.data(), true,
+                          cmdln_int("seed", shared_argc,
+                                    shared_argv.data(),
+                                    _PYTHIA_SEED_DEFAULT),
+                          analyses[0], verbose);
+
+    // ---------------------------------
+    // =====================================
+    // Analyzing events
+    // =====================================
+    // ---------------------------------
+    make_analysis_engines(analyses, n_threads, memory, JETS_PER_THREAD);
+    analysis_jets.set_threads(n_threads);
+
+    // (every analysis analyzes every jet of Open Data, synthetic
+    //  jets and jet caches)
+    std::vector<size_t> all_analyses;
+    for (size_t ianalysis = 0; ianalysis < analyses.size(); ++ianalysis)
+        all_analyses.push_back(ianalysis);
+
+    // Processes a single jet with each analysis which selected it
+    auto process_jet = [&](const size_t ithread, const BatchJet& jet) {
+        analysis_jets.process_jet(ithread, jet.constituents,
+                                  jet.analyses);
+    };
+
+    // Jets waiting to be processed by the worker threads
+    // (storing constituents rather than jets, since the
+    //  cluster sequence of each jet is deleted after its event)
+    std::vector<BatchJet> jet_batch;
+    const size_t jet_batch_size = JETS_PER_THREAD*n_threads;
+    jet_batch.reserve(jet_batch_size);
+
+    // Processes all jets in the current batch, handing each
+    // worker thread the next unprocessed jet until none remain
+    auto process_jet_batch = [&]() {
+        for_each_jet_parallel(n_threads, jet_batch, process_jet);
+        jet_batch.clear();
+    };
+
+    // Progress and throughput of the run, reported every
+    // --progress_interval seconds (with the work of the highest-order
+    // correlator, which dominates that of the others)
+    RunTelemetry telemetry(events.size(),
+            telemetry_settings(shared_argc, shared_argv.data(),
+                               max_analysis_order(analyses),
+                               verbose >= 0));
+
+    // Passes a selected jet on to the analyses which selected it
+    auto analyze_jet = [&](const PseudoJet& jet,
+                           const std::vector<size_t>& jet_analyses) {
+        BatchJet batch_jet;
+        try {
+            batch_jet.constituents = jet.constituents();
+        } catch (const fastjet::Error& ex) {
+            // (sometimes I find empty jets)
+            std::cerr << "Warning: FastJet: " << ex.message()
+                      << std::endl;
+            // Still counting the jet towards the normalization
+            for (const size_t ianalysis : jet_analyses)
+                ++analyses[ianalysis].empty_jets;
+            return;
+        }
+        telemetry.add_jet(batch_jet.constituents.size());
+        batch_jet.analyses = jet_analyses;
+
+        if (n_threads == 1) {
+            // Processing the jet right away if single-threaded
+            process_jet(0, batch_jet);
+        } else {
+            // Otherwise, waiting for a full batch of jets
+            jet_batch.push_back(std::move(batch_jet));
+            if (jet_batch.size() >= jet_batch_size)
+                process_jet_batch();
+        }
+    };
+
+    mute_fastjet_banner();
+
+    // =====================================
+    // Looping over events
+    // =====================================
+    std::vector<PseudoJet> event, good_jets;
+    std::vector<std::vector<size_t>> jet_analyses;
+    for (int iev = 0; iev < events.size(); ++iev) {
+        telemetry.add_event();
+
+        // Considering next event, if valid
+        if (not events.next(event)) continue;
+
+        // -----------------------------------------
+        // Jet cache, or CMS Open Data (give the jets from the start)
+        // -----------------------------------------
+        if (not events.finds_jets()) {
+            analyze_jet(event[0], all_analyses);
+            continue;
+        }
+
+        // -----------------------------------------
+        // If using Pythia, find jets manually, once for each jet
+        // definition
+        // -----------------------------------------
+        for (const AnalysisJetFinder& finder : jet_finders) {
+            std::unique_ptr<ClusterSequence> cluster_seq_ptr;
+            good_jets.clear();
+            jet_analyses.clear();
+            finder.find_jets(event, analyses, cluster_seq_ptr,
+                             good_jets, jet_analyses);
+
+            // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
+            // Loop on jets
+            // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
+            for (size_t i = 0; i < good_jets.size(); ++i)
+                analyze_jet(good_jets[i], jet_analyses[i]);
+            // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
+        }
+    } // end event loop
+
+    // Processing any remaining jets
+    if (not jet_batch.empty())
+        process_jet_batch();
+    telemetry.finish();
+    // =====================================
+
+
+    // ===================================
+    // Merging the results of all threads,
+    // and writing histograms to output files
+    // ===================================
+    for (ENCAnalysis& analysis : analyses) {
+        if (verbose >= 0)
+            std::cout << "\n[" << analysis.name << "]";
+        analysis.write(verbose);
+    }
+
+    // ---------------------------------
+    // =====================================
+    // Verifying successful run
+    // =====================================
+    // ---------------------------------
+    if (verbose >= 0) {
+        std::cout << "\nComplete!\n";
+        auto stop = high_resolution_clock::now();
+        auto duration = duration_cast<microseconds>(stop-start);
+        std::cout << "Analyzed and saved data from "
+                  << std::to_string(n_events)
+                  << " events in "
+                  << std::to_string(float(duration.count())/std::pow(10, 6))
+                  << " seconds, for " << analyses.size()
+                  << " analyses.\n";
+        std::cout << "Peak memory use: "
+                  << format_bytes(peak_rss_bytes()) << ".\n";
+    }
+
+    return 0;
+}
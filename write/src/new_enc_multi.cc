@@ -0,0 +1,126 @@
+/**
+ * @file    new_enc_multi.cc
+ *
+ * @brief   Code for generating histograms for several "new angles
+ *          on" n-point energy correlators (ENCs) at once: each
+ *          selected jet is found (or read) a single time, and is
+ *          then analyzed by all of the correlators chosen with
+ *          --analyses, which share the per-jet kinematics and
+ *          pairwise angles of the jet (the jet_properties
+ *          analysis histograms the jet itself).
+ *
+ *          The output files are the same as those of the
+ *          executables for each correlator.
+ */
+
+
+// ---------------------------------
+// Basic imports
+// ---------------------------------
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+// Local imports:
+#include "../include/general_utils.h"
+#include "../include/cmdln.h"
+#include "../include/pythia_cmdln.h"
+
+#include "../include/enc_utils.h"
+#include "../include/enc_analysis.h"
+
+
+// ####################################
+// Main
+// ####################################
+/**
+* @brief: Generates (or reads) events, and creates the histograms of
+*         each of the given ENCs from the same jets.
+*
+* @return: int
+*/
+int main (int argc, char* argv[]) {
+    // Printing if told to be verbose
+    int verbose = cmdln_int("verbose", argc, argv, 1);
+    if (verbose >= 0) std::cout << enc_banner;
+
+    // ---------------------------------
+    // =====================================
+    // Command line setup
+    // =====================================
+    // ---------------------------------
+    // Reading jets from a cache (see --write_jet_cache) rather
+    // than generating them: the settings which selected the cached
+    // jets (see jet_cache_options) then come from the cache
+    AnalysisRun run(argc, argv, verbose);
+    argc = run.argc();
+    argv = run.argv();
+
+    // Ensuring valid command line inputs
+    if (checkPythiaInputs(argc, argv) == 1) return 1;
+
+    // ---------------------------------
+    // Getting command line variables
+    // ---------------------------------
+    // File to which we want to write
+    std::string file_prefix = cmdln_string("file_prefix",
+                                           argc, argv, "",
+                                           true); /* required */
+
+    // Analyses to run, e.g. --analyses 2particle 3particle
+    std::vector<std::string> analysis_names;
+    for(int iarg=0; iarg<argc; ++iarg) {
+        if(str_eq(argv[iarg], "--analyses"))
+            while (iarg+1 < argc and
+                    // next arg doesn't start with '--'
+                   std::string(argv[iarg+1]).find("--") == std::string::npos) {
+                ++iarg;
+                analysis_names.emplace_back(argv[iarg]);
+            }
+    }
+
+    if (analysis_names.size() == 0)
+        throw std::invalid_argument(
+            "Must be given at least one analysis (--analyses).");
+    for (const std::string& analysis : analysis_names)
+        if (std::find(analysis_correlators.begin(),
+                      analysis_correlators.end(), analysis)
+                == analysis_correlators.end())
+            throw std::invalid_argument(
+                "Cannot run the analysis " + analysis + " with the "
+                "others; the analyses which can be run together are "
+                "2particle, 3particle, 4particle, 2special, "
+                "old_3particle and jet_properties.");
+
+
+    // Whether the events are pp collisions, which decides the
+    // defaults of the analyses
+    const bool is_proton_collision = run.is_proton_collision();
+
+
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Analyses
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Each with all of the options of the command line (with the
+    // same defaults as its executable, e.g. the two-particle
+    // correlator extends to larger angles unless --maxbin is given),
+    // and its own energy weights, e.g.
+    //   --weights_2particle 1 2 --weights_3particle 1 1 2 0.5
+    // (single weights, pairs, or triples; pairs for 2special, and
+    //  none for old_3particle and jet_properties)
+    std::vector<ENCAnalysis> analyses;
+    analyses.reserve(analysis_correlators.size());
+    for (const std::string& correlator : analysis_correlators)
+        if (std::find(analysis_names.begin(), analysis_names.end(),
+                      correlator) != analysis_names.end())
+            analyses.emplace_back(correlator, correlator, run.arguments,
+                    weights_cmdln("weights_" + correlator, argc, argv),
+                    "--weights_" + correlator, is_proton_collision,
+                    file_prefix);
+
+    // Generating (or reading) events, and writing the histograms of
+    // each analysis
+    return run.run(analyses);
+}
@@ -45,15 +45,20 @@ using namespace std::chrono;
 #include "../include/enc_utils.h"
 
 #include "../include/opendata_utils.h"
+#include "../include/synthetic_jets.h"
+#include "../include/jet_geometry.h"
+#include "../include/nd_histogram.h"
+#include "../include/enc_kernels.h"
+#include "../include/enc_output.h"
+#include "../include/runtime_stats.h"
+#include "../include/telemetry.h"
 
 
 // =====================================
 // Type definitions for histograms
 // =====================================
 // Multi-dimensional Histograms
-typedef std::vector<double> Hist1d;
-typedef std::vector< std::vector<double>> Hist2d;
-typedef std::vector< std::vector< std::vector<double>>> Hist3d;
+typedef NDHistogram<3> Hist3d;
 
 // Using pairs of weights to specify the doubly-projected correlator
 typedef std::pair<double, double> weight_t;
@@ -68,80 +73,6 @@ std::string CMS_JET_ALG = "akt";
 float CMS_PT_MIN        = 500;
 float CMS_PT_MAX        = 550;
 
-// =====================================
-// Additional Utilities
-// =====================================
-inline double mod2pi(double phi) {
-    while (phi > PI)
-        phi -= TWOPI;
-    while (phi <= -PI)
-        phi += TWOPI;
-
-    return phi;
-}
-
-double enc_azimuth(const PseudoJet& part1,
-                   const PseudoJet& part_sp,
-                   const PseudoJet& part2) {
-    // NOTE: I think this doesn't work for very fat jets --
-    // NOTE:   roughly because fat jets require a bit more care
-    // NOTE:   with mod(2pi) arithmetic
-    // - - - - - - - - - - - - - - - - - - -
-    // Normalized vectors in eta-phi plane
-    // - - - - - - - - - - - - - - - - - - -
-    // From part_sp to part1
-    double x1 = part1.rap() - part_sp.rap();
-    double y1 = mod2pi(part1.phi() - part_sp.phi());
-    const double n1  = sqrt(std::pow(x1, 2.) + std::pow(y1, 2.));
-    if (n1 == 0)
-        return 0;
-    x1 /= n1; y1 /= n1;
-
-    // From part_sp to part2
-    double x2;
-    x2 = part2.rap() - part_sp.rap();
-    double y2 = mod2pi(part2.phi() - part_sp.phi());
-    const double n2  = sqrt(std::pow(x2, 2.) + std::pow(y2, 2.));
-    if (n2 == 0)
-        return 0;
-    x2 /= n2; y2 /= n2;
-
-    // - - - - - - - - - - - - - - - - - - -
-    // Getting the "angle" between these vectors
-    // - - - - - - - - - - - - - - - - - - -
-    const double dot = x1*x2 + y1*y2;
-    const double det = x1*y2 - y1*x2;
-    double phi = mod2pi(atan2(det, dot));
-
-    // Setting it to be between -pi and pi
-    phi = phi > PI ? phi - TWOPI : phi;
-    if (phi < -PI or PI < phi)
-        throw std::range_error(
-                "Found azimuthal angle not between -pi and pi.");
-
-    return phi;
-}
-
-
-inline std::tuple<double, double, double> thetaL_thetaS_phi(
-    const double& theta1, const double& theta2, const double& theta12,
-    const PseudoJet& part1, const PseudoJet& part_sp, const PseudoJet& part2) {
-    // Assuming theta2 < theta1
-    double thetaS = std::min(theta12, theta2);
-    double thetaL = std::max(theta1, theta12);
-    double phi;
-
-    if (theta12 < theta2) {
-        phi = enc_azimuth(part2, part1, part_sp);
-    } else if (theta12 < theta1) {
-        phi = enc_azimuth(part1, part_sp, part2);
-    } else {
-        phi = enc_azimuth(part1, part2, part_sp);
-    }
-
-    return {thetaL, thetaS, phi};
-}
-
 // ####################################
 // Main
 // ####################################
@@ -268,7 +199,6 @@ int main (int argc, char* argv[]) {
                                    -8, false);
     const double maxbin   = cmdln_double("maxbin", argc, argv,
                                    0.05, false);
-    const bool binL_uflow = true, binL_oflow = true;
 
     // Phi is binned linearly, with same nbins by default
     const int   nphibins  = cmdln_int("nphibins", argc, argv,
@@ -278,95 +208,48 @@ int main (int argc, char* argv[]) {
     const bool lin_binS   = cmdln_bool("lin_binS", argc, argv,
                                  true, false);
 
-    // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
-    // Initializing bin edges and centers
-    // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
-    // - - - - - - - - - - - - - - -
-    // For theta1
-    // - - - - - - - - - - - - - - -
-    // Setting up under/overflow
-    int nbinsL_finite = nbins, binL_finite_start = 0;
-    if (binL_uflow) {nbinsL_finite -= 1; binL_finite_start += 1;}
-    if (binL_oflow) nbinsL_finite -= 1;
-
-    // (logarithmic, from 10^minbin to 10^maxbin)
-    const std::vector<double> binL_edges   = get_bin_edges(
-                                            minbin, maxbin, nbins,
-                                            binL_uflow, binL_oflow);
-    const std::vector<double> binL_centers = get_bin_centers(
-                                            minbin, maxbin, nbins,
-                                            binL_uflow, binL_oflow);
-
-    // - - - - - - - - - - - - - - -
-    // Bins for theta2/theta
-    // - - - - - - - - - - - - - - -
-    // (from 0 to 1, with a variable bin-spacing scheme)
-    // Options dependent on the binning of theta2/theta1:
-    const std::string binS_scheme = lin_binS ? "lin" : "log";
-    // t2/t1 in (0, 1) in linear bins, or
-    // t2/t1 in (1e-minbin, 1) if logarithmic bins
-    const double binS_min = lin_binS ?   0   : minbin;
-    const double binS_max = lin_binS ?   1   : 0;
-    // Use underflow only if binning logarithmically
-    const bool binS_uflow        = lin_binS ? false : true;
-    const int  binS_finite_start = lin_binS ?   0   : 1;
-    const int  nbinsS_finite     = lin_binS ? nbins : nbins-1;
-
-    const std::vector<double> binS_edges = get_bin_edges(
-                                        binS_min, binS_max,
-                                        nbins, binS_uflow, false);
-                            /* underflow = (!bin_lin2) */
-                            /* but overflow = false */
-    const std::vector<double> binS_centers = get_bin_centers(
-                                        binS_min, binS_max,
-                                        nbins, binS_uflow, false);
-
-    // - - - - - - - - - - - - - - -
-    // For "azimuthal" angle phi
-    // - - - - - - - - - - - - - - -
-    // (linear, from -pi to pi)
-    const std::vector<double> phi_edges   = get_bin_edges(
-                                                -PI, PI, nphibins,
-                                                false, false);
-    const std::vector<double> phi_centers = get_bin_centers(
-                                                -PI, PI, nphibins,
-                                                false, false);
-    // Bin for phi = 0
-    const int phizerobin = bin_position(0, -PI, PI, nphibins,
-                                        "linear", false, false);
+    // Bins of thetaL (logarithmic, from 10^minbin to 10^maxbin,
+    // with under- and overflow), thetaS/thetaL (from 0 to 1, with a
+    // variable bin-spacing scheme) and phi (linear, from -pi to pi),
+    // as for theta1, theta2/theta1 and phi2 of the new correlator
+    const ENCBinning binning(minbin, maxbin, nbins, nphibins,
+                             {lin_binS});
+    const BinAxis& binS_axis = binning.ratios[0].axis;
+    const BinAxis& phi_axis  = binning.phi_axis;
 
     // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
     // Output Settings
     // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
     // Whether to output hist in a mathematica friendly format
-    const bool mathematica_format = cmdln_bool("mathematica",
-                                               argc, argv, false);
-    const std::string HIST_DELIM = mathematica_format ?  " " : ", ";
-    const std::string file_ext   = mathematica_format ?  ".txt"
-                                                      : ".py";
+    ENCOutputFormat output_format;
+    output_format.mathematica = cmdln_bool("mathematica",
+                                           argc, argv, false);
+    output_format.argc = argc;
+    output_format.argv = argv;
 
     // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
     // Input Settings
     // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
-    const bool use_opendata = cmdln_bool("use_opendata", argc, argv,
-                                         true);
+    // Source of the jets: CMS Open Data (by default), Pythia, or
+    // synthetic jets from a toy generator (--source, or
+    // --use_opendata), the latter read in the same way as Open Data
+    const std::string jet_source = jet_source_cmdln(argc, argv, true);
+    const bool use_opendata = jet_source != "pythia";
+    // File of CMS Open Data, as text or as a binary jet dataset
+    // (see ecscribe-convert)
+    const std::string od_file = cmdln_string("od_file", argc, argv,
+                                             od::cms_jets_file);
 
     // =====================================
     // Output Setup
     // =====================================
     // Set up histograms
-    Hist3d enc_hist (nbins, Hist2d(nbins, Hist1d(nphibins)));
+    Hist3d enc_hist (nbins, nbins, nphibins);
 
-    // Setting up output file
-    std::string filename = "output/new_encs/old_3particle_" +
-        file_prefix;
-    filename = periods_to_hyphens(filename);
-    filename += file_ext;
-    // writing a header with relevant information
-    // for a E^nC projected to depend on only a single angle
-    write_enc_header(filename, argc, argv,
-                     std::vector<double> {1.0, 1.0},
-                     not(mathematica_format));
+    // Setting up output file, with a header with relevant
+    // information
+    const std::string filename = setup_old_3particle_outfile(
+                                        file_prefix, output_format);
 
 
     // =====================================
@@ -398,11 +281,19 @@ int main (int argc, char* argv[]) {
     // ---------------------------------
     const JetDefinition jet_def = process_JetDef(jet_alg, jet_rad,
                                                  jet_recomb);
+    // Cuts on the jets found in each event (see select_jets)
+    const JetCuts jet_cuts{jet_rad, n_exclusive_jets, pt_min, pt_max,
+                           eta_cut, is_proton_collision};
 
     // ---------------------------------
-    // CMS Open Data
+    // CMS Open Data (or synthetic jets)
     // ---------------------------------
-    od::EventReader cms_jet_reader(od::cms_jets_file);
+    od::EventReader cms_jet_reader = jet_source == "synthetic" ?
+            od::EventReader(synthetic_jet_settings(argc, argv,
+                    cmdln_int("seed", argc, argv,
+                              _PYTHIA_SEED_DEFAULT),
+                    pt_min, pt_max, eta_cut, jet_rad))
+            : od::EventReader(od_file);
 
     // ---------------------------------
     // =====================================
@@ -415,28 +306,29 @@ int main (int argc, char* argv[]) {
     //   (used to normalize the histogram)
     int njets_tot = 0;
 
-    // Initializing particles, good_jets, sorted angles and weights
+    // Initializing particles, good_jets, and per-jet storage
     std::vector<PseudoJet> particles;
-    std::vector<PseudoJet> all_jets;
     std::vector<PseudoJet> good_jets;
-    std::vector<std::pair<double, PseudoJet>> sorted_angs_parts;
+    CompactJet compact_jet;
+    JetGeometry geometry = binning.geometry();
 
     // Reserving memory
     particles.reserve(150);
-    all_jets.reserve(20);
     good_jets.reserve(5);
-    sorted_angs_parts.reserve(50);
 
     // Preparing to store runtime info
-    std::map<int, std::vector<double>> jet_runtimes;
+    RuntimeStatistics jet_runtimes;
 
 
     // =====================================
     // Looping over events
     // =====================================
+    // Progress and throughput of the run, reported every
+    // --progress_interval seconds
+    RunTelemetry telemetry(n_events,
+            telemetry_settings(argc, argv, 3, verbose >= 0));
     for (int iev = 0; iev < n_events; ++iev) {
-        progressbar(static_cast<double>(iev+1)/
-                    double(n_events));
+        telemetry.add_event();
 
         // -#-#-#-#-#-#-#-#-#-#-#-#-#-#-#-#-
         // Jet finding (with cuts)
@@ -471,62 +363,15 @@ int main (int argc, char* argv[]) {
                 std::cout.rdbuf(fastjetstream.rdbuf());
             }
 
-            cluster_seq_ptr = std::make_unique
-                <ClusterSequence>(particles, jet_def);
-
-            if (iev == 0) {
-                std::cout.rdbuf(old);  // Restore std::cout
-            }
-
             // ---------------------------------
             // Jet finding (with cuts)
             // ---------------------------------
-            if (jet_rad < 1000) {
-                // If given a generic value of R,
-                // cluster the event with the given jet definition
-                all_jets = sorted_by_pt(
-                        cluster_seq_ptr->inclusive_jets(pt_min));
-            } else {
-                // If we are given the maximum possible value of R,
-                // use the whole event as a single "jet"
-                PseudoJet full_event;
-                for (auto part : particles)
-                    if (part.modp() > 0)
-                        full_event = join(full_event, part);
-
-                all_jets.push_back(std::move(full_event));
-            }
+            select_jets(particles, jet_def, jet_cuts, cluster_seq_ptr,
+                        good_jets);
 
-            // Getting all jets which satisfy other requirements
-            for (size_t i = 0; i < all_jets.size()
-                               &&
-                // Only working up to the Nth jet if doing exclusive analysis
-                     (n_exclusive_jets <= 0
-                      ||
-                      i < static_cast<size_t>(n_exclusive_jets));
-             ++i) {
-                const PseudoJet& jet = all_jets[i];
-
-                // Getting jets that satisfy certain criteria
-                if (is_proton_collision) {
-                    // For pp, ensuring pt_min < pt < pt_max
-                    // and |eta| < eta_cut   (or no eta_cut given)
-                    if (pt_min <= jet.pt() and jet.pt() <= pt_max
-                            and (abs(jet.eta()) <= eta_cut
-                                or eta_cut < 0)) {
-                        good_jets.push_back(jet);
-                    }
-                } else {
-                    // For other collisions, ensuring E_min < E < E_max
-                    // (for now, keeping confusing notation with, e.g.,
-                    //    E_min represented by `pt_min` below)
-                    if (pt_min <= jet.E() and jet.E() <= pt_max) {
-                        good_jets.push_back(jet);
-                    }
-                }
+            if (iev == 0) {
+                std::cout.rdbuf(old);  // Restore std::cout
             }
-
-            all_jets.clear();
         }
 
         // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
@@ -542,150 +387,27 @@ int main (int argc, char* argv[]) {
 
             // Storing jet constituents
             const std::vector<PseudoJet>& constituents = jet.constituents();
-            double weight_tot = 0;
-            for (const auto& particle : constituents) {
-                weight_tot += use_pt ? particle.pt() : particle.e();
-            }
+            telemetry.add_jet(constituents.size());
+            // Compact kinematics and normalized weights
+            compact_jet.fill(constituents, use_pt);
 
-            // ---------------------------------
-            // Loop on "special" particle
-            for (const auto& part_sp : constituents) {
-                // Energy-weighting factor for "special" particle
-                double weight_sp = use_pt ?
-                        part_sp.pt() / weight_tot :
-                        part_sp.e() / weight_tot;
-
-                // -|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-
-                // Preparing contact term
-                // -|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-
-                if (contact_terms)
-                    enc_hist[0][0][phizerobin] +=
-                                pow(weight_sp, 3.);
-                // -|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-
-
-                // (Sorting:
-                //   * [theta1]: angle relative to special particle
-                //   * [weight1]: either E2/Ejet or pt2/ptjet
-                //  by theta1)
-                sorted_angs_parts.clear();
-
-                // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
-                // Loop on particles
-                for (const auto& part1 : constituents) {
-                    // Angle relative to "special" particle
-                    double theta1 = use_deltaR ?
-                            part_sp.delta_R(part1) :
-                            fastjet::theta(part_sp, part1);
-
-                    sorted_angs_parts.emplace_back(theta1, part1);
-                } // end second particle loop
-                // Sorting angles/weights by angle as promised :)
-                std::sort(sorted_angs_parts.begin(),
-                          sorted_angs_parts.end(),
-                          [](auto& left, auto& right) {
-                              return left.first < right.first;
-                         });
-                // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
-
-                // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
-                // Loop on first non-special particle
-                // (calculating change in cumulative E^3 C)
-                for (size_t jpart=1; jpart<sorted_angs_parts.size(); ++jpart) {
-                    // Properties of 1st particle
-                    double theta1 = sorted_angs_parts[jpart].first;
-                    PseudoJet& part1  = sorted_angs_parts[jpart].second;
-                    double weight1 = use_pt ?
-                            part1.pt() / weight_tot :
-                            part1.e() / weight_tot;
-
-                    // -|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-
-                    // Preparing contact term:
-                    // -|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-
-                    if (contact_terms) {
-                        // Calculating the theta1 bin
-                        int bin1 = bin_position(theta1,
-                                minbin, maxbin, nbins, "log",
-                                binL_uflow, binL_oflow);
-
-                        // part2 = part_sp != part_1
-                        enc_hist[bin1][0][phizerobin] +=
-                            2*pow(weight_sp, 2) * pow(weight1, 1);
-
-                        // part2 = part1 != part_sp
-                        enc_hist[bin1][0][phizerobin] +=
-                            pow(weight_sp, 1) * pow(weight1, 2);
-                    }
-                    // -|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-|-
-
-
-                    // -----------------------------------
-                    // Loop on second non-special particle
-                    for (size_t kpart=1; kpart<jpart; ++kpart) {
-                        // Getting 2nd particle
-                        double theta2    = sorted_angs_parts[kpart].first;
-                        PseudoJet& part2 = sorted_angs_parts[kpart].second;
-                        double weight2 = use_pt ?
-                                part2.pt() / weight_tot :
-                                part2.e() / weight_tot;
-
-                        // Getting thetaL, thetaM, thetaS
-                        double theta12 = part1.delta_R(part2);
-                        auto [thetaL, thetaS, phi] =
-                            thetaL_thetaS_phi(
-                                theta1, theta2, theta12,
-                                part1, part_sp, part2);
-
-                        double thetaS_over_thetaL = thetaS/thetaL;
-
-                        // Calculating thetaL bin in the histogram
-                        int binL = bin_position(thetaL,
-                                minbin, maxbin, nbins,
-                                "log", binL_uflow, binL_oflow);
-                        // Calculating thetaS/thetaL bin position
-                        int binS = bin_position(thetaS_over_thetaL,
-                                            binS_min, binS_max,
-                                            nbins, binS_scheme,
-                                            binS_uflow, false);
-                                        /* Variable spacing scheme,
-                                         * but with no overflow. */
-                        // Calculating the phi bin
-                        int binphi = bin_position(phi, -PI, PI,
-                                                  nphibins, "linear",
-                                                  false, false);
-
-                        // *:*:*:*:*:*:*:*:*:*:*:*:*:*:*:*:*:*:*
-                        // Adding to the histogram
-                        // *:*:*:*:*:*:*:*:*:*:*:*:*:*:*:*:*:*:*
-                        // Getting weight
-                        double hist_weight = weight_sp *
-                                            weight1 * weight2;
-                        double perm = 2;
-                        // imagine a triangle with theta_j < theta_i;
-                        // need to count twice to get the full
-                        // sum on all pairs (see also contact term)
-
-                        enc_hist[binL][binS][binphi] += perm*hist_weight;
-                        // *:*:*:*:*:*:*:*:*:*:*:*:*:*:*:*:*:*:*
-                    } // end calculation/2nd particle loop
-                    // -----------------------------------
-                } // end 1st particle loop
-                // -#-#-#-#-#-#-#-#-#-#-#-#-#-#-#-#-
-            // ---------------------------------
-            } // end "special particle" loop
-            // ---------------------------------
+            // Pairwise angles, and particles sorted by angle
+            geometry.fill(compact_jet, use_deltaR);
+
+            // Loops on the special particle and on pairs of
+            // non-special particles
+            old_3particle_jet(compact_jet, geometry, binS_axis,
+                              phi_axis, enc_hist, contact_terms);
 
             // ---------------------------------
             // Finished with this jet!
             // ---------------------------------
             // End timing
-            auto jet_end =
-                std::chrono::high_resolution_clock::now();
-            auto jet_duration = std::chrono::duration_cast
-                    <std::chrono::microseconds>(jet_end - jet_start);
+            const std::chrono::duration<double, std::micro> jet_duration =
+                    std::chrono::high_resolution_clock::now() - jet_start;
 
             // Store the runtime for this jet
-            jet_runtimes[constituents.size()].emplace_back(
-                    static_cast<double>(jet_duration.count()));
+            jet_runtimes.add(constituents.size(), jet_duration.count());
         } catch (const fastjet::Error& ex) {
             // ending try statement (sometimes I find empty jets)
             std::cerr << "Warning: FastJet: " << ex.message()
@@ -696,316 +418,15 @@ int main (int argc, char* argv[]) {
         } // end loop on jets
         // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
     } // end event loop
+    telemetry.finish();
     // =====================================
 
     // ===================================
     // Writing histograms to output files
     // ===================================
-    // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
-    // Output setup
-    // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
-    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
-    // Opening histogram output file
-    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
-    std::fstream outfile;
-    outfile.open(filename, std::ios_base::in |
-                           std::ios_base::out |
-                           std::ios_base::app);
-
-    // Checking for existence
-    if (!outfile.is_open()) {
-        std::stringstream errMsg;
-        errMsg << "File for EnC output was expected "
-               << "to be open, but was not open.\n\n"
-               << "It is possible the file was unable to "
-               << "be created at the desired location:\n\n\t"
-               << "filename = " << filename << "\n\n"
-               << "Is the filename an absolute path? If not, "
-               << "that might be the problem.";
-        throw std::runtime_error(errMsg.str().c_str());
-    }
-
-
-    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
-    // Writing bins to files
-    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
-    // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
-    // thetaLs
-    // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
-    // -:-:-:-:-:-:-:-:-:-:-:-:
-    // bin edges
-    // -:-:-:-:-:-:-:-:-:-:-:-:
-    if (not(mathematica_format)) outfile << "thetaL_edges = [\n\t";
-    else outfile << "(* thetaL_edges *)\n";
-
-    // nbins+1 bin edges:
-    //   include -infty and infty for under/overflow
-    for (int ibin = 0; ibin < nbins; ++ibin)
-        outfile << pow(10, binL_edges[ibin]) << HIST_DELIM;
-    if (std::isinf(binL_edges[nbins]) and not(mathematica_format))
-        outfile << "np.inf\n";
-    else
-        outfile << pow(10, binL_edges[nbins]) << "\n";
-
-    if (not(mathematica_format)) outfile << "]\n\n";
-
-    // -:-:-:-:-:-:-:-:-:-:-:-:
-    // bin centers
-    // -:-:-:-:-:-:-:-:-:-:-:-:
-    if (not(mathematica_format)) outfile << "thetaL_centers = [\n\t";
-    else outfile << "\n(* thetaLs *)\n";
-
-    for (int ibin = 0; ibin < nbins-1; ++ibin)
-        outfile << pow(10, binL_centers[ibin]) << HIST_DELIM;
-    if (std::isinf(binL_centers[nbins-1]) and not(mathematica_format))
-        outfile << "np.inf\n";
-    else
-        outfile << pow(10, binL_centers[nbins-1]) << "\n";
-
-    if (not(mathematica_format)) outfile << "]\n\n";
-
-
-    // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
-    // thetaS_over_thetaLs
-    // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
-    // -:-:-:-:-:-:-:-:-:-:-:-:
-    // bin edges
-    // -:-:-:-:-:-:-:-:-:-:-:-:
-    if (not(mathematica_format))
-        outfile << "thetaS_over_thetaL_edges = [\n\t";
-    else outfile << "(* thetaS_over_thetaL_edges *)\n";
-
-    // nbins+1 bin edges:
-    for (int ibin = 0; ibin < nbins+1; ++ibin) {
-        double binS_edge = lin_binS ? binS_edges[ibin]
-                                    : pow(10, binS_edges[ibin]);
-
-        outfile << binS_edge;
-        if (ibin < nbins)
-            outfile << HIST_DELIM;
-        else
-            outfile << std::endl;
-    }
-
-    if (not(mathematica_format)) outfile << "]\n\n";
-
-    // -:-:-:-:-:-:-:-:-:-:-:-:
-    // bin centers
-    // -:-:-:-:-:-:-:-:-:-:-:-:
-    if (not(mathematica_format))
-        outfile << "thetaS_over_thetaL_centers = [\n\t";
-    else outfile << "\n(* thetaS_over_thetaLs *)\n";
-
-    for (int ibin = 0; ibin < nbins; ++ibin) {
-        double binS_val = lin_binS ? binS_centers[ibin]
-                                   : pow(10, binS_centers[ibin]);
-        outfile << binS_val;
-        if (ibin < nbins-1)
-            outfile << HIST_DELIM;
-        else
-            outfile << std::endl;
-    }
-
-    if (not(mathematica_format)) outfile << "]\n\n";
-
-
-    // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
-    // phis
-    // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
-    // -:-:-:-:-:-:-:-:-:-:-:-:
-    // bin edges
-    // -:-:-:-:-:-:-:-:-:-:-:-:
-    if (not(mathematica_format)) outfile << "phi_edges = [\n\t";
-    else outfile << "(* phi_edges *)\n";
-
-    // nphibins+1 bin edges:
-    for (int ibin = 0; ibin < nphibins; ++ibin)
-        outfile << phi_edges[ibin] << HIST_DELIM;
-    outfile << phi_edges[nphibins] << "\n";
-
-    if (not(mathematica_format)) outfile << "]\n\n";
-
-    // -:-:-:-:-:-:-:-:-:-:-:-:
-    // bin centers
-    // -:-:-:-:-:-:-:-:-:-:-:-:
-    if (not(mathematica_format)) outfile << "phi_centers = [\n\t";
-    else outfile << "\n(* phis *)\n";
-
-    for (int ibin = 0; ibin < nphibins-1; ++ibin)
-        outfile << phi_centers[ibin] << HIST_DELIM;
-    outfile << phi_centers[nphibins-1] << "\n";
-
-    if (not(mathematica_format)) outfile << "]\n\n";
-
-
-    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
-    // Processing/writing histogram
-    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
-    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
-    // Normalizing histogram
-    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
-    // Currently, hist contains
-    //   hist[ibin] = N_jets * d^3 Sigma[thetaL][thetaS/thetaL][phi]
-    // Now, changing all finite bins:
-    //   hist[ibin] -> (thetaL^2 * d^3Sigma/dthetaL dthetaS dphi)
-    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
-    double total_sum = 0.0;
-
-    // Looping over all finite bins
-    for (int binL=0; binL<nbins; ++binL) {
-        for (int binS=0; binS<nbins; ++binS) {
-            for (int binphi=0; binphi<nphibins; ++binphi) {
-                // Dealing with expectation value over N jets
-                enc_hist[binL][binS][binphi] /= njets_tot;
-                total_sum += enc_hist[binL][binS][binphi];
-
-                // Not normalizing outflow bins further
-                if (binL < binL_finite_start
-                        or binL >= nbinsL_finite
-                        or binS < binS_finite_start
-                        or binS >= nbinsS_finite)
-                    continue;
-
-                // Otherwise,
-                double dlogthetaL = (binL_edges[binL+1] - binL_edges[binL]);
-                double dthetaS_over_thetaL = (binS_edges[binS+1] - binS_edges[binS]);
-                double dphi = (phi_edges[binphi+1] - phi_edges[binphi]);
-
-                double dvol = dlogthetaL * dthetaS_over_thetaL * dphi;
-                enc_hist[binL][binS][binphi] /= dvol;
-                // NOTE: This is thetaL^2 times the linearly
-                // NOTE:   normalized distribution
-            }
-        }
-    }
-
-    if (verbose >= 0) {
-        double total_integral = 0.0;
-        for (int binL=0; binL<nbins; ++binL) {
-            for (int binS=0; binS<nbins; ++binS) {
-                for (int binphi=0; binphi<nphibins; ++binphi) {
-                    if (binL < binL_finite_start
-                            or binL >= nbinsL_finite
-                            or binS < binS_finite_start
-                            or binS >= nbinsS_finite) {
-                        total_integral += enc_hist[binL][binS][binphi];
-                        continue;
-                    }
-
-                    // Otherwise,
-                    double dlogthetaL = (binL_edges[binL+1] - binL_edges[binL]);
-                    double dthetaS_over_thetaL = (binS_edges[binS+1] - binS_edges[binS]);
-                    double dphi = (phi_edges[binphi+1] - phi_edges[binphi]);
-
-                    double dvol = dlogthetaL * dthetaS_over_thetaL * dphi;
-
-                    total_integral += enc_hist[binL][binS][binphi] * dvol;
-                }
-            }
-        }
-
-        // Printing normalization
-        std::cout << "\nTotal weight for old defn, "
-                  << "weights=(1,1,1):\n\t"
-                  << total_sum;
-
-        std::cout << "\nIntegrated weight for old defn, "
-                  << "weights=(1,1,1):\n\t"
-                  << total_integral;
-    }
-
-    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
-    // Writing histogram
-    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
-    if (not(mathematica_format)) outfile << "hist = [\n\t";
-    else outfile << "\n(* hist *)\n";
-
-    // thetaLs
-    for (int binL = 0; binL < nbins; ++binL) {
-        if (not(mathematica_format)) outfile << "[\n\t";
-
-        // thetaSs
-        for (int binS = 0; binS < nbins; ++binS) {
-            // Phis
-            if (not(mathematica_format))
-                outfile << "\t[\n\t\t\t";
-
-            // Loop over phis
-            for (int binphi = 0; binphi < nphibins-1; ++binphi) {
-                outfile << std::setprecision(10)
-                        << enc_hist[binL][binS][binphi] << HIST_DELIM;
-            }
-            outfile << enc_hist[binL][binS][nphibins-1] << "\n";
-
-            if (not(mathematica_format))
-                outfile << (binS != nbins-1 ? "\t\t],\n\t"
-                                            : "\t\t]\n");
-        }
-
-        if (not(mathematica_format))
-            outfile << (binL != nbins-1 ? "\t],\n\t"
-                                        : "\t]\n");
-    }
-    if (not(mathematica_format)) outfile << "]";
-
-
-    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
-    // Writing runtimes
-    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
-    std::vector<double> runtime_means;
-    std::vector<double> runtime_stds;
-
-    // Looping over number of particles in a jet
-    for (int num=0; num<200; ++num) {
-        // Finding the runtimes associated with this
-        // number of particles
-        std::map<int, std::vector<double>>::iterator it
-                = jet_runtimes.find(num);
-        if(it == jet_runtimes.end()) {
-            runtime_means.emplace_back(
-                    std::numeric_limits<double>::quiet_NaN());
-            runtime_stds.emplace_back(
-                    std::numeric_limits<double>::quiet_NaN());
-            continue;
-        }
-
-        // If found, calculate mean and standard deviation:
-        const std::vector<double>& runtimes = it->second;
-        double mean  = vector_mean(runtimes);
-        double stdev = vector_std(runtimes);
-        runtime_means.push_back(mean);
-        runtime_stds.push_back(stdev);
-    }
-
-    // Adding mean runtimes to file
-    if (not(mathematica_format))
-        outfile << "\n\nruntime_means = [\n\t";
-    else outfile << "\n(* mean runtimes *)\n";
-    for (size_t inum = 0; inum < runtime_means.size(); ++inum) {
-        !std::isnan(runtime_means[inum])    ?
-            outfile << runtime_means[inum] :
-            outfile << "np.nan";
-        if (inum < runtime_means.size()) outfile << HIST_DELIM;
-        else outfile << "\n";
-    }
-    if (not(mathematica_format)) outfile << "]\n";
-
-    // Adding stdev runtimes to file
-    if (not(mathematica_format))
-        outfile << "runtime_stds = [\n\t";
-    else outfile << "\n(* stdev runtimes *)\n";
-    for (size_t inum = 0; inum < runtime_stds.size(); ++inum) {
-        !std::isnan(runtime_stds[inum])    ?
-            outfile << runtime_stds[inum] :
-            outfile << "np.nan";
-        if (inum < runtime_stds.size()) outfile << HIST_DELIM;
-        else outfile << "\n";
-    }
-    if (not(mathematica_format)) outfile << "]";
-
-    // Closing file
-    outfile.close();
-
+    write_old_3particle_hist(enc_hist, njets_tot, binning,
+                             &jet_runtimes, filename, output_format,
+                             verbose);
 
     // ---------------------------------
     // =====================================
@@ -0,0 +1,112 @@
+/**
+ * @file    angle_sort.cc
+ *
+ * @brief   Index sorting specialized to non-negative floating
+ *          point keys, such as the angles between jet constituents.
+ */
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+// Local imports
+#include "../../include/angle_sort.h"
+
+
+// =====================================
+// Angle Sorting
+// =====================================
+void AngleSorter::sort(const double* keys, size_t* indices,
+                       const size_t n) {
+    if (n <= INSERTION_SORT_MAX)
+        insertion_sort(keys, indices, n);
+    else
+        radix_sort(keys, indices, n);
+}
+
+
+void AngleSorter::insertion_sort(const double* keys, size_t* indices,
+                                 const size_t n) const {
+    for (size_t i = 1; i < n; ++i) {
+        const size_t index = indices[i];
+        const double key   = keys[index];
+
+        // Shifting larger keys up (strictly larger, for stability)
+        size_t j = i;
+        while (j > 0 and key < keys[indices[j-1]]) {
+            indices[j] = indices[j-1];
+            --j;
+        }
+        indices[j] = index;
+    }
+}
+
+
+void AngleSorter::radix_sort(const double* keys, size_t* indices,
+                             const size_t n) {
+    bits.resize(n);
+    bits_tmp.resize(n);
+    indices_tmp.resize(n);
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Leading 32 bits of the keys, and histograms of every byte
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    size_t counts[4][256] = {};
+    for (size_t i = 0; i < n; ++i) {
+        // (adding zero turns -0 into +0)
+        const double key = keys[indices[i]] + 0.0;
+        uint64_t key_bits;
+        std::memcpy(&key_bits, &key, sizeof(key_bits));
+
+        const uint32_t high_bits = key_bits >> 32;
+        bits[i] = high_bits;
+        for (int byte = 0; byte < 4; ++byte)
+            ++counts[byte][(high_bits >> (8*byte)) & 0xFF];
+    }
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // One stable counting sort per byte, least significant first
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    uint32_t* bits_in   = bits.data();
+    uint32_t* bits_out  = bits_tmp.data();
+    size_t* indices_in  = indices;
+    size_t* indices_out = indices_tmp.data();
+
+    for (int byte = 0; byte < 4; ++byte) {
+        size_t* count = counts[byte];
+
+        // Skipping bytes shared by all keys
+        // (e.g. the sign and leading exponent bits)
+        const int shift = 8*byte;
+        if (count[(bits_in[0] >> shift) & 0xFF] == n)
+            continue;
+
+        // Offsets of each bucket
+        size_t offset = 0;
+        for (int bucket = 0; bucket < 256; ++bucket) {
+            const size_t bucket_size = count[bucket];
+            count[bucket] = offset;
+            offset += bucket_size;
+        }
+
+        for (size_t i = 0; i < n; ++i) {
+            const size_t pos = count[(bits_in[i] >> shift) & 0xFF]++;
+            bits_out[pos]    = bits_in[i];
+            indices_out[pos] = indices_in[i];
+        }
+
+        std::swap(bits_in, bits_out);
+        std::swap(indices_in, indices_out);
+    }
+
+    // Results end up in the scratch buffer after an odd number of passes
+    if (indices_in != indices)
+        std::memcpy(indices, indices_in, n*sizeof(size_t));
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Ordering keys which share their leading 32 bits
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // (the input is now sorted up to a relative precision of ~1e-6,
+    //  so that insertion sort only makes a single pass)
+    insertion_sort(keys, indices, n);
+}
@@ -0,0 +1,335 @@
+/**
+ * @file    checkpoint.cc
+ *
+ * @brief   Writes and reads checkpoints of in-progress ENC runs.
+ */
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iterator>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+
+#include "Pythia8/Pythia.h"
+
+// Local imports
+#include "../../include/general_utils.h"
+#include "../../include/cmdln.h"
+#include "../../include/checkpoint.h"
+
+
+namespace {
+    const char CHECKPOINT_MAGIC[8] = "ECSCKPT";
+    const uint32_t CHECKPOINT_VERSION = 2;
+    // (read back differently on machines of the other byte order)
+    const uint32_t BYTE_ORDER_MARK = 0x01020304;
+    // Written after the correlators, to catch any mismatch in
+    // their layout
+    const uint64_t CHECKPOINT_END = 0x45434B50544E4421;
+
+    void write_string(std::ostream& stream, const std::string& str) {
+        write_binary(stream, static_cast<uint64_t>(str.size()));
+        stream.write(str.data(), str.size());
+    }
+
+    std::string read_string(std::istream& stream) {
+        uint64_t size;
+        read_binary(stream, size);
+        std::string str(size, '\0');
+        stream.read(&str[0], size);
+        if (not stream)
+            throw std::runtime_error("Unexpected end of binary data.");
+        return str;
+    }
+
+    // Opens a checkpoint, reading its header and settings
+    std::ifstream open_checkpoint(const std::string& filename,
+                                  RunCheckpoint& checkpoint) {
+        std::ifstream file(filename, std::ios::in | std::ios::binary);
+        if (not file.is_open())
+            throw std::runtime_error("read_checkpoint: Error: "
+                                     "Could not open " + filename);
+
+        char magic[8];
+        uint32_t version = 0, byte_order = 0;
+        file.read(magic, sizeof(magic));
+        if (not file or memcmp(magic, CHECKPOINT_MAGIC,
+                               sizeof(magic)) != 0)
+            throw std::runtime_error("read_checkpoint: Error: "
+                                     + filename + " is not a checkpoint.");
+        try {
+            read_binary(file, version);
+            read_binary(file, byte_order);
+            if (version != CHECKPOINT_VERSION
+                    or byte_order != BYTE_ORDER_MARK)
+                throw std::runtime_error("read_checkpoint: Error: "
+                        + filename + " was written with an incompatible "
+                        "version or machine.");
+
+            uint64_t n_arguments;
+            read_binary(file, n_arguments);
+            checkpoint.arguments.clear();
+            for (uint64_t iarg = 0; iarg < n_arguments; ++iarg)
+                checkpoint.arguments.push_back(read_string(file));
+            read_binary(file, checkpoint.events_done);
+            read_binary(file, checkpoint.njets);
+            checkpoint.rng_state = read_string(file);
+        } catch (const std::runtime_error& ex) {
+            throw std::runtime_error("read_checkpoint: Error: Could not "
+                    "read " + filename + ": " + ex.what());
+        }
+        return file;
+    }
+
+    // Set when a checkpoint is requested by a signal
+    volatile std::sig_atomic_t checkpoint_signal = 0;
+    volatile std::sig_atomic_t stop_signal = 0;
+
+    void request_checkpoint(const int signal) {
+        checkpoint_signal = 1;
+        if (signal == SIGTERM)
+            stop_signal = 1;
+    }
+}
+
+
+// =====================================
+// Checkpoints
+// =====================================
+void write_checkpoint(const std::string& filename,
+        const RunCheckpoint& checkpoint,
+        const std::function<void(std::ostream&)>& write_engines) {
+    const std::string tmp_filename = filename + ".tmp";
+    std::ofstream file(tmp_filename, std::ios::out | std::ios::binary
+                                     | std::ios::trunc);
+    if (not file.is_open())
+        throw std::runtime_error("write_checkpoint: Error: "
+                                 "Could not create " + tmp_filename);
+
+    file.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    write_binary(file, CHECKPOINT_VERSION);
+    write_binary(file, BYTE_ORDER_MARK);
+
+    write_binary(file, static_cast<uint64_t>(checkpoint.arguments.size()));
+    for (const std::string& argument : checkpoint.arguments)
+        write_string(file, argument);
+    write_binary(file, checkpoint.events_done);
+    write_binary(file, checkpoint.njets);
+    write_string(file, checkpoint.rng_state);
+
+    write_engines(file);
+    write_binary(file, CHECKPOINT_END);
+
+    file.close();
+    if (not file)
+        throw std::runtime_error("write_checkpoint: Error: "
+                                 "Failed to write " + tmp_filename);
+    if (std::rename(tmp_filename.c_str(), filename.c_str()) != 0)
+        throw std::runtime_error("write_checkpoint: Error: "
+                                 "Could not replace " + filename);
+}
+
+
+RunCheckpoint read_checkpoint(const std::string& filename) {
+    RunCheckpoint checkpoint;
+    open_checkpoint(filename, checkpoint);
+    return checkpoint;
+}
+
+
+void read_checkpoint_engines(const std::string& filename,
+        const std::function<void(std::istream&)>& read_engines) {
+    RunCheckpoint checkpoint;
+    std::ifstream file = open_checkpoint(filename, checkpoint);
+
+    uint64_t end = 0;
+    try {
+        read_engines(file);
+        read_binary(file, end);
+    } catch (const std::runtime_error& ex) {
+        throw std::runtime_error("read_checkpoint: Error: Could not "
+                "read the correlators of " + filename + ": " + ex.what());
+    }
+    if (end != CHECKPOINT_END or file.peek() != EOF)
+        throw std::runtime_error("read_checkpoint: Error: The "
+                "correlators of " + filename + " do not match the "
+                "settings of the run.");
+}
+
+
+std::vector<std::string> resumed_arguments(int argc, char* argv[],
+        const RunCheckpoint& checkpoint) {
+    for (int iarg = 1; iarg < argc; ++iarg) {
+        if (str_eq(argv[iarg], "--resume")
+                or str_eq(argv[iarg], "--verbose")) {
+            ++iarg;
+            continue;
+        }
+        throw std::invalid_argument(std::string(argv[iarg])
+                + " cannot be given when resuming from a checkpoint, "
+                + "which uses the settings of the checkpointed run.");
+    }
+    return checkpoint.arguments;
+}
+
+
+// ---------------------------------
+// Pythia
+// ---------------------------------
+std::string pythia_rng_state(Pythia8::Pythia& pythia,
+                             const std::string& scratch_file) {
+    // (muting Pythia's report of the state)
+    std::stringstream pythiastream;
+    std::streambuf *old = std::cout.rdbuf(pythiastream.rdbuf());
+    const bool dumped = pythia.rndm.dumpState(scratch_file);
+    std::cout.rdbuf(old);
+    if (not dumped)
+        throw std::runtime_error("pythia_rng_state: Error: Could not "
+                                 "write " + scratch_file);
+
+    std::ifstream file(scratch_file, std::ios::in | std::ios::binary);
+    const std::string state((std::istreambuf_iterator<char>(file)),
+                            std::istreambuf_iterator<char>());
+    file.close();
+    std::remove(scratch_file.c_str());
+    return state;
+}
+
+
+void set_pythia_rng_state(Pythia8::Pythia& pythia,
+                          const std::string& state,
+                          const std::string& scratch_file) {
+    std::ofstream file(scratch_file, std::ios::out | std::ios::binary
+                                     | std::ios::trunc);
+    file.write(state.data(), state.size());
+    file.close();
+    if (not file)
+        throw std::runtime_error("set_pythia_rng_state: Error: Could "
+                                 "not write " + scratch_file);
+
+    std::stringstream pythiastream;
+    std::streambuf *old = std::cout.rdbuf(pythiastream.rdbuf());
+    const bool restored = pythia.rndm.readState(scratch_file);
+    std::cout.rdbuf(old);
+    std::remove(scratch_file.c_str());
+    if (not restored)
+        throw std::runtime_error("set_pythia_rng_state: Error: Could "
+                                 "not restore the random number "
+                                 "generator of Pythia.");
+}
+
+
+// =====================================
+// Scheduling Checkpoints
+// =====================================
+CheckpointSchedule::CheckpointSchedule(const double interval_)
+        : interval(interval_),
+          last_checkpoint(std::chrono::steady_clock::now()) {
+    checkpoint_signal = 0;
+    stop_signal = 0;
+    std::signal(SIGUSR1, request_checkpoint);
+    std::signal(SIGTERM, request_checkpoint);
+}
+
+
+bool CheckpointSchedule::due() {
+    const auto now = std::chrono::steady_clock::now();
+    const bool interval_over = interval > 0 and
+        std::chrono::duration<double>(now - last_checkpoint).count()
+            >= interval;
+    if (not interval_over and not checkpoint_signal)
+        return false;
+
+    checkpoint_signal = 0;
+    last_checkpoint = now;
+    return true;
+}
+
+
+bool CheckpointSchedule::stop_requested() const {
+    return stop_signal;
+}
+
+
+// =====================================
+// Checkpointed Runs
+// =====================================
+RunCheckpoints::RunCheckpoints(int& argc, char**& argv,
+                               const int verbose) {
+    // Resuming an interrupted run from its last checkpoint, with the
+    // command line of that run
+    resume_file = cmdln_string("resume", argc, argv, "");
+    if (not resume_file.empty()) {
+        resumed = std::make_unique<RunCheckpoint>(
+                read_checkpoint(resume_file));
+        resumed_args = resumed_arguments(argc, argv, *resumed);
+        resumed_argv = strings_to_argv(resumed_args);
+        argc = static_cast<int>(resumed_args.size());
+        argv = resumed_argv.data();
+
+        if (verbose >= 1)
+            std::cout << "Resuming from " << resume_file
+                      << " after " << resumed->events_done
+                      << " events.\n";
+    }
+    arguments = std::vector<std::string>(argv, argv + argc);
+
+    // File to which the raw histograms and the position in the
+    // input are written every --checkpoint_interval seconds (and on
+    // SIGUSR1, or on SIGTERM, after which the run stops), so that an
+    // interrupted run can be continued with --resume <file>
+    file = cmdln_string("checkpoint_file", argc, argv, "");
+    interval = cmdln_double("checkpoint_interval", argc, argv, 600);
+}
+
+
+int RunCheckpoints::resume(const int first_event,
+        const std::function<void(std::istream&)>& read_engines,
+        Pythia8::Pythia* pythia, int& njets) const {
+    if (not resumed)
+        return first_event;
+
+    read_checkpoint_engines(resume_file, read_engines);
+    njets += static_cast<int>(resumed->njets);
+    if (pythia)
+        set_pythia_rng_state(*pythia, resumed->rng_state,
+                             resume_file + ".rndm");
+    return static_cast<int>(resumed->events_done);
+}
+
+
+void RunCheckpoints::start() {
+    if (not file.empty())
+        schedule = std::make_unique<CheckpointSchedule>(interval);
+}
+
+
+bool RunCheckpoints::write_if_due(const int events_done,
+        const int64_t njets,
+        const std::function<void(std::ostream&)>& write_engines,
+        Pythia8::Pythia* pythia) {
+    if (not schedule or not schedule->due())
+        return false;
+
+    RunCheckpoint checkpoint;
+    checkpoint.arguments   = arguments;
+    checkpoint.events_done = events_done;
+    checkpoint.njets       = njets;
+    if (pythia)
+        checkpoint.rng_state = pythia_rng_state(*pythia,
+                                                file + ".rndm");
+    write_checkpoint(file, checkpoint, write_engines);
+
+    if (not schedule->stop_requested())
+        return false;
+    std::cout << "\nStopped after " << events_done << " events; "
+              << "continue with --resume " << file << "\n";
+    return true;
+}
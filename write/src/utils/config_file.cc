@@ -0,0 +1,164 @@
+/**
+ * @file    config_file.cc
+ *
+ * @brief   Configuration files for batch runs, and the command line
+ *          options of each analysis.
+ */
+#include <string>
+#include <vector>
+#include <set>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+
+// Local imports
+#include "../../include/general_utils.h"
+#include "../../include/config_file.h"
+
+
+namespace {
+    bool is_option(const std::string& arg) {
+        return arg.rfind("--", 0) == 0;
+    }
+
+    std::string trim(const std::string& str) {
+        const size_t first = str.find_first_not_of(" \t\r");
+        if (first == std::string::npos)
+            return "";
+        const size_t last = str.find_last_not_of(" \t\r");
+        return str.substr(first, last - first + 1);
+    }
+
+    OptionList::const_iterator find_option(const OptionList& options,
+                                           const std::string& option) {
+        return std::find_if(options.begin(), options.end(),
+                [&](const auto& entry) { return entry.first == option; });
+    }
+}
+
+
+// =====================================
+// Options
+// =====================================
+OptionList command_line_options(int argc, char* argv[]) {
+    OptionList options;
+    for (int iarg = 1; iarg < argc; ++iarg) {
+        if (is_option(argv[iarg]))
+            options.emplace_back(argv[iarg], std::vector<std::string>());
+        else if (not options.empty())
+            options.back().second.emplace_back(argv[iarg]);
+    }
+    return options;
+}
+
+
+bool has_option(const OptionList& options, const std::string& option) {
+    return find_option(options, option) != options.end();
+}
+
+
+std::vector<std::string> option_values(const OptionList& options,
+                                       const std::string& option) {
+    const auto entry = find_option(options, option);
+    return entry != options.end() ? entry->second
+                                  : std::vector<std::string>();
+}
+
+
+OptionList merge_options(const OptionList& first,
+                         const OptionList& second) {
+    OptionList options = first;
+    for (const auto& entry : second)
+        if (not has_option(first, entry.first))
+            options.push_back(entry);
+    return options;
+}
+
+
+std::vector<std::string> option_arguments(const std::string& program,
+                                          const OptionList& options) {
+    std::vector<std::string> arguments{program};
+    for (const auto& [option, values] : options) {
+        arguments.push_back(option);
+        arguments.insert(arguments.end(), values.begin(), values.end());
+    }
+    return arguments;
+}
+
+
+// =====================================
+// Configuration Files
+// =====================================
+std::vector<ConfigSection> read_config_file(const std::string& filename) {
+    std::ifstream file(filename);
+    if (not file.is_open())
+        throw std::runtime_error("Could not open configuration file "
+                                 + filename + ".");
+
+    std::vector<ConfigSection> sections(1);
+    std::set<std::string> names;
+
+    std::string line;
+    int iline = 0;
+    while (std::getline(file, line)) {
+        ++iline;
+        auto error = [&](const std::string& message) {
+            return std::invalid_argument(filename + ":"
+                    + std::to_string(iline) + ": " + message);
+        };
+
+        // (ignoring comments and blank lines)
+        line = trim(line.substr(0, line.find_first_of("#;")));
+        if (line.empty())
+            continue;
+
+        // ---------------------------------
+        // Sections
+        // ---------------------------------
+        if (line.front() == '[') {
+            if (line.back() != ']')
+                throw error("Expected a section name in brackets.");
+            const std::string name = trim(line.substr(1,
+                                                      line.size() - 2));
+            if (name.empty() or name.find_first_of(" \t") !=
+                                    std::string::npos)
+                throw error("Section names cannot be empty, or "
+                            "contain spaces.");
+            if (not names.insert(name).second)
+                throw error("Section [" + name + "] is given twice.");
+            sections.push_back(ConfigSection{name, {}});
+            continue;
+        }
+
+        // ---------------------------------
+        // Options
+        // ---------------------------------
+        const size_t equals = line.find('=');
+        std::string key = trim(line.substr(0, equals));
+        if (is_option(key))
+            key = key.substr(2);
+        if (key.empty() or key.find_first_of(" \t") != std::string::npos)
+            throw error("Expected an option, optionally followed by "
+                        "'=' and its values.");
+
+        std::vector<std::string> values;
+        if (equals != std::string::npos) {
+            std::stringstream stream(line.substr(equals + 1));
+            std::string value;
+            while (stream >> value)
+                values.push_back(value);
+            if (values.empty())
+                throw error("Option " + key + " has an '=', but no "
+                            "values.");
+        }
+
+        OptionList& options = sections.back().options;
+        if (has_option(options, "--" + key))
+            throw error("Option " + key + " is given twice in the "
+                        "same section.");
+        options.emplace_back("--" + key, values);
+    }
+
+    return sections;
+}
@@ -0,0 +1,1553 @@
+/**
+ * @file    enc_analysis.cc
+ *
+ * @brief   Several "new angles on" ENCs run over the same jets: the
+ *          analyses, their shared per-jet work, the planning of their
+ *          threads, the events they read, the loops over them, and the
+ *          runs which combine all of these.
+ */
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <sstream>
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <thread>
+#include <stdexcept>
+
+#include "Pythia8/Pythia.h"
+#include "fastjet/PseudoJet.hh"
+#include "fastjet/ClusterSequence.hh"
+
+// Local imports
+#include "../../include/general_utils.h"
+#include "../../include/jet_utils.h"
+#include "../../include/cmdln.h"
+#include "../../include/pythia_cmdln.h"
+#include "../../include/synthetic_jets.h"
+#include "../../include/checkpoint.h"
+#include "../../include/enc_shard.h"
+#include "../../include/enc_analysis.h"
+
+
+namespace {
+    // Cut on jets from the CMS Jet 2011A Dataset
+    // (as in the executables for each correlator)
+    const float CMS_ETA_CUT       = 1.9;
+    const float CMS_R_JET         = 0.5;
+    const std::string CMS_JET_ALG = "akt";
+    const float CMS_PT_MIN        = 500;
+    const float CMS_PT_MAX        = 550;
+
+    // Number of jets per thread to gather before processing
+    // them in parallel (only used with more than one thread)
+    const size_t JETS_PER_THREAD  = 32;
+
+    // Number of events in each batch passed between the stages
+    // of the pipeline (only used with --pipeline true)
+    const size_t EVENTS_PER_BATCH = 16;
+
+    // Adds a jet to the histograms of a kernel without an engine,
+    // counting and timing the jet as engines do
+    template <class Histograms, class Kernel>
+    void process_kernel_jet(Histograms& hists, const size_t nparts,
+                            Kernel kernel) {
+        auto jet_start = std::chrono::high_resolution_clock::now();
+        ++hists.njets;
+
+        kernel();
+
+        const std::chrono::duration<double, std::micro> jet_duration =
+                std::chrono::high_resolution_clock::now() - jet_start;
+        hists.jet_runtimes.add(nparts, jet_duration.count());
+    }
+
+    // Finds the constituents of a jet, returning false (with a
+    // warning) if FastJet cannot find them
+    bool jet_constituents(const PseudoJet& jet,
+                          std::vector<PseudoJet>& constituents) {
+        try {
+            constituents = jet.constituents();
+        } catch (const fastjet::Error& ex) {
+            std::cerr << "Warning: FastJet: " << ex.message()
+                      << std::endl;
+            return false;
+        }
+        return true;
+    }
+}
+
+
+// =====================================
+// Analyses
+// =====================================
+const std::vector<std::string> analysis_correlators = {"2particle",
+                                                       "3particle",
+                                                       "4particle",
+                                                       "2special",
+                                                       "old_3particle",
+                                                       "jet_properties"};
+
+
+std::vector<double> weights_cmdln(const std::string& flag,
+                                  int argc, char* argv[]) {
+    std::vector<double> values;
+    for(int iarg=0; iarg<argc; ++iarg) {
+        if(str_eq(argv[iarg], ("--" + flag).c_str()))
+            while (iarg+1 < argc and
+                    // next arg doesn't start with '--'
+                   std::string(argv[iarg+1]).find("--") == std::string::npos) {
+                ++iarg;
+                values.emplace_back(atof(argv[iarg]));
+            }
+    }
+    return values;
+}
+
+
+ENCAnalysis::ENCAnalysis(const std::string& name_,
+                         const std::string& correlator_,
+                         const std::vector<std::string>& arguments_,
+                         const std::vector<double>& weights,
+                         const std::string& weights_option,
+                         const bool is_proton_collision_,
+                         const std::string& default_file_prefix)
+        : name(name_),
+          arguments(arguments_),
+          argv(strings_to_argv(arguments)),
+          is_proton_collision(is_proton_collision_),
+          correlator(correlator_),
+          order(correlator == "2particle" ? 2
+                : correlator == "4particle" ? 4
+                : correlator == "jet_properties" ? 1 : 3),
+          // (before the bins, whose range for jet properties depends
+          //  on it)
+          pt_max(cmdln_double("pt_max", argc(), argv.data(),
+                              is_proton_collision ? CMS_PT_MAX
+                              : _PTMAX_DEFAULT)),
+          binning(read_binning()) {
+    if (std::find(analysis_correlators.begin(),
+                  analysis_correlators.end(), correlator)
+            == analysis_correlators.end())
+        throw std::invalid_argument(
+            "[" + name + "]: Must be given an analysis which can be "
+            "run with others (2particle, 3particle, 4particle, "
+            "2special, old_3particle or jet_properties), rather than '"
+            + correlator + "'.");
+
+    // ---------------------------------
+    // Jets
+    // ---------------------------------
+    jet_rad = cmdln_double("jet_rad", argc(), argv.data(),
+                           is_proton_collision ? CMS_R_JET : 1000.);
+    jet_alg    = jetalgstr_cmdln(argc(), argv.data(), CMS_JET_ALG);
+    jet_recomb = jetrecomb_cmdln(argc(), argv.data());
+    n_exclusive_jets = cmdln_int("n_exclusive_jets",
+                                 argc(), argv.data(), -1);
+    pt_min  = cmdln_double("pt_min", argc(), argv.data(),
+                           is_proton_collision ? CMS_PT_MIN
+                           : _PTMIN_DEFAULT);
+    eta_cut = cmdln_double("eta_cut", argc(), argv.data(),
+                           is_proton_collision ? CMS_ETA_CUT : -1.0);
+
+    // ---------------------------------
+    // ENC settings
+    // ---------------------------------
+    // (the four-particle and two-special-particle correlators have
+    //  no contact terms yet)
+    const bool has_contact_terms = order < 4
+                                   and correlator != "2special";
+    contact_terms = cmdln_bool("contact_terms", argc(), argv.data(),
+                               has_contact_terms);
+    if (contact_terms and not has_contact_terms)
+        throw std::invalid_argument(
+            "[" + name + "]: No support for contact terms yet.");
+    use_deltaR = cmdln_bool("use_deltaR", argc(), argv.data(),
+                            is_proton_collision);
+    use_pt     = cmdln_bool("use_pt", argc(), argv.data(),
+                            is_proton_collision);
+    recursive_phi = cmdln_bool("recursive_phi", argc(), argv.data(),
+                               true);
+    sparse_hist   = cmdln_bool("sparse_hist", argc(), argv.data(),
+                               false);
+
+    // Energy weights, in groups of order-1, e.g.
+    //   1 1 2 0.5
+    // for two three-particle correlators
+    // (the old three-particle correlator has the fixed weights
+    //  (1,1,1), and jet properties have none)
+    if (correlator == "old_3particle" or correlator == "jet_properties") {
+        if (not weights.empty())
+            throw std::invalid_argument(
+                "[" + name + "]: The " + correlator + " analysis has "
+                "fixed weights, and cannot be given "
+                + weights_option + ".");
+        if (correlator == "old_3particle")
+            nus.push_back({1.0, 1.0});
+    } else {
+        const size_t group = static_cast<size_t>(order - 1);
+        if (weights.size() == 0 or weights.size() % group != 0)
+            throw std::invalid_argument(
+                "[" + name + "]: Need to give a positive number of "
+                "weights divisible by " + std::to_string(group)
+                + " with " + weights_option + ".");
+        for (size_t ival = 0; ival < weights.size(); ival += group)
+            nus.emplace_back(weights.begin() + ival,
+                             weights.begin() + ival + group);
+    }
+    // (as pairs, for the kernel of the two-special-particle
+    //  correlator)
+    if (correlator == "2special")
+        for (const auto& weights_2special : nus)
+            nu_pairs.emplace_back(weights_2special[0],
+                                  weights_2special[1]);
+
+    // ---------------------------------
+    // Output
+    // ---------------------------------
+    file_prefix = cmdln_string("file_prefix", argc(), argv.data(),
+                               default_file_prefix);
+    output_format.mathematica = cmdln_bool("mathematica",
+                                           argc(), argv.data(), false);
+    // (histograms of jet properties are always written as text)
+    output_format.npz = cmdln_bool("npz", argc(), argv.data(), false);
+    if (output_format.npz and output_format.mathematica)
+        throw std::invalid_argument(
+            "[" + name + "]: Cannot write both binary and "
+            "mathematica output.");
+    // (recording the options of the analysis in each header)
+    output_format.argc = argc();
+    output_format.argv = argv.data();
+}
+
+
+// Bins of the correlator (with the same defaults as the executable
+// for the correlator)
+ENCBinning ENCAnalysis::read_binning() {
+    // (jet properties have bins of their own, up to twice the
+    //  largest pT)
+    const bool jet_properties = correlator == "jet_properties";
+    const int nbins = cmdln_int("nbins", argc(), argv.data(),
+                                jet_properties ? 500 : 100, false);
+    const double minbin = cmdln_double("minbin", argc(), argv.data(),
+                                       jet_properties ? -2 : -8, false);
+    // (the two-particle correlator extends to larger angles
+    //  by default)
+    const double maxbin = cmdln_double("maxbin", argc(), argv.data(),
+                                       jet_properties ? log10(2*pt_max)
+                                       : order == 2 ? 1 : 0.05, false);
+    const int nphibins = cmdln_int("nphibins", argc(), argv.data(),
+                                   nbins, false);
+    const bool lin_bin2 = cmdln_bool("lin_bin2", argc(), argv.data(),
+                                     true, false);
+    const bool lin_bin3 = cmdln_bool("lin_bin3", argc(), argv.data(),
+                                     true, false);
+    // (thetaS/thetaL of the old three-particle correlator is binned
+    //  as theta2/theta1)
+    const bool lin_binS = cmdln_bool("lin_binS", argc(), argv.data(),
+                                     true, false);
+
+    if (order < 3 or correlator == "2special")
+        return ENCBinning(minbin, maxbin, nbins, 1, {});
+    if (correlator == "old_3particle")
+        return ENCBinning(minbin, maxbin, nbins, nphibins, {lin_binS});
+    if (order == 3)
+        return ENCBinning(minbin, maxbin, nbins, nphibins, {lin_bin2});
+    return ENCBinning(minbin, maxbin, nbins, nphibins,
+                      {lin_bin2, lin_bin3});
+}
+
+
+JetCuts ENCAnalysis::jet_cuts() const {
+    return JetCuts{jet_rad, n_exclusive_jets, pt_min, pt_max, eta_cut,
+                   is_proton_collision};
+}
+
+
+ENCMemoryEstimate ENCAnalysis::memory_estimate(
+        const size_t jets_per_thread) const {
+    const JetGeometry geometry = binning.geometry();
+
+    // Kernels without an engine use the per-jet storage of one
+    // (without its running products)
+    if (correlator == "2special" or correlator == "old_3particle") {
+        ENCMemoryEstimate estimate = EECEngine::memory_estimate(
+                geometry, {}, binning.phi_axis, 0, jets_per_thread);
+        const size_t nbins = binning.nbins;
+        const size_t nphibins = binning.nphibins;
+        estimate.histograms = correlator == "2special" ?
+                nus.size()*(NDHistogram<1>::allocated_bytes({nbins})
+                            + NDHistogram<2>::allocated_bytes(
+                                    {nbins, nbins}))
+                : NDHistogram<3>::allocated_bytes(
+                        {nbins, nbins, nphibins});
+        return estimate;
+    }
+    if (correlator == "jet_properties") {
+        ENCMemoryEstimate estimate;
+        estimate.histograms = JetPropertyHistograms(binning.nbins,
+                binning.minbin, binning.maxbin, eta_cut).memory_bytes();
+        estimate.jet_buffer = EECEngine::memory_estimate(geometry, {},
+                binning.phi_axis, 0, jets_per_thread).jet_buffer;
+        return estimate;
+    }
+
+    if (order == 2)
+        return EECEngine::memory_estimate(geometry, {},
+                binning.phi_axis, nus.size(), jets_per_thread);
+    if (order == 3)
+        return EEECEngine::memory_estimate(geometry,
+                binning.ratio_axes(), binning.phi_axis,
+                nus.size(), jets_per_thread);
+    if (sparse_hist)
+        return SparseEEEECEngine::memory_estimate(geometry,
+                binning.ratio_axes(), binning.phi_axis,
+                nus.size(), jets_per_thread);
+    return EEEECEngine::memory_estimate(geometry,
+            binning.ratio_axes(), binning.phi_axis,
+            nus.size(), jets_per_thread);
+}
+
+
+void ENCAnalysis::make_engines(const int n_threads,
+                               const size_t histogram_memory) {
+    auto engine_nus = [&](auto& engine_weights) {
+        for (const auto& weights : nus) {
+            engine_weights.emplace_back();
+            std::copy(weights.begin(), weights.end(),
+                      engine_weights.back().begin());
+        }
+    };
+
+    if (correlator == "2special") {
+        TwoSpecialHistograms hists;
+        for (size_t inu = 0; inu < nus.size(); ++inu) {
+            hists.hist_1.emplace_back(binning.nbins);
+            hists.hist_2.emplace_back(binning.nbins, binning.nbins);
+        }
+        two_special_hists.assign(n_threads, hists);
+    } else if (correlator == "old_3particle") {
+        Old3ParticleHistograms hists;
+        hists.hist = NDHistogram<3>(binning.nbins, binning.nbins,
+                                    binning.nphibins);
+        old_3particle_hists.assign(n_threads, hists);
+    } else if (correlator == "jet_properties") {
+        jet_property_hists.assign(n_threads,
+                JetPropertyHistograms(binning.nbins, binning.minbin,
+                                      binning.maxbin, eta_cut));
+    } else if (order == 2) {
+        std::vector<EECEngine::nus_t> weights;
+        engine_nus(weights);
+        engines_2particle.assign(n_threads,
+            EECEngine(binning.geometry(), {}, binning.phi_axis,
+                      weights, use_pt, use_deltaR, contact_terms));
+    } else if (order == 3) {
+        std::vector<EEECEngine::nus_t> weights;
+        engine_nus(weights);
+        engines_3particle.assign(n_threads,
+            EEECEngine(binning.geometry(), binning.ratio_axes(),
+                       binning.phi_axis, weights, use_pt,
+                       use_deltaR, contact_terms));
+    } else {
+        std::vector<EEEECEngine::nus_t> weights;
+        engine_nus(weights);
+        auto make_4particle_engines = [&](auto& thread_engines) {
+            typedef typename std::decay_t<decltype(thread_engines)>
+                    ::value_type Engine;
+            thread_engines.assign(n_threads,
+                    Engine(binning.geometry(), binning.ratio_axes(),
+                           binning.phi_axis, weights, use_pt,
+                           use_deltaR, false,
+                           SelectablePhi{recursive_phi}));
+        };
+        if (sparse_hist) {
+            make_4particle_engines(sparse_engines_4particle);
+            if (histogram_memory > 0)
+                for (auto& engine : sparse_engines_4particle)
+                    engine.limit_histogram_memory(histogram_memory);
+        } else {
+            make_4particle_engines(engines_4particle);
+        }
+    }
+}
+
+
+void ENCAnalysis::setup_outfiles() {
+    if (correlator == "old_3particle") {
+        outfiles.push_back(setup_old_3particle_outfile(file_prefix,
+                                                       output_format));
+        return;
+    }
+    if (correlator == "jet_properties") {
+        outfiles = setup_jet_property_outfiles(file_prefix, argc(),
+                argv.data(), output_format.mathematica);
+        return;
+    }
+    for (const auto& weights : nus)
+        outfiles.push_back(setup_enc_outfile(correlator, file_prefix,
+                                             weights, output_format));
+}
+
+
+void ENCAnalysis::process_jet(const size_t ithread,
+                              const CompactJet& jet,
+                              const JetGeometry& geometry) {
+    if (correlator == "2special") {
+        TwoSpecialHistograms& hists = two_special_hists[ithread];
+        process_kernel_jet(hists, jet.size(), [&]() {
+            two_special_jet(jet, geometry, nu_pairs,
+                            hists.hist_1, hists.hist_2, contact_terms);
+        });
+    } else if (correlator == "old_3particle") {
+        Old3ParticleHistograms& hists = old_3particle_hists[ithread];
+        process_kernel_jet(hists, jet.size(), [&]() {
+            old_3particle_jet(jet, geometry, binning.ratios[0].axis,
+                              binning.phi_axis, hists.hist,
+                              contact_terms);
+        });
+    } else if (order == 2)
+        engines_2particle[ithread].process_jet(jet, geometry);
+    else if (order == 3)
+        engines_3particle[ithread].process_jet(jet, geometry);
+    else if (sparse_hist)
+        sparse_engines_4particle[ithread].process_jet(jet, geometry);
+    else
+        engines_4particle[ithread].process_jet(jet, geometry);
+}
+
+
+void ENCAnalysis::process_jet(const size_t ithread,
+        const std::vector<PseudoJet>& constituents) {
+    // (the jet as the sum of its constituents, as are those read
+    //  from Open Data or from a jet cache)
+    jet_property_hists[ithread].fill(fastjet::join(constituents),
+                                     constituents.size());
+}
+
+
+void ENCAnalysis::write(const int verbose) {
+    auto merge_engines = [&](auto& thread_engines) {
+        auto& enc = thread_engines[0];
+        for (size_t ithread = 1; ithread < thread_engines.size();
+                ++ithread)
+            enc.merge(thread_engines[ithread]);
+        return static_cast<double>(empty_jets + enc.njets);
+    };
+
+    // Kernels without an engine
+    auto merge_kernel_hists = [&](auto& thread_hists, auto merge_hists) {
+        auto& hists = thread_hists[0];
+        for (size_t ithread = 1; ithread < thread_hists.size();
+                ++ithread) {
+            merge_hists(hists, thread_hists[ithread]);
+            hists.njets += thread_hists[ithread].njets;
+            hists.jet_runtimes.merge(thread_hists[ithread].jet_runtimes);
+        }
+        return static_cast<double>(empty_jets + hists.njets);
+    };
+
+    if (correlator == "2special") {
+        const double njets = merge_kernel_hists(two_special_hists,
+                [&](TwoSpecialHistograms& hists,
+                    const TwoSpecialHistograms& other) {
+                    for (size_t inu = 0; inu < nus.size(); ++inu) {
+                        hists.hist_1[inu] += other.hist_1[inu];
+                        hists.hist_2[inu] += other.hist_2[inu];
+                    }
+                });
+        TwoSpecialHistograms& hists = two_special_hists[0];
+        for (size_t inu = 0; inu < nus.size(); ++inu)
+            write_2special_hist(hists.hist_1[inu], hists.hist_2[inu],
+                    nus[inu], njets, binning, &hists.jet_runtimes,
+                    outfiles[inu], output_format, verbose);
+        return;
+    }
+    if (correlator == "old_3particle") {
+        const double njets = merge_kernel_hists(old_3particle_hists,
+                [](Old3ParticleHistograms& hists,
+                   const Old3ParticleHistograms& other) {
+                    hists.hist += other.hist;
+                });
+        Old3ParticleHistograms& hists = old_3particle_hists[0];
+        write_old_3particle_hist(hists.hist, njets, binning,
+                &hists.jet_runtimes, outfiles[0], output_format,
+                verbose);
+        return;
+    }
+    if (correlator == "jet_properties") {
+        // (counting only the jets with constituents, as the
+        //  jet_properties executable)
+        JetPropertyHistograms& hists = jet_property_hists[0];
+        for (size_t ithread = 1; ithread < jet_property_hists.size();
+                ++ithread)
+            hists.merge(jet_property_hists[ithread]);
+        hists.write(outfiles, output_format.mathematica);
+        return;
+    }
+
+    if (order == 2) {
+        const double njets = merge_engines(engines_2particle);
+        EECEngine& enc = engines_2particle[0];
+        for (size_t inu = 0; inu < nus.size(); ++inu)
+            write_2particle_hist(enc.hist(inu), nus[inu], njets,
+                    binning, &enc.jet_runtimes, outfiles[inu],
+                    output_format, verbose);
+        return;
+    }
+    if (order == 3) {
+        const double njets = merge_engines(engines_3particle);
+        EEECEngine& enc = engines_3particle[0];
+        for (size_t inu = 0; inu < nus.size(); ++inu)
+            write_3particle_hist(enc.hist(inu), nus[inu], njets,
+                    binning, &enc.jet_runtimes, outfiles[inu],
+                    output_format, verbose);
+        return;
+    }
+
+    auto write_4particle = [&](auto& thread_engines) {
+        const double njets = merge_engines(thread_engines);
+        auto& enc = thread_engines[0];
+        for (size_t inu = 0; inu < nus.size(); ++inu)
+            write_4particle_hist(enc.hist(inu), nus[inu], njets,
+                    binning, &enc.jet_runtimes, outfiles[inu],
+                    output_format, verbose);
+    };
+    if (sparse_hist)
+        write_4particle(sparse_engines_4particle);
+    else
+        write_4particle(engines_4particle);
+}
+
+
+void ENCAnalysis::save(std::ostream& stream) const {
+    if (order == 3)
+        save_engines(stream, engines_3particle);
+    else if (sparse_hist)
+        save_engines(stream, sparse_engines_4particle);
+    else
+        save_engines(stream, engines_4particle);
+}
+
+
+void ENCAnalysis::load(std::istream& stream) {
+    if (order == 3)
+        load_engines(stream, engines_3particle);
+    else if (sparse_hist)
+        load_engines(stream, sparse_engines_4particle);
+    else
+        load_engines(stream, engines_4particle);
+}
+
+
+long long ENCAnalysis::engine_njets() const {
+    auto count_jets = [](const auto& thread_engines) {
+        long long njets = 0;
+        for (const auto& engine : thread_engines)
+            njets += engine.njets;
+        return njets;
+    };
+    if (order == 3)
+        return count_jets(engines_3particle);
+    if (sparse_hist)
+        return count_jets(sparse_engines_4particle);
+    return count_jets(engines_4particle);
+}
+
+
+void ENCAnalysis::write_shard(const EventRange& range,
+                              const int n_events, const int verbose) {
+    ShardInfo shard = shard_info(correlator, argc(), argv.data(),
+                                 binning, nus, sparse_hist, range,
+                                 n_events);
+    shard.njets = empty_jets;
+    const std::string shard_file = shard_filename(correlator,
+                                                  file_prefix, range);
+
+    auto write_engines = [&](auto& thread_engines) {
+        auto& enc = thread_engines[0];
+        for (size_t ithread = 1; ithread < thread_engines.size();
+                ++ithread)
+            enc.merge(thread_engines[ithread]);
+        ::write_shard(shard_file, shard,
+            [&](std::ostream& stream) { enc.save(stream); });
+    };
+    if (order == 3)
+        write_engines(engines_3particle);
+    else if (sparse_hist)
+        write_engines(sparse_engines_4particle);
+    else
+        write_engines(engines_4particle);
+
+    if (verbose >= 0)
+        std::cout << "\nWrote events " << range.first << " to "
+                  << range.last << " to " << shard_file << ".\n";
+}
+
+
+// =====================================
+// Shared Per-Jet Work
+// =====================================
+void AnalysisJetFinder::find_jets(
+        const std::vector<PseudoJet>& particles,
+        const std::vector<ENCAnalysis>& all_analyses,
+        std::unique_ptr<ClusterSequence>& cluster_seq_ptr,
+        std::vector<PseudoJet>& jets,
+        std::vector<std::vector<size_t>>& jet_analyses) const {
+    const std::vector<PseudoJet> all_jets = event_jets(particles,
+            jet_def, jet_rad, pt_min, cluster_seq_ptr);
+
+    // (with the cuts of each analysis, as select_jets)
+    std::vector<JetCuts> cuts;
+    for (const size_t ianalysis : analyses)
+        cuts.push_back(all_analyses[ianalysis].jet_cuts());
+
+    for (size_t i = 0; i < all_jets.size(); ++i) {
+        std::vector<size_t> selected;
+        for (size_t icut = 0; icut < cuts.size(); ++icut)
+            if (cuts[icut].selects(all_jets[i], i))
+                selected.push_back(analyses[icut]);
+        if (selected.empty())
+            continue;
+        jets.push_back(all_jets[i]);
+        jet_analyses.push_back(std::move(selected));
+    }
+}
+
+
+std::vector<AnalysisJetFinder> analysis_jet_finders(
+        const std::vector<ENCAnalysis>& analyses) {
+    std::vector<AnalysisJetFinder> finders;
+    for (size_t ianalysis = 0; ianalysis < analyses.size(); ++ianalysis) {
+        const ENCAnalysis& analysis = analyses[ianalysis];
+
+        auto finder = std::find_if(finders.begin(), finders.end(),
+                [&](const AnalysisJetFinder& shared) {
+                    return shared.jet_alg == analysis.jet_alg
+                           and shared.jet_rad == analysis.jet_rad
+                           and shared.jet_recomb == analysis.jet_recomb;
+                });
+        if (finder == finders.end()) {
+            finders.push_back(AnalysisJetFinder{analysis.jet_alg,
+                    analysis.jet_rad, analysis.jet_recomb,
+                    analysis.pt_min,
+                    process_JetDef(analysis.jet_alg, analysis.jet_rad,
+                                   analysis.jet_recomb),
+                    {}});
+            finder = finders.end() - 1;
+        }
+        // (the loosest cut of ClusterSequence::inclusive_jets, which
+        //  keeps jets with pt^2 >= pt_min^2)
+        if (std::abs(analysis.pt_min) < std::abs(finder->pt_min))
+            finder->pt_min = analysis.pt_min;
+        finder->analyses.push_back(ianalysis);
+    }
+    return finders;
+}
+
+
+bool AnalysisJets::SharedGeometry::matches(
+        const ENCAnalysis& analysis) const {
+    return use_pt == analysis.use_pt
+           and use_deltaR == analysis.use_deltaR
+           and minbin == analysis.binning.minbin
+           and maxbin == analysis.binning.maxbin
+           and nbins == analysis.binning.nbins;
+}
+
+
+AnalysisJets::AnalysisJets(std::vector<ENCAnalysis>& analyses_)
+        : analyses(analyses_) {
+    for (ENCAnalysis& analysis : analyses) {
+        if (not analysis.uses_geometry())
+            continue;
+        const auto geometry = std::find_if(geometries.begin(),
+                geometries.end(), [&](const SharedGeometry& shared) {
+                    return shared.matches(analysis);
+                });
+        analysis.igeometry = geometry - geometries.begin();
+        if (geometry == geometries.end())
+            geometries.push_back(SharedGeometry{analysis.use_pt,
+                    analysis.use_deltaR, analysis.binning.minbin,
+                    analysis.binning.maxbin, analysis.binning.nbins,
+                    analysis.binning.geometry()});
+    }
+}
+
+
+void AnalysisJets::set_threads(const int n_threads) {
+    thread_jets.assign(n_threads, ThreadJet());
+    for (ThreadJet& thread_jet : thread_jets) {
+        for (const SharedGeometry& shared : geometries)
+            thread_jet.geometries.push_back(shared.geometry);
+        thread_jet.filled_geometries.resize(geometries.size());
+    }
+}
+
+
+void AnalysisJets::process_jet(const size_t ithread,
+        const std::vector<PseudoJet>& constituents,
+        const std::vector<size_t>& jet_analyses) {
+    ThreadJet& thread_jet = thread_jets[ithread];
+    thread_jet.filled_jets[0] = thread_jet.filled_jets[1] = false;
+    std::fill(thread_jet.filled_geometries.begin(),
+              thread_jet.filled_geometries.end(), false);
+
+    for (const size_t ianalysis : jet_analyses) {
+        ENCAnalysis& analysis = analyses[ianalysis];
+        if (not analysis.uses_geometry()) {
+            analysis.process_jet(ithread, constituents);
+            continue;
+        }
+
+        // Compact kinematics and normalized weights, then pairwise
+        // angles, and particles sorted by angle
+        CompactJet& compact_jet = thread_jet.jets[analysis.use_pt];
+        if (not thread_jet.filled_jets[analysis.use_pt]) {
+            compact_jet.fill(constituents, analysis.use_pt);
+            thread_jet.filled_jets[analysis.use_pt] = true;
+        }
+        JetGeometry& geometry = thread_jet.geometries[analysis.igeometry];
+        if (not thread_jet.filled_geometries[analysis.igeometry]) {
+            geometry.fill(compact_jet, analysis.use_deltaR);
+            thread_jet.filled_geometries[analysis.igeometry] = true;
+        }
+
+        analysis.process_jet(ithread, compact_jet, geometry);
+    }
+}
+
+
+// =====================================
+// Threads and Memory
+// =====================================
+ENCMemoryEstimate plan_analysis_threads(
+        std::vector<ENCAnalysis>& analyses, int& n_threads,
+        const size_t max_memory, const size_t jets_per_thread,
+        const int verbose) {
+    auto estimate_memory = [&]() {
+        ENCMemoryEstimate memory;
+        for (const ENCAnalysis& analysis : analyses) {
+            const ENCMemoryEstimate estimate = analysis.memory_estimate(
+                                                        jets_per_thread);
+            memory.histograms += estimate.histograms;
+            memory.scratch    += estimate.scratch;
+            memory.jet_buffer  = estimate.jet_buffer;
+            memory.histograms_grow |= estimate.histograms_grow;
+        }
+        return memory;
+    };
+    ENCMemoryEstimate memory = estimate_memory();
+
+    if (max_memory > 0 and memory.total(n_threads) > max_memory) {
+        // Using fewer threads, each with its own histograms
+        int threads_within = memory.threads_within(max_memory,
+                                                   n_threads);
+        // Storing only the filled bins of the four-particle
+        // correlators if even a single thread's dense histograms
+        // would not fit
+        const bool dense_4particle = std::any_of(analyses.begin(),
+                analyses.end(), [](const ENCAnalysis& analysis) {
+                    return analysis.order == 4 and not analysis.sparse_hist;
+                });
+        if (threads_within == 0 and dense_4particle) {
+            if (verbose >= 0)
+                std::cout << "Dense histograms need "
+                          << format_bytes(memory.total(1))
+                          << " even with a single thread, more than "
+                          << "the memory budget of "
+                          << format_bytes(max_memory)
+                          << "; using sparse histograms instead "
+                          << "(which only store the filled bins).\n";
+            for (ENCAnalysis& analysis : analyses)
+                if (analysis.order == 4)
+                    analysis.sparse_hist = true;
+            memory = estimate_memory();
+            threads_within = memory.threads_within(max_memory,
+                                                   n_threads);
+        }
+        if (threads_within == 0)
+            throw std::runtime_error(
+                    "Need " + format_bytes(memory.total(1))
+                    + " even with a single thread, more than the "
+                    + "memory budget of "
+                    + format_bytes(max_memory) + " (--max_memory).");
+
+        if (verbose >= 0 and threads_within < n_threads)
+            std::cout << "Reducing the number of threads from "
+                      << n_threads << " to " << threads_within
+                      << " to fit within the memory budget of "
+                      << format_bytes(max_memory) << ".\n";
+        n_threads = threads_within;
+    }
+
+    // Sparse histograms grow with the number of filled bins, and
+    // are kept within the budget by a single thread whose histograms
+    // may use all of the memory its scratch space leaves
+    if (max_memory > 0 and memory.histograms_grow) {
+        if (verbose >= 0 and n_threads > 1)
+            std::cout << "Using a single thread, rather than "
+                      << n_threads << ", to keep sparse histograms "
+                      << "within the memory budget of "
+                      << format_bytes(max_memory) << ".\n";
+        n_threads = 1;
+        memory.histograms = max_memory - memory.per_thread(1)
+                            + memory.histograms;
+        memory.histograms_capped = true;
+    }
+
+    if (verbose >= 0)
+        std::cout << "Estimated memory use:\n"
+                  << memory.summary(n_threads) << "\n";
+    return memory;
+}
+
+
+void make_analysis_engines(std::vector<ENCAnalysis>& analyses,
+                           const int n_threads,
+                           const ENCMemoryEstimate& memory,
+                           const size_t jets_per_thread) {
+    // Memory left over by the fixed-size histograms, shared equally
+    // by those which grow
+    size_t fixed_histograms = 0;
+    size_t ngrowing = 0;
+    for (const ENCAnalysis& analysis : analyses) {
+        const ENCMemoryEstimate estimate = analysis.memory_estimate(
+                                                    jets_per_thread);
+        if (estimate.histograms_grow)
+            ++ngrowing;
+        else
+            fixed_histograms += estimate.histograms;
+    }
+
+    for (ENCAnalysis& analysis : analyses)
+        analysis.make_engines(n_threads,
+                (memory.histograms_capped and ngrowing > 0) ?
+                (memory.histograms - fixed_histograms)/ngrowing : 0);
+}
+
+
+int max_analysis_order(const std::vector<ENCAnalysis>& analyses) {
+    int max_order = 1;
+    for (const ENCAnalysis& analysis : analyses)
+        max_order = std::max(max_order, analysis.order);
+    return max_order;
+}
+
+
+// =====================================
+// Events
+// =====================================
+std::unique_ptr<JetCacheReader> open_jet_cache(
+        std::vector<std::string>& arguments, const int verbose) {
+    std::vector<char*> argv = strings_to_argv(arguments);
+    const int argc = static_cast<int>(arguments.size());
+
+    const std::string read_cache_file = cmdln_string("read_jet_cache",
+                                                     argc, argv.data(),
+                                                     "");
+    if (read_cache_file.empty())
+        return nullptr;
+
+    auto jet_cache = std::make_unique<JetCacheReader>(read_cache_file);
+    arguments = with_cached_arguments(argc, argv.data(),
+                                      jet_cache->arguments());
+
+    if (verbose >= 1)
+        std::cout << "Reading " << jet_cache->size()
+                  << " jets from " << read_cache_file
+                  << ", written by\n\t" << jet_cache->command()
+                  << "\n";
+    return jet_cache;
+}
+
+
+std::unique_ptr<Pythia8::Pythia> new_pythia(const int verbose) {
+    // Usual output stream (std::cout)
+    std::streambuf *old = std::cout.rdbuf();
+
+    std::stringstream pythiastream; pythiastream.str("");
+    if (verbose < 3)
+        // Muting Pythia banner
+        std::cout.rdbuf(pythiastream.rdbuf());
+
+    auto pythia = std::make_unique<Pythia8::Pythia>();
+
+    std::cout.rdbuf(old);    // Restore std::cout
+    return pythia;
+}
+
+
+std::vector<std::unique_ptr<Pythia8::Pythia>> setup_thread_pythias(
+        const std::vector<int>& seeds, int argc, char* argv[],
+        const int verbose) {
+    std::cout << "Setting up " << seeds.size() << " pythia instances"
+              << std::endl;
+
+    std::vector<std::unique_ptr<Pythia8::Pythia>> pythias;
+    for (size_t ithread = 0; ithread < seeds.size(); ++ithread) {
+        // (muting all but the setup of the first instance)
+        pythias.push_back(new_pythia(ithread == 0 ? verbose : 0));
+        std::streambuf *old = std::cout.rdbuf();
+        std::stringstream pythiastream; pythiastream.str("");
+        if (ithread > 0)
+            std::cout.rdbuf(pythiastream.rdbuf());
+        setup_pythia_cmdln(*pythias.back(), argc, argv, seeds[ithread]);
+        std::cout.rdbuf(old);
+    }
+
+    if (verbose >= 1) {
+        std::cout << "Pythia seeds:";
+        for (const int seed : seeds)
+            std::cout << " " << seed;
+        std::cout << std::endl;
+    }
+    return pythias;
+}
+
+
+void mute_fastjet_banner() {
+    std::streambuf *old = std::cout.rdbuf();
+    std::stringstream fastjetstream; fastjetstream.str("");
+    std::cout.rdbuf(fastjetstream.rdbuf());
+    ClusterSequence::print_banner();
+    std::cout.rdbuf(old);  // Restore std::cout
+}
+
+
+AnalysisEvents::AnalysisEvents(
+        std::unique_ptr<JetCacheReader> jet_cache_,
+        const std::string& jet_source, int argc, char* argv[],
+        int pythia_argc, char* pythia_argv[], const bool setup_pythia,
+        const int pythia_seed, const ENCAnalysis& analysis,
+        const int verbose)
+        : jet_cache(std::move(jet_cache_)),
+          finds_jets_(jet_source == "pythia" and not jet_cache) {
+    n_events = jet_cache ? static_cast<int>(jet_cache->size())
+               : cmdln_int("n_events", argc, argv, _NEVENTS_DEFAULT);
+
+    // ---------------------------------
+    // Pythia
+    // ---------------------------------
+    if (finds_jets_ and setup_pythia) {
+        pythia = new_pythia(verbose);
+        std::cout << "Setting up pythia" << std::endl;
+        // Setting up pythia based on command line arguments
+        setup_pythia_cmdln(*pythia, pythia_argc, pythia_argv,
+                           pythia_seed);
+    }
+
+    // ---------------------------------
+    // CMS Open Data (or synthetic jets)
+    // ---------------------------------
+    // (with the cuts of the given analysis)
+    // (synthetic jets are generated from --seed, also by shards, which
+    //  skip the jets before their range)
+    if (not finds_jets_ and not jet_cache) {
+        if (jet_source == "synthetic")
+            jet_reader = std::make_unique<od::EventReader>(
+                    synthetic_jet_settings(argc, argv,
+                            cmdln_int("seed", argc, argv,
+                                      _PYTHIA_SEED_DEFAULT),
+                            analysis.pt_min, analysis.pt_max,
+                            analysis.eta_cut, analysis.jet_rad));
+        else
+            jet_reader = std::make_unique<od::EventReader>(
+                    cmdln_string("od_file", argc, argv,
+                                 od::cms_jets_file));
+    }
+}
+
+
+bool AnalysisEvents::next(std::vector<PseudoJet>& event) {
+    // Jet cache, or CMS Open Data (give the jets from the start)
+    if (not finds_jets_) {
+        PseudoJet jet;
+        if (jet_cache)
+            jet_cache->read_jet(jet);
+        else
+            jet_reader->read_jet(jet);
+        event.assign(1, std::move(jet));
+        return true;
+    }
+
+    // Considering next Pythia event, if valid
+    if (not pythia->next())
+        return false;
+    event = get_particles_pythia(pythia->event);
+    return true;
+}
+
+
+void AnalysisEvents::skip(const int n_jets) {
+    if (jet_cache)
+        jet_cache->skip_jets(n_jets);
+    else if (jet_reader)
+        jet_reader->skip_jets(n_jets);
+}
+
+
+// =====================================
+// Event Loops
+// =====================================
+int run_event_pipeline(const int n_events, const NextEvent& next_event,
+                       const FindJets& find_jets,
+                       const ProcessJet& process_jet,
+                       const PipelineSettings& settings,
+                       RunTelemetry& telemetry,
+                       JetCacheWriter* jet_cache_writer,
+                       const int verbose) {
+    int iev = 0;
+    const PipelineResult pipeline = run_jet_pipeline(
+        [&](std::vector<PseudoJet>& event) {
+            while (iev < n_events) {
+                ++iev;
+                telemetry.add_event();
+
+                // Considering next event, if valid
+                if (next_event(event))
+                    return true;
+            }
+            return false;
+        },
+        [&](const std::vector<PseudoJet>& event,
+            std::unique_ptr<ClusterSequence>& cluster_seq_ptr,
+            std::vector<PseudoJet>& jets) {
+            if (not find_jets)
+                jets.push_back(event[0]);
+            else
+                find_jets(event, cluster_seq_ptr, jets);
+        },
+        [&](const int ithread,
+            const std::vector<PseudoJet>& constituents) {
+            if (jet_cache_writer)
+                jet_cache_writer->write_jet(constituents);
+            telemetry.add_jet(constituents.size());
+            process_jet(ithread, constituents);
+        },
+        settings);
+
+    if (jet_cache_writer)
+        jet_cache_writer->write_empty_jets(pipeline.empty_jets);
+    if (verbose >= 0)
+        std::cout << pipeline.occupancy;
+    return pipeline.empty_jets;
+}
+
+
+int run_parallel_pythia(
+        std::vector<std::unique_ptr<Pythia8::Pythia>>& pythias,
+        const int n_events, const FindJets& find_jets,
+        const ProcessJet& process_jet, RunTelemetry& telemetry,
+        JetCacheWriter* jet_cache_writer) {
+    const int n_threads = static_cast<int>(pythias.size());
+    std::vector<int> empty_jets(n_threads, 0);
+
+    std::vector<std::thread> workers;
+    for (int ithread = 0; ithread < n_threads; ++ithread) {
+        workers.emplace_back([&, ithread]() {
+            Pythia8::Pythia& generator = *pythias[ithread];
+            std::vector<PseudoJet> thread_jets;
+
+            const int first_event = static_cast<int>(
+                    static_cast<long long>(n_events)*ithread
+                    / n_threads);
+            const int last_event = static_cast<int>(
+                    static_cast<long long>(n_events)*(ithread+1)
+                    / n_threads);
+            for (int iev = first_event; iev < last_event; ++iev) {
+                telemetry.add_event();
+
+                // Considering next event, if valid
+                if (not generator.next()) continue;
+
+                std::unique_ptr<ClusterSequence> cluster_seq_ptr;
+                thread_jets.clear();
+                find_jets(get_particles_pythia(generator.event),
+                          cluster_seq_ptr, thread_jets);
+
+                for (const auto& jet : thread_jets) {
+                    std::vector<PseudoJet> constituents;
+                    if (not jet_constituents(jet, constituents)) {
+                        // Still counting the jet towards the
+                        // normalization
+                        ++empty_jets[ithread];
+                        continue;
+                    }
+                    if (jet_cache_writer)
+                        jet_cache_writer->write_jet(constituents);
+                    telemetry.add_jet(constituents.size());
+                    process_jet(ithread, constituents);
+                }
+            }
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+
+    int total_empty_jets = 0;
+    for (const int nempty : empty_jets) {
+        total_empty_jets += nempty;
+        if (jet_cache_writer)
+            jet_cache_writer->write_empty_jets(nempty);
+    }
+    return total_empty_jets;
+}
+
+
+// =====================================
+// Runs
+// =====================================
+AnalysisRun::AnalysisRun(int argc, char* argv[], const int verbose_)
+        : verbose(verbose_),
+          start(std::chrono::high_resolution_clock::now()),
+          checkpoints(argc, argv, verbose) {
+    // Reading jets from a cache (see --write_jet_cache) rather
+    // than generating them: the settings which selected the cached
+    // jets (see jet_cache_options) then come from the cache
+    arguments = checkpoints.arguments;
+    jet_cache = open_jet_cache(arguments, verbose);
+    arguments_argv = strings_to_argv(arguments);
+}
+
+
+bool AnalysisRun::is_proton_collision() {
+    return cmdln_int("pid_1", argc(), argv(), _PID_1_DEFAULT) == 2212
+           and cmdln_int("pid_2", argc(), argv(), _PID_2_DEFAULT) == 2212;
+}
+
+
+int AnalysisRun::run(std::vector<ENCAnalysis>& analyses) {
+    const int argc = this->argc();
+    char** argv = this->argv();
+
+    // 50k e+ e=:=> hadrons events, by default
+    const int n_events = cmdln_int("n_events", argc, argv,
+                                   _NEVENTS_DEFAULT);
+
+    // Jets are found once for all analyses, with their shared jet
+    // definition and cuts
+    const AnalysisJetFinder jet_finder = analysis_jet_finders(
+                                                    analyses)[0];
+    std::vector<size_t> all_analyses;
+    for (size_t ianalysis = 0; ianalysis < analyses.size(); ++ianalysis)
+        all_analyses.push_back(ianalysis);
+
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Input Settings
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Source of the jets: CMS Open Data (by default), Pythia, or
+    // synthetic jets from a toy generator (--source, or
+    // --use_opendata), the latter read in the same way as Open Data
+    const std::string jet_source = jet_source_cmdln(argc, argv, true);
+    const bool use_opendata = jet_source != "pythia";
+    // Random seed for Pythia (with --parallel_pythia, the first
+    // thread uses this seed, and the others seeds derived from it)
+    const int pythia_seed = cmdln_int("seed", argc, argv,
+                                      _PYTHIA_SEED_DEFAULT);
+    // File to which the selected jets are written, so that later
+    // runs can analyze them again with --read_jet_cache
+    const std::string write_cache_file = cmdln_string("write_jet_cache",
+                                                      argc, argv, "");
+    if (jet_cache and not write_cache_file.empty())
+        throw std::invalid_argument(
+            "Cannot both read and write a jet cache.");
+
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Shard Settings
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Events (or, for Open Data and jet caches, jets) to analyze:
+    // all of them, or, with --shard i --nshards n or with
+    // --first_event and --last_event, only a range of them, whose
+    // raw histograms are written to a shard which ecscribe-merge
+    // combines with the others
+    const int n_source_events = jet_cache ?
+                                static_cast<int>(jet_cache->size())
+                                : n_events;
+    const EventRange event_range = event_range_cmdln(argc, argv,
+            n_source_events, use_opendata or jet_cache);
+    if (event_range.sharded and not write_cache_file.empty())
+        throw std::invalid_argument(
+            "Shards cannot write jet caches (--write_jet_cache).");
+    // (each shard of a Pythia run generates its own events, with a
+    //  seed derived from --seed)
+    const int run_seed = shard_pythia_seeds(pythia_seed,
+            event_range.shard, event_range.nshards, 1)[0];
+
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Parallelization Settings
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Number of threads over which jets are distributed
+    // (each thread runs all of the analyses on its jets)
+    int n_threads = cmdln_int("threads", argc, argv, 1);
+    if (n_threads < 1)
+        throw std::invalid_argument(
+            "Must be given a positive number of threads.");
+    // Whether each thread should generate and analyze its own
+    // events, with its own Pythia instance, rather than share the
+    // jets from a single stream of events
+    const bool parallel_pythia = cmdln_bool("parallel_pythia",
+                                            argc, argv, false);
+    if (parallel_pythia and (use_opendata or jet_cache))
+        throw std::invalid_argument(
+            "Parallel event generation (--parallel_pythia) "
+            "requires Pythia events (--source pythia), and no "
+            "jet cache.");
+    // Whether to run event generation (or reading), jet finding and
+    // the correlator kernels concurrently, as stages of a pipeline:
+    // the kernels then use --threads threads, jet finding uses
+    // --cluster_threads threads, and the stages are connected by
+    // queues of --queue_size batches of events
+    const bool use_pipeline = cmdln_bool("pipeline", argc, argv, false);
+    const int cluster_threads = cmdln_int("cluster_threads",
+                                          argc, argv, 1);
+    const int queue_size = cmdln_int("queue_size", argc, argv, 8);
+    if (use_pipeline and parallel_pythia)
+        throw std::invalid_argument(
+            "Cannot use both --pipeline and --parallel_pythia.");
+    if (cluster_threads < 1 or queue_size < 1)
+        throw std::invalid_argument(
+            "Must be given a positive number of jet-finding threads "
+            "(--cluster_threads) and queue size (--queue_size).");
+
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Checkpoint Settings
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // File to which the raw histograms and the position in the
+    // input are written every --checkpoint_interval seconds (see
+    // RunCheckpoints)
+    const std::string& checkpoint_file = checkpoints.file;
+    if (not checkpoint_file.empty() and (parallel_pythia or use_pipeline
+                                         or not write_cache_file.empty()))
+        throw std::invalid_argument(
+            "Checkpoints (--checkpoint_file) cannot be used with "
+            "--parallel_pythia, --pipeline or --write_jet_cache.");
+    // (both hold the raw histograms of a single correlator, which
+    //  ecscribe-merge can combine)
+    if ((event_range.sharded or not checkpoint_file.empty())
+            and not (analyses.size() == 1
+                     and analyses[0].saves_engines()))
+        throw std::invalid_argument(
+            "Only runs of a single 3particle or 4particle analysis "
+            "can write shards or checkpoints (--checkpoint_file).");
+
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Memory Settings
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Memory budget for the histograms and per-thread storage,
+    // e.g. 4G or 500M (no budget by default); the number of
+    // threads is reduced if needed to fit within the budget
+    const size_t max_memory = parse_memory_size(
+            cmdln_string("max_memory", argc, argv, "0"));
+
+    // =====================================
+    // Memory Planning
+    // =====================================
+    // (before allocating anything, or setting up event generation)
+    const ENCMemoryEstimate memory = plan_analysis_threads(analyses,
+            n_threads, max_memory, JETS_PER_THREAD, verbose);
+
+    // =====================================
+    // Output Setup
+    // =====================================
+    // Set up histogram output files, with the names used by the
+    // executables for each analysis
+    // (shards write their raw histograms only at the end)
+    if (not event_range.sharded)
+        for (ENCAnalysis& analysis : analyses)
+            analysis.setup_outfiles();
+
+
+    // =====================================
+    // Event Generation Setup
+    // =====================================
+    // Open Data, synthetic jets or the jet cache, or Pythia events
+    // (unless each thread generates its own)
+    AnalysisEvents events(std::move(jet_cache), jet_source, argc, argv,
+                          argc, argv, not parallel_pythia, run_seed,
+                          analyses[0], verbose);
+
+    // Independent Pythia instances for each thread, with
+    // distinct seeds
+    std::vector<std::unique_ptr<Pythia8::Pythia>> thread_pythias;
+    if (parallel_pythia) {
+        // (distinct from those of the threads of other shards, given
+        //  by --threads even where --max_memory allows fewer)
+        std::vector<int> seeds = shard_pythia_seeds(pythia_seed,
+                event_range.shard, event_range.nshards,
+                cmdln_int("threads", argc, argv, 1));
+        seeds.resize(n_threads);
+        thread_pythias = setup_thread_pythias(seeds, argc, argv,
+                                              verbose);
+    }
+
+    // ---------------------------------
+    // Jet cache
+    // ---------------------------------
+    std::unique_ptr<JetCacheWriter> jet_cache_writer;
+    if (not write_cache_file.empty())
+        jet_cache_writer = std::make_unique<JetCacheWriter>(
+                write_cache_file, argc, argv);
+
+    // ---------------------------------
+    // =====================================
+    // Analyzing events
+    // =====================================
+    // ---------------------------------
+
+    // Initializing the number of jets whose constituents could not
+    // be found, which count towards the normalization of every
+    // analysis
+    int empty_jets = 0;
+
+    // Initializing good_jets
+    std::vector<PseudoJet> good_jets;
+
+    // Reserving memory
+    good_jets.reserve(5);
+
+    // Histograms, jet counts, and runtimes private to each thread,
+    // for each analysis
+    make_analysis_engines(analyses, n_threads, memory, JETS_PER_THREAD);
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Per-jet work shared by all analyses
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // For each thread, the kinematics of the current jet, and its
+    // pairwise angles and sorted neighbours for each binning of
+    // theta1 (one for all analyses unless the two-particle
+    // correlator has a different maxbin)
+    AnalysisJets analysis_jets(analyses);
+    analysis_jets.set_threads(n_threads);
+
+    // Processes a single jet with each analysis
+    auto process_jet = [&](const size_t ithread,
+            const std::vector<PseudoJet>& constituents) {
+        analysis_jets.process_jet(ithread, constituents, all_analyses);
+    };
+
+    // Jets waiting to be processed by the worker threads
+    // (storing constituents rather than jets, since the
+    //  cluster sequence of each jet is deleted after its event)
+    std::vector<std::vector<PseudoJet>> jet_batch;
+    const size_t jet_batch_size = JETS_PER_THREAD*n_threads;
+    jet_batch.reserve(jet_batch_size);
+
+
+    // Processes all jets in the current batch, handing each
+    // worker thread the next unprocessed jet until none remain
+    // (or, with checkpoints, giving each jet to a fixed thread, so
+    //  that a resumed run has the same histograms as a run which
+    //  was not interrupted)
+    long long jets_processed = 0;
+    auto process_jet_batch = [&]() {
+        if (checkpoint_file.empty())
+            for_each_jet_parallel(n_threads, jet_batch, process_jet);
+        else
+            for_each_jet_interleaved(n_threads,
+                    static_cast<size_t>(jets_processed), jet_batch,
+                    process_jet);
+        jets_processed += jet_batch.size();
+        jet_batch.clear();
+    };
+
+    // Writes the engines to a checkpoint, once all jets of the
+    // events before it are processed
+    auto write_checkpoint_engines = [&](std::ostream& stream) {
+        if (not jet_batch.empty())
+            process_jet_batch();
+        analyses[0].save(stream);
+    };
+
+
+    // Clusters the particles of a Pythia event, adding the jets
+    // which pass all cuts to jets
+    // (which need cluster_seq_ptr to stay alive)
+    auto find_pythia_jets = [&](const std::vector<PseudoJet>& particles,
+            std::unique_ptr<ClusterSequence>& cluster_seq_ptr,
+            std::vector<PseudoJet>& jets) {
+        // (every jet which passes the cuts is analyzed by all of
+        //  the analyses, which share them)
+        std::vector<std::vector<size_t>> jet_analyses;
+        jet_finder.find_jets(particles, analyses, cluster_seq_ptr,
+                             jets, jet_analyses);
+    };
+
+    // (the random number generator of Pythia is checkpointed
+    //  unless the jets are read)
+    Pythia8::Pythia* checkpointed_pythia = events.generator();
+    // Starting from the first event of the range, or continuing
+    // from the checkpoint being resumed, if any
+    const int start_event = checkpoints.resume(event_range.first,
+            [&](std::istream& stream) { analyses[0].load(stream); },
+            checkpointed_pythia, empty_jets);
+    if (not checkpoint_file.empty())
+        jets_processed = analyses[0].engine_njets();
+    // (skipping the jets before the start; generated events are
+    //  instead generated from the seed of the shard, or the
+    //  checkpointed random number generator)
+    events.skip(start_event);
+
+    checkpoints.start();
+
+    // Progress and throughput of the run, reported every
+    // --progress_interval seconds (with the work of the highest-order
+    // correlator, which dominates that of the others)
+    RunTelemetry telemetry(event_range.size(),
+            telemetry_settings(argc, argv, max_analysis_order(analyses),
+                               verbose >= 0),
+            start_event - event_range.first);
+
+    mute_fastjet_banner();
+
+    // =====================================
+    // Generating events in parallel
+    // =====================================
+    // With --parallel_pythia, each thread generates, clusters and
+    // analyzes a fixed share of the events, with its own Pythia
+    // instance and engines, so that the results depend only on the
+    // seeds (and not on how the threads are scheduled)
+    if (parallel_pythia)
+        empty_jets += run_parallel_pythia(thread_pythias,
+                                          event_range.size(),
+                                          find_pythia_jets, process_jet,
+                                          telemetry,
+                                          jet_cache_writer.get());
+
+    // =====================================
+    // Pipelined event loop
+    // =====================================
+    // With --pipeline, events are generated (or read) on one
+    // thread while earlier events are clustered and analyzed
+    // (with a jet cache, or Open Data, each event is a single jet)
+    if (use_pipeline) {
+        PipelineSettings pipeline_settings;
+        pipeline_settings.jet_finders = cluster_threads;
+        pipeline_settings.kernels     = n_threads;
+        pipeline_settings.queue_size  = static_cast<size_t>(queue_size);
+        pipeline_settings.batch_size  = EVENTS_PER_BATCH;
+
+        empty_jets += run_event_pipeline(
+            event_range.last - start_event,
+            [&](std::vector<PseudoJet>& event) {
+                return events.next(event);
+            },
+            events.finds_jets() ? FindJets(find_pythia_jets) : FindJets(),
+            process_jet, pipeline_settings, telemetry,
+            jet_cache_writer.get(), verbose);
+    }
+
+    // =====================================
+    // Looping over events
+    // =====================================
+    // (unless they were all analyzed in parallel, above)
+    const int last_serial_event = (parallel_pythia or use_pipeline) ?
+                                  0 : event_range.last;
+    std::vector<PseudoJet> event;
+    for (int iev = start_event; iev < last_serial_event; ++iev) {
+        // Writing a checkpoint, if due, after the previous events
+        if (checkpoints.write_if_due(iev, empty_jets,
+                                     write_checkpoint_engines,
+                                     checkpointed_pythia))
+            return 1;
+
+        telemetry.add_event();
+
+        // -#-#-#-#-#-#-#-#-#-#-#-#-#-#-#-#-
+        // Jet finding (with cuts)
+        // -#-#-#-#-#-#-#-#-#-#-#-#-#-#-#-#-
+        good_jets.clear();
+        std::unique_ptr<ClusterSequence> cluster_seq_ptr = nullptr;
+
+        // Considering next event, if valid
+        if (not events.next(event)) continue;
+
+        if (not events.finds_jets()) {
+            // Jet cache, or CMS Open Data (give the jets from the
+            // start)
+            good_jets.emplace_back(std::move(event[0]));
+        } else {
+            // If using Pythia, find jets manually
+            find_pythia_jets(event, cluster_seq_ptr, good_jets);
+        }
+
+        // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
+        // Loop on jets
+        // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
+        for (const auto& jet : good_jets) {
+            // Storing jet constituents
+            std::vector<PseudoJet> constituents;
+            if (not jet_constituents(jet, constituents)) {
+                // Still counting the jet towards the normalization
+                ++empty_jets;
+                if (jet_cache_writer)
+                    jet_cache_writer->write_empty_jets(1);
+                continue;
+            }
+            if (jet_cache_writer)
+                jet_cache_writer->write_jet(constituents);
+            telemetry.add_jet(constituents.size());
+
+            if (n_threads == 1) {
+                // Processing the jet right away if single-threaded
+                process_jet(0, constituents);
+            } else {
+                // Otherwise, waiting for a full batch of jets
+                jet_batch.push_back(std::move(constituents));
+                if (jet_batch.size() >= jet_batch_size)
+                    process_jet_batch();
+            }
+        } // end loop on jets
+        // -*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-*-
+    } // end event loop
+
+    // Processing any remaining jets
+    if (not jet_batch.empty())
+        process_jet_batch();
+    telemetry.finish();
+
+    if (jet_cache_writer) {
+        jet_cache_writer->close();
+        if (verbose >= 0)
+            std::cout << "Wrote " << jet_cache_writer->size()
+                      << " jets to " << write_cache_file << ".\n";
+    }
+    // =====================================
+
+
+    // ===================================
+    // Merging the results of all threads,
+    // and writing histograms to output files
+    // ===================================
+    // (or, for a range of events, their raw histograms to a shard,
+    //  for ecscribe-merge)
+    for (ENCAnalysis& analysis : analyses) {
+        analysis.empty_jets = empty_jets;
+        if (event_range.sharded)
+            analysis.write_shard(event_range, n_source_events, verbose);
+        else
+            analysis.write(verbose);
+    }
+
+    // ---------------------------------
+    // =====================================
+    // Verifying successful run
+    // =====================================
+    // ---------------------------------
+    if (verbose >= 0) {
+        std::cout << "\nComplete!\n";
+        auto stop = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<
+                std::chrono::microseconds>(stop-start);
+        std::cout << "Analyzed and saved data from "
+                  << std::to_string(n_events)
+                  << " events in "
+                  << std::to_string(float(duration.count())/std::pow(10, 6))
+                  << " seconds.\n";
+        std::cout << "Peak memory use: "
+                  << format_bytes(peak_rss_bytes()) << ".\n";
+    }
+
+    return 0;
+}
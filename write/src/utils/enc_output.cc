@@ -0,0 +1,1275 @@
+/**
+ * @file    enc_output.cc
+ *
+ * @brief   Binning, normalization and output of the histograms of
+ *          the "new angles on" N-point energy correlators.
+ */
+#include <cmath>
+#include <string>
+#include <vector>
+#include <array>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+
+// Local imports
+#include "../../include/general_utils.h"
+#include "../../include/enc_utils.h"
+#include "../../include/npy_utils.h"
+#include "../../include/jet_geometry.h"
+#include "../../include/nd_histogram.h"
+#include "../../include/sparse_histogram.h"
+#include "../../include/enc_output.h"
+
+
+// =====================================
+// Binning
+// =====================================
+ENCBinning::ENCBinning(const double minbin_, const double maxbin_,
+                       const int nbins_, const int nphibins_,
+                       const std::vector<bool>& lin_ratios)
+        : minbin(minbin_), maxbin(maxbin_),
+          nbins(nbins_), nphibins(nphibins_),
+          phi_axis(-PI, PI, nphibins_, "linear", false, false) {
+    // - - - - - - - - - - - - - - -
+    // For theta1
+    // - - - - - - - - - - - - - - -
+    // (logarithmic, from 10^minbin to 10^maxbin,
+    //  with under- and overflow)
+    theta1_finite_start = 1;
+    theta1_nfinite      = nbins - 2;
+    theta1_edges   = get_bin_edges(minbin, maxbin, nbins, true, true);
+    theta1_centers = get_bin_centers(minbin, maxbin, nbins, true, true);
+
+    // - - - - - - - - - - - - - - -
+    // For theta_k/theta_{k-1}
+    // - - - - - - - - - - - - - - -
+    // (from 0 to 1, with a variable bin-spacing scheme)
+    for (const bool lin : lin_ratios) {
+        // theta_k/theta_{k-1} in (0, 1) in linear bins, or
+        // in (1e-minbin, 1) if logarithmic bins
+        const double ratio_min = lin ? 0 : minbin;
+        const double ratio_max = lin ? 1 : 0;
+        // Use underflow only if binning logarithmically
+        const bool uflow = not lin;
+
+        ratios.push_back({lin,
+                get_bin_edges(ratio_min, ratio_max, nbins, uflow, false),
+                get_bin_centers(ratio_min, ratio_max, nbins, uflow, false),
+                lin ?   0   : 1,
+                lin ? nbins : nbins-1,
+                BinAxis(ratio_min, ratio_max, nbins,
+                        lin ? "lin" : "log", uflow, false)});
+    }
+
+    // - - - - - - - - - - - - - - -
+    // For "azimuthal" angles
+    // - - - - - - - - - - - - - - -
+    // (linear, from -pi to pi)
+    phi_edges   = get_bin_edges(-PI, PI, nphibins, false, false);
+    phi_centers = get_bin_centers(-PI, PI, nphibins, false, false);
+}
+
+
+JetGeometry ENCBinning::geometry() const {
+    return JetGeometry(minbin, maxbin, nbins, true, true);
+}
+
+
+std::vector<BinAxis> ENCBinning::ratio_axes() const {
+    std::vector<BinAxis> axes;
+    for (const RatioBins& ratio : ratios)
+        axes.push_back(ratio.axis);
+    return axes;
+}
+
+
+// =====================================
+// Output Files
+// =====================================
+std::string setup_enc_outfile(const std::string& correlator,
+                              const std::string& file_prefix,
+                              const std::vector<double>& nus,
+                              const ENCOutputFormat& format) {
+    std::string filename = "output/new_encs/" + correlator + "_"
+                           + file_prefix;
+    if (nus.size() == 1) {
+        filename += "_nu" + str_round(nus[0], 2);
+    } else {
+        filename += "_nus";
+        for (const double nu : nus)
+            filename += "_" + str_round(nu, 2);
+    }
+
+    filename = periods_to_hyphens(filename);
+    filename += format.extension();
+    // writing a header with relevant information
+    // (binary files are instead written all at once, at the end)
+    if (not format.npz)
+        write_enc_header(filename, format.argc, format.argv,
+                         nus, not(format.mathematica));
+
+    return filename;
+}
+
+
+std::string setup_old_3particle_outfile(const std::string& file_prefix,
+                                        const ENCOutputFormat& format) {
+    std::string filename = "output/new_encs/old_3particle_"
+                           + file_prefix;
+
+    filename = periods_to_hyphens(filename);
+    filename += format.extension();
+    // (with the fixed weights of the correlator in the header)
+    if (not format.npz)
+        write_enc_header(filename, format.argc, format.argv,
+                         {1.0, 1.0}, not(format.mathematica));
+
+    return filename;
+}
+
+
+namespace {
+
+// ---------------------------------
+// Pieces of the output files
+// ---------------------------------
+// Opens an output file whose header was already written
+void open_enc_outfile(std::fstream& outfile,
+                      const std::string& filename) {
+    outfile.open(filename, std::ios_base::in |
+                           std::ios_base::out |
+                           std::ios_base::app);
+
+    // Checking for existence
+    if (!outfile.is_open()) {
+        std::stringstream errMsg;
+        errMsg << "File for EnC output was expected "
+               << "to be open, but was not open.\n\n"
+               << "It is possible the file was unable to "
+               << "be created at the desired location:\n\n\t"
+               << "filename = " << filename << "\n\n"
+               << "Is the filename an absolute path? If not, "
+               << "that might be the problem.";
+        throw std::runtime_error(errMsg.str().c_str());
+    }
+}
+
+
+// Prints the total and integrated weights of a histogram
+void print_enc_weights(const std::vector<double>& nus,
+                       const double total_sum,
+                       const double total_integral) {
+    std::stringstream nu;
+    if (nus.size() == 1) {
+        nu << nus[0];
+    } else {
+        nu << "(";
+        for (size_t inu = 0; inu < nus.size(); ++inu)
+            nu << nus[inu] << (inu+1 < nus.size() ? "," : ")");
+    }
+
+    std::cout << "\nTotal weight for nu=" << nu.str() << ": "
+              << total_sum;
+    std::cout << "\nIntegrated weight for nu=" << nu.str() << ": "
+              << total_integral;
+}
+
+
+// Writes the edges and centers of the bins of theta1 (or of
+// another angle with the same bins, e.g. name = "thetaL", with
+// centers_label labelling the centers in Mathematica files)
+void write_theta1_bins(std::fstream& outfile,
+                       const ENCBinning& binning,
+                       const ENCOutputFormat& format,
+                       const std::string& name = "theta1",
+                       const std::string& centers_label = "theta1s") {
+    const bool mathematica_format = format.mathematica;
+    const std::string HIST_DELIM = mathematica_format ?  " " : ", ";
+    const int nbins = binning.nbins;
+    const std::vector<double>& bin1_edges   = binning.theta1_edges;
+    const std::vector<double>& bin1_centers = binning.theta1_centers;
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:
+    // bin edges
+    // -:-:-:-:-:-:-:-:-:-:-:-:
+    if (not(mathematica_format)) outfile << name << "_edges = [\n\t";
+    else outfile << "(* " << name << "_edges *)\n";
+
+    // nbins+1 bin edges:
+    //   include -infty and infty for under/overflow
+    for (int ibin = 0; ibin < nbins; ++ibin)
+        outfile << std::pow(10, bin1_edges[ibin]) << HIST_DELIM;
+    if (std::isinf(bin1_edges[nbins]) and not(mathematica_format))
+        outfile << "np.inf\n";
+    else
+        outfile << std::pow(10, bin1_edges[nbins]) << "\n";
+
+    if (not(mathematica_format)) outfile << "]\n\n";
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:
+    // bin centers
+    // -:-:-:-:-:-:-:-:-:-:-:-:
+    if (not(mathematica_format)) outfile << name << "_centers = [\n\t";
+    else outfile << "\n(* " << centers_label << " *)\n";
+
+    for (int ibin = 0; ibin < nbins-1; ++ibin)
+        outfile << std::pow(10, bin1_centers[ibin]) << HIST_DELIM;
+    if (std::isinf(bin1_centers[nbins-1]) and not(mathematica_format))
+        outfile << "np.inf\n";
+    else
+        outfile << std::pow(10, bin1_centers[nbins-1]) << "\n";
+
+    if (not(mathematica_format)) outfile << "]\n\n";
+}
+
+
+// Writes the edges and centers of the bins of a ratio
+// theta_k/theta_{k-1}, e.g. name = "theta2_over_theta1", with
+// centers_label labelling the centers in Mathematica files
+void write_ratio_bins(std::fstream& outfile,
+                      const ENCBinning::RatioBins& ratio,
+                      const int nbins,
+                      const std::string& name,
+                      const std::string& centers_label,
+                      const ENCOutputFormat& format) {
+    const bool mathematica_format = format.mathematica;
+    const std::string HIST_DELIM = mathematica_format ?  " " : ", ";
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:
+    // bin edges
+    // -:-:-:-:-:-:-:-:-:-:-:-:
+    if (not(mathematica_format))
+        outfile << name << "_edges = [\n\t";
+    else outfile << "(* " << name << "_edges *)\n";
+
+    // nbins+1 bin edges:
+    for (int ibin = 0; ibin < nbins+1; ++ibin) {
+        double bin_edge = ratio.lin ? ratio.edges[ibin]
+                                    : std::pow(10, ratio.edges[ibin]);
+        outfile << bin_edge;
+        if (ibin < nbins)
+            outfile << HIST_DELIM;
+        else
+            outfile << std::endl;
+    }
+
+    if (not(mathematica_format)) outfile << "]\n\n";
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:
+    // bin centers
+    // -:-:-:-:-:-:-:-:-:-:-:-:
+    if (not(mathematica_format))
+        outfile << name << "_centers = [\n\t";
+    else outfile << "\n(* " << centers_label << " *)\n";
+
+    for (int ibin = 0; ibin < nbins; ++ibin) {
+        double bin_val = ratio.lin ? ratio.centers[ibin]
+                                   : std::pow(10, ratio.centers[ibin]);
+        outfile << bin_val;
+        if (ibin < nbins-1)
+            outfile << HIST_DELIM;
+        else
+            outfile << std::endl;
+    }
+    if (not(mathematica_format)) outfile << "]\n\n";
+}
+
+
+// Writes the edges and centers of the bins of an azimuthal angle,
+// e.g. name = "phi2", with centers_label labelling the centers in
+// Mathematica files
+void write_phi_bins(std::fstream& outfile,
+                    const ENCBinning& binning,
+                    const std::string& name,
+                    const std::string& centers_label,
+                    const ENCOutputFormat& format) {
+    const bool mathematica_format = format.mathematica;
+    const std::string HIST_DELIM = mathematica_format ?  " " : ", ";
+    const int nphibins = binning.nphibins;
+    const std::vector<double>& phi_edges   = binning.phi_edges;
+    const std::vector<double>& phi_centers = binning.phi_centers;
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:
+    // bin edges
+    // -:-:-:-:-:-:-:-:-:-:-:-:
+    if (not(mathematica_format)) outfile << name << "_edges = [\n\t";
+    else outfile << "(* " << name << "_edges *)\n";
+
+    // nphibins+1 bin edges:
+    for (int ibin = 0; ibin < nphibins; ++ibin)
+        outfile << phi_edges[ibin] << HIST_DELIM;
+    outfile << phi_edges[nphibins] << "\n";
+
+    if (not(mathematica_format)) outfile << "]\n\n";
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:
+    // bin centers
+    // -:-:-:-:-:-:-:-:-:-:-:-:
+    if (not(mathematica_format)) outfile << name << "_centers = [\n\t";
+    else outfile << "\n(* " << centers_label << " *)\n";
+
+    for (int ibin = 0; ibin < nphibins-1; ++ibin)
+        outfile << phi_centers[ibin] << HIST_DELIM;
+    outfile << phi_centers[nphibins-1] << "\n";
+
+    if (not(mathematica_format)) outfile << "]\n\n";
+}
+
+
+// Statistics of the runtimes per jet, by number of particles, with
+// their names in output files (and labels, for Mathematica)
+struct RuntimeColumn {
+    std::string name, label;
+    std::vector<double> values;
+};
+
+std::vector<RuntimeColumn> runtime_columns(
+        const RuntimeStatistics& jet_runtimes) {
+    return {{"runtime_means",  "mean runtimes",   jet_runtimes.means()},
+            {"runtime_stds",   "stdev runtimes",  jet_runtimes.stds()},
+            {"runtime_counts", "runtime counts",  jet_runtimes.counts()},
+            {"runtime_mins",   "min runtimes",    jet_runtimes.mins()},
+            {"runtime_maxs",   "max runtimes",    jet_runtimes.maxs()},
+            {"runtime_p50s",   "median runtimes",
+                               jet_runtimes.quantiles(0.5)},
+            {"runtime_p99s",   "99th percentile runtimes",
+                               jet_runtimes.quantiles(0.99)}};
+}
+
+
+// Writes the statistics of the runtimes per jet, by number of
+// particles
+void write_runtimes(std::fstream& outfile,
+        const RuntimeStatistics& jet_runtimes,
+        const ENCOutputFormat& format) {
+    const bool mathematica_format = format.mathematica;
+    const std::string HIST_DELIM = mathematica_format ?  " " : ", ";
+
+    bool first_column = true;
+    for (const RuntimeColumn& column : runtime_columns(jet_runtimes)) {
+        if (not(mathematica_format))
+            outfile << (first_column ? "\n\n" : "\n")
+                    << column.name << " = [\n\t";
+        else outfile << "\n(* " << column.label << " *)\n";
+        first_column = false;
+
+        for (const double value : column.values) {
+            !std::isnan(value)    ?
+                outfile << value :
+                outfile << "np.nan";
+            outfile << HIST_DELIM;
+        }
+        if (not(mathematica_format)) outfile << "]";
+    }
+}
+
+
+// Adds the statistics of the runtimes per jet to a binary file
+void add_runtimes(NpzWriter& npz, const RuntimeStatistics& jet_runtimes) {
+    for (const RuntimeColumn& column : runtime_columns(jet_runtimes))
+        npz.add(column.name, column.values);
+}
+
+
+// Adds the bins of theta1, theta_k/theta_{k-1} and phi_k to a
+// binary file (with the names used for text files)
+void add_bins(NpzWriter& npz, const ENCBinning& binning,
+              const std::vector<std::string>& ratio_names,
+              const std::vector<std::string>& phi_names) {
+    npz.add("theta1_edges", powers_of_ten(binning.theta1_edges));
+    npz.add("theta1_centers", powers_of_ten(binning.theta1_centers));
+
+    for (size_t iratio = 0; iratio < binning.ratios.size(); ++iratio) {
+        const ENCBinning::RatioBins& ratio = binning.ratios[iratio];
+        npz.add(ratio_names[iratio] + "_edges",
+                ratio.lin ? ratio.edges : powers_of_ten(ratio.edges));
+        npz.add(ratio_names[iratio] + "_centers",
+                ratio.lin ? ratio.centers
+                          : powers_of_ten(ratio.centers));
+        npz.add(phi_names[iratio] + "_edges", binning.phi_edges);
+        npz.add(phi_names[iratio] + "_centers", binning.phi_centers);
+    }
+}
+
+
+// ---------------------------------
+// Three-particle normalization
+// ---------------------------------
+// Normalizes a histogram differential in theta1, theta2/theta1 and
+// phi (or in thetaL, thetaS/thetaL and phi, for the old
+// three-particle correlator), giving its total and integrated
+// weights
+void normalize_3particle(NDHistogram<3>& enc_hist,
+                         const double njets_tot,
+                         const ENCBinning& binning,
+                         double& total_sum, double& total_integral) {
+    const int nbins    = binning.nbins;
+    const int nphibins = binning.nphibins;
+    const int bin1_finite_start = binning.theta1_finite_start;
+    const int nbins1_finite     = binning.theta1_nfinite;
+    const int bin2_finite_start = binning.ratios[0].finite_start;
+    const int nbins2_finite     = binning.ratios[0].nfinite;
+    const std::vector<double>& bin1_edges = binning.theta1_edges;
+    const std::vector<double>& bin2_edges = binning.ratios[0].edges;
+    const std::vector<double>& phi_edges  = binning.phi_edges;
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Normalizing histogram
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Currently, hist contains
+    //   hist[ibin] = N_jets * d^3 Sigma[theta1][theta2/theta1][phi]
+    // Now, changing all finite bins:
+    //   hist[ibin] -> (theta1^2 * d^3Sigma/dtheta1 dtheta2 dphi)
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    total_sum = 0.0;
+    total_integral = 0.0;
+
+    // Looping over all bins
+    for (int bin1=0; bin1<nbins; ++bin1) {
+        for (int bin2=0; bin2<nbins; ++bin2) {
+            for (int binphi=0; binphi<nphibins; ++binphi) {
+                double& value = enc_hist(bin1, bin2, binphi);
+
+                // Dealing with expectation value over N jets
+                value /= njets_tot;
+                total_sum += value;
+
+                // Not normalizing outflow bins further
+                if (bin1 < bin1_finite_start
+                        or bin1 >= nbins1_finite
+                        or bin2 < bin2_finite_start
+                        or bin2 >= nbins2_finite) {
+                    total_integral += value;
+                    continue;
+                }
+
+                // Getting differential "volume" element
+                double dlogtheta1 = (bin1_edges[bin1+1] - bin1_edges[bin1]);
+                double dtheta2_over_theta1 = (bin2_edges[bin2+1] - bin2_edges[bin2]);
+                double dphi = (phi_edges[binphi+1] - phi_edges[binphi]);
+
+                double dvol = dlogtheta1 * dtheta2_over_theta1 * dphi;
+                value /= dvol;
+                total_integral += value * dvol;
+
+                // NOTE: This is theta1^2 times the
+                // NOTE:    linearly normed distribution
+            }
+        }
+    }
+}
+
+
+// Writes a histogram in three angles as nested lists, e.g.
+//   hist[R_sp][theta1][theta1']
+void write_nested_hist(std::fstream& outfile,
+                       const NDHistogram<3>& enc_hist,
+                       const ENCOutputFormat& format) {
+    const bool mathematica_format = format.mathematica;
+    const std::string HIST_DELIM = mathematica_format ?  " " : ", ";
+    const int nbins1 = enc_hist.shape()[0];
+    const int nbins2 = enc_hist.shape()[1];
+    const int nbins3 = enc_hist.shape()[2];
+
+    if (not(mathematica_format)) outfile << "hist = [\n\t";
+    else outfile << "\n(* hist *)\n";
+
+    for (int bin1 = 0; bin1 < nbins1; ++bin1) {
+        if (not(mathematica_format)) outfile << "[\n\t";
+
+        for (int bin2 = 0; bin2 < nbins2; ++bin2) {
+            if (not(mathematica_format))
+                outfile << "\t[\n\t\t\t";
+
+            for (int bin3 = 0; bin3 < nbins3-1; ++bin3) {
+                outfile << std::setprecision(10)
+                        << enc_hist(bin1, bin2, bin3) << HIST_DELIM;
+            }
+            outfile << enc_hist(bin1, bin2, nbins3-1) << "\n";
+
+            if (not(mathematica_format))
+                outfile << (bin2 != nbins2-1 ? "\t\t],\n\t"
+                                             : "\t\t]\n");
+        }
+
+        if (not(mathematica_format))
+            outfile << (bin1 != nbins1-1 ? "\t],\n\t"
+                                         : "\t]\n");
+    }
+    if (not(mathematica_format)) outfile << "]";
+}
+
+
+// ---------------------------------
+// Four-particle normalization
+// ---------------------------------
+// Whether a bin is an under/overflow bin for any of the angles
+// (indices ordered as theta1, theta2/theta1, phi2,
+//  theta3/theta2, phi3)
+bool is_outflow_4particle(const ENCBinning& binning,
+                          const std::array<size_t, 5>& bins) {
+    const int bin1 = bins[0], bin2 = bins[1], bin3 = bins[3];
+    const ENCBinning::RatioBins& ratio2 = binning.ratios[0];
+    const ENCBinning::RatioBins& ratio3 = binning.ratios[1];
+    return (bin1 < binning.theta1_finite_start
+            or bin1 >= binning.theta1_nfinite
+            or bin2 < ratio2.finite_start
+            or bin2 >= ratio2.nfinite
+            or bin3 < ratio3.finite_start
+            or bin3 >= ratio3.nfinite);
+}
+
+// Differential "volume" element of a finite bin
+double bin_volume_4particle(const ENCBinning& binning,
+                            const std::array<size_t, 5>& bins) {
+    const int bin1 = bins[0], bin2 = bins[1], binphi2 = bins[2],
+              bin3 = bins[3], binphi3 = bins[4];
+    const std::vector<double>& bin1_edges = binning.theta1_edges;
+    const std::vector<double>& bin2_edges = binning.ratios[0].edges;
+    const std::vector<double>& bin3_edges = binning.ratios[1].edges;
+    const std::vector<double>& phi_edges  = binning.phi_edges;
+
+    double dlogtheta1 = (bin1_edges[bin1+1] - bin1_edges[bin1]);
+    double dtheta2_over_theta1 = (bin2_edges[bin2+1] - bin2_edges[bin2]);
+    double dtheta3_over_theta2 = (bin3_edges[bin3+1] - bin3_edges[bin3]);
+    double dphi2 = (phi_edges[binphi2+1] - phi_edges[binphi2]);
+    double dphi3 = (phi_edges[binphi3+1] - phi_edges[binphi3]);
+
+    return dlogtheta1 * dtheta2_over_theta1 *
+           dtheta3_over_theta2 * dphi2 * dphi3;
+}
+
+template <class Hist>
+void normalize_4particle(Hist& enc_hist, const std::vector<double>& nus,
+                         const double njets_tot,
+                         const ENCBinning& binning, const int verbose) {
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Normalizing histogram
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Currently, hist contains
+    //   hist[ibin] = N_jets * d^3 Sigma[theta1][theta2/theta1][phi]
+    // Now, changing all finite bins:
+    //   hist[ibin] -> (theta1^2 * d^3Sigma/dtheta1 dtheta2 dphi)
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+
+    // Looping over all bins
+    // (only over filled bins, for sparse histograms)
+    double total_sum = 0;
+    double total_integral = 0;
+
+    enc_hist.for_each_bin([&](const std::array<size_t, 5>& bins,
+                              double& value) {
+        // Dealing with expectation value over N jets
+        value /= njets_tot;
+        total_sum += value;
+
+        // Not normalizing outflow bins further
+        if (is_outflow_4particle(binning, bins)) {
+            total_integral += value;
+            return;
+        }
+
+        // Normalizing by the differential "volume" element
+        double dvol = bin_volume_4particle(binning, bins);
+        value /= dvol;
+        total_integral += value * dvol;
+
+        // NOTE: This is theta1^2 * theta2 times the
+        // NOTE:    actual distribution
+    });
+
+    // Printing normalization
+    if (verbose >= 0)
+        print_enc_weights(nus, total_sum, total_integral);
+}
+
+
+// Writes the bins of a four-particle histogram, which has been
+// normalized, and returns the open file
+void write_4particle_bins(std::fstream& outfile,
+                          const ENCBinning& binning,
+                          const std::string& filename,
+                          const ENCOutputFormat& format) {
+    open_enc_outfile(outfile, filename);
+
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Writing bins to files
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    write_theta1_bins(outfile, binning, format);
+    write_ratio_bins(outfile, binning.ratios[0], binning.nbins,
+                     "theta2_over_theta1", "theta2_over_theta1_centers",
+                     format);
+    write_phi_bins(outfile, binning, "phi2", "phi2s", format);
+    write_ratio_bins(outfile, binning.ratios[1], binning.nbins,
+                     "theta3_over_theta2", "theta3_over_theta2_centers",
+                     format);
+    write_phi_bins(outfile, binning, "phi3", "phi3s", format);
+}
+
+const std::vector<std::string> ratio_names_4particle =
+        {"theta2_over_theta1", "theta3_over_theta2"};
+const std::vector<std::string> phi_names_4particle = {"phi2", "phi3"};
+
+}
+
+
+// =====================================
+// Writing Histograms
+// =====================================
+// ---------------------------------
+// Two particles
+// ---------------------------------
+void write_2particle_hist(NDHistogram<1>& enc_hist,
+        const std::vector<double>& nus, const double njets_tot,
+        const ENCBinning& binning,
+        const RuntimeStatistics* jet_runtimes,
+        const std::string& filename, const ENCOutputFormat& format,
+        const int verbose) {
+    const bool mathematica_format = format.mathematica;
+    const std::string HIST_DELIM = mathematica_format ?  " " : ", ";
+    const int nbins = binning.nbins;
+    const int bins_finite_start = binning.theta1_finite_start;
+    const int nbins_finite = binning.theta1_nfinite;
+    const std::vector<double>& bin_edges = binning.theta1_edges;
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Normalizing histogram
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Currently, hist contains
+    //   hist[ibin] = N_jets * d Sigma_asymm[theta1] (integrated over [theta2/theta1][phi])
+    // Now, changing all finite bins:
+    //   hist[ibin] -> (dSigma_asymm/dtheta1)
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    double total_sum = 0.0;
+
+    // Looping over all bins
+    for (int bin=0; bin < nbins; ++bin) {
+        // Dealing with expectation value over N jets
+        enc_hist(bin) /= njets_tot;
+        total_sum += enc_hist(bin);
+
+        // Not normalizing outflow bins further
+        if (bin < bins_finite_start or bin >= nbins_finite)
+            continue;
+
+        // Otherwise, getting differential "volume" element
+        double dlogtheta1 = (bin_edges[bin+1] - bin_edges[bin]);
+        if (dlogtheta1 == 0) {
+            throw std::runtime_error("Found invalid bin "
+                                     "width dlogtheta1=0.");
+        }
+        enc_hist(bin) /= dlogtheta1;
+
+        // NOTE: This is theta1 times the
+        // NOTE:    linearly normed distribution
+    }
+
+    // Printing out weight information if verbose
+    if (verbose >= 0) {
+        float total_integral = 0;
+        // Looping over all bins
+        for (int bin=0; bin < nbins; ++bin) {
+            // Not normalizing outflow bins further
+            if (bin < bins_finite_start or bin >= nbins_finite) {
+                total_integral += enc_hist(bin);
+                continue;
+            }
+
+            // Otherwise, getting differential "volume" element
+            double dlogtheta1 = (bin_edges[bin+1] - bin_edges[bin]);
+            if (dlogtheta1 == 0) {
+                throw std::runtime_error("Found invalid bin "
+                                         "width dlogtheta1=0.");
+            }
+
+            total_integral += enc_hist(bin)*dlogtheta1;
+        }
+
+        // Printing normalization
+        print_enc_weights(nus, total_sum, total_integral);
+    }
+
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Writing binary output
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // (the same bins, histogram and runtimes as below,
+    //  as NumPy arrays in a single .npz file)
+    if (format.npz) {
+        NpzWriter npz(filename);
+        add_enc_header(npz, format.argc, format.argv, nus);
+        add_bins(npz, binning, {}, {});
+
+        npz.add("hist", enc_hist.data(), enc_hist.shape());
+
+        if (jet_runtimes)
+            add_runtimes(npz, *jet_runtimes);
+        return;
+    }
+
+    std::fstream outfile;
+    open_enc_outfile(outfile, filename);
+
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Writing bins to files
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    write_theta1_bins(outfile, binning, format);
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Writing finalized histogram
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    if (not(mathematica_format)) outfile << "hist = [\n\t";
+    else outfile << "\n(* hist *)\n";
+
+    // loop over theta1s
+    for (int bin = 0; bin < nbins; ++bin) {
+        outfile << std::setprecision(10)
+                << enc_hist[bin];
+        if (bin != nbins-1)
+            outfile << HIST_DELIM;
+        else
+            outfile << "\n";
+    }
+    if (not(mathematica_format)) outfile << "]";
+
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Writing runtimes
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    if (jet_runtimes)
+        write_runtimes(outfile, *jet_runtimes, format);
+}
+
+
+// ---------------------------------
+// Three particles
+// ---------------------------------
+void write_3particle_hist(NDHistogram<3>& enc_hist,
+        const std::vector<double>& nus, const double njets_tot,
+        const ENCBinning& binning,
+        const RuntimeStatistics* jet_runtimes,
+        const std::string& filename, const ENCOutputFormat& format,
+        const int verbose) {
+    const bool mathematica_format = format.mathematica;
+    const std::string HIST_DELIM = mathematica_format ?  " " : ", ";
+    const int nbins    = binning.nbins;
+    const int nphibins = binning.nphibins;
+
+    double total_sum, total_integral;
+    normalize_3particle(enc_hist, njets_tot, binning,
+                        total_sum, total_integral);
+    if (verbose >= 0)
+        print_enc_weights(nus, total_sum, total_integral);
+
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Writing binary output
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // (the same bins, histogram and runtimes as below,
+    //  as NumPy arrays in a single .npz file)
+    if (format.npz) {
+        NpzWriter npz(filename);
+        add_enc_header(npz, format.argc, format.argv, nus);
+        add_bins(npz, binning, {"theta2_over_theta1"}, {"phi"});
+
+        npz.add("hist", enc_hist.data(), enc_hist.shape());
+
+        if (jet_runtimes)
+            add_runtimes(npz, *jet_runtimes);
+        return;
+    }
+
+    std::fstream outfile;
+    open_enc_outfile(outfile, filename);
+
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Writing bins to files
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    write_theta1_bins(outfile, binning, format);
+    write_ratio_bins(outfile, binning.ratios[0], nbins,
+                     "theta2_over_theta1", "theta2_over_theta1s",
+                     format);
+    write_phi_bins(outfile, binning, "phi", "phis", format);
+
+    // Then getting a view of the finalized histogram
+    const auto hist = enc_hist.view();
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Writing histogram
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    if (not(mathematica_format)) outfile << "hist = [\n\t";
+    else outfile << "\n(* hist *)\n";
+
+    // theta1s
+    for (int bin1 = 0; bin1 < nbins; ++bin1) {
+        if (not(mathematica_format)) outfile << "[\n\t";
+
+        // theta2s
+        for (int bin2 = 0; bin2 < nbins; ++bin2) {
+            // Phis
+            if (nphibins == 1){
+                outfile << hist[bin1][bin2][0];
+                if (not(mathematica_format))
+                    outfile << (bin2 != nbins-1 ? HIST_DELIM
+                                                : "\n");
+            } else {
+                if (not(mathematica_format))
+                    outfile << "\t[\n\t\t\t";
+
+                // Loop over phis
+                for (int binphi = 0; binphi < nphibins-1; ++binphi) {
+                    outfile << std::setprecision(10)
+                            << hist[bin1][bin2][binphi] << HIST_DELIM;
+                }
+                outfile << hist[bin1][bin2][nphibins-1] << "\n";
+
+                if (not(mathematica_format))
+                    outfile << (bin2 != nbins-1 ? "\t\t],\n\t"
+                                                : "\t\t]\n");
+            }
+        }
+
+        if (not(mathematica_format))
+            outfile << (bin1 != nbins-1 ? "\t],\n\t"
+                                        : "\t]\n");
+    }
+    if (not(mathematica_format)) outfile << "]";
+
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Writing runtimes
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    if (jet_runtimes)
+        write_runtimes(outfile, *jet_runtimes, format);
+}
+
+
+// ---------------------------------
+// Four particles
+// ---------------------------------
+void write_4particle_hist(NDHistogram<5>& enc_hist,
+        const std::vector<double>& nus, const double njets_tot,
+        const ENCBinning& binning,
+        const RuntimeStatistics* jet_runtimes,
+        const std::string& filename, const ENCOutputFormat& format,
+        const int verbose) {
+    const bool mathematica_format = format.mathematica;
+    const std::string HIST_DELIM = mathematica_format ?  " " : ", ";
+    const int nbins    = binning.nbins;
+    const int nphibins = binning.nphibins;
+
+    normalize_4particle(enc_hist, nus, njets_tot, binning, verbose);
+
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Writing binary output
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // (the same bins, histogram and runtimes as below,
+    //  as NumPy arrays in a single .npz file)
+    if (format.npz) {
+        NpzWriter npz(filename);
+        add_enc_header(npz, format.argc, format.argv, nus);
+        add_bins(npz, binning, ratio_names_4particle,
+                 phi_names_4particle);
+
+        npz.add("hist", enc_hist.data(), enc_hist.shape());
+
+        if (jet_runtimes)
+            add_runtimes(npz, *jet_runtimes);
+        return;
+    }
+
+    std::fstream outfile;
+    write_4particle_bins(outfile, binning, filename, format);
+
+    // Then getting a view of the finalized histogram
+    const auto hist = enc_hist.view();
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Writing histogram
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    if (not(mathematica_format)) outfile << "hist = [\n\t";
+    else outfile << "\n(* hist *)\n";
+
+    // theta1s
+    for (int bin1 = 0; bin1 < nbins; ++bin1) {
+        if (not(mathematica_format)) outfile << "[\n\t";
+        // theta2s
+        for (int bin2 = 0; bin2 < nbins; ++bin2) {
+            if (not(mathematica_format))
+                outfile << "\t[\n\t\t";
+            // phi2s
+            for (int binphi2 = 0; binphi2 < nphibins; ++binphi2) {
+                if (not(mathematica_format))
+                    outfile << "\t[\n\t\t\t";
+                // theta3s
+                for (int bin3 = 0; bin3 < nbins; ++bin3) {
+                    if (not(mathematica_format))
+                        outfile << "\t[\n\t\t\t\t";
+                    // phi3s
+                    for (int binphi3 = 0; binphi3 < nphibins; ++binphi3) {
+                        outfile << std::setprecision(10)
+                                << hist[bin1][bin2][binphi2][bin3][binphi3];
+                        outfile << (binphi3 != nphibins-1 ? HIST_DELIM
+                                                          : "\n\t");
+                    }
+                    if (not(mathematica_format))
+                        outfile << (bin3 != nbins-1 ? "\t\t\t],\n\t\t\t"
+                                                    : "\t\t\t]\n\t\t");
+                }
+                if (not(mathematica_format))
+                    outfile << (binphi2 != nphibins-1 ? "\t],\n\t\t"
+                                                : "\t]\n\t");
+            }
+            if (not(mathematica_format))
+                outfile << (bin2 != nbins-1 ? "\t],\n\t"
+                                            : "\t]\n");
+        }
+        if (not(mathematica_format))
+            outfile << (bin1 != nbins-1 ? "\t],\n\t"
+                                        : "\t]\n");
+    }
+    if (not(mathematica_format)) outfile << "]";
+
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Writing runtimes
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    if (jet_runtimes)
+        write_runtimes(outfile, *jet_runtimes, format);
+}
+
+
+void write_4particle_hist(SparseHistogram<5>& hist,
+        const std::vector<double>& nus, const double njets_tot,
+        const ENCBinning& binning,
+        const RuntimeStatistics* jet_runtimes,
+        const std::string& filename, const ENCOutputFormat& format,
+        const int verbose) {
+    const bool mathematica_format = format.mathematica;
+    const std::string HIST_DELIM = mathematica_format ?  " " : ", ";
+
+    normalize_4particle(hist, nus, njets_tot, binning, verbose);
+
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Writing binary output
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // (the same bins, histogram and runtimes as below,
+    //  as NumPy arrays in a single .npz file)
+    if (format.npz) {
+        NpzWriter npz(filename);
+        add_enc_header(npz, format.argc, format.argv, nus);
+        add_bins(npz, binning, ratio_names_4particle,
+                 phi_names_4particle);
+
+        // (in coordinate format, as for text output)
+        std::vector<int64_t> hist_shape(hist.shape().begin(),
+                                        hist.shape().end());
+        std::vector<int64_t> hist_indices;
+        std::vector<double> hist_values;
+        hist.for_each_bin([&](const std::array<size_t, 5>& bins,
+                              const double value) {
+            hist_indices.insert(hist_indices.end(),
+                                bins.begin(), bins.end());
+            hist_values.push_back(value);
+        });
+        npz.add("hist_shape", hist_shape.data(), {5});
+        npz.add("hist_indices", hist_indices.data(),
+                {hist_values.size(), 5});
+        npz.add("hist_values", hist_values);
+
+        if (jet_runtimes)
+            add_runtimes(npz, *jet_runtimes);
+        return;
+    }
+
+    std::fstream outfile;
+    write_4particle_bins(outfile, binning, filename, format);
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Writing sparse histogram
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // (in coordinate format: the shape of the full histogram,
+    //  then the indices and value of each filled bin)
+    if (not(mathematica_format)) outfile << "hist_shape = [";
+    else outfile << "\n(* hist_shape *)\n";
+    for (size_t dim = 0; dim < 5; ++dim)
+        outfile << hist.shape(dim)
+                << (dim != 4 ? HIST_DELIM : "");
+    if (not(mathematica_format)) outfile << "]\n\n";
+    else outfile << "\n";
+
+    if (not(mathematica_format)) outfile << "hist_indices = [\n";
+    else outfile << "\n(* hist_indices *)\n";
+
+    std::vector<double> hist_values;
+    hist_values.reserve(hist.nnz());
+    hist.for_each_bin([&](const std::array<size_t, 5>& bins,
+                          const double value) {
+        outfile << (not(mathematica_format) ? "\t[" : "");
+        for (size_t dim = 0; dim < 5; ++dim)
+            outfile << bins[dim] << (dim != 4 ? HIST_DELIM : "");
+        outfile << (not(mathematica_format) ? "],\n" : "\n");
+        hist_values.push_back(value);
+    });
+    if (not(mathematica_format)) outfile << "]\n\n";
+
+    if (not(mathematica_format)) outfile << "hist_values = [\n\t";
+    else outfile << "\n(* hist_values *)\n";
+    outfile << std::setprecision(10);
+    for (size_t ival = 0; ival < hist_values.size(); ++ival)
+        outfile << hist_values[ival]
+                << (ival+1 != hist_values.size() ? HIST_DELIM
+                                                 : "");
+    outfile << "\n";
+    if (not(mathematica_format)) outfile << "]";
+
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Writing runtimes
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    if (jet_runtimes)
+        write_runtimes(outfile, *jet_runtimes, format);
+}
+
+
+// ---------------------------------
+// Two special particles
+// ---------------------------------
+void write_2special_hist(NDHistogram<1>& hist_1,
+        NDHistogram<2>& hist_2,
+        const std::vector<double>& nus, const double njets_tot,
+        const ENCBinning& binning,
+        const RuntimeStatistics* jet_runtimes,
+        const std::string& filename, const ENCOutputFormat& format,
+        const int verbose) {
+    const int nbins = binning.nbins;
+    const int bin1_finite_start = binning.theta1_finite_start;
+    const int nbins1_finite     = binning.theta1_nfinite;
+    const std::vector<double>& bin1_edges = binning.theta1_edges;
+    // (R_sp has the same bins as theta1 and theta1')
+    const int bin_sp_finite_start = bin1_finite_start;
+    const int nbins_sp_finite     = nbins1_finite;
+    const std::vector<double>& bin_sp_edges = bin1_edges;
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Normalizing histograms
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    double sum_1 = 0.0;
+    double sum_2 = 0.0;
+
+    // Normalizing first histogram
+    for (int bin1=0; bin1<nbins; ++bin1) {
+        // Dealing with expectation values over N jets
+        hist_1[bin1] /= njets_tot;
+        sum_1 += hist_1[bin1];
+
+        // Not normalizing outflow bins further
+        if (bin1 < bin1_finite_start or bin1 >= nbins1_finite)
+            continue;
+
+        // Otherwise, log-normalizing the histogram
+        hist_1[bin1] /= (bin1_edges[bin1+1] - bin1_edges[bin1]);
+    }
+
+    // Normalizing second histogram
+    for (int bin_sp=0; bin_sp<nbins; ++bin_sp) {
+        for (int bin1p=0; bin1p<nbins; ++bin1p) {
+            // Dealing with expectation values over N jets
+            hist_2(bin_sp, bin1p) /= njets_tot;
+            sum_2 += hist_2(bin_sp, bin1p);
+
+            // Not normalizing outflow bins further
+            if (bin_sp < bin_sp_finite_start
+                    or bin_sp >= nbins_sp_finite
+                    or bin1p < bin1_finite_start
+                    or bin1p >= nbins1_finite)
+                continue;
+
+            // Otherwise, log-normalizing the histogram
+            double dlog_sp = (bin_sp_edges[bin_sp+1]
+                              - bin_sp_edges[bin_sp]);
+            double dlog_1p = (bin1_edges[bin1p+1]
+                              - bin1_edges[bin1p]);
+            hist_2(bin_sp, bin1p) /= dlog_sp*dlog_1p;
+        }
+    }
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Taking the outer product
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    NDHistogram<3> enc_hist(nbins, nbins, nbins);
+    for (int bin_sp=0; bin_sp<nbins; ++bin_sp)
+        for (int bin1=0; bin1<nbins; ++bin1)
+            for (int bin1p=0; bin1p<nbins; ++bin1p)
+                enc_hist(bin_sp, bin1, bin1p) =
+                    hist_1[bin1] * hist_2(bin_sp, bin1p);
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Printing normalization info
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    if (verbose >= 0) {
+        double total_integral = 0.0;
+        // Looping over all bins
+        for (int bin_sp=0; bin_sp<nbins; ++bin_sp) {
+            for (int bin1=0; bin1<nbins; ++bin1) {
+                for (int bin1p=0; bin1p<nbins; ++bin1p) {
+                    if (bin_sp < bin_sp_finite_start
+                            or bin_sp >= nbins_sp_finite
+                            or bin1 < bin1_finite_start
+                            or bin1 >= nbins1_finite
+                            or bin1p < bin1_finite_start
+                            or bin1p >= nbins1_finite) {
+                        total_integral += enc_hist(bin_sp, bin1, bin1p);
+                        continue;
+                    }
+
+                    // Getting differential "volume" element
+                    double dlog_sp = (bin_sp_edges[bin_sp+1]
+                                      - bin_sp_edges[bin_sp]);
+                    double dlog_1  = (bin1_edges[bin1+1]
+                                      - bin1_edges[bin1]);
+                    double dlog_1p = (bin1_edges[bin1p+1]
+                                      - bin1_edges[bin1p]);
+
+                    double dvol = dlog_sp*dlog_1*dlog_1p;
+                    total_integral += enc_hist(bin_sp, bin1, bin1p) * dvol;
+                }
+            }
+        }
+
+        // Printing normalization
+        std::cout << "\nTotal weight for nu=("
+                  << nus[0] << "," << nus[1] << "): "
+                  << sum_1*sum_2;
+        // for sub-histograms as well
+        if (verbose >= 1) {
+            std::cout << "\n\tSub-histograms: "
+                      << sum_1 << " and " << sum_2;
+        }
+
+        // And integral
+        std::cout << "\nIntegrated weight for nu=("
+                  << nus[0] << "," << nus[1] << "): "
+                  << total_integral;
+    }
+
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Writing binary output
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    const std::vector<std::string> bin_names = {"R_sp", "theta1",
+                                                "theta1p"};
+    if (format.npz) {
+        NpzWriter npz(filename);
+        add_enc_header(npz, format.argc, format.argv, nus);
+        // (all bins have the same range)
+        for (const std::string& bin_name : bin_names) {
+            npz.add(bin_name + "_edges",
+                    powers_of_ten(binning.theta1_edges));
+            npz.add(bin_name + "_centers",
+                    powers_of_ten(binning.theta1_centers));
+        }
+
+        npz.add("hist", enc_hist.data(), enc_hist.shape());
+
+        if (jet_runtimes)
+            add_runtimes(npz, *jet_runtimes);
+        return;
+    }
+
+    std::fstream outfile;
+    open_enc_outfile(outfile, filename);
+
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Writing bins to files
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // (all bins have the same range)
+    for (const std::string& bin_name : bin_names)
+        write_theta1_bins(outfile, binning, format,
+                          bin_name, bin_name + "s");
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Writing histogram
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    write_nested_hist(outfile, enc_hist, format);
+
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Writing runtimes
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    if (jet_runtimes)
+        write_runtimes(outfile, *jet_runtimes, format);
+}
+
+
+// ---------------------------------
+// Old three particles
+// ---------------------------------
+void write_old_3particle_hist(NDHistogram<3>& enc_hist,
+        const double njets_tot,
+        const ENCBinning& binning,
+        const RuntimeStatistics* jet_runtimes,
+        const std::string& filename, const ENCOutputFormat& format,
+        const int verbose) {
+    // Currently, hist contains
+    //   hist[ibin] = N_jets * d^3 Sigma[thetaL][thetaS/thetaL][phi]
+    // Now, changing all finite bins:
+    //   hist[ibin] -> (thetaL^2 * d^3Sigma/dthetaL dthetaS dphi)
+    double total_sum, total_integral;
+    normalize_3particle(enc_hist, njets_tot, binning,
+                        total_sum, total_integral);
+
+    if (verbose >= 0) {
+        // Printing normalization
+        std::cout << "\nTotal weight for old defn, "
+                  << "weights=(1,1,1):\n\t"
+                  << total_sum;
+
+        std::cout << "\nIntegrated weight for old defn, "
+                  << "weights=(1,1,1):\n\t"
+                  << total_integral;
+    }
+
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Writing binary output
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    if (format.npz) {
+        const ENCBinning::RatioBins& ratio = binning.ratios[0];
+        NpzWriter npz(filename);
+        add_enc_header(npz, format.argc, format.argv, {1.0, 1.0});
+        npz.add("thetaL_edges", powers_of_ten(binning.theta1_edges));
+        npz.add("thetaL_centers",
+                powers_of_ten(binning.theta1_centers));
+        npz.add("thetaS_over_thetaL_edges",
+                ratio.lin ? ratio.edges : powers_of_ten(ratio.edges));
+        npz.add("thetaS_over_thetaL_centers",
+                ratio.lin ? ratio.centers
+                          : powers_of_ten(ratio.centers));
+        npz.add("phi_edges", binning.phi_edges);
+        npz.add("phi_centers", binning.phi_centers);
+
+        npz.add("hist", enc_hist.data(), enc_hist.shape());
+
+        if (jet_runtimes)
+            add_runtimes(npz, *jet_runtimes);
+        return;
+    }
+
+    std::fstream outfile;
+    open_enc_outfile(outfile, filename);
+
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Writing bins to files
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    write_theta1_bins(outfile, binning, format, "thetaL", "thetaLs");
+    write_ratio_bins(outfile, binning.ratios[0], binning.nbins,
+                     "thetaS_over_thetaL", "thetaS_over_thetaLs",
+                     format);
+    write_phi_bins(outfile, binning, "phi", "phis", format);
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Writing histogram
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    write_nested_hist(outfile, enc_hist, format);
+
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    // Writing runtimes
+    // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+    if (jet_runtimes)
+        write_runtimes(outfile, *jet_runtimes, format);
+}
@@ -0,0 +1,418 @@
+/**
+ * @file    enc_shard.cc
+ *
+ * @brief   Ranges of events, configurations, and shards of ENC runs.
+ */
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+
+// Local imports
+#include "../../include/general_utils.h"
+#include "../../include/cmdln.h"
+#include "../../include/enc_output.h"
+#include "../../include/enc_shard.h"
+
+
+namespace {
+    const char SHARD_MAGIC[8] = "ECSSHRD";
+    const uint32_t SHARD_VERSION = 2;
+    // (read back differently on machines of the other byte order)
+    const uint32_t BYTE_ORDER_MARK = 0x01020304;
+    // Written after the correlator, to catch any mismatch in its
+    // layout
+    const uint64_t SHARD_END = 0x45435348524445ff;
+
+    const std::vector<std::string> range_options = {
+        "--first_event", "--last_event", "--shard", "--nshards"};
+
+    void write_string(std::ostream& stream, const std::string& str) {
+        write_binary(stream, static_cast<uint64_t>(str.size()));
+        stream.write(str.data(), str.size());
+    }
+
+    std::string read_string(std::istream& stream) {
+        uint64_t size;
+        read_binary(stream, size);
+        std::string str(size, '\0');
+        stream.read(&str[0], size);
+        if (not stream)
+            throw std::runtime_error("Unexpected end of binary data.");
+        return str;
+    }
+
+    bool is_option(const std::string& arg) {
+        return arg.rfind("--", 0) == 0;
+    }
+
+    // Opens a shard, reading its header and settings
+    std::ifstream open_shard(const std::string& filename,
+                             ShardInfo& info) {
+        std::ifstream file(filename, std::ios::in | std::ios::binary);
+        if (not file.is_open())
+            throw std::runtime_error("read_shard: Error: "
+                                     "Could not open " + filename);
+
+        char magic[8];
+        uint32_t version = 0, byte_order = 0;
+        file.read(magic, sizeof(magic));
+        if (not file or memcmp(magic, SHARD_MAGIC, sizeof(magic)) != 0)
+            throw std::runtime_error("read_shard: Error: "
+                                     + filename + " is not a shard.");
+        try {
+            read_binary(file, version);
+            read_binary(file, byte_order);
+            if (version != SHARD_VERSION or byte_order != BYTE_ORDER_MARK)
+                throw std::runtime_error("read_shard: Error: "
+                        + filename + " was written with an incompatible "
+                        "version or machine.");
+
+            info.correlator = read_string(file);
+            uint64_t n_arguments;
+            read_binary(file, n_arguments);
+            info.arguments.clear();
+            for (uint64_t iarg = 0; iarg < n_arguments; ++iarg)
+                info.arguments.push_back(read_string(file));
+            info.configuration = read_string(file);
+            read_binary(file, info.hash);
+
+            read_binary(file, info.minbin);
+            read_binary(file, info.maxbin);
+            read_binary(file, info.nbins);
+            read_binary(file, info.nphibins);
+            uint64_t n_ratios;
+            read_binary(file, n_ratios);
+            info.lin_ratios.clear();
+            for (uint64_t iratio = 0; iratio < n_ratios; ++iratio) {
+                uint8_t lin;
+                read_binary(file, lin);
+                info.lin_ratios.push_back(lin != 0);
+            }
+            uint64_t n_nus, nus_size;
+            read_binary(file, n_nus);
+            read_binary(file, nus_size);
+            info.nus.assign(n_nus, std::vector<double>(nus_size));
+            for (std::vector<double>& nus : info.nus)
+                for (double& nu : nus)
+                    read_binary(file, nu);
+            uint8_t sparse;
+            read_binary(file, sparse);
+            info.sparse = sparse != 0;
+
+            read_binary(file, info.first_event);
+            read_binary(file, info.last_event);
+            read_binary(file, info.n_events);
+            read_binary(file, info.njets);
+        } catch (const std::runtime_error& ex) {
+            throw std::runtime_error("read_shard: Error: Could not "
+                    "read " + filename + ": " + ex.what());
+        }
+        return file;
+    }
+}
+
+
+// =====================================
+// Event Ranges
+// =====================================
+EventRange event_range_cmdln(int argc, char* argv[], const int n_events,
+                             const bool reading_jets) {
+    const int shard      = cmdln_int("shard", argc, argv, -1);
+    const int nshards    = cmdln_int("nshards", argc, argv, 0);
+    const int first      = cmdln_int("first_event", argc, argv, -1);
+    const int last       = cmdln_int("last_event", argc, argv, -1);
+
+    EventRange range;
+    range.last = n_events;
+
+    const bool by_shard = shard >= 0 or nshards > 0;
+    const bool by_event = first >= 0 or last >= 0;
+    if (by_shard and by_event)
+        throw std::invalid_argument("Cannot give both --shard/--nshards "
+                "and --first_event/--last_event.");
+
+    if (by_shard) {
+        if (nshards < 1 or shard < 0 or shard >= nshards)
+            throw std::invalid_argument("Must be given a shard index "
+                    "(--shard) from 0 to one less than the number of "
+                    "shards (--nshards).");
+        range.first = static_cast<int>(
+                static_cast<long long>(n_events)*shard / nshards);
+        range.last  = static_cast<int>(
+                static_cast<long long>(n_events)*(shard+1) / nshards);
+        range.shard   = shard;
+        range.nshards = nshards;
+        range.sharded = true;
+    } else if (by_event) {
+        if (not reading_jets)
+            throw std::invalid_argument("Generated events cannot be "
+                    "skipped: split Pythia runs with --shard and "
+                    "--nshards, which give each shard its own seed.");
+        range.first = std::max(first, 0);
+        range.last  = last >= 0 ? std::min(last, n_events) : n_events;
+        if (range.first >= range.last)
+            throw std::invalid_argument("Must be given a non-empty "
+                    "range of events (--first_event to --last_event) "
+                    "within the " + std::to_string(n_events)
+                    + " of the run.");
+        range.sharded = true;
+    }
+
+    return range;
+}
+
+
+// =====================================
+// Configurations
+// =====================================
+const std::vector<std::string> configuration_independent_options = {
+    // Output
+    "--file_prefix", "--verbose", "--npz", "--mathematica",
+    "--progress_interval", "--status_file",
+    // Ranges of events
+    "--first_event", "--last_event", "--shard", "--nshards",
+    // Parallelization and memory
+    "--threads", "--max_memory", "--pipeline", "--cluster_threads",
+    "--queue_size",
+    // Checkpoints and jet caches
+    "--checkpoint_file", "--checkpoint_interval", "--resume",
+    "--write_jet_cache", "--read_jet_cache"};
+
+
+std::string run_configuration(int argc, char* argv[]) {
+    // (with --parallel_pythia, each thread generates its own events,
+    //  so that the events of the run depend on the number of threads)
+    const bool parallel_pythia = cmdln_bool("parallel_pythia", argc, argv,
+                                            false);
+
+    // (sorted by option, keeping the order of repeated options)
+    std::multimap<std::string, std::string> options;
+    for (int iarg = 1; iarg < argc; ++iarg) {
+        const std::string option = argv[iarg];
+        if (not is_option(option))
+            continue;
+
+        std::string values;
+        while (iarg+1 < argc and not is_option(argv[iarg+1]))
+            values += std::string(" ") + argv[++iarg];
+
+        if (std::find(configuration_independent_options.begin(),
+                      configuration_independent_options.end(), option)
+                    == configuration_independent_options.end()
+                or (parallel_pythia and option == "--threads"))
+            options.emplace(option, values);
+    }
+
+    std::string configuration;
+    for (const auto& [option, values] : options)
+        configuration += option + values + "\n";
+    return configuration;
+}
+
+
+uint64_t configuration_hash(const std::string& configuration) {
+    uint64_t hash = 0xcbf29ce484222325;
+    for (const char c : configuration) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+
+std::vector<std::string> unsharded_arguments(
+        const std::vector<std::string>& arguments) {
+    std::vector<std::string> unsharded;
+    for (size_t iarg = 0; iarg < arguments.size(); ++iarg) {
+        if (std::find(range_options.begin(), range_options.end(),
+                      arguments[iarg]) == range_options.end()) {
+            unsharded.push_back(arguments[iarg]);
+            continue;
+        }
+        while (iarg+1 < arguments.size()
+                and not is_option(arguments[iarg+1]))
+            ++iarg;
+    }
+    return unsharded;
+}
+
+
+// =====================================
+// Shards
+// =====================================
+std::string shard_filename(const std::string& correlator,
+                           const std::string& file_prefix,
+                           const EventRange& range) {
+    return "output/new_encs/" + correlator + "_" + file_prefix
+           + "_events_" + std::to_string(range.first) + "_"
+           + std::to_string(range.last) + ".shard";
+}
+
+
+ENCBinning ShardInfo::binning() const {
+    return ENCBinning(minbin, maxbin, static_cast<int>(nbins),
+                      static_cast<int>(nphibins), lin_ratios);
+}
+
+
+ShardInfo shard_info(const std::string& correlator,
+                     int argc, char* argv[],
+                     const ENCBinning& binning,
+                     const std::vector<std::vector<double>>& nus,
+                     const bool sparse,
+                     const EventRange& range, const int n_events) {
+    ShardInfo info;
+    info.correlator    = correlator;
+    info.arguments     = std::vector<std::string>(argv, argv + argc);
+    info.configuration = run_configuration(argc, argv);
+    info.hash          = configuration_hash(correlator + "\n"
+                                            + info.configuration);
+
+    info.minbin   = binning.minbin;
+    info.maxbin   = binning.maxbin;
+    info.nbins    = binning.nbins;
+    info.nphibins = binning.nphibins;
+    for (const ENCBinning::RatioBins& ratio : binning.ratios)
+        info.lin_ratios.push_back(ratio.lin);
+    info.nus    = nus;
+    info.sparse = sparse;
+
+    info.first_event = range.first;
+    info.last_event  = range.last;
+    info.n_events    = n_events;
+    return info;
+}
+
+
+void write_shard(const std::string& filename, const ShardInfo& info,
+        const std::function<void(std::ostream&)>& write_engine) {
+    std::ofstream file(filename, std::ios::out | std::ios::binary
+                                 | std::ios::trunc);
+    if (not file.is_open())
+        throw std::runtime_error("write_shard: Error: "
+                                 "Could not create " + filename);
+
+    file.write(SHARD_MAGIC, sizeof(SHARD_MAGIC));
+    write_binary(file, SHARD_VERSION);
+    write_binary(file, BYTE_ORDER_MARK);
+
+    write_string(file, info.correlator);
+    write_binary(file, static_cast<uint64_t>(info.arguments.size()));
+    for (const std::string& argument : info.arguments)
+        write_string(file, argument);
+    write_string(file, info.configuration);
+    write_binary(file, info.hash);
+
+    write_binary(file, info.minbin);
+    write_binary(file, info.maxbin);
+    write_binary(file, info.nbins);
+    write_binary(file, info.nphibins);
+    write_binary(file, static_cast<uint64_t>(info.lin_ratios.size()));
+    for (const bool lin : info.lin_ratios)
+        write_binary(file, static_cast<uint8_t>(lin));
+    write_binary(file, static_cast<uint64_t>(info.nus.size()));
+    write_binary(file, static_cast<uint64_t>(
+            info.nus.empty() ? 0 : info.nus[0].size()));
+    for (const std::vector<double>& nus : info.nus)
+        for (const double nu : nus)
+            write_binary(file, nu);
+    write_binary(file, static_cast<uint8_t>(info.sparse));
+
+    write_binary(file, info.first_event);
+    write_binary(file, info.last_event);
+    write_binary(file, info.n_events);
+    write_binary(file, info.njets);
+
+    write_engine(file);
+    write_binary(file, SHARD_END);
+
+    file.close();
+    if (not file)
+        throw std::runtime_error("write_shard: Error: "
+                                 "Failed to write " + filename);
+}
+
+
+ShardInfo read_shard(const std::string& filename) {
+    ShardInfo info;
+    open_shard(filename, info);
+    return info;
+}
+
+
+void read_shard_engine(const std::string& filename,
+        const std::function<void(std::istream&)>& read_engine) {
+    ShardInfo info;
+    std::ifstream file = open_shard(filename, info);
+
+    uint64_t end = 0;
+    try {
+        read_engine(file);
+        read_binary(file, end);
+    } catch (const std::runtime_error& ex) {
+        throw std::runtime_error("read_shard: Error: Could not "
+                "read the correlator of " + filename + ": " + ex.what());
+    }
+    if (end != SHARD_END or file.peek() != EOF)
+        throw std::runtime_error("read_shard: Error: The correlator "
+                "of " + filename + " does not match its settings.");
+}
+
+
+void check_compatible_shards(const std::vector<ShardInfo>& shards,
+                             const std::vector<std::string>& filenames) {
+    if (shards.empty())
+        throw std::invalid_argument("Must be given at least one shard.");
+
+    const ShardInfo& first = shards[0];
+    for (size_t ishard = 1; ishard < shards.size(); ++ishard) {
+        const ShardInfo& shard = shards[ishard];
+        const std::string mismatch = filenames[ishard]
+                + " cannot be combined with " + filenames[0] + ": ";
+
+        if (shard.correlator != first.correlator)
+            throw std::invalid_argument(mismatch + "they are shards of "
+                    "different correlators.");
+        if (shard.hash != first.hash
+                or shard.configuration != first.configuration)
+            throw std::invalid_argument(mismatch + "they were run with "
+                    "different options.");
+        if (shard.minbin != first.minbin or shard.maxbin != first.maxbin
+                or shard.nbins != first.nbins
+                or shard.nphibins != first.nphibins
+                or shard.lin_ratios != first.lin_ratios
+                or shard.sparse != first.sparse)
+            throw std::invalid_argument(mismatch + "they have different "
+                    "binnings.");
+        if (shard.nus != first.nus)
+            throw std::invalid_argument(mismatch + "they have different "
+                    "energy weights.");
+        if (shard.n_events != first.n_events)
+            throw std::invalid_argument(mismatch + "they are shards of "
+                    "runs with different numbers of events.");
+    }
+
+    // Ensuring no event is counted twice
+    std::vector<size_t> order(shards.size());
+    for (size_t ishard = 0; ishard < shards.size(); ++ishard)
+        order[ishard] = ishard;
+    std::sort(order.begin(), order.end(),
+              [&](const size_t a, const size_t b) {
+                  return shards[a].first_event < shards[b].first_event;
+              });
+    for (size_t iorder = 1; iorder < order.size(); ++iorder) {
+        const ShardInfo& previous = shards[order[iorder-1]];
+        const ShardInfo& shard = shards[order[iorder]];
+        if (shard.first_event < previous.last_event)
+            throw std::invalid_argument(filenames[order[iorder]]
+                    + " and " + filenames[order[iorder-1]]
+                    + " have overlapping ranges of events.");
+    }
+}
@@ -10,13 +10,63 @@
 #include <string.h>
 #include <iostream>
 
+#include "../../include/general_utils.h"
 #include "../../include/cmdln.h"
 #include "../../include/pythia_cmdln.h"
+#include "../../include/npy_utils.h"
 #include "../../include/enc_utils.h"
 
 
 const std::string enc_banner = "";
 
+
+namespace {
+
+/**
+* @brief: Event generation and jet settings recorded in the
+*         header of each output file, from the command line.
+*/
+struct EncHeaderInfo {
+    // Event generation settings
+    int         n_events;
+    std::string level;
+    double      E_cm;
+    int         pid_1, pid_2;
+    std::string outstate_str;
+    bool        use_opendata;
+
+    // Jet settings
+    double      jet_rad;
+    std::string jet_alg;
+    std::string jet_scheme;
+
+    EncHeaderInfo(int argc, char* argv[]) {
+        n_events      = cmdln_int("n_events", argc, argv,
+                                  _NEVENTS_DEFAULT);
+        level         = cmdln_string("level", argc, argv,
+                                     _LEVEL_DEFAULT);
+        E_cm          = cmdln_double("energy", argc, argv,
+                                     _ENERGY_DEFAULT);
+        pid_1         = cmdln_int("pid_1", argc, argv,
+                                  _PID_1_DEFAULT);
+        pid_2         = cmdln_int("pid_2", argc, argv,
+                                  _PID_2_DEFAULT);
+        outstate_str  = cmdln_string("outstate", argc, argv,
+                                     _OUTSTATE_DEFAULT);
+
+        use_opendata  = cmdln_bool("use_opendata", argc, argv,
+                                   true);
+        if (use_opendata) level = "data";
+
+        jet_rad       = cmdln_double("jet_rad", argc, argv,
+                                     1000.);
+        jet_alg       = jetalgstr_cmdln(argc, argv);
+        jet_scheme    = scheme_string[jetrecomb_cmdln(argc, argv)];
+    }
+};
+
+}
+
 /**
 * @brief: Writes a header containing information used in event
 *         generation in Pythia using given command line args.
@@ -39,29 +89,17 @@ void write_enc_header(std::string filename,
     // ---------------------------------
     // Getting command line variables
     // ---------------------------------
-    // Event generation settings
-    int         n_events      = cmdln_int("n_events", argc, argv,
-                                          _NEVENTS_DEFAULT);
-    std::string level         = cmdln_string("level", argc, argv,
-                                             _LEVEL_DEFAULT);
-    double      E_cm          = cmdln_double("energy", argc, argv,
-                                             _ENERGY_DEFAULT);
-    int         pid_1         = cmdln_int("pid_1", argc, argv,
-                                          _PID_1_DEFAULT);
-    int         pid_2         = cmdln_int("pid_2", argc, argv,
-                                          _PID_2_DEFAULT);
-    std::string outstate_str  = cmdln_string("outstate", argc, argv,
-                                             _OUTSTATE_DEFAULT);
-
-    bool        use_opendata  = cmdln_bool("use_opendata", argc, argv,
-                                           true);
-    if (use_opendata) level = "data";
-
-    // Jet settings
-    double      jet_rad       = cmdln_double("jet_rad", argc, argv,
-                                             1000.);
-    std::string jet_alg       = jetalgstr_cmdln(argc, argv);
-    std::string jet_scheme    = scheme_string[jetrecomb_cmdln(argc, argv)];
+    const EncHeaderInfo info(argc, argv);
+    const int         n_events      = info.n_events;
+    const std::string level         = info.level;
+    const double      E_cm          = info.E_cm;
+    const int         pid_1         = info.pid_1;
+    const int         pid_2         = info.pid_2;
+    const std::string outstate_str  = info.outstate_str;
+    const bool        use_opendata  = info.use_opendata;
+    const double      jet_rad       = info.jet_rad;
+    const std::string jet_alg       = info.jet_alg;
+    const std::string jet_scheme    = info.jet_scheme;
 
     // ---------------------------------
     // Writing the header
@@ -155,3 +193,44 @@ void write_enc_header(std::string filename,
 
     return;
 }
+
+
+/**
+* @brief: Adds the same information as write_enc_header, as
+*         scalars and strings, to a binary (.npz) output file.
+*
+* @param: npz        Binary output file.
+*
+* @param: argc/argv  Command line input.
+*
+* @param: weights    Energy weights for this file.
+*/
+void add_enc_header(NpzWriter& npz, int argc, char* argv[],
+                    const std::vector<double> weights) {
+    const EncHeaderInfo info(argc, argv);
+
+    std::string function_call;
+    for (int iarg = 0; iarg < argc; ++iarg)
+        function_call += std::string(argv[iarg]) + " ";
+    npz.add("function_call", function_call);
+
+    npz.add("n_events", static_cast<double>(info.n_events));
+    npz.add("energy", info.E_cm);
+    npz.add("level", info.level);
+    npz.add("pid_1", static_cast<double>(info.pid_1));
+    npz.add("pid_2", static_cast<double>(info.pid_2));
+    npz.add("outstate_str", info.outstate_str);
+    npz.add("weight", weights);
+
+    // (jet information is left out for the full event,
+    //  as None is in the text header)
+    if (info.use_opendata) {
+        npz.add("jet_alg", std::string("anti-kt"));
+        npz.add("jet_scheme", std::string("E?"));
+        npz.add("jet_rad", 0.5);
+    } else if (info.jet_rad != 1000) {
+        npz.add("jet_alg", info.jet_alg);
+        npz.add("jet_scheme", info.jet_scheme);
+        npz.add("jet_rad", info.jet_rad);
+    }
+}
@@ -10,6 +10,7 @@
 // Basic imports
 // ---------------------------------
 #include <cstring>
+#include <cctype>
 #include <cmath>
 #include <fstream>
 #include <sstream>
@@ -19,6 +20,10 @@
 #include <algorithm>
 #include <cassert>
 #include <limits>
+#include <stdexcept>
+
+#include <sys/resource.h>
+#include <unistd.h>
 
 #include <iostream>  // for DEBUG
 
@@ -261,6 +266,25 @@ std::vector<double> get_bin_centers(const double minbin,
 }
 
 
+/**
+* @brief: Converts the logarithms of bin edges or centers
+*         (as given by get_bin_edges/get_bin_centers for
+*         logarithmic bins) into the true values.
+*
+* @param: log10_vals  Base 10 logarithms of the values
+*
+* @return: std::vector<double>
+*                     The values themselves
+*/
+std::vector<double> powers_of_ten(const std::vector<double>& log10_vals) {
+    std::vector<double> vals;
+    vals.reserve(log10_vals.size());
+    for (const double log10_val : log10_vals)
+        vals.push_back(std::pow(10, log10_val));
+    return vals;
+}
+
+
 /**
 * @brief: Returns the bin position of a given
 *         value in a histogram.
@@ -364,6 +388,64 @@ int bin_position(const double val,
 }
 
 
+BinAxis::BinAxis(const double minbin_, const double maxbin_,
+                 const int nbins_, const std::string bin_scheme,
+                 const bool underflow_, const bool overflow_)
+        : minbin(minbin_), maxbin(maxbin_), nbins(nbins_),
+          underflow(underflow_), overflow(overflow_) {
+    // Resolving the bin spacing scheme once
+    if (bin_scheme == "linear" or bin_scheme == "lin")
+        log_bins = false;
+    else if (bin_scheme == "logarithmic" or bin_scheme == "log")
+        log_bins = true;
+    else
+        throw std::invalid_argument(
+                "Invalid bin scheme " + bin_scheme + ".");
+
+    minbin_val = log_bins ? pow(10, minbin) : minbin;
+    maxbin_val = log_bins ? pow(10, maxbin) : maxbin;
+
+    // Effective bin positions for "finite" bins
+    // (as in bin_position)
+    base_bin = underflow ? 1 : 0;
+    const int nbins_finite = nbins - (underflow ? 1 : 0)
+                                   - (overflow ? 1 : 0);
+    inv_width = nbins_finite/(maxbin - minbin);
+}
+
+
+/**
+* @brief: Bin indices of many values at once; the loops
+*         without range checks or logarithms can vectorize.
+*/
+void BinAxis::bin_indices(const double* vals, const size_t n,
+                          int* bins) const {
+    if (not underflow or not overflow)
+        for (size_t i = 0; i < n; ++i)
+            check_range(vals[i]);
+
+    if (log_bins)
+        for (size_t i = 0; i < n; ++i)
+            bins[i] = bin_from_coordinate(log10(vals[i]));
+    else
+        for (size_t i = 0; i < n; ++i)
+            bins[i] = bin_from_coordinate(vals[i]);
+}
+
+
+void BinAxis::throw_out_of_range(const double val) const {
+    if (val < minbin_val)
+        throw std::underflow_error(
+                "Invalid val "+std::to_string(val)+" is smaller than "
+                "minimum bin edge "+std::to_string(minbin_val)+"."
+            );
+    throw std::overflow_error(
+            "Invalid val "+std::to_string(val)+" is larger than "
+            "maximum bin edge "+std::to_string(maxbin_val)+"."
+        );
+}
+
+
 // ---------------------------------
 // Command Line Utilities
 // ---------------------------------
@@ -372,22 +454,114 @@ int bin_position(const double val,
 *          See https://stackoverflow.com/a/39883532
 *
 * @param: arguments   A vector of strings describing the command line
-*                     arguments.
+*                     arguments (which must outlive the result).
 *
 * @return: std::vector<char*>      An appropriate `argv` for the
 *                                  command line arguments.
 */
-std::vector<char*> strings_to_argv(std::vector<std::string> arguments) {
+std::vector<char*> strings_to_argv(std::vector<std::string>& arguments) {
     std::vector<char*> argv;
 
-    for (const auto& arg : arguments)
-        argv.push_back((char*)arg.data());
+    for (auto& arg : arguments)
+        argv.push_back(&arg[0]);
     argv.push_back(nullptr);
 
     return argv;
 }
 
 
+// ---------------------------------
+// Memory Utilities
+// ---------------------------------
+/**
+* @brief:   Reads a memory size such as "512M", "4G" or "4GB"
+*           (with binary prefixes K, M, G, T; a bare number is
+*           taken to be in megabytes).
+*
+* @param: size_str  The memory size.
+*
+* @return: size_t   The memory size in bytes.
+*/
+size_t parse_memory_size(const std::string size_str) {
+    size_t num_chars = 0;
+    double size = 0;
+    try {
+        size = std::stod(size_str, &num_chars);
+    } catch (const std::exception&) {
+        throw std::invalid_argument("Invalid memory size "
+                                    + size_str + ".");
+    }
+
+    std::string unit = size_str.substr(num_chars);
+    std::transform(unit.begin(), unit.end(), unit.begin(), ::toupper);
+    if (unit.size() > 1 and unit.back() == 'B')
+        unit.pop_back();
+
+    double multiplier;
+    if (unit == "" or unit == "M")  multiplier = std::pow(1024, 2);
+    else if (unit == "K")           multiplier = 1024;
+    else if (unit == "G")           multiplier = std::pow(1024, 3);
+    else if (unit == "T")           multiplier = std::pow(1024, 4);
+    else if (unit == "B")           multiplier = 1;
+    else
+        throw std::invalid_argument("Invalid memory size "
+                                    + size_str + ".");
+
+    if (size < 0)
+        throw std::invalid_argument("Memory size must be "
+                                    "non-negative.");
+    return static_cast<size_t>(size*multiplier);
+}
+
+
+/**
+* @brief:   Formats a number of bytes for printing, e.g. "1.50 GB".
+*/
+std::string format_bytes(const size_t bytes) {
+    const std::vector<std::string> units = {"B", "KB", "MB",
+                                            "GB", "TB"};
+    double size = bytes;
+    size_t iunit = 0;
+    while (size >= 1024 and iunit+1 < units.size()) {
+        size /= 1024;
+        ++iunit;
+    }
+    return str_round(size, iunit == 0 ? 0 : 2) + " " + units[iunit];
+}
+
+
+/**
+* @brief:   Peak resident set size of this process, in bytes.
+*/
+size_t peak_rss_bytes() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    // (in bytes on macOS)
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    // (in kilobytes on Linux)
+    return static_cast<size_t>(usage.ru_maxrss)*1024;
+#endif
+}
+
+
+/**
+* @brief:   Current resident set size of this process, in bytes
+*           (or the peak, where the current size is not available).
+*/
+size_t current_rss_bytes() {
+#ifdef __linux__
+    std::ifstream statm("/proc/self/statm");
+    size_t total_pages, resident_pages;
+    if (statm >> total_pages >> resident_pages)
+        return resident_pages*static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+    return peak_rss_bytes();
+}
+
+
 // ---------------------------------
 // Progress Bar
 // ---------------------------------
@@ -0,0 +1,306 @@
+/**
+ * @file    jet_cache.cc
+ *
+ * @brief   Writes and reads binary caches of selected jets.
+ */
+#include <string>
+#include <vector>
+#include <fstream>
+#include <mutex>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include "fastjet/PseudoJet.hh"
+
+// Local imports
+#include "../../include/general_utils.h"
+#include "../../include/opendata_utils.h"
+#include "../../include/jet_cache.h"
+
+
+namespace {
+    const char CACHE_MAGIC[8] = "ECSJETC";
+    const uint32_t CACHE_VERSION = 1;
+    // (read back differently on machines of the other byte order)
+    const uint32_t BYTE_ORDER_MARK = 0x01020304;
+    // Alignment of the jets from the start of the file
+    const size_t JETS_ALIGNMENT = 64;
+    // Bytes of jets to gather before each write
+    const size_t WRITE_BUFFER_SIZE = 1 << 20;
+
+    struct CacheHeader {
+        char     magic[8];
+        uint32_t version;
+        uint32_t byte_order;
+        uint64_t njets;
+        uint64_t nparticles;
+        uint64_t settings_size;
+        uint64_t jets_offset;
+        uint64_t file_size;
+        uint64_t reserved;
+    };
+    static_assert(sizeof(CacheHeader) == 64,
+                  "Jet cache header should not be padded.");
+
+    template <typename T>
+    void append_value(std::string& buffer, const T value) {
+        buffer.append(reinterpret_cast<const char*>(&value),
+                      sizeof(value));
+    }
+}
+
+
+// =====================================
+// Cached Settings
+// =====================================
+const std::vector<std::string> jet_cache_options = {
+    // Events
+    "--use_opendata", "--od_file", "--source",
+    "--synthetic_mult", "--synthetic_fixed_mult",
+    "--n_events", "--level", "--energy", "--pid_1", "--pid_2",
+    "--outstate", "--pi0_decay", "--isr", "--fsr", "--mpi",
+    "--shower_model", "--seed",
+    // Jets
+    "--jet_rad", "-j", "--jet_alg", "--jet_algorithm",
+    "--jet_recomb", "--jet_scheme", "--jet_recombination",
+    "--jet_recombination_scheme",
+    // Cuts
+    "--n_exclusive_jets", "--pt_min", "--pt_max", "--eta_cut"
+};
+
+
+std::vector<std::string> jet_cache_arguments(int argc, char* argv[]) {
+    std::vector<std::string> arguments;
+    for (int iarg = 1; iarg+1 < argc; ++iarg) {
+        if (std::find(jet_cache_options.begin(), jet_cache_options.end(),
+                      argv[iarg]) != jet_cache_options.end()) {
+            arguments.emplace_back(argv[iarg]);
+            arguments.emplace_back(argv[iarg+1]);
+        }
+    }
+    return arguments;
+}
+
+
+std::vector<std::string> with_cached_arguments(int argc, char* argv[],
+        const std::vector<std::string>& cached_arguments) {
+    std::vector<std::string> arguments(argv, argv + argc);
+    for (int iarg = 1; iarg < argc; ++iarg) {
+        if (std::find(jet_cache_options.begin(), jet_cache_options.end(),
+                      argv[iarg]) != jet_cache_options.end()) {
+            throw std::invalid_argument(std::string(argv[iarg])
+                    + " cannot be given when reading a jet cache, "
+                    + "which uses the settings that selected its jets.");
+        }
+    }
+    arguments.insert(arguments.end(), cached_arguments.begin(),
+                     cached_arguments.end());
+    return arguments;
+}
+
+
+// =====================================
+// Writing Jet Caches
+// =====================================
+JetCacheWriter::JetCacheWriter(const std::string& filename_,
+                               int argc, char* argv[])
+        : filename(filename_) {
+    file.open(filename, std::ios::out | std::ios::binary
+                        | std::ios::trunc);
+    if (not file.is_open())
+        throw std::runtime_error("JetCacheWriter: Error: "
+                                 "Could not create " + filename);
+
+    // Settings: the command line, then the arguments
+    // which decide the jets
+    std::string settings;
+    for (int iarg = 0; iarg < argc; ++iarg)
+        settings += std::string(argv[iarg])
+                    + (iarg+1 < argc ? " " : "");
+    settings.push_back('\0');
+    for (const std::string& argument : jet_cache_arguments(argc, argv)) {
+        settings += argument;
+        settings.push_back('\0');
+    }
+
+    // (the header is left blank until the cache is complete)
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    settings_size = settings.size();
+    header.settings_size = settings_size;
+    jets_offset = (sizeof(header) + settings.size() + JETS_ALIGNMENT - 1)
+                  / JETS_ALIGNMENT * JETS_ALIGNMENT;
+    settings.resize(jets_offset - sizeof(header), '\0');
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(settings.data(), settings.size());
+    buffer.reserve(WRITE_BUFFER_SIZE);
+}
+
+
+JetCacheWriter::~JetCacheWriter() {
+    // (not completing the header, so that a cache abandoned
+    //  after an error is not mistaken for a complete one)
+    if (not closed)
+        file.close();
+}
+
+
+void JetCacheWriter::write_jet(
+        const std::vector<fastjet::PseudoJet>& constituents) {
+    std::lock_guard<std::mutex> lock(write_mutex);
+    if (closed)
+        throw std::runtime_error("JetCacheWriter: Error: Cannot write "
+                                 "to " + filename + " after closing it.");
+
+    append_value(buffer, static_cast<uint64_t>(constituents.size()));
+    for (const fastjet::PseudoJet& particle : constituents) {
+        append_value(buffer, particle.px());
+        append_value(buffer, particle.py());
+        append_value(buffer, particle.pz());
+        append_value(buffer, particle.E());
+    }
+    ++njets;
+    nparticles += constituents.size();
+
+    if (buffer.size() >= WRITE_BUFFER_SIZE) {
+        file.write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+}
+
+
+void JetCacheWriter::write_empty_jets(const size_t nempty) {
+    const std::vector<fastjet::PseudoJet> no_constituents;
+    for (size_t ijet = 0; ijet < nempty; ++ijet)
+        write_jet(no_constituents);
+}
+
+
+void JetCacheWriter::close() {
+    std::lock_guard<std::mutex> lock(write_mutex);
+    if (closed) return;
+    closed = true;
+
+    file.write(buffer.data(), buffer.size());
+    buffer.clear();
+    const uint64_t file_size = static_cast<uint64_t>(file.tellp());
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.version       = CACHE_VERSION;
+    header.byte_order    = BYTE_ORDER_MARK;
+    header.njets         = njets;
+    header.nparticles    = nparticles;
+    header.settings_size = settings_size;
+    header.jets_offset   = jets_offset;
+    header.file_size     = file_size;
+
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.close();
+    if (not file)
+        throw std::runtime_error("JetCacheWriter: Error: "
+                                 "Failed to write " + filename);
+}
+
+
+// =====================================
+// Reading Jet Caches
+// =====================================
+JetCacheReader::JetCacheReader(const std::string& filename_)
+        : filename(filename_), file(filename_, true) {
+    CacheHeader header;
+    if (file.size() < sizeof(header))
+        throw std::runtime_error("JetCacheReader: Error: "
+                                 + filename + " is not a jet cache.");
+    memcpy(&header, file.data(), sizeof(header));
+
+    if (memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) != 0)
+        throw std::runtime_error("JetCacheReader: Error: "
+                                 + filename + " is not a complete jet "
+                                 "cache (was it written by a run "
+                                 "which did not finish?).");
+    if (header.version != CACHE_VERSION
+            or header.byte_order != BYTE_ORDER_MARK)
+        throw std::runtime_error("JetCacheReader: Error: " + filename
+                                 + " was written with an incompatible "
+                                 "version or machine; please rewrite "
+                                 "it.");
+    if (header.file_size != file.size()
+            or header.jets_offset < sizeof(header) + header.settings_size
+            or header.jets_offset + (header.njets + 4*header.nparticles)
+                                    *sizeof(double) != file.size())
+        throw std::runtime_error("JetCacheReader: Error: "
+                                 + filename + " is truncated or "
+                                 "corrupted.");
+
+    njets      = header.njets;
+    nparticles = header.nparticles;
+    position   = header.jets_offset;
+
+    // Settings: the command line, then the arguments
+    const char* settings = file.data() + sizeof(header);
+    const char* settings_end = settings + header.settings_size;
+    bool first = true;
+    while (settings < settings_end) {
+        const char* end = static_cast<const char*>(
+                memchr(settings, '\0', settings_end - settings));
+        if (end == nullptr) end = settings_end;
+        if (first) command_.assign(settings, end);
+        else       arguments_.emplace_back(settings, end);
+        first = false;
+        settings = end + 1;
+    }
+}
+
+
+bool JetCacheReader::read_jet(
+        std::vector<fastjet::PseudoJet>& constituents) {
+    constituents.clear();
+    if (next_jet >= njets)
+        return false;
+
+    // (the size of the file was checked on opening)
+    uint64_t count;
+    memcpy(&count, file.data() + position, sizeof(count));
+    const double* momenta = reinterpret_cast<const double*>(
+            file.data() + position + sizeof(count));
+
+    constituents.reserve(count);
+    for (uint64_t ipart = 0; ipart < count; ++ipart)
+        constituents.emplace_back(momenta[4*ipart],   momenta[4*ipart+1],
+                                  momenta[4*ipart+2], momenta[4*ipart+3]);
+
+    position += sizeof(count) + 4*count*sizeof(double);
+    ++next_jet;
+    return true;
+}
+
+
+bool JetCacheReader::skip_jets(const size_t count) {
+    for (size_t ijet = 0; ijet < count; ++ijet) {
+        if (next_jet >= njets)
+            return false;
+
+        uint64_t nconstituents;
+        memcpy(&nconstituents, file.data() + position,
+               sizeof(nconstituents));
+        position += sizeof(nconstituents) + 4*nconstituents*sizeof(double);
+        ++next_jet;
+    }
+    return true;
+}
+
+
+bool JetCacheReader::read_jet(fastjet::PseudoJet& jet) {
+    if (not read_jet(particle_buffer)) {
+        jet = fastjet::PseudoJet();
+        return false;
+    }
+    jet = join(particle_buffer);
+    return true;
+}
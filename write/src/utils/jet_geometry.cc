@@ -0,0 +1,193 @@
+/**
+ * @file    jet_geometry.cc
+ *
+ * @brief   Compact per-jet representations of jet constituents
+ *          and of their pairwise angles, for use in energy
+ *          correlator kernels.
+ */
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include "fastjet/PseudoJet.hh"
+
+// Local imports
+#include "../../include/general_utils.h"
+#include "../../include/angle_sort.h"
+#include "../../include/jet_geometry.h"
+
+
+// =====================================
+// Compact Jets
+// =====================================
+/**
+* @brief: Reads the kinematics and normalized weights of the
+*         given constituents into contiguous arrays.
+*
+* @param: constituents  Particles in the jet.
+* @param: use_pt        Whether to use pT (true) or energy (false)
+*                       as the weight of each particle.
+*/
+void CompactJet::fill(
+        const std::vector<fastjet::PseudoJet>& constituents,
+        const bool use_pt) {
+    const size_t nparts = constituents.size();
+    rap.resize(nparts);
+    phi.resize(nparts);
+    ux.resize(nparts);
+    uy.resize(nparts);
+    uz.resize(nparts);
+    weight.resize(nparts);
+
+    double weight_tot = 0;
+    for (size_t i = 0; i < nparts; ++i) {
+        const fastjet::PseudoJet& part = constituents[i];
+
+        rap[i] = part.rap();
+        phi[i] = part.phi();
+
+        const double modp = part.modp();
+        const double inv_modp = modp > 0 ? 1./modp : 0;
+        ux[i] = part.px()*inv_modp;
+        uy[i] = part.py()*inv_modp;
+        uz[i] = part.pz()*inv_modp;
+
+        weight[i] = use_pt ? part.pt() : part.e();
+        weight_tot += weight[i];
+    }
+
+    for (size_t i = 0; i < nparts; ++i)
+        weight[i] /= weight_tot;
+}
+
+
+// =====================================
+// Azimuthal Angles
+// =====================================
+/**
+* @brief: Azimuthal angle (in the rapidity-azimuth plane, and
+*         between -pi and pi) from the particle at ipart1 to the
+*         particle at ipart2, about the particle at ipart_sp.
+*/
+double enc_azimuth(const CompactJet& jet,
+                   const size_t ipart1,
+                   const size_t ipart_sp,
+                   const size_t ipart2) {
+    // NOTE: I think this doesn't work for very fat jets --
+    // NOTE:   roughly because fat jets require a bit more care
+    // NOTE:   with mod(2pi) arithmetic
+    // - - - - - - - - - - - - - - - - - - -
+    // Normalized vectors in eta-phi plane
+    // - - - - - - - - - - - - - - - - - - -
+    // From part_sp to part1
+    double x1 = jet.rap[ipart1] - jet.rap[ipart_sp];
+    double y1 = mod2pi(jet.phi[ipart1] - jet.phi[ipart_sp]);
+    const double n1  = sqrt(std::pow(x1, 2.) + std::pow(y1, 2.));
+    if (n1 == 0)
+        return 0;
+    x1 /= n1; y1 /= n1;
+
+    // From part_sp to part2
+    double x2 = jet.rap[ipart2] - jet.rap[ipart_sp];
+    double y2 = mod2pi(jet.phi[ipart2] - jet.phi[ipart_sp]);
+    const double n2  = sqrt(std::pow(x2, 2.) + std::pow(y2, 2.));
+    if (n2 == 0)
+        return 0;
+    x2 /= n2; y2 /= n2;
+
+    // - - - - - - - - - - - - - - - - - - -
+    // Getting the "angle" between these vectors
+    // - - - - - - - - - - - - - - - - - - -
+    const double dot = x1*x2 + y1*y2;
+    const double det = x1*y2 - y1*x2;
+    double phi = mod2pi(atan2(det, dot));
+
+    // Setting it to be between -pi and pi
+    phi = phi > PI ? phi - TWOPI : phi;
+    if (phi < -PI or PI < phi)
+        throw std::range_error(
+                "Found azimuthal angle not between -pi and pi.");
+
+    return phi;
+}
+
+
+// =====================================
+// Jet Geometry
+// =====================================
+JetGeometry::JetGeometry(const double minbin_, const double maxbin_,
+                         const int nbins_,
+                         const bool underflow_, const bool overflow_)
+        : axis(minbin_, maxbin_, nbins_, "log",
+               underflow_, overflow_) {}
+
+
+/**
+* @brief: Computes the pairwise angles between the particles
+*         of the given jet, and sorts the neighbours of each
+*         particle by angle.
+*
+* @param: jet           Compact representation of the jet.
+* @param: use_deltaR    Whether to use Delta R in the rapidity-azimuth
+*                       plane (true) or real-space angles (false).
+*/
+void JetGeometry::fill(const CompactJet& jet, const bool use_deltaR) {
+    nparts = jet.size();
+    angles.resize(nparts*nparts);
+    angle_bins.resize(nparts*nparts);
+    neighbours.resize(nparts*nparts);
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Pairwise angles (each pair only once)
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    for (size_t i = 0; i < nparts; ++i) {
+        const size_t ii = i*nparts + i;
+        angles[ii] = 0;
+
+        for (size_t j = i+1; j < nparts; ++j) {
+            double theta;
+            if (use_deltaR) {
+                // (as in fastjet::PseudoJet::delta_R)
+                double dphi = std::abs(jet.phi[i] - jet.phi[j]);
+                if (dphi > PI) dphi = TWOPI - dphi;
+                const double drap = jet.rap[i] - jet.rap[j];
+                theta = sqrt(dphi*dphi + drap*drap);
+            } else {
+                const double cos_theta = jet.ux[i]*jet.ux[j]
+                                       + jet.uy[i]*jet.uy[j]
+                                       + jet.uz[i]*jet.uz[j];
+                theta = acos(std::max(-1., std::min(1., cos_theta)));
+            }
+            angles[ii + (j-i)] = theta;
+        }
+
+        // Binning the angles from i to particles j >= i all at once
+        axis.bin_indices(&angles[ii], nparts-i, &angle_bins[ii]);
+
+        // and mirroring
+        for (size_t j = i+1; j < nparts; ++j) {
+            const size_t ij = i*nparts + j, ji = j*nparts + i;
+            angles[ji]     = angles[ij];
+            angle_bins[ji] = angle_bins[ij];
+        }
+    }
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Sorting neighbours by angle
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    for (size_t i = 0; i < nparts; ++i) {
+        size_t* row = &neighbours[i*nparts];
+        const double* row_angles = &angles[i*nparts];
+
+        // Particle i goes first (even if others sit at zero angle),
+        row[0] = i;
+        for (size_t j = 0, k = 1; j < nparts; ++j)
+            if (j != i) row[k++] = j;
+
+        // followed by all others, by angle (the sort is stable,
+        // so that equal angles remain ordered by index)
+        if (nparts > 1)
+            sorter.sort(row_angles, row + 1, nparts - 1);
+    }
+}
@@ -0,0 +1,221 @@
+/**
+ * @file    jet_property_hists.cc
+ *
+ * @brief   Histograms of several properties of jets, and their
+ *          output files.
+ */
+#include <cmath>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+
+#include "fastjet/PseudoJet.hh"
+
+// Local imports
+#include "../../include/general_utils.h"
+#include "../../include/pythia_cmdln.h"
+#include "../../include/nd_histogram.h"
+#include "../../include/jet_property_hists.h"
+
+
+namespace {
+    // Largest number of constituents with a bin of its own
+    const int MAX_N_CONSTITUENTS = 200;
+}
+
+
+const std::vector<std::string> jet_property_names = {"mass", "pT",
+                                                     "energy", "eta",
+                                                     "n_constituents"};
+
+
+JetPropertyHistograms::JetPropertyHistograms(const int nbins,
+                                             const double minbin,
+                                             const double maxbin,
+                                             const double eta_cut) {
+    const bool uflow = true, oflow = true;
+
+    // Mass, pT and energy
+    for (int ilog = 0; ilog < 3; ++ilog)
+        properties.push_back({true,
+                get_bin_edges(minbin, maxbin, nbins, uflow, oflow),
+                get_bin_centers(minbin, maxbin, nbins, uflow, oflow),
+                BinAxis(minbin, maxbin, nbins, "log", uflow, oflow),
+                NDHistogram<1>(nbins)});
+
+    // Pseudorapidity
+    properties.push_back({false,
+            get_bin_edges(-eta_cut, eta_cut, nbins, false, false),
+            get_bin_centers(-eta_cut, eta_cut, nbins, false, false),
+            BinAxis(-eta_cut, eta_cut, nbins, "lin", false, false),
+            NDHistogram<1>(nbins)});
+
+    // Number of constituents
+    properties.push_back({false,
+            get_bin_edges(-0.5, MAX_N_CONSTITUENTS+0.5,
+                          MAX_N_CONSTITUENTS+1, false, false),
+            get_bin_centers(-0.5, MAX_N_CONSTITUENTS+0.5,
+                            MAX_N_CONSTITUENTS+1, false, false),
+            BinAxis(-0.5, MAX_N_CONSTITUENTS+0.5,
+                    MAX_N_CONSTITUENTS+1, "lin", false, false),
+            NDHistogram<1>(MAX_N_CONSTITUENTS+1)});
+}
+
+
+void JetPropertyHistograms::fill(const fastjet::PseudoJet& jet,
+                                 const size_t n_constituents) {
+    const double values[] = {jet.m(), jet.pt(), jet.e(), jet.eta(),
+                             static_cast<double>(n_constituents)};
+    for (size_t iprop = 0; iprop < properties.size(); ++iprop) {
+        PropertyBins& property = properties[iprop];
+        property.hist[property.axis.bin(values[iprop])] += 1;
+    }
+
+    // Counting total num jets for normalization
+    ++njets;
+}
+
+
+void JetPropertyHistograms::merge(const JetPropertyHistograms& other) {
+    for (size_t iprop = 0; iprop < properties.size(); ++iprop)
+        properties[iprop].hist += other.properties[iprop].hist;
+    njets += other.njets;
+}
+
+
+size_t JetPropertyHistograms::memory_bytes() const {
+    size_t bytes = 0;
+    for (const PropertyBins& property : properties)
+        bytes += NDHistogram<1>::allocated_bytes(property.hist.shape());
+    return bytes;
+}
+
+
+void JetPropertyHistograms::write(
+        const std::vector<std::string>& filenames,
+        const bool mathematica_format) {
+    const std::string HIST_DELIM = mathematica_format ?  " " : ", ";
+
+    for (size_t iprop = 0; iprop < properties.size(); ++iprop) {
+        const std::string& prop = jet_property_names[iprop];
+        PropertyBins& property = properties[iprop];
+        const int nbins = property.hist.size();
+        const std::vector<double>& edges = property.edges;
+        const std::vector<double>& centers = property.centers;
+
+        // Bins of the property (rather than its logarithm)
+        auto bin_value = [&](const double value) {
+            return property.log ? std::pow(10, value) : value;
+        };
+
+        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+        // Opening histogram output file
+        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+        std::fstream outfile;
+        outfile.open(filenames[iprop], std::ios_base::in |
+                                       std::ios_base::out |
+                                       std::ios_base::app);
+
+        // Checking for existence
+        if (!outfile.is_open()) {
+            std::stringstream errMsg;
+            errMsg << "File for jet property output was expected "
+                   << "to be open, but was not open.\n\n"
+                   << "It is possible the file was unable to "
+                   << "be created at the desired location:\n\n\t"
+                   << "filename = " << filenames[iprop] << "\n\n"
+                   << "Is the filename an absolute path? If not, "
+                   << "that might be the problem.";
+            throw std::runtime_error(errMsg.str().c_str());
+        }
+
+        // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+        // Writing to files
+        // =:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=:=
+        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+        // Edges
+        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+        if (not(mathematica_format))
+            outfile << prop << "_edges = [\n\t";
+        else outfile << "(* " << prop << "_edges *)\n";
+
+        for (int ibin = 0; ibin < nbins; ++ibin)
+            outfile << bin_value(edges[ibin]) << HIST_DELIM;
+        if (std::isinf(edges[nbins]) and not(mathematica_format))
+            outfile << "np.inf\n";
+        else
+            outfile << bin_value(edges[nbins]) << "\n";
+        if (not(mathematica_format)) outfile << "]\n\n";
+
+        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+        // Centers
+        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+        if (not(mathematica_format))
+            outfile << prop << "_centers = [\n\t";
+        else outfile << "\n(* " << prop << "_centers *)\n";
+
+        for (int ibin = 0; ibin < nbins-1; ++ibin)
+            outfile << bin_value(centers[ibin]) << HIST_DELIM;
+        if (std::isinf(centers[nbins-1]) and not(mathematica_format))
+            outfile << "np.inf\n";
+        else
+            outfile << bin_value(centers[nbins-1]) << "\n";
+        if (not(mathematica_format)) outfile << "]\n\n";
+
+        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+        // Histogram
+        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+        if (not(mathematica_format))
+            outfile << "hist = [\n\t";
+        else outfile << "\n(* " << prop << " hist *)\n";
+
+        // (with under- and overflow for logarithmic bins)
+        const int bins_finite_start = 1, nbins_finite = nbins-2;
+        for (int bin = 0; bin < nbins; ++bin) {
+            // Expectation values over N jets
+            property.hist[bin] /= njets;
+
+            // Not normalizing outflow bins further
+            if (not(property.log and (bin < bins_finite_start
+                                      or bin >= nbins_finite))) {
+                // getting differential "volume" element
+                double dvol = (edges[bin+1] - edges[bin]);
+                // and normalizing
+                property.hist[bin] /= dvol;
+            }
+
+            // Printing histogram
+            outfile << std::setprecision(10) << property.hist[bin];
+            if (bin != nbins-1)
+                outfile << HIST_DELIM;
+            else
+                outfile << "\n";
+        }
+        if (not(mathematica_format)) outfile << "]\n\n";
+
+        outfile.close();
+    }
+}
+
+
+std::vector<std::string> setup_jet_property_outfiles(
+        const std::string& file_prefix, int argc, char* argv[],
+        const bool mathematica_format) {
+    std::vector<std::string> filenames;
+    for (const std::string& prop : jet_property_names) {
+        std::string filename = "output/jet_properties/";
+        if (not file_prefix.empty())
+            filename += file_prefix + "_";
+        filename += prop;
+        filename += mathematica_format ? ".txt" : ".py";
+
+        // Write a header
+        write_jetproperty_header(filename, argc, argv,
+                                 not(mathematica_format));
+        filenames.push_back(filename);
+    }
+    return filenames;
+}
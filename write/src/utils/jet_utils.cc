@@ -19,6 +19,7 @@
 #include <vector>
 #include <stdexcept>
 #include <algorithm>  // std::max and std::min
+#include <memory>
 
 #include <assert.h>
 
@@ -268,6 +269,27 @@ PseudoJets add_events(const PseudoJets event1, const PseudoJets event2) {
 }
 
 
+/**
+* @brief: Returns a single jet made of every particle in the event
+*         with nonzero momentum, joined all at once, so that its
+*         constituents are stored flat (rather than as a chain of
+*         nested pairs, as when joining one particle at a time).
+*
+* @param: particles  A vector containing the particles of the event.
+*
+* @return: PseudoJet The whole event, as a jet.
+*/
+PseudoJet full_event_jet(const PseudoJets& particles) {
+    PseudoJets pieces;
+    pieces.reserve(particles.size());
+    for (const auto& part : particles)
+        if (part.modp() > 0)
+            pieces.push_back(part);
+
+    return join(pieces);
+}
+
+
 /**
 * @brief: Returns the sum of scalar pT in a vector of pseudojets.
 *
@@ -413,6 +435,62 @@ std::string jetAlgorithmType(std::string algorithm) {
 }
 
 
+// =====================================
+// Jet Selection
+// =====================================
+bool JetCuts::selects(const PseudoJet& jet, const size_t i) const {
+    // Only working up to the Nth jet if doing exclusive analysis
+    if (n_exclusive_jets > 0
+            and i >= static_cast<size_t>(n_exclusive_jets))
+        return false;
+    // (as for ClusterSequence::inclusive_jets(pt_min), unless the
+    //  whole event is a single "jet")
+    if (jet_rad < 1000 and jet.pt2() < pt_min*pt_min)
+        return false;
+
+    if (is_proton_collision)
+        // For pp, ensuring pt_min < pt < pt_max
+        // and |eta| < eta_cut   (or no eta_cut given)
+        return pt_min <= jet.pt() and jet.pt() <= pt_max
+               and (std::abs(jet.eta()) <= eta_cut or eta_cut < 0);
+    // For other collisions, ensuring E_min < E < E_max
+    // (for now, keeping confusing notation with, e.g.,
+    //    E_min represented by `pt_min`)
+    return pt_min <= jet.E() and jet.E() <= pt_max;
+}
+
+
+PseudoJets event_jets(const PseudoJets& particles,
+                      const JetDefinition& jet_def,
+                      const double jet_rad, const double pt_min,
+                      std::unique_ptr<ClusterSequence>& cluster_seq_ptr) {
+    cluster_seq_ptr = std::make_unique<ClusterSequence>(particles,
+                                                        jet_def);
+
+    // If given a generic value of R,
+    // cluster the event with the given jet definition
+    if (jet_rad < 1000)
+        return sorted_by_pt(cluster_seq_ptr->inclusive_jets(pt_min));
+
+    // If we are given the maximum possible value of R,
+    // use the whole event as a single "jet"
+    return {full_event_jet(particles)};
+}
+
+
+void select_jets(const PseudoJets& particles,
+                 const JetDefinition& jet_def, const JetCuts& cuts,
+                 std::unique_ptr<ClusterSequence>& cluster_seq_ptr,
+                 PseudoJets& jets) {
+    const PseudoJets all_jets = event_jets(particles, jet_def,
+                                           cuts.jet_rad, cuts.pt_min,
+                                           cluster_seq_ptr);
+    for (size_t i = 0; i < all_jets.size(); ++i)
+        if (cuts.selects(all_jets[i], i))
+            jets.push_back(all_jets[i]);
+}
+
+
 
 // =====================================
 // Visualization Utilities
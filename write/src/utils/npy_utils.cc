@@ -0,0 +1,265 @@
+/**
+ * @file    npy_utils.cc
+ *
+ * @brief   Writes arrays to binary files in the NumPy .npz format.
+ */
+#include <string>
+#include <vector>
+#include <sstream>
+#include <fstream>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+#include "../../include/npy_utils.h"
+
+
+// =====================================
+// Binary Utilities
+// =====================================
+namespace {
+
+// Whether this machine stores numbers little-endian first
+bool little_endian() {
+    const uint16_t one = 1;
+    return *reinterpret_cast<const unsigned char*>(&one) == 1;
+}
+
+// Writes little-endian integers, as used in .zip and .npy headers
+void put_le(std::string& out, uint64_t value, const int nbytes) {
+    for (int ibyte = 0; ibyte < nbytes; ++ibyte) {
+        out.push_back(static_cast<char>(value & 0xFF));
+        value >>= 8;
+    }
+}
+
+// CRC-32 checksum (as used by .zip archives), continued from crc
+uint32_t crc32(uint32_t crc, const char* data, const size_t nbytes) {
+    static const std::vector<uint32_t> table = []() {
+        std::vector<uint32_t> crc_table(256);
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            crc_table[n] = c;
+        }
+        return crc_table;
+    }();
+
+    crc = ~crc;
+    for (size_t i = 0; i < nbytes; ++i)
+        crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF]
+              ^ (crc >> 8);
+    return ~crc;
+}
+
+// "(2, 3)", "(5,)" or "()" for the given shape
+std::string shape_tuple(const std::vector<size_t>& shape) {
+    std::stringstream ss;
+    ss << "(";
+    for (size_t dim = 0; dim < shape.size(); ++dim)
+        ss << shape[dim] << (shape.size() == 1 ? "," :
+                             dim+1 < shape.size() ? ", " : "");
+    ss << ")";
+    return ss.str();
+}
+
+size_t shape_size(const std::vector<size_t>& shape) {
+    size_t size = 1;
+    for (const size_t dim_size : shape)
+        size *= dim_size;
+    return size;
+}
+
+// Alignment of array data from the start of the archive
+const size_t NPY_ALIGNMENT = 64;
+
+// Fixed size of a .zip local file header (before the file name)
+const size_t ZIP_LOCAL_HEADER_SIZE = 30;
+// DOS date for 1980-01-01, the earliest .zip timestamp
+const uint16_t ZIP_DATE = (1 << 5) | 1;
+
+}
+
+
+// =====================================
+// NumPy Archives
+// =====================================
+NpzWriter::NpzWriter(const std::string& filename_)
+        : filename(filename_) {
+    file.open(filename, std::ios::out | std::ios::binary
+                        | std::ios::trunc);
+    if (!file.is_open()) {
+        std::stringstream errMsg;
+        errMsg << "File for binary output was expected "
+               << "to be open, but was not open.\n\n"
+               << "It is possible the file was unable to "
+               << "be created at the desired location:\n\n\t"
+               << "filename = " << filename << "\n\n"
+               << "Is the filename an absolute path? If not, "
+               << "that might be the problem.";
+        throw std::runtime_error(errMsg.str().c_str());
+    }
+}
+
+
+NpzWriter::~NpzWriter() {
+    // (not throwing from a destructor)
+    try { close(); } catch (...) {}
+}
+
+
+void NpzWriter::add(const std::string& name, const double* data,
+                    const std::vector<size_t>& shape) {
+    add_array(name, little_endian() ? "<f8" : ">f8", shape,
+              reinterpret_cast<const char*>(data),
+              shape_size(shape)*sizeof(double));
+}
+
+
+void NpzWriter::add(const std::string& name, const int64_t* data,
+                    const std::vector<size_t>& shape) {
+    add_array(name, little_endian() ? "<i8" : ">i8", shape,
+              reinterpret_cast<const char*>(data),
+              shape_size(shape)*sizeof(int64_t));
+}
+
+
+void NpzWriter::add(const std::string& name,
+                    const std::vector<double>& values) {
+    add(name, values.data(), std::vector<size_t>{values.size()});
+}
+
+
+void NpzWriter::add(const std::string& name, const double value) {
+    add(name, &value, std::vector<size_t>{});
+}
+
+
+void NpzWriter::add(const std::string& name,
+                    const std::string& value) {
+    // (as a NumPy unicode string, i.e. UTF-32)
+    std::string utf32;
+    for (const char c : value)
+        put_le(utf32, static_cast<unsigned char>(c), 4);
+    add_array(name, "<U" + std::to_string(value.size()), {},
+              utf32.data(), utf32.size());
+}
+
+
+void NpzWriter::add_array(const std::string& name,
+                          const std::string& descr,
+                          const std::vector<size_t>& shape,
+                          const char* data, const size_t nbytes) {
+    if (closed)
+        throw std::runtime_error("Cannot add " + name + " to "
+                                 + filename + " after closing it.");
+
+    const std::string member_name = name + ".npy";
+    const uint64_t offset = static_cast<uint64_t>(file.tellp());
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // .npy header
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // (version 1.0, padded with spaces so that the data is aligned)
+    std::string dict = "{'descr': '" + descr + "', "
+                       "'fortran_order': False, "
+                       "'shape': " + shape_tuple(shape) + ", }";
+    const size_t unpadded = offset + ZIP_LOCAL_HEADER_SIZE
+                            + member_name.size() + 10 + dict.size() + 1;
+    dict.append((NPY_ALIGNMENT - unpadded%NPY_ALIGNMENT)%NPY_ALIGNMENT,
+                ' ');
+    dict.push_back('\n');
+
+    std::string npy_header = "\x93NUMPY";
+    npy_header.push_back(1);
+    npy_header.push_back(0);
+    put_le(npy_header, dict.size(), 2);
+    npy_header += dict;
+
+    const uint64_t size = npy_header.size() + nbytes;
+    if (offset + size > std::numeric_limits<uint32_t>::max())
+        throw std::runtime_error("Binary output " + filename
+                                 + " would exceed 4 GB, which is not "
+                                 "supported; use text output instead.");
+
+    uint32_t crc = crc32(0, npy_header.data(), npy_header.size());
+    crc = crc32(crc, data, nbytes);
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // .zip local file header
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // (stored without compression)
+    std::string local_header;
+    put_le(local_header, 0x04034b50, 4);  // signature
+    put_le(local_header, 20, 2);          // version needed
+    put_le(local_header, 0, 2);           // flags
+    put_le(local_header, 0, 2);           // method: stored
+    put_le(local_header, 0, 2);           // time
+    put_le(local_header, ZIP_DATE, 2);    // date
+    put_le(local_header, crc, 4);
+    put_le(local_header, size, 4);        // compressed size
+    put_le(local_header, size, 4);        // uncompressed size
+    put_le(local_header, member_name.size(), 2);
+    put_le(local_header, 0, 2);           // extra field length
+    local_header += member_name;
+
+    file.write(local_header.data(), local_header.size());
+    file.write(npy_header.data(), npy_header.size());
+    file.write(data, nbytes);
+    if (!file)
+        throw std::runtime_error("Failed to write " + name
+                                 + " to " + filename + ".");
+
+    members.push_back({member_name, crc, static_cast<uint32_t>(size),
+                       static_cast<uint32_t>(offset)});
+}
+
+
+void NpzWriter::close() {
+    if (closed) return;
+    closed = true;
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // .zip central directory
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    const uint64_t directory_offset = static_cast<uint64_t>(file.tellp());
+    std::string directory;
+    for (const Member& member : members) {
+        put_le(directory, 0x02014b50, 4);  // signature
+        put_le(directory, 20, 2);          // version made by
+        put_le(directory, 20, 2);          // version needed
+        put_le(directory, 0, 2);           // flags
+        put_le(directory, 0, 2);           // method: stored
+        put_le(directory, 0, 2);           // time
+        put_le(directory, ZIP_DATE, 2);    // date
+        put_le(directory, member.crc, 4);
+        put_le(directory, member.size, 4);
+        put_le(directory, member.size, 4);
+        put_le(directory, member.name.size(), 2);
+        put_le(directory, 0, 2);           // extra field length
+        put_le(directory, 0, 2);           // comment length
+        put_le(directory, 0, 2);           // disk number
+        put_le(directory, 0, 2);           // internal attributes
+        put_le(directory, 0, 4);           // external attributes
+        put_le(directory, member.offset, 4);
+        directory += member.name;
+    }
+
+    // End of central directory record
+    const size_t directory_size = directory.size();
+    put_le(directory, 0x06054b50, 4);
+    put_le(directory, 0, 2);               // disk number
+    put_le(directory, 0, 2);               // disk with directory
+    put_le(directory, members.size(), 2);
+    put_le(directory, members.size(), 2);
+    put_le(directory, directory_size, 4);
+    put_le(directory, directory_offset, 4);
+    put_le(directory, 0, 2);               // comment length
+
+    file.write(directory.data(), directory.size());
+    file.close();
+    if (!file)
+        throw std::runtime_error("Failed to finish writing "
+                                 + filename + ".");
+}
@@ -6,6 +6,19 @@
  * @author: Samuel Alipour-fard
  */
 #include <sstream>
+#include <fstream>
+#include <string>
+#include <limits>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include "fastjet/PseudoJet.hh"
 
 // Local imports
@@ -13,66 +26,436 @@
 #include "../../include/opendata_utils.h"
 
 
+namespace {
+    // =====================================
+    // Parsing Utilities
+    // =====================================
+    // First position at or after pos which is not a space or tab
+    const char* skip_blanks(const char* pos, const char* end) {
+        while (pos < end and (*pos == ' ' or *pos == '\t'))
+            ++pos;
+        return pos;
+    }
+
+    // End of the line starting at pos (its newline, or the end)
+    const char* line_end(const char* pos, const char* end) {
+        const void* newline = memchr(pos, '\n', end - pos);
+        return newline ? static_cast<const char*>(newline) : end;
+    }
+
+    // Reads a number starting at pos (after any blanks), moving
+    // pos past it; returns false if there is no number there
+    template <typename T>
+    bool parse_value(const char*& pos, const char* end, T& value) {
+        pos = skip_blanks(pos, end);
+        const std::from_chars_result result = std::from_chars(pos, end,
+                                                              value);
+        if (result.ec != std::errc())
+            return false;
+        pos = result.ptr;
+        return true;
+    }
+
+
+    // =====================================
+    // Binary Jet Datasets
+    // =====================================
+    const char DATASET_MAGIC[8] = "ECSJETS";
+    const uint32_t DATASET_VERSION = 1;
+    // (read back differently on machines of the other byte order)
+    const uint32_t BYTE_ORDER_MARK = 0x01020304;
+    // Alignment of each section from the start of the file
+    const size_t SECTION_ALIGNMENT = 64;
+
+    struct DatasetHeader {
+        char     magic[8];
+        uint32_t version;
+        uint32_t byte_order;
+        uint64_t njets;
+        uint64_t nparticles;
+        uint64_t pt_offset;
+        uint64_t eta_offset;
+        uint64_t phi_offset;
+        uint64_t index_offset;
+    };
+    static_assert(sizeof(DatasetHeader) == 64,
+                  "Dataset header should not be padded.");
+    static_assert(sizeof(od::JetDataset::JetEntry) == 16,
+                  "Dataset index should not be padded.");
+
+    uint64_t align_section(const uint64_t offset) {
+        return (offset + SECTION_ALIGNMENT - 1)
+               / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+    }
+}
+
+
 namespace od
 {
     // =====================================
-    // File Reading Utilities
+    // Memory-Mapped Files
     // =====================================
+    MappedFile::MappedFile(const std::string& filename,
+                           const bool sequential) {
+        const int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("od::MappedFile: Error: "
+                                     "Input file not found: "
+                                     + filename);
+        }
+
+        struct stat file_info;
+        if (fstat(fd, &file_info) != 0) {
+            close(fd);
+            throw std::runtime_error("od::MappedFile: Error: "
+                                     "Could not read " + filename);
+        }
+        size_ = static_cast<size_t>(file_info.st_size);
+
+        // (empty files cannot be mapped, but have no contents anyway)
+        if (size_ > 0) {
+            void* mapped = mmap(nullptr, size_, PROT_READ,
+                                MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error("od::MappedFile: Error: "
+                                         "Could not map " + filename
+                                         + " into memory.");
+            }
+            data_ = static_cast<const char*>(mapped);
+            if (sequential)
+                madvise(mapped, size_, MADV_SEQUENTIAL);
+        }
+        // (the mapping stays valid once the file is closed)
+        close(fd);
+    }
+
+    MappedFile::~MappedFile() {
+        if (data_ != nullptr) {
+            munmap(const_cast<char*>(data_), size_);
+        }
+    }
+
+
+    // =====================================
+    // Binary Jet Datasets
+    // =====================================
+    JetDataset::JetDataset(const std::string& filename)
+            : file(filename) {
+        if (not is_dataset(filename)) {
+            throw std::runtime_error("od::JetDataset: Error: "
+                                     + filename + " is not a binary "
+                                     "jet dataset.");
+        }
+
+        DatasetHeader header;
+        if (file.size() < sizeof(header)) {
+            throw std::runtime_error("od::JetDataset: Error: "
+                                     + filename + " is truncated.");
+        }
+        memcpy(&header, file.data(), sizeof(header));
+        if (header.version != DATASET_VERSION
+                or header.byte_order != BYTE_ORDER_MARK) {
+            throw std::runtime_error("od::JetDataset: Error: "
+                                     + filename + " was written by an "
+                                     "incompatible version or machine; "
+                                     "please convert it again.");
+        }
+
+        // Checking that every section lies within the file
+        const uint64_t column_size = header.nparticles*sizeof(float);
+        const uint64_t index_size  = header.njets*sizeof(JetEntry);
+        if (header.pt_offset + column_size > file.size()
+                or header.eta_offset + column_size > file.size()
+                or header.phi_offset + column_size > file.size()
+                or header.index_offset + index_size > file.size()) {
+            throw std::runtime_error("od::JetDataset: Error: "
+                                     + filename + " is truncated.");
+        }
+
+        njets      = header.njets;
+        nparticles = header.nparticles;
+        pt  = reinterpret_cast<const float*>(file.data()
+                                             + header.pt_offset);
+        eta = reinterpret_cast<const float*>(file.data()
+                                             + header.eta_offset);
+        phi = reinterpret_cast<const float*>(file.data()
+                                             + header.phi_offset);
+        index = reinterpret_cast<const JetEntry*>(file.data()
+                                                  + header.index_offset);
+    }
+
+    bool JetDataset::is_dataset(const std::string& filename) {
+        std::ifstream source(filename, std::ios::binary);
+        char magic[sizeof(DATASET_MAGIC)];
+        return source.read(magic, sizeof(magic))
+               and memcmp(magic, DATASET_MAGIC, sizeof(magic)) == 0;
+    }
+
+    void JetDataset::read_jet(const size_t ijet,
+                              JetConstituents& jet) const {
+        if (ijet >= njets) {
+            throw std::out_of_range("od::JetDataset: Error: Jet "
+                                    + std::to_string(ijet) + " requested,"
+                                    " but there are only "
+                                    + std::to_string(njets) + " jets.");
+        }
+
+        const JetEntry& entry = index[ijet];
+        jet.event = entry.event;
+        jet.pt.assign(pt + entry.offset,
+                      pt + entry.offset + entry.count);
+        jet.eta.assign(eta + entry.offset,
+                       eta + entry.offset + entry.count);
+        jet.phi.assign(phi + entry.offset,
+                       phi + entry.offset + entry.count);
+    }
+
+    std::pair<size_t, size_t> JetDataset::shard(
+            const size_t ishard, const size_t nshards) const {
+        if (ishard >= nshards) {
+            throw std::invalid_argument("od::JetDataset: Error: Shard "
+                                        + std::to_string(ishard)
+                                        + " requested out of "
+                                        + std::to_string(nshards) + ".");
+        }
+        return {ishard*njets/nshards, (ishard+1)*njets/nshards};
+    }
+
+    std::vector<size_t> JetDataset::select_by_multiplicity(
+            const size_t min_mult, const size_t max_mult) const {
+        std::vector<size_t> selected;
+        for (size_t ijet = 0; ijet < njets; ++ijet) {
+            if (min_mult <= index[ijet].count
+                    and index[ijet].count <= max_mult) {
+                selected.push_back(ijet);
+            }
+        }
+        return selected;
+    }
+
+
     /**
-    * @brief: Takes in a text file containing processed CMS Open Data.
-    *         Reads events into a given vector of PseudoJets when
-    *         read_event is called.
+    * @brief: Converts a text file of CMS Open Data to a binary jet
+    *         dataset, in two passes over the text (counting, and
+    *         then writing), so that memory use stays small for
+    *         large files.
     *
-    * @param: inputfile   The text file containing CMS Open Data
+    *         Momenta are stored as floats, i.e. to about seven
+    *         significant figures.
     */
-    EventReader::EventReader(const std::string& inputfile)
-                : current_event(0) {
-        source.open(inputfile);
-        if (!source.good()) {
-            throw std::runtime_error("od::EventReader: Error: "
-                                     "Input file not found.");
+    size_t write_jet_dataset(const std::string& textfile,
+                             const std::string& binaryfile) {
+        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+        // Counting jets and particles
+        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+        std::vector<JetDataset::JetEntry> index;
+        JetConstituents jet;
+        uint64_t nparticles = 0;
+        {
+            EventReader reader(textfile);
+            while (reader.read_jet(jet)) {
+                if (jet.size() > std::numeric_limits<uint32_t>::max()) {
+                    throw std::runtime_error("od::write_jet_dataset: "
+                                             "Error: Jet with too many "
+                                             "particles in " + textfile);
+                }
+                index.push_back({nparticles,
+                                 static_cast<uint32_t>(jet.size()),
+                                 static_cast<int32_t>(jet.event)});
+                nparticles += jet.size();
+            }
+        }
+
+        DatasetHeader header;
+        memcpy(header.magic, DATASET_MAGIC, sizeof(header.magic));
+        header.version      = DATASET_VERSION;
+        header.byte_order   = BYTE_ORDER_MARK;
+        header.njets        = index.size();
+        header.nparticles   = nparticles;
+        header.pt_offset    = align_section(sizeof(header));
+        header.eta_offset   = align_section(header.pt_offset
+                                            + nparticles*sizeof(float));
+        header.phi_offset   = align_section(header.eta_offset
+                                            + nparticles*sizeof(float));
+        header.index_offset = align_section(header.phi_offset
+                                            + nparticles*sizeof(float));
+
+        std::ofstream out(binaryfile, std::ios::binary | std::ios::trunc);
+        if (not out.is_open()) {
+            throw std::runtime_error("od::write_jet_dataset: Error: "
+                                     "Could not create " + binaryfile);
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+        // Writing each column
+        // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+        // (buffered, and written to each column in turn)
+        const size_t buffer_size = 1 << 20;
+        std::vector<float> pt_buffer, eta_buffer, phi_buffer;
+        uint64_t nwritten = 0;
+        auto flush = [&]() {
+            const uint64_t position = nwritten*sizeof(float);
+            const size_t nbytes = pt_buffer.size()*sizeof(float);
+            out.seekp(header.pt_offset + position);
+            out.write(reinterpret_cast<const char*>(pt_buffer.data()),
+                      nbytes);
+            out.seekp(header.eta_offset + position);
+            out.write(reinterpret_cast<const char*>(eta_buffer.data()),
+                      nbytes);
+            out.seekp(header.phi_offset + position);
+            out.write(reinterpret_cast<const char*>(phi_buffer.data()),
+                      nbytes);
+            nwritten += pt_buffer.size();
+            pt_buffer.clear(); eta_buffer.clear(); phi_buffer.clear();
+        };
+
+        EventReader reader(textfile);
+        while (reader.read_jet(jet)) {
+            pt_buffer.insert(pt_buffer.end(), jet.pt.begin(), jet.pt.end());
+            eta_buffer.insert(eta_buffer.end(),
+                              jet.eta.begin(), jet.eta.end());
+            phi_buffer.insert(phi_buffer.end(),
+                              jet.phi.begin(), jet.phi.end());
+            if (pt_buffer.size() >= buffer_size)
+                flush();
+        }
+        flush();
+
+        out.seekp(header.index_offset);
+        out.write(reinterpret_cast<const char*>(index.data()),
+                  index.size()*sizeof(JetDataset::JetEntry));
+
+        out.close();
+        if (not out or nwritten != nparticles) {
+            throw std::runtime_error("od::write_jet_dataset: Error: "
+                                     "Failed to write " + binaryfile);
         }
+        return index.size();
     }
 
-    EventReader::~EventReader() {
-        if (source.is_open()) {
-            source.close();
+
+    // =====================================
+    // File Reading Utilities
+    // =====================================
+    /**
+    * @brief: Takes in a file containing processed CMS Open Data,
+    *         either as text or as a binary jet dataset. Reads jets,
+    *         one at a time, when read_jet is called.
+    *
+    *         Text files are memory-mapped and parsed in a single
+    *         forward pass, without copying lines or creating streams.
+    *
+    * @param: inputfile   The file containing CMS Open Data
+    */
+    EventReader::EventReader(const std::string& inputfile) {
+        if (JetDataset::is_dataset(inputfile)) {
+            dataset = std::make_unique<JetDataset>(inputfile);
+        } else {
+            text = std::make_unique<MappedFile>(inputfile, true);
+            cursor = text->data();
         }
     }
 
-    bool EventReader::read_jet(
-            fastjet::PseudoJet& jet) {
-        std::string line;
-        while (std::getline(source, line)) {
-            if (line.substr(0, 4) == "#END") {
+    EventReader::EventReader(const SyntheticJetSettings& settings)
+            : synthetic(std::make_unique<SyntheticJets>(settings)) {}
+
+    /**
+    * @brief: Reads the constituents of the next jet, i.e. all
+    *         consecutive lines with the same event number.
+    *
+    *         The first line of the following jet is left unread
+    *         (one line of lookahead), so that no particles are lost.
+    *
+    * @return: bool  Whether a jet was read (false at the end of the
+    *                file, or at a line starting with #END)
+    */
+    bool EventReader::read_jet(JetConstituents& jet) {
+        jet.clear();
+        jet.event = -1;
+
+        if (dataset) {
+            if (next_jet >= dataset->size()) {
                 return false;
             }
-            if (line.substr(0, 1) == "#") {
+            dataset->read_jet(next_jet++, jet);
+            return true;
+        }
+        if (synthetic) {
+            synthetic->generate(next_jet++, jet);
+            return true;
+        }
+
+        const char* end = text->data() + text->size();
+        while (cursor < end) {
+            const char* eol = line_end(cursor, end);
+            const char* next_line = eol < end ? eol + 1 : end;
+            const char* pos = skip_blanks(cursor, eol);
+
+            // Skipping comments and blank lines
+            if (pos == eol or *pos == '\r' or *pos == '#') {
+                if (eol - pos >= 4 and strncmp(pos, "#END", 4) == 0) {
+                    cursor = end;
+                    break;
+                }
+                cursor = next_line;
                 continue;
             }
 
-            std::istringstream linestream(line);
             int event_number;
             double pt, eta, phi;
-            linestream >> event_number >> pt >> eta >> phi;
-
-            if (linestream.fail()) {
+            if (not (parse_value(pos, eol, event_number)
+                     and parse_value(pos, eol, pt)
+                     and parse_value(pos, eol, eta)
+                     and parse_value(pos, eol, phi))) {
                 throw std::runtime_error("od::EventReader: Error:"
-                   " Incorrect input format in line: " + line);
+                   " Incorrect input format in line: "
+                   + std::string(cursor, eol));
             }
 
-            if (event_number > current_event) {
-                current_event = event_number;
-                return true;
+            // Stopping at the first particle of the next jet
+            if (jet.size() > 0 and event_number != jet.event) {
+                break;
             }
 
-            double px = pt * cos(phi);
-            double py = pt * sin(phi);
-            double pz = pt * sinh(eta);
-            double E = sqrt(px * px + py * py + pz * pz);
-            jet = join(jet, fastjet::PseudoJet(px, py, pz, E));
+            jet.event = event_number;
+            jet.pt.push_back(pt);
+            jet.eta.push_back(eta);
+            jet.phi.push_back(phi);
+            cursor = next_line;
         }
-        return false;
+
+        return jet.size() > 0;
+    }
+
+    bool EventReader::read_jet(fastjet::PseudoJet& jet) {
+        if (not read_jet(jet_buffer)) {
+            jet = fastjet::PseudoJet();
+            return false;
+        }
+
+        jet_buffer.to_pseudojets(particle_buffer);
+        jet = join(particle_buffer);
+        return true;
+    }
+
+
+    bool EventReader::skip_jets(const size_t njets) {
+        if (dataset) {
+            const size_t nleft = dataset->size() - next_jet;
+            next_jet += std::min(njets, nleft);
+            return njets <= nleft;
+        }
+        if (synthetic) {
+            next_jet += njets;
+            return true;
+        }
+
+        for (size_t ijet = 0; ijet < njets; ++ijet)
+            if (not read_jet(jet_buffer))
+                return false;
+        return true;
     }
 
 
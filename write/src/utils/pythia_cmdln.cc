@@ -8,6 +8,10 @@
 #include <string>
 #include <string.h>
 #include <iostream>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -75,6 +79,9 @@ const int          _PID_2_DEFAULT    = 2212;
 const std::string  _OUTSTATE_DEFAULT = "qcd";
 const double       _ENERGY_DEFAULT   = 14000;
 
+const int          _PYTHIA_SEED_DEFAULT = 19780503;
+const int          _PYTHIA_SEED_MAX     = 900000000;
+
 
 // =====================================
 // Command Line Reading Utilities
@@ -229,8 +236,12 @@ int checkPythiaInputs(int argc, char* argv[]) {
 * @brief: Sets up a Pythia instance using given command line args
 *
 * @param: argc/argv         Command line input.
+*
+* @param: seed              Random seed (if positive; otherwise,
+*                           Pythia's default seed is used).
 */
-void setup_pythia_cmdln(Pythia8::Pythia &pythia, int argc, char* argv[]) {
+void setup_pythia_cmdln(Pythia8::Pythia &pythia, int argc, char* argv[],
+                        const int seed) {
     // ---------------------------------
     // Convert command line variables
     // ---------------------------------
@@ -408,6 +419,12 @@ void setup_pythia_cmdln(Pythia8::Pythia &pythia, int argc, char* argv[]) {
         }
     }
 
+    // Random numbers
+    if (seed > 0) {
+        pythia.readString("Random:setSeed = on");
+        pythia.readString("Random:seed = " + std::to_string(seed));
+    }
+
     // Misc. options
     pythia.readString("Next:numberCount = "+print_every);
 
@@ -436,6 +453,79 @@ void setup_pythia_cmdln(Pythia8::Pythia &pythia, int argc, char* argv[]) {
 }
 
 
+/**
+* @brief: Returns distinct seeds for independent Pythia instances,
+*         e.g. one for each worker thread. The first seed is the
+*         base seed itself, so that a single instance reproduces a
+*         serial run; the others are scrambled from the base seed
+*         (so that nearby base seeds do not share streams).
+*
+* @param: base_seed         Seed of the first instance, between 1
+*                           and _PYTHIA_SEED_MAX.
+* @param: n_streams         Number of instances.
+*
+* @return: std::vector<int> One seed per instance.
+*/
+std::vector<int> pythia_seeds(const int base_seed, const int n_streams) {
+    if (base_seed < 1 or base_seed > _PYTHIA_SEED_MAX)
+        throw std::invalid_argument("Pythia seeds must be between 1 and "
+                                    + std::to_string(_PYTHIA_SEED_MAX)
+                                    + " (given " + std::to_string(base_seed)
+                                    + ").");
+
+    // (SplitMix64 finalizer)
+    uint64_t scrambled = static_cast<uint64_t>(base_seed)
+                         + UINT64_C(0x9E3779B97F4A7C15);
+    scrambled = (scrambled ^ (scrambled >> 30))*UINT64_C(0xBF58476D1CE4E5B9);
+    scrambled = (scrambled ^ (scrambled >> 27))*UINT64_C(0x94D049BB133111EB);
+    scrambled ^= scrambled >> 31;
+
+    std::vector<int> seeds{base_seed};
+    for (int istream = 1; istream < n_streams; ++istream) {
+        int seed = 1 + static_cast<int>((scrambled + istream)
+                                        % _PYTHIA_SEED_MAX);
+        // (moving on to the next seed if already taken)
+        while (std::find(seeds.begin(), seeds.end(), seed) != seeds.end())
+            seed = seed % _PYTHIA_SEED_MAX + 1;
+        seeds.push_back(seed);
+    }
+    return seeds;
+}
+
+
+/**
+* @brief: Returns the seeds of the n_streams Pythia instances of one
+*         shard of a run, out of a single set of seeds for all of
+*         the instances of all of its shards (so that no two
+*         instances, in the same or in different shards, generate
+*         the same events).
+*
+* @param: base_seed         Seed of the run (see pythia_seeds).
+* @param: shard/nshards     Shard of the run, and the number of
+*                           shards (0 for an unsharded run).
+* @param: n_streams         Number of instances of each shard.
+*
+* @return: std::vector<int> One seed per instance of the shard;
+*                           those of an unsharded run, and of
+*                           shards with a single instance, are
+*                           the first of pythia_seeds(base_seed, .).
+*/
+std::vector<int> shard_pythia_seeds(const int base_seed,
+                                    const int shard, const int nshards,
+                                    const int n_streams) {
+    if (nshards > 0 and (shard < 0 or shard >= nshards))
+        throw std::invalid_argument("Shard " + std::to_string(shard)
+                                    + " is not one of the "
+                                    + std::to_string(nshards)
+                                    + " shards of the run.");
+
+    const int first = nshards > 0 ? shard*n_streams : 0;
+    const std::vector<int> run_seeds = pythia_seeds(base_seed,
+                                                    first + n_streams);
+    return std::vector<int>(run_seeds.begin() + first, run_seeds.end());
+}
+
+
 /**
 * @brief: Writes a header containing information used in event
 *         generation in Pythia using given command line args.
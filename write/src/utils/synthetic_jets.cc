@@ -0,0 +1,186 @@
+/**
+ * @file    synthetic_jets.cc
+ *
+ * @brief   A toy generator of jets with collinear and soft
+ *          enhancements, and the selection of the source of jets.
+ */
+#include <string>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+
+// Local imports
+#include "../../include/general_utils.h"
+#include "../../include/cmdln.h"
+#include "../../include/opendata_utils.h"
+#include "../../include/synthetic_jets.h"
+
+
+namespace {
+    // Smallest splitting angle, relative to the jet radius, and
+    // smallest energy fraction of the softer particle of a splitting
+    const double MIN_ANGLE_RATIO = 1e-3;
+    const double MIN_SOFT_FRACTION = 1e-3;
+
+    // Shape parameter of the negative binomial distribution of the
+    // multiplicity (larger is narrower)
+    const double MULTIPLICITY_SHAPE = 8;
+
+    // A constituent of a jet being generated: its energy fraction,
+    // position in (eta, phi) relative to the jet axis, and the
+    // largest angle at which it can split (angular ordering)
+    struct ShowerParticle {
+        double z, deta, dphi, max_angle;
+    };
+}
+
+
+// =====================================
+// Settings
+// =====================================
+SyntheticJetSettings synthetic_jet_settings(int argc, char* argv[],
+        const int seed, const double pt_min, const double pt_max,
+        const double eta_max, const double jet_rad) {
+    SyntheticJetSettings settings;
+    settings.seed = seed;
+    settings.multiplicity = cmdln_double("synthetic_mult", argc, argv,
+                                         settings.multiplicity);
+    settings.fixed_multiplicity = cmdln_bool("synthetic_fixed_mult",
+                                             argc, argv, false);
+
+    // (for e+e- collisions, without a finite radius or largest
+    //  transverse momentum, jets of radius 1 and the smallest pT)
+    settings.pt_min  = pt_min;
+    settings.pt_max  = std::isfinite(pt_max) ? pt_max : pt_min;
+    settings.eta_max = std::isfinite(eta_max) ? eta_max : 0;
+    settings.jet_rad = std::min(jet_rad, 1.);
+
+    if (settings.multiplicity < 1)
+        throw std::invalid_argument(
+            "Synthetic jets need a multiplicity of at least one "
+            "(--synthetic_mult).");
+    if (not (0 < settings.pt_min and settings.pt_min <= settings.pt_max)
+            or not (0 < settings.jet_rad))
+        throw std::invalid_argument(
+            "Synthetic jets need 0 < pt_min <= pt_max and a positive "
+            "jet radius.");
+    return settings;
+}
+
+
+// =====================================
+// Jet Sources
+// =====================================
+std::string jet_source_cmdln(int argc, char* argv[],
+                             const bool default_use_opendata) {
+    const bool use_opendata = cmdln_bool("use_opendata", argc, argv,
+                                         default_use_opendata);
+    const std::string source = cmdln_string("source", argc, argv, "");
+    if (source.empty())
+        return use_opendata ? "opendata" : "pythia";
+
+    if (source != "opendata" and source != "pythia"
+            and source != "synthetic")
+        throw std::invalid_argument("Unknown source of jets " + source
+                + " (--source must be opendata, pythia or synthetic).");
+    // (synthetic jets are neither Open Data nor Pythia events)
+    for (int iarg = 0; iarg < argc; ++iarg)
+        if (str_eq(argv[iarg], "--use_opendata")
+                and (source == "synthetic"
+                     or use_opendata != (source == "opendata")))
+            throw std::invalid_argument(
+                "--use_opendata contradicts --source " + source + ".");
+    return source;
+}
+
+
+// =====================================
+// Synthetic Jets
+// =====================================
+SyntheticJets::SyntheticJets(const SyntheticJetSettings& settings)
+        : settings_(settings) {}
+
+
+void SyntheticJets::generate(const uint64_t ijet,
+                             od::JetConstituents& jet) const {
+    jet.clear();
+    jet.event = static_cast<int>(ijet);
+
+    // (a stream of random numbers for each jet, so that jets can be
+    //  generated in any order)
+    std::seed_seq seeds{static_cast<uint32_t>(settings_.seed),
+                        static_cast<uint32_t>(ijet),
+                        static_cast<uint32_t>(ijet >> 32)};
+    std::mt19937_64 rng(seeds);
+    std::uniform_real_distribution<double> uniform(0, 1);
+
+    // ---------------------------------
+    // Multiplicity and jet kinematics
+    // ---------------------------------
+    size_t nparts = static_cast<size_t>(
+            std::llround(settings_.multiplicity));
+    if (not settings_.fixed_multiplicity) {
+        std::negative_binomial_distribution<int> multiplicity(
+                MULTIPLICITY_SHAPE, MULTIPLICITY_SHAPE
+                /(MULTIPLICITY_SHAPE + settings_.multiplicity));
+        nparts = std::max(2, multiplicity(rng));
+    }
+
+    const double pt_jet = settings_.pt_min
+            + (settings_.pt_max - settings_.pt_min)*uniform(rng);
+    const double eta_jet = settings_.eta_max*(2*uniform(rng) - 1);
+    const double phi_jet = TWOPI*uniform(rng);
+
+    // ---------------------------------
+    // Shower
+    // ---------------------------------
+    const double min_angle = MIN_ANGLE_RATIO*settings_.jet_rad;
+    std::vector<ShowerParticle> particles;
+    particles.reserve(nparts);
+    particles.push_back({1, 0, 0, settings_.jet_rad});
+
+    while (particles.size() < nparts) {
+        // Particle to split, with probability proportional to its
+        // energy fraction
+        double target = uniform(rng);
+        size_t isplit = 0;
+        while (isplit+1 < particles.size()
+                and (target -= particles[isplit].z) > 0)
+            ++isplit;
+        const ShowerParticle parent = particles[isplit];
+
+        // Angle from d(theta)/theta, energy fraction of the softer
+        // particle from dz/z, and direction of the splitting
+        const double max_angle = std::max(parent.max_angle, min_angle);
+        const double angle = max_angle*std::pow(min_angle/max_angle,
+                                                uniform(rng));
+        const double z_soft = MIN_SOFT_FRACTION*std::pow(
+                0.5/MIN_SOFT_FRACTION, uniform(rng));
+        const double alpha = TWOPI*uniform(rng);
+
+        // (keeping the direction of the parent as the weighted mean
+        //  of those of the daughters)
+        const double deta = angle*std::cos(alpha),
+                     dphi = angle*std::sin(alpha);
+        particles[isplit] = {parent.z*(1 - z_soft),
+                             parent.deta - z_soft*deta,
+                             parent.dphi - z_soft*dphi, angle};
+        particles.push_back({parent.z*z_soft,
+                             parent.deta + (1 - z_soft)*deta,
+                             parent.dphi + (1 - z_soft)*dphi, angle});
+    }
+
+    // ---------------------------------
+    // Constituents
+    // ---------------------------------
+    for (const ShowerParticle& particle : particles) {
+        jet.pt.push_back(pt_jet*particle.z);
+        jet.eta.push_back(eta_jet + particle.deta);
+        // (in [0, 2pi), as in fastjet)
+        double phi = std::fmod(phi_jet + particle.dphi, TWOPI);
+        jet.phi.push_back(phi < 0 ? phi + TWOPI : phi);
+    }
+}
@@ -0,0 +1,296 @@
+/**
+ * @file    telemetry.cc
+ *
+ * @brief   Rate-limited progress and throughput reports of a run,
+ *          printed to stderr and written to an optional status file.
+ */
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <ctime>
+#include <cstdio>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+
+#include <unistd.h>
+
+// Local imports
+#include "../../include/general_utils.h"
+#include "../../include/cmdln.h"
+#include "../../include/telemetry.h"
+
+
+namespace {
+    // Name of the units of work of the given order
+    std::string work_unit_name(const int order) {
+        switch (order) {
+            case 1:  return "particles";
+            case 2:  return "pairs";
+            case 3:  return "triples";
+            case 4:  return "quadruples";
+            default: return "tuples";
+        }
+    }
+
+    // Rate with a metric prefix, e.g. "12.3k" (or "?" if not known)
+    std::string format_rate(double rate) {
+        if (not std::isfinite(rate))
+            return "?";
+        const std::string prefixes[] = {"", "k", "M", "G", "T"};
+        int iprefix = 0;
+        while (rate >= 1000 and iprefix < 4) {
+            rate /= 1000;
+            ++iprefix;
+        }
+        std::stringstream ss;
+        ss << std::setprecision(3) << rate << prefixes[iprefix];
+        return ss.str();
+    }
+
+    // Duration as h:mm:ss
+    std::string format_duration(const double seconds) {
+        if (not std::isfinite(seconds))
+            return "?";
+        const long long total = std::llround(seconds);
+        std::stringstream ss;
+        ss << total/3600 << ":" << std::setfill('0')
+           << std::setw(2) << (total/60) % 60 << ":"
+           << std::setw(2) << total % 60;
+        return ss.str();
+    }
+
+    // (with null for rates and times which are not known yet)
+    std::string json_number(const double value) {
+        if (not std::isfinite(value))
+            return "null";
+        std::stringstream ss;
+        ss << std::setprecision(10) << value;
+        return ss.str();
+    }
+}
+
+
+// =====================================
+// Settings
+// =====================================
+TelemetrySettings telemetry_settings(int argc, char* argv[],
+                                     const int work_order,
+                                     const bool print) {
+    TelemetrySettings settings;
+    settings.interval = cmdln_double("progress_interval", argc, argv,
+            isatty(STDERR_FILENO) ? settings.interval : 30);
+    settings.print = print;
+    settings.status_file = cmdln_string("status_file", argc, argv, "");
+    settings.work_order = work_order;
+
+    if (not (settings.interval > 0))
+        throw std::invalid_argument("--progress_interval must be "
+                                    "positive.");
+    return settings;
+}
+
+
+// =====================================
+// Telemetry
+// =====================================
+RunTelemetry::RunTelemetry(const int64_t total_events_,
+                           const TelemetrySettings& settings_,
+                           const int64_t events_done)
+        : settings(settings_),
+          total_events(total_events_), initial_events(events_done),
+          terminal(isatty(STDERR_FILENO)),
+          work_unit(work_unit_name(settings_.work_order)),
+          events(events_done), jets(0), work(0) {
+    start = snapshot();
+    if (not settings.print and settings.status_file.empty())
+        return;
+
+    // (so that a status file which cannot be written stops the run
+    //  right away)
+    report(start, start, "running");
+
+    reporter = std::thread([this]() {
+        const std::chrono::duration<double> interval(settings.interval);
+        Snapshot previous = start;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        while (not wake.wait_for(lock, interval,
+                                 [this]() { return stopping; })) {
+            const Snapshot current = snapshot();
+            try {
+                report(current, previous, "running");
+            } catch (const std::runtime_error& error) {
+                std::cerr << "\nWarning: " << error.what()
+                          << " (no longer writing the status file)\n";
+                settings.status_file.clear();
+            }
+            previous = current;
+        }
+    });
+}
+
+
+RunTelemetry::~RunTelemetry() {
+    try {
+        stop("stopped");
+    } catch (const std::exception& error) {
+        std::cerr << "\nWarning: " << error.what() << "\n";
+    }
+}
+
+
+void RunTelemetry::finish() {
+    stop("done");
+}
+
+
+uint64_t RunTelemetry::work_units(const size_t nparts) const {
+    // (binomial(nparts, work_order), exactly)
+    uint64_t units = 1;
+    for (int k = 0; k < settings.work_order; ++k) {
+        if (nparts <= static_cast<size_t>(k))
+            return 0;
+        units = units*(nparts - k)/(k + 1);
+    }
+    return units;
+}
+
+
+RunTelemetry::Snapshot RunTelemetry::snapshot() const {
+    Snapshot current;
+    current.events = events.load(std::memory_order_relaxed);
+    current.jets   = jets.load(std::memory_order_relaxed);
+    current.work   = work.load(std::memory_order_relaxed);
+    current.time   = std::chrono::steady_clock::now();
+    return current;
+}
+
+
+/**
+* @brief: Prints (to stderr) and writes (to the status file) the
+*         progress of the run, with rates over the interval since
+*         the previous snapshot.
+*/
+void RunTelemetry::report(const Snapshot& current,
+                          const Snapshot& previous,
+                          const std::string& state) {
+    const double seconds = std::chrono::duration<double>(
+            current.time - previous.time).count();
+    const double elapsed = std::chrono::duration<double>(
+            current.time - start.time).count();
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    const double event_rate = seconds > 0 ?
+            (current.events - previous.events)/seconds : nan;
+    const double jet_rate = seconds > 0 ?
+            (current.jets - previous.jets)/seconds : nan;
+    const double work_rate = seconds > 0 ?
+            (current.work - previous.work)/seconds : nan;
+
+    // Remaining time, at the mean rate of the run so far
+    const double mean_event_rate = elapsed > 0 ?
+            (current.events - initial_events)/elapsed : 0;
+    const int64_t remaining = std::max<int64_t>(
+            total_events - current.events, 0);
+    const double eta = state == "done" or remaining == 0 ? 0
+            : mean_event_rate > 0 ? remaining/mean_event_rate
+            : std::numeric_limits<double>::infinity();
+
+    const double fraction = total_events > 0 ?
+            std::min(1., double(current.events)/total_events) : 1;
+    const size_t rss = current_rss_bytes();
+
+    // ---------------------------------
+    // Printing
+    // ---------------------------------
+    if (settings.print) {
+        std::stringstream line;
+        if (terminal) {
+            const int complete = static_cast<int>(PBWIDTH*fraction);
+            line << "\r[" << std::string(complete, PBCHAR)
+                 << std::string(PBWIDTH - complete, EMCHAR) << "] ";
+        } else {
+            line << "Progress: ";
+        }
+        line << std::setprecision(3) << 100*fraction << "% ("
+             << current.events << "/" << total_events << " events) | "
+             << format_rate(event_rate) << " events/s | "
+             << format_rate(jet_rate) << " jets/s | "
+             << format_rate(work_rate) << " " << work_unit << "/s | "
+             << "ETA " << format_duration(eta) << " | "
+             << "RSS " << format_bytes(rss);
+
+        // (overwriting the whole of the previous line on terminals)
+        std::string text = line.str();
+        const size_t length = text.size();
+        if (terminal and length < last_line_length)
+            text += std::string(last_line_length - length, ' ');
+        last_line_length = length;
+
+        std::cerr << text << (terminal and state == "running" ?
+                              "" : "\n") << std::flush;
+    }
+
+    // ---------------------------------
+    // Status file
+    // ---------------------------------
+    // (written to a temporary file which then replaces the previous
+    //  status, so that readers never see a partial status)
+    if (not settings.status_file.empty()) {
+        const std::string tmp_filename = settings.status_file + ".tmp";
+        std::ofstream file(tmp_filename);
+        if (not file)
+            throw std::runtime_error("Could not write status file "
+                                     + tmp_filename + ".");
+
+        file << "{\n"
+             << "  \"state\": \"" << state << "\",\n"
+             << "  \"time\": " << std::time(nullptr) << ",\n"
+             << "  \"elapsed_seconds\": " << json_number(elapsed) << ",\n"
+             << "  \"events_done\": " << current.events << ",\n"
+             << "  \"events_total\": " << total_events << ",\n"
+             << "  \"fraction_done\": " << json_number(fraction) << ",\n"
+             << "  \"jets\": " << current.jets << ",\n"
+             << "  \"work\": " << current.work << ",\n"
+             << "  \"work_unit\": \"" << work_unit << "\",\n"
+             << "  \"events_per_second\": " << json_number(event_rate)
+             << ",\n"
+             << "  \"jets_per_second\": " << json_number(jet_rate)
+             << ",\n"
+             << "  \"work_per_second\": " << json_number(work_rate)
+             << ",\n"
+             << "  \"eta_seconds\": " << json_number(eta) << ",\n"
+             << "  \"rss_bytes\": " << rss << "\n"
+             << "}\n";
+        file.close();
+
+        if (not file or std::rename(tmp_filename.c_str(),
+                                    settings.status_file.c_str()) != 0)
+            throw std::runtime_error("Could not write status file "
+                                     + settings.status_file + ".");
+    }
+}
+
+
+/**
+* @brief: Stops the reporting thread, and makes the final report,
+*         with the mean rates of the whole run.
+*/
+void RunTelemetry::stop(const std::string& state) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping)
+            return;
+        stopping = true;
+    }
+    wake.notify_all();
+
+    if (not reporter.joinable())
+        return;
+    reporter.join();
+    report(snapshot(), start, state);
+}
@@ -0,0 +1,125 @@
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+
+#include "../include/angle_sort.h"
+
+
+// =======================================
+// Parameters for sorting tests
+// =======================================
+// Jet multiplicities typical of CMS Open Data jets
+std::vector<size_t> multiplicities{20, 40, 60, 80, 100, 150};
+
+// Number of jets to sort at each multiplicity
+int njets = 200;
+
+// Jet radius
+double R_jet = 0.5;
+
+
+// =======================================
+// Sorting tests
+// =======================================
+// Pairwise Delta R for a jet with randomly placed constituents;
+// some particles are duplicated, to test ties
+std::vector<double> random_angles(const size_t nparts,
+                                  std::mt19937& rng) {
+    std::uniform_real_distribution<double> coord(-R_jet, R_jet);
+    std::vector<double> rap(nparts), phi(nparts);
+    for (size_t i = 0; i < nparts; ++i) {
+        if (i > 0 and i % 7 == 0) {
+            rap[i] = rap[i-1]; phi[i] = phi[i-1];
+        } else {
+            rap[i] = coord(rng); phi[i] = coord(rng);
+        }
+    }
+
+    std::vector<double> angles(nparts*nparts);
+    for (size_t i = 0; i < nparts; ++i)
+        for (size_t j = 0; j < nparts; ++j)
+            angles[i*nparts + j] = std::sqrt(
+                    std::pow(rap[i]-rap[j], 2) + std::pow(phi[i]-phi[j], 2));
+    return angles;
+}
+
+
+// Sorts the neighbours of every particle of the jet,
+// in the way the ENC executables do (particle i first)
+template <typename Sort>
+void sort_neighbours(const std::vector<double>& angles,
+                     const size_t nparts,
+                     std::vector<size_t>& neighbours,
+                     Sort sort) {
+    neighbours.resize(nparts*nparts);
+    for (size_t i = 0; i < nparts; ++i) {
+        size_t* row = &neighbours[i*nparts];
+        row[0] = i;
+        for (size_t j = 0, k = 1; j < nparts; ++j)
+            if (j != i) row[k++] = j;
+        sort(&angles[i*nparts], row + 1, nparts - 1);
+    }
+}
+
+
+int main (int argc, char* argv[]) {
+    std::mt19937 rng(12345);
+    AngleSorter sorter;
+    bool all_passed = true;
+
+    // Comparison sort used previously by the ENC executables
+    auto comparison_sort = [](const double* row_angles,
+                              size_t* first, const size_t n) {
+        std::sort(first, first + n,
+                  [row_angles](const size_t a, const size_t b) {
+                      return row_angles[a] < row_angles[b] or
+                             (row_angles[a] == row_angles[b] and a < b);
+                  });
+    };
+    auto angle_sort = [&sorter](const double* row_angles,
+                                size_t* first, const size_t n) {
+        sorter.sort(row_angles, first, n);
+    };
+
+    std::cout << "\tN \tstd::sort [us/jet] \tAngleSorter [us/jet] \tmatch\n";
+    for (const size_t nparts : multiplicities) {
+        std::vector<std::vector<double>> jets;
+        for (int ijet = 0; ijet < njets; ++ijet)
+            jets.push_back(random_angles(nparts, rng));
+
+        std::vector<size_t> expected, result;
+        bool match = true;
+        double time_std = 0, time_angle = 0;
+
+        for (const auto& angles : jets) {
+            auto start = std::chrono::high_resolution_clock::now();
+            sort_neighbours(angles, nparts, expected, comparison_sort);
+            auto mid   = std::chrono::high_resolution_clock::now();
+            sort_neighbours(angles, nparts, result, angle_sort);
+            auto end   = std::chrono::high_resolution_clock::now();
+
+            time_std   += std::chrono::duration<double,
+                                    std::micro>(mid - start).count();
+            time_angle += std::chrono::duration<double,
+                                    std::micro>(end - mid).count();
+            match = match and (expected == result);
+        }
+
+        std::cout << "\t" << nparts
+                  << std::fixed << std::setprecision(2)
+                  << " \t" << time_std/njets
+                  << " \t\t\t" << time_angle/njets
+                  << " \t\t\t" << (match ? "yes" : "NO") << "\n";
+        all_passed = all_passed and match;
+    }
+
+    if (not all_passed) {
+        std::cout << "AngleSorter disagrees with std::sort.\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,291 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <array>
+#include <string>
+#include <utility>
+#include <cmath>
+#include <algorithm>
+
+#include "fastjet/PseudoJet.hh"
+
+#include "../include/general_utils.h"
+#include "../include/cmdln.h"
+#include "../include/jet_geometry.h"
+#include "../include/nd_histogram.h"
+#include "../include/sparse_histogram.h"
+#include "../include/enc_engine.h"
+#include "../include/enc_kernels.h"
+#include "../include/enc_reference.h"
+#include "../include/opendata_utils.h"
+#include "../include/synthetic_jets.h"
+
+typedef ENCEngine<2> EECEngine;
+typedef ENCEngine<3> EEECEngine;
+typedef ENCEngine<4, PowerWeights, SelectablePhi> EEEECEngine;
+typedef ENCEngine<4, PowerWeights, SelectablePhi,
+                  SparseHistogram<5>> SparseEEEECEngine;
+
+
+// =======================================
+// Parameters for reference ENC tests
+// =======================================
+// (the number of jets, seed and tolerance can also be given on the
+//  command line, e.g. to test a new kernel on many more jets)
+int njets = 60;
+int seed = 1;
+// Largest difference between the kernels and the references,
+// relative to the largest bin of the histogram of each jet
+double rtol = 1e-10;
+
+// Largest multiplicity of the jets, lower for the four-particle
+// correlators, whose references take N^4 * (number of bins) steps
+int max_multiplicity = 16;
+int max_multiplicity_4particle = 10;
+
+// Binning (with the angles of synthetic jets of radius 0.5 filling
+// the underflow and overflow bins as well)
+double minbin = -2.5, maxbin = -0.5;
+int nbins = 10, nphibins = 6;
+
+// Energy weights (including non-integer weights)
+std::vector<EECEngine::nus_t> nus_2particle{{0.5}, {1}, {2.3}};
+std::vector<EEECEngine::nus_t> nus_3particle{{1, 1}, {0.5, 2},
+                                             {2.3, 0.7}};
+std::vector<EEEECEngine::nus_t> nus_4particle{{1, 1, 1},
+                                              {0.5, 1.5, 2}};
+std::vector<std::pair<double, double>> nus_2special{{1, 1}, {0.5, 2}};
+
+
+// =======================================
+// Reference ENC tests
+// =======================================
+// Reports a failed check
+bool check(const bool passed, const std::string& name) {
+    if (not passed)
+        std::cout << "\tFAILED: " << name << "\n";
+    return passed;
+}
+
+// Contents of a bin, by flat position
+template <size_t Rank>
+double bin_value(const NDHistogram<Rank>& hist, const size_t i) {
+    return hist[i];
+}
+template <size_t Rank>
+double bin_value(const SparseHistogram<Rank>& hist, const size_t i) {
+    return hist.at(i);
+}
+
+
+/**
+* @brief: Largest difference (relative to the largest bin) between
+*         the histograms of the references, and those of the kernels
+*         for each jet, printing the bin of any difference beyond the
+*         tolerance.
+*/
+class Comparison {
+public:
+    explicit Comparison(const std::string& name_) : name(name_) {}
+
+    template <size_t Rank, class Histogram>
+    void compare(const NDHistogram<Rank>& reference,
+                 const Histogram& kernel, const std::string& case_name) {
+        double scale = 0;
+        for (size_t i = 0; i < reference.size(); ++i)
+            scale = std::max(scale, std::abs(reference[i]));
+
+        for (size_t i = 0; i < reference.size(); ++i) {
+            const double diff = std::abs(bin_value(kernel, i)
+                                         - reference[i]);
+            const double rel_diff = scale > 0 ? diff/scale : diff;
+            if (not (rel_diff <= rtol) and passed) {
+                std::cout << "\t" << name << " (" << case_name
+                          << "): bin " << i << " is "
+                          << std::setprecision(15) << bin_value(kernel, i)
+                          << ", but " << reference[i]
+                          << " in the reference.\n";
+                passed = false;
+            }
+            if (not (rel_diff <= max_rel_diff))
+                max_rel_diff = rel_diff;
+        }
+    }
+
+    bool report() const {
+        std::stringstream ss;
+        ss << name << " matches the reference (largest relative "
+           << "difference " << std::scientific << std::setprecision(1)
+           << max_rel_diff << ")";
+        return check(passed, ss.str());
+    }
+
+private:
+    std::string name;
+    bool passed = true;
+    double max_rel_diff = 0;
+};
+
+
+// Synthetic jets of each multiplicity from 2 to max_mult in turn; a
+// copy of the first constituent is added to every third jet, giving
+// particles at zero angle and equal angles to other particles
+std::vector<std::vector<fastjet::PseudoJet>> test_jets(
+        const int max_mult) {
+    std::vector<std::vector<fastjet::PseudoJet>> jets(njets);
+    od::JetConstituents constituents;
+
+    for (int ijet = 0; ijet < njets; ++ijet) {
+        SyntheticJetSettings settings;
+        settings.seed = seed;
+        settings.multiplicity = 2 + ijet % (max_mult - 1);
+        settings.fixed_multiplicity = true;
+        SyntheticJets(settings).generate(ijet, constituents);
+
+        constituents.to_pseudojets(jets[ijet]);
+        if (ijet % 3 == 2)
+            jets[ijet].push_back(jets[ijet][0]);
+    }
+    return jets;
+}
+
+// Description of the settings used for a jet
+std::string case_name(const int ijet, const bool use_pt,
+                      const bool use_deltaR, const bool contact_terms) {
+    return "jet " + std::to_string(ijet)
+           + (use_pt ? ", pT" : ", energy")
+           + (use_deltaR ? ", Delta R" : ", real-space angles")
+           + (contact_terms ? ", contact terms" : "");
+}
+
+
+int main (int argc, char* argv[]) {
+    njets = cmdln_int("njets", argc, argv, njets);
+    seed  = cmdln_int("seed", argc, argv, seed);
+    rtol  = cmdln_double("rtol", argc, argv, rtol);
+
+    const BinAxis theta_axis(minbin, maxbin, nbins, "log", true, true);
+    const BinAxis ratio_axis(0, 1, nbins, "lin", false, false);
+    const BinAxis phi_axis(-PI, PI, nphibins, "linear", false, false);
+    const JetGeometry geometry(minbin, maxbin, nbins);
+
+    const std::vector<std::vector<fastjet::PseudoJet>>
+            jets = test_jets(max_multiplicity),
+            jets_4particle = test_jets(max_multiplicity_4particle);
+
+    Comparison penc("PENC"), re3c("RE3C"), re4c("RE4C"),
+               re4c_recursive("RE4C (recursive phi)"),
+               re4c_sparse("RE4C (sparse histograms)"),
+               two_special("two-special-particle correlator"),
+               old_3particle("old three-particle correlator");
+
+    for (int ijet = 0; ijet < njets; ++ijet) {
+        // Energy or pT weights, and Delta R or real-space angles, in
+        // turn, each with and without contact terms
+        const bool use_pt = ijet % 2 == 0;
+        const bool use_deltaR = (ijet/2) % 2 == 0;
+        const ReferenceJet jet(jets[ijet], use_pt, use_deltaR);
+        const ReferenceJet jet_4particle(jets_4particle[ijet],
+                                         use_pt, use_deltaR);
+
+        CompactJet compact_jet;
+        compact_jet.fill(jets[ijet], use_pt);
+        JetGeometry jet_geometry = geometry;
+        jet_geometry.fill(compact_jet, use_deltaR);
+
+        for (const bool contact_terms : {false, true}) {
+            const std::string name = case_name(ijet, use_pt, use_deltaR,
+                                               contact_terms);
+
+            // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+            // Projected and resolved ENCs
+            // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+            EECEngine eec(geometry, {}, phi_axis, nus_2particle,
+                          use_pt, use_deltaR, contact_terms);
+            eec.process_jet(jets[ijet]);
+            for (size_t inu = 0; inu < nus_2particle.size(); ++inu)
+                penc.compare(reference_penc(jet, theta_axis,
+                                            nus_2particle[inu][0],
+                                            contact_terms),
+                             eec.hist(inu), name);
+
+            EEECEngine eeec(geometry, {ratio_axis}, phi_axis,
+                            nus_3particle, use_pt, use_deltaR,
+                            contact_terms);
+            eeec.process_jet(jets[ijet]);
+            for (size_t inu = 0; inu < nus_3particle.size(); ++inu)
+                re3c.compare(reference_re3c(jet, theta_axis, ratio_axis,
+                                            phi_axis, nus_3particle[inu],
+                                            contact_terms),
+                             eeec.hist(inu), name);
+
+            for (const bool recursive_phi : {false, true}) {
+                SelectablePhi angle_policy;
+                angle_policy.recursive = recursive_phi;
+                EEEECEngine eeeec(geometry, {ratio_axis, ratio_axis},
+                                  phi_axis, nus_4particle, use_pt,
+                                  use_deltaR, contact_terms,
+                                  angle_policy);
+                eeeec.process_jet(jets_4particle[ijet]);
+                SparseEEEECEngine sparse_eeeec(geometry,
+                        {ratio_axis, ratio_axis}, phi_axis,
+                        nus_4particle, use_pt, use_deltaR,
+                        contact_terms, angle_policy);
+                sparse_eeeec.process_jet(jets_4particle[ijet]);
+
+                for (size_t inu = 0; inu < nus_4particle.size(); ++inu) {
+                    const NDHistogram<5> reference = reference_re4c(
+                            jet_4particle, theta_axis,
+                            {ratio_axis, ratio_axis}, phi_axis,
+                            nus_4particle[inu], recursive_phi,
+                            contact_terms);
+                    (recursive_phi ? re4c_recursive : re4c).compare(
+                            reference, eeeec.hist(inu), name);
+                    re4c_sparse.compare(reference,
+                                        sparse_eeeec.hist(inu), name);
+                }
+            }
+
+            // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+            // Other kernels
+            // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+            std::vector<NDHistogram<1>> hist_1(nus_2special.size(),
+                    NDHistogram<1>(NDHistogram<1>::shape_t{
+                            size_t(nbins)}));
+            std::vector<NDHistogram<2>> hist_2(nus_2special.size(),
+                    NDHistogram<2>(NDHistogram<2>::shape_t{
+                            size_t(nbins), size_t(nbins)}));
+            two_special_jet(compact_jet, jet_geometry, nus_2special,
+                            hist_1, hist_2, contact_terms);
+            for (size_t inu = 0; inu < nus_2special.size(); ++inu) {
+                const auto reference = reference_two_special(jet,
+                        theta_axis, nus_2special[inu], contact_terms);
+                two_special.compare(reference.first, hist_1[inu], name);
+                two_special.compare(reference.second, hist_2[inu], name);
+            }
+
+            NDHistogram<3> old_hist(NDHistogram<3>::shape_t{
+                    size_t(nbins), size_t(nbins), size_t(nphibins)});
+            old_3particle_jet(compact_jet, jet_geometry, ratio_axis,
+                              phi_axis, old_hist, contact_terms);
+            old_3particle.compare(reference_old_3particle(jet,
+                                          theta_axis, ratio_axis,
+                                          phi_axis, contact_terms),
+                                  old_hist, name);
+        }
+    }
+
+    bool all_passed = true;
+    for (const Comparison* comparison : {&penc, &re3c, &re4c,
+                                         &re4c_recursive, &re4c_sparse,
+                                         &two_special, &old_3particle})
+        all_passed &= comparison->report();
+
+    if (not all_passed) {
+        std::cout << "Reference ENC tests failed.\n";
+        return 1;
+    }
+    std::cout << "All reference ENC tests passed.\n";
+    return 0;
+}
@@ -146,6 +146,50 @@ void test_lin_hist(bool underflow, bool overflow) {
 }
 
 
+// Checks that BinAxis agrees with bin_position, including
+// which values are rejected; returns the number of disagreements
+int test_bin_axis(const std::vector<double>& vals,
+                  const double minbin, const double maxbin,
+                  const int nbins_finite, const std::string scheme,
+                  bool underflow, bool overflow) {
+    int nbins = nbins_finite;
+    if (underflow) nbins += 1;
+    if (overflow)  nbins += 1;
+
+    const BinAxis axis(minbin, maxbin, nbins, scheme,
+                       underflow, overflow);
+    std::vector<int> batch_bins(vals.size());
+    bool batch_valid = true;
+    try {
+        axis.bin_indices(vals.data(), vals.size(), batch_bins.data());
+    } catch (std::runtime_error) {
+        batch_valid = false;
+    }
+
+    int failures = 0;
+    for (unsigned int i=0; i < vals.size(); i++) {
+        int expected = -1, result = -1;
+        try {
+            expected = bin_position(vals[i], minbin, maxbin, nbins,
+                                    scheme, underflow, overflow);
+        } catch (std::runtime_error) {}
+        try {
+            result = axis.bin(vals[i]);
+        } catch (std::runtime_error) {}
+
+        if (result != expected or
+                (batch_valid and batch_bins[i] != expected)) {
+            std::cout << "\tBinAxis(" << vals[i] << ") = " << result
+                      << ", but bin_position gives " << expected
+                      << std::endl;
+            ++failures;
+        }
+        if (expected == -1) batch_valid = false;
+    }
+    return failures;
+}
+
+
 // =======================================
 // Main
 // =======================================
@@ -226,4 +270,27 @@ int main (int argc, char* argv[]) {
     std::cout << std::endl;
 
     test_lin_hist(false, true);
+
+
+    std::cout << "\n\n\n"
+    "// ==================================\n"
+    "// Testing BinAxis against bin_position\n"
+    "// ==================================\n";
+    std::cout << std::endl;
+
+    int failures = 0;
+    for (bool underflow : {false, true})
+        for (bool overflow : {false, true}) {
+            failures += test_bin_axis(log_test_vals,
+                                      minbin_log, maxbin_log,
+                                      nbins_finite_log, "log",
+                                      underflow, overflow);
+            failures += test_bin_axis(lin_test_vals,
+                                      minbin_lin, maxbin_lin,
+                                      nbins_finite_lin, "lin",
+                                      underflow, overflow);
+        }
+    std::cout << "\t" << failures << " disagreements." << std::endl;
+
+    return failures == 0 ? 0 : 1;
 }
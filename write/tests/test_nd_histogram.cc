@@ -0,0 +1,140 @@
+#include <iostream>
+#include <vector>
+#include <sstream>
+#include <cstdint>
+#include <stdexcept>
+
+#include "../include/nd_histogram.h"
+
+
+// =======================================
+// Parameters for histogram tests
+// =======================================
+// Shape of the test histogram, as in the three-particle ENC
+size_t nbins1 = 4, nbins2 = 3, nphibins = 6;
+
+
+// =======================================
+// N-dimensional histogram tests
+// =======================================
+// Reports a failed check
+bool check(const bool passed, const std::string& name) {
+    if (not passed)
+        std::cout << "\tFAILED: " << name << "\n";
+    return passed;
+}
+
+
+int main (int argc, char* argv[]) {
+    bool all_passed = true;
+
+    // Nested histogram, and the same values in an NDHistogram
+    std::vector<std::vector<std::vector<double>>> nested(nbins1,
+            std::vector<std::vector<double>>(nbins2,
+                std::vector<double>(nphibins)));
+    NDHistogram<3> hist(nbins1, nbins2, nphibins);
+
+    for (size_t i = 0; i < nbins1; ++i)
+        for (size_t j = 0; j < nbins2; ++j)
+            for (size_t k = 0; k < nphibins; ++k) {
+                nested[i][j][k] = 100*i + 10*j + k;
+                hist(i, j, k)   = 100*i + 10*j + k;
+            }
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Layout
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    all_passed &= check(hist.size() == nbins1*nbins2*nphibins, "size");
+    all_passed &= check(hist.stride(2) == 1 and
+                        hist.stride(1) == nphibins and
+                        hist.stride(0) == nbins2*nphibins, "strides");
+    all_passed &= check(
+            reinterpret_cast<std::uintptr_t>(hist.data()) % 64 == 0,
+            "alignment");
+    all_passed &= check(hist[hist.index(2, 1, 5)] == nested[2][1][5],
+                        "flat index");
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Views
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    const auto view = hist.view();
+    bool view_matches = view.size() == nbins1;
+    for (size_t i = 0; i < nbins1; ++i)
+        for (size_t j = 0; j < nbins2; ++j)
+            for (size_t k = 0; k < nphibins; ++k)
+                view_matches &= (view[i][j][k] == nested[i][j][k]);
+    all_passed &= check(view_matches, "view");
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Bulk operations
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    NDHistogram<3> doubled = hist;
+    doubled += hist;
+    NDHistogram<3> scaled = hist;
+    scaled.scale(2);
+    bool add_matches = true;
+    for (size_t ibin = 0; ibin < hist.size(); ++ibin)
+        add_matches &= (doubled[ibin] == 2*hist[ibin] and
+                        scaled[ibin] == 2*hist[ibin]);
+    all_passed &= check(add_matches, "add and scale");
+
+    // Projection onto theta1 and phi
+    NDHistogram<2> proj = hist.project<2>({0, 2});
+    bool proj_matches = proj.shape(0) == nbins1 and
+                        proj.shape(1) == nphibins;
+    for (size_t i = 0; i < nbins1; ++i)
+        for (size_t k = 0; k < nphibins; ++k) {
+            double sum = 0;
+            for (size_t j = 0; j < nbins2; ++j)
+                sum += nested[i][j][k];
+            proj_matches &= (proj(i, k) == sum);
+        }
+    all_passed &= check(proj_matches, "project");
+
+    // Merging pairs of phi bins
+    NDHistogram<3> rebinned = hist.rebin(2, 2);
+    bool rebin_matches = rebinned.shape(2) == nphibins/2;
+    for (size_t i = 0; i < nbins1; ++i)
+        for (size_t j = 0; j < nbins2; ++j)
+            for (size_t k = 0; k < nphibins/2; ++k)
+                rebin_matches &= (rebinned(i, j, k) ==
+                        nested[i][j][2*k] + nested[i][j][2*k+1]);
+    all_passed &= check(rebin_matches, "rebin");
+
+    // Saving and loading the raw bins (e.g. for checkpoints)
+    std::stringstream saved;
+    hist.save(saved);
+    NDHistogram<3> loaded(nbins1, nbins2, nphibins);
+    loaded.load(saved);
+    bool load_matches = true;
+    for (size_t ibin = 0; ibin < hist.size(); ++ibin)
+        load_matches &= (loaded[ibin] == hist[ibin]);
+    all_passed &= check(load_matches, "save and load");
+
+    // Invalid operations
+    bool threw = false;
+    try { hist.rebin(1, 2); }
+    catch (const std::invalid_argument&) { threw = true; }
+    all_passed &= check(threw, "rebin by a non-divisor");
+
+    threw = false;
+    try { hist += NDHistogram<3>(nbins1, nbins2, nphibins+1); }
+    catch (const std::invalid_argument&) { threw = true; }
+    all_passed &= check(threw, "adding histograms of different shapes");
+
+    threw = false;
+    try {
+        std::stringstream saved_other;
+        hist.save(saved_other);
+        NDHistogram<3>(nbins1, nbins2+1, nphibins).load(saved_other);
+    }
+    catch (const std::runtime_error&) { threw = true; }
+    all_passed &= check(threw, "loading a histogram of a different shape");
+
+    if (not all_passed) {
+        std::cout << "NDHistogram tests failed.\n";
+        return 1;
+    }
+    std::cout << "All NDHistogram tests passed.\n";
+    return 0;
+}
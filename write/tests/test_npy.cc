@@ -0,0 +1,125 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+
+#include "../include/npy_utils.h"
+
+
+// =======================================
+// Parameters for .npz tests
+// =======================================
+std::string filename = "test_npy.npz";
+// Shape of the test histogram
+size_t nrows = 3, ncols = 7;
+
+
+// =======================================
+// .npz tests
+// =======================================
+// Reports a failed check
+bool check(const bool passed, const std::string& name) {
+    if (not passed)
+        std::cout << "\tFAILED: " << name << "\n";
+    return passed;
+}
+
+
+// Little-endian integer at the given position
+uint64_t get_le(const std::string& bytes, const size_t pos,
+                const int nbytes) {
+    uint64_t value = 0;
+    for (int ibyte = nbytes; ibyte-- > 0;)
+        value = (value << 8)
+                | static_cast<unsigned char>(bytes[pos+ibyte]);
+    return value;
+}
+
+
+int main (int argc, char* argv[]) {
+    bool all_passed = true;
+
+    std::vector<double> hist(nrows*ncols);
+    for (size_t ibin = 0; ibin < hist.size(); ++ibin)
+        hist[ibin] = 0.5*ibin;
+    std::vector<int64_t> indices{0, 4, 2, 6};
+
+    {
+        NpzWriter npz(filename);
+        npz.add("hist", hist.data(), std::vector<size_t>{nrows, ncols});
+        npz.add("indices", indices.data(), std::vector<size_t>{2, 2});
+        npz.add("edges", std::vector<double>{0, 0.5, 1});
+        npz.add("energy", 14000.);
+        npz.add("level", std::string("hadron"));
+        npz.close();
+
+        bool threw = false;
+        try { npz.add("late", 1.); }
+        catch (const std::runtime_error&) { threw = true; }
+        all_passed &= check(threw, "adding after closing");
+    }
+
+    std::ifstream file(filename, std::ios::binary);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    const std::string bytes = buffer.str();
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Archive directory
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    const size_t eocd = bytes.size() - 22;
+    all_passed &= check(get_le(bytes, eocd, 4) == 0x06054b50,
+                        "end of central directory");
+    const size_t nmembers = get_le(bytes, eocd + 10, 2);
+    all_passed &= check(nmembers == 5, "number of members");
+
+    size_t entry = get_le(bytes, eocd + 16, 4);
+    std::vector<std::string> names;
+    bool members_valid = true, data_aligned = true;
+    for (size_t imember = 0; imember < nmembers; ++imember) {
+        members_valid &= (get_le(bytes, entry, 4) == 0x02014b50);
+        const size_t name_size = get_le(bytes, entry + 28, 2);
+        const size_t offset = get_le(bytes, entry + 42, 4);
+        names.push_back(bytes.substr(entry + 46, name_size));
+
+        // Local header, then the .npy header, then the data
+        members_valid &= (get_le(bytes, offset, 4) == 0x04034b50);
+        members_valid &= (get_le(bytes, offset + 14, 4)
+                          == get_le(bytes, entry + 16, 4));
+        const size_t npy = offset + 30 + name_size;
+        members_valid &= (bytes.compare(npy, 6, "\x93NUMPY") == 0);
+        const size_t data = npy + 10 + get_le(bytes, npy + 8, 2);
+        data_aligned &= (data % 64 == 0);
+
+        if (names.back() == "hist.npy") {
+            bool hist_matches = true;
+            for (size_t ibin = 0; ibin < hist.size(); ++ibin)
+                hist_matches &= (bytes.compare(data + 8*ibin, 8,
+                    reinterpret_cast<const char*>(&hist[ibin]), 8) == 0);
+            all_passed &= check(hist_matches, "histogram contents");
+            all_passed &= check(bytes.find("'shape': (3, 7), }", npy)
+                                < data, "histogram shape");
+        }
+
+        entry += 46 + name_size;
+    }
+    all_passed &= check(members_valid, "member headers");
+    all_passed &= check(data_aligned, "data alignment");
+    all_passed &= check(names == std::vector<std::string>{
+                            "hist.npy", "indices.npy", "edges.npy",
+                            "energy.npy", "level.npy"},
+                        "member names");
+
+    std::remove(filename.c_str());
+
+    if (not all_passed) {
+        std::cout << "NpzWriter tests failed.\n";
+        return 1;
+    }
+    std::cout << "All NpzWriter tests passed.\n";
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <stdexcept>
+
+#include "fastjet/PseudoJet.hh"
+
+#include "../include/pipeline.h"
+
+
+// =======================================
+// Parameters for pipeline tests
+// =======================================
+// Events, and particles in the single jet of each event
+int nevents = 200;
+int nparticles = 5;
+
+
+// =======================================
+// Pipeline tests
+// =======================================
+// Reports a failed check
+bool check(const bool passed, const std::string& name) {
+    if (not passed)
+        std::cout << "\tFAILED: " << name << "\n";
+    return passed;
+}
+
+
+/**
+* @brief: Runs a pipeline over nevents events, in small batches and
+*         queues (so that stages often wait on each other), in which
+*         the given stage throws at the given event or jet.
+*
+* @return: std::string  The message of the exception rethrown by
+*                       the pipeline (empty if none), with the
+*                       number of particles processed in count.
+*/
+std::string run_failing_pipeline(const std::string& failing_stage,
+                                 const int ifail,
+                                 std::atomic<int>& count) {
+    std::atomic<int> ievent(0), ifound(0), iprocessed(0);
+
+    auto next_event = [&](std::vector<fastjet::PseudoJet>& event) {
+        if (ievent >= nevents)
+            return false;
+        if (failing_stage == "events" and ievent == ifail)
+            throw std::runtime_error("events");
+        for (int ipart = 0; ipart < nparticles; ++ipart)
+            event.push_back(fastjet::PseudoJet(1, ipart, 0, 10));
+        ++ievent;
+        return true;
+    };
+
+    auto find_jets = [&](const std::vector<fastjet::PseudoJet>& event,
+                         std::unique_ptr<fastjet::ClusterSequence>&,
+                         std::vector<fastjet::PseudoJet>& jets) {
+        if (failing_stage == "jets" and ifound++ == ifail)
+            throw std::runtime_error("jets");
+        jets.push_back(fastjet::join(event));
+    };
+
+    auto process_jet = [&](const int,
+                           const std::vector<fastjet::PseudoJet>& jet) {
+        if (failing_stage == "kernels" and iprocessed++ == ifail)
+            throw std::runtime_error("kernels");
+        count += jet.size();
+    };
+
+    PipelineSettings settings;
+    settings.jet_finders = 2;
+    settings.kernels = 2;
+    settings.queue_size = 2;
+    settings.batch_size = 1;
+
+    try {
+        run_jet_pipeline(next_event, find_jets, process_jet, settings);
+    } catch (const std::runtime_error& error) {
+        return error.what();
+    }
+    return "";
+}
+
+
+int main (int argc, char* argv[]) {
+    bool all_passed = true;
+
+    // Every particle of every event reaches the kernels
+    std::atomic<int> count(0);
+    all_passed &= check(run_failing_pipeline("", -1, count).empty()
+                        and count == nevents*nparticles,
+                        "all jets processed");
+
+    // Errors in each stage are rethrown once the pipeline has
+    // stopped, rather than terminating the program
+    for (const std::string stage : {"events", "jets", "kernels"}) {
+        for (const int ifail : {0, nevents/2}) {
+            count = 0;
+            const std::string message = run_failing_pipeline(
+                    stage, ifail, count);
+            all_passed &= check(message == stage
+                                and count < nevents*nparticles,
+                                "error in " + stage + " at "
+                                + std::to_string(ifail));
+        }
+    }
+
+    if (not all_passed) {
+        std::cout << "Pipeline tests failed.\n";
+        return 1;
+    }
+    std::cout << "All pipeline tests passed.\n";
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <set>
+
+#include "Pythia8/Pythia.h"
+
+#include "../include/pythia_cmdln.h"
+
+
+// =======================================
+// Parameters for seed tests
+// =======================================
+// Base seeds of the runs tested, including the largest allowed seed
+// (whose scrambled seeds wrap around)
+const std::vector<int> base_seeds = {1, 2, 42, 12345,
+                                     _PYTHIA_SEED_DEFAULT,
+                                     _PYTHIA_SEED_MAX};
+// Largest numbers of shards and of threads per shard tested
+int max_shards = 16;
+int max_threads = 16;
+
+
+// =======================================
+// Seed tests
+// =======================================
+// Reports a failed check
+bool check(const bool passed, const std::string& name) {
+    if (not passed)
+        std::cout << "\tFAILED: " << name << "\n";
+    return passed;
+}
+
+
+/**
+* @brief: Checks that no two Pythia instances of a run, in the same
+*         or in different shards, share a seed, and that all seeds
+*         are valid.
+*/
+bool check_distinct(const int base_seed, const int nshards,
+                    const int n_threads) {
+    const std::string name = "distinct seeds of " + std::to_string(nshards)
+                             + " shards of " + std::to_string(n_threads)
+                             + " threads, from seed "
+                             + std::to_string(base_seed);
+
+    std::set<int> seen;
+    int n_seeds = 0;
+    for (int shard = 0; shard < std::max(nshards, 1); ++shard) {
+        for (const int seed : shard_pythia_seeds(base_seed, shard,
+                                                 nshards, n_threads)) {
+            if (seed < 1 or seed > _PYTHIA_SEED_MAX)
+                return check(false, name + " (invalid seed)");
+            seen.insert(seed);
+            ++n_seeds;
+        }
+    }
+
+    return check(n_seeds == std::max(nshards, 1)*n_threads
+                 and static_cast<int>(seen.size()) == n_seeds, name);
+}
+
+
+int main (int argc, char* argv[]) {
+    bool all_passed = true;
+
+    for (const int base_seed : base_seeds) {
+        // Every thread of every shard has its own seed
+        for (int nshards = 0; nshards <= max_shards; ++nshards)
+            for (int n_threads = 1; n_threads <= max_threads; ++n_threads)
+                all_passed &= check_distinct(base_seed, nshards,
+                                             n_threads);
+
+        // Unsharded runs, and shards with a single thread, keep the
+        // seeds they had before threads were given seeds of their own
+        const std::vector<int> seeds = pythia_seeds(base_seed,
+                                                    max_shards);
+        all_passed &= check(shard_pythia_seeds(base_seed, 0, 0,
+                                               max_shards) == seeds,
+                            "unsharded seeds from seed "
+                            + std::to_string(base_seed));
+        for (int shard = 0; shard < max_shards; ++shard)
+            all_passed &= check(shard_pythia_seeds(base_seed, shard,
+                                                   max_shards, 1)
+                                    == std::vector<int>{seeds[shard]},
+                                "seed of shard " + std::to_string(shard)
+                                + " from seed "
+                                + std::to_string(base_seed));
+    }
+
+    // Shards outside of the run are rejected
+    bool threw = false;
+    try {
+        shard_pythia_seeds(1, 4, 4, 2);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    all_passed &= check(threw, "shard outside of the run");
+
+    if (not all_passed) {
+        std::cout << "Seed tests failed.\n";
+        return 1;
+    }
+    std::cout << "All seed tests passed.\n";
+    return 0;
+}
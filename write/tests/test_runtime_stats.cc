@@ -0,0 +1,148 @@
+#include <iostream>
+#include <vector>
+#include <sstream>
+#include <random>
+#include <algorithm>
+#include <cmath>
+
+#include "../include/general_utils.h"
+#include "../include/runtime_stats.h"
+
+
+// =======================================
+// Parameters for runtime statistics tests
+// =======================================
+// Multiplicities and number of runtimes for each
+int max_multiplicity = 40;
+int nruntimes = 2000;
+
+
+// =======================================
+// Runtime statistics tests
+// =======================================
+// Reports a failed check
+bool check(const bool passed, const std::string& name) {
+    if (not passed)
+        std::cout << "\tFAILED: " << name << "\n";
+    return passed;
+}
+
+bool close(const double a, const double b, const double rtol) {
+    return std::abs(a - b) <= rtol*std::max(std::abs(a), std::abs(b));
+}
+
+// (with NaN, for multiplicities without runtimes, equal to itself)
+bool same(const std::vector<double>& a, const std::vector<double>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i)
+        if (a[i] != b[i] and not (std::isnan(a[i]) and std::isnan(b[i])))
+            return false;
+    return true;
+}
+
+
+int main (int argc, char* argv[]) {
+    bool all_passed = true;
+
+    // Log-normal runtimes growing with the multiplicity, filled
+    // into a single collector and, alternately, into two collectors
+    // (as by two threads) which are then merged
+    std::mt19937 rng(12345);
+    std::normal_distribution<double> log_runtime(0, 0.5);
+
+    RuntimeStatistics all, even, odd;
+    std::vector<std::vector<double>> runtimes(max_multiplicity + 1);
+    for (int iruntime = 0; iruntime < nruntimes; ++iruntime) {
+        for (int num = 2; num <= max_multiplicity; num += 2) {
+            const double runtime = num*num*std::exp(log_runtime(rng));
+            runtimes[num].push_back(runtime);
+            all.add(num, runtime);
+            (iruntime % 2 ? odd : even).add(num, runtime);
+        }
+    }
+    RuntimeStatistics merged = even;
+    merged.merge(odd);
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Moments and extrema
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    const std::vector<double> means = all.means(), stds = all.stds(),
+                              counts = all.counts(),
+                              mins = all.mins(), maxs = all.maxs();
+    all_passed &= check(means.size() == size_t(max_multiplicity + 1),
+                        "multiplicities");
+
+    bool moments_match = true, extrema_match = true,
+         empty_are_nan = true;
+    for (int num = 0; num <= max_multiplicity; ++num) {
+        if (runtimes[num].empty()) {
+            empty_are_nan &= std::isnan(means[num]) and counts[num] == 0;
+            continue;
+        }
+        moments_match &= close(means[num],
+                               vector_mean(runtimes[num]), 1e-10);
+        moments_match &= close(stds[num],
+                               vector_std(runtimes[num]), 1e-8);
+        moments_match &= counts[num] == runtimes[num].size();
+        extrema_match &= mins[num] == *std::min_element(
+                runtimes[num].begin(), runtimes[num].end());
+        extrema_match &= maxs[num] == *std::max_element(
+                runtimes[num].begin(), runtimes[num].end());
+    }
+    all_passed &= check(moments_match, "mean and stdev");
+    all_passed &= check(extrema_match, "min and max");
+    all_passed &= check(empty_are_nan, "empty multiplicities");
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Quantiles
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // (within the width of a latency bin, a tenth of a decade)
+    const std::vector<double> p50s = all.quantiles(0.5),
+                              p99s = all.quantiles(0.99);
+    bool quantiles_match = true;
+    for (int num = 2; num <= max_multiplicity; num += 2) {
+        std::vector<double> sorted = runtimes[num];
+        std::sort(sorted.begin(), sorted.end());
+        const double p50 = sorted[sorted.size()/2];
+        const double p99 = sorted[size_t(0.99*sorted.size())];
+        quantiles_match &= std::abs(std::log10(p50s[num]/p50)) < 0.1;
+        quantiles_match &= std::abs(std::log10(p99s[num]/p99)) < 0.1;
+    }
+    all_passed &= check(quantiles_match, "quantiles");
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Merging and saving
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    bool merge_matches = true;
+    const std::vector<double> merged_means = merged.means(),
+                              merged_stds = merged.stds(),
+                              merged_p99s = merged.quantiles(0.99);
+    for (int num = 2; num <= max_multiplicity; num += 2) {
+        merge_matches &= close(merged_means[num], means[num], 1e-10);
+        merge_matches &= close(merged_stds[num], stds[num], 1e-8);
+        merge_matches &= merged_p99s[num] == p99s[num];
+    }
+    all_passed &= check(merge_matches, "merge");
+
+    std::stringstream saved;
+    all.save(saved);
+    RuntimeStatistics loaded = odd;
+    loaded.load(saved);
+    all_passed &= check(same(loaded.means(), means) and
+                        same(loaded.counts(), counts) and
+                        same(loaded.quantiles(0.99), p99s),
+                        "save and load");
+
+    bool threw = false;
+    std::stringstream truncated(saved.str().substr(0, 100));
+    try { loaded.load(truncated); }
+    catch (const std::runtime_error&) { threw = true; }
+    all_passed &= check(threw, "loading truncated statistics");
+
+    if (not all_passed) {
+        std::cout << "RuntimeStatistics tests failed.\n";
+        return 1;
+    }
+    std::cout << "All RuntimeStatistics tests passed.\n";
+    return 0;
+}
@@ -0,0 +1,157 @@
+#include <iostream>
+#include <vector>
+#include <sstream>
+#include <random>
+#include <stdexcept>
+
+#include "../include/nd_histogram.h"
+#include "../include/sparse_histogram.h"
+
+
+// =======================================
+// Parameters for histogram tests
+// =======================================
+// Shape of the test histogram, as in the four-particle ENC
+size_t nbins = 7, nphibins = 5;
+// Number of random fills (fewer than the number of bins,
+// so that some bins stay empty)
+int nfills = 2000;
+
+
+// =======================================
+// Sparse histogram tests
+// =======================================
+// Reports a failed check
+bool check(const bool passed, const std::string& name) {
+    if (not passed)
+        std::cout << "\tFAILED: " << name << "\n";
+    return passed;
+}
+
+
+int main (int argc, char* argv[]) {
+    bool all_passed = true;
+
+    // Filling dense and sparse histograms with the same
+    // random entries
+    NDHistogram<5> dense(nbins, nbins, nphibins, nbins, nphibins);
+    // (starting from a small table, to exercise rehashing)
+    SparseHistogram<5> sparse(dense.shape(), 16);
+
+    std::mt19937 rng(12345);
+    std::uniform_int_distribution<size_t> theta_bin(0, nbins-1);
+    std::uniform_int_distribution<size_t> phi_bin(0, nphibins-1);
+    std::uniform_real_distribution<double> weight(0, 1);
+
+    for (int ifill = 0; ifill < nfills; ++ifill) {
+        size_t i = theta_bin(rng), j = theta_bin(rng),
+               k = phi_bin(rng), l = theta_bin(rng),
+               m = phi_bin(rng);
+        double w = weight(rng);
+        dense(i, j, k, l, m)  += w;
+        sparse(i, j, k, l, m) += w;
+    }
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Layout
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    all_passed &= check(sparse.num_bins() == dense.size(), "num_bins");
+    all_passed &= check(sparse.strides() == dense.strides(), "strides");
+    all_passed &= check(sparse.capacity() > 16 and
+                        2*sparse.nnz() <= sparse.capacity(), "rehash");
+
+    bool unravel_matches = true;
+    for (size_t ibin = 0; ibin < dense.size(); ibin += 37) {
+        const auto indices = sparse.unravel(ibin);
+        unravel_matches &= (dense.index(indices[0], indices[1],
+                                        indices[2], indices[3],
+                                        indices[4]) == ibin);
+    }
+    all_passed &= check(unravel_matches, "unravel");
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Contents
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    size_t nonzero = 0;
+    bool contents_match = true;
+    for (size_t ibin = 0; ibin < dense.size(); ++ibin) {
+        if (dense[ibin] != 0) ++nonzero;
+        contents_match &= (sparse.at(ibin) == dense[ibin]);
+    }
+    all_passed &= check(contents_match, "contents");
+    all_passed &= check(sparse.nnz() == nonzero, "nnz");
+
+    // Filled bins should be visited in the same order as
+    // the dense histogram
+    size_t last_index = 0, nvisited = 0;
+    bool order_matches = true;
+    sparse.for_each_bin([&](const std::array<size_t, 5>& bins,
+                            const double value) {
+        size_t flat_index = dense.index(bins[0], bins[1], bins[2],
+                                        bins[3], bins[4]);
+        order_matches &= (nvisited == 0 or flat_index > last_index);
+        order_matches &= (value == dense[flat_index]);
+        last_index = flat_index;
+        ++nvisited;
+    });
+    all_passed &= check(order_matches and nvisited == nonzero,
+                        "for_each_bin");
+
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    // Bulk operations
+    // -:-:-:-:-:-:-:-:-:-:-:-:-:-:-
+    SparseHistogram<5> doubled = sparse;
+    doubled += sparse;
+    SparseHistogram<5> scaled = sparse;
+    scaled.scale(2);
+    bool add_matches = doubled.nnz() == sparse.nnz();
+    for (size_t ibin = 0; ibin < dense.size(); ++ibin)
+        add_matches &= (doubled.at(ibin) == 2*dense[ibin] and
+                        scaled.at(ibin) == 2*dense[ibin]);
+    all_passed &= check(add_matches, "add and scale");
+
+    // Saving and loading the filled bins (e.g. for checkpoints),
+    // into a histogram with other bins already filled
+    std::stringstream saved;
+    sparse.save(saved);
+    SparseHistogram<5> loaded = doubled;
+    loaded[0] += 1;
+    loaded.load(saved);
+    bool load_matches = loaded.nnz() == sparse.nnz();
+    for (size_t ibin = 0; ibin < dense.size(); ++ibin)
+        load_matches &= (loaded.at(ibin) == dense[ibin]);
+    all_passed &= check(load_matches, "save and load");
+
+    // Invalid operations
+    bool threw = false;
+    try {
+        sparse += SparseHistogram<5>({nbins, nbins, nphibins,
+                                      nbins, nphibins+1});
+    }
+    catch (const std::invalid_argument&) { threw = true; }
+    all_passed &= check(threw, "adding histograms of different shapes");
+
+    // Memory limits, including the old table while resizing
+    SparseHistogram<5> limited({nbins, nbins, nphibins,
+                                nbins, nphibins}, 16);
+    limited.set_memory_limit(3*limited.memory_bytes());
+    size_t nfilled = 0;
+    threw = false;
+    try {
+        for (; nfilled < dense.size(); ++nfilled)
+            limited[nfilled] += 1;
+    }
+    catch (const std::runtime_error&) { threw = true; }
+    all_passed &= check(threw and nfilled == 16
+                        and limited.nnz() == 16
+                        and limited.memory_bytes()
+                            <= limited.get_memory_limit(),
+                        "memory limit");
+
+    if (not all_passed) {
+        std::cout << "SparseHistogram tests failed.\n";
+        return 1;
+    }
+    std::cout << "All SparseHistogram tests passed.\n";
+    return 0;
+}